@@ -11,6 +11,7 @@
 #include <stdarg.h>
 #include <syslog.h>
 #include <string.h>
+#include <stddef.h>
 #include <errno.h>
 #include <glib.h>
 #include <time.h>
@@ -252,16 +253,107 @@ ACAP_Get_Config(const char* service) {
  * HTTP Request Processing Implementation
  *------------------------------------------------------------------*/
 
-static pthread_t http_thread;
+static pthread_t http_threads[ACAP_MAX_HTTP_THREADS];
+static int http_thread_count = 0;
 static int http_thread_running = 0; // Flag to track thread state
 static pthread_mutex_t http_nodes_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t http_socket_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t http_accept_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 typedef struct {
     char path[ACAP_MAX_PATH_LENGTH];
     ACAP_HTTP_Callback callback;
 } HTTPNode;
 
-// Thread function for FastCGI processing
+// POST bodies come from a small pool so uploads of the same size reuse memory
+typedef struct {
+    size_t capacity;
+    char data[];
+} HTTPBody;
+
+static HTTPBody* http_body_pool[ACAP_HTTP_BODY_POOL];
+static int http_body_pool_count = 0;
+static size_t http_body_pool_bytes = 0;
+static pthread_mutex_t http_body_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static HTTPBody* ACAP_HTTP_Body_From_Data(void* data) {
+    return (HTTPBody*)((char*)data - offsetof(HTTPBody, data));
+}
+
+// Buffer for length bytes plus a terminating NUL
+static char* ACAP_HTTP_Acquire_Body(size_t length) {
+    size_t needed = length + 1;
+    HTTPBody* body = NULL;
+
+    pthread_mutex_lock(&http_body_mutex);
+    // Smallest pooled buffer that fits; otherwise recycle the largest one
+    int best = -1;
+    for (int i = 0; i < http_body_pool_count; i++) {
+        size_t capacity = http_body_pool[i]->capacity;
+        if (capacity >= needed && (best < 0 || capacity < http_body_pool[best]->capacity)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        for (int i = 0; i < http_body_pool_count; i++) {
+            if (best < 0 || http_body_pool[i]->capacity > http_body_pool[best]->capacity) {
+                best = i;
+            }
+        }
+    }
+    if (best >= 0) {
+        body = http_body_pool[best];
+        http_body_pool[best] = http_body_pool[--http_body_pool_count];
+        http_body_pool_bytes -= body->capacity;
+    }
+    pthread_mutex_unlock(&http_body_mutex);
+
+    if (body && body->capacity < needed) {
+        free(body);  // Contents are not needed, so no realloc copy
+        body = NULL;
+    }
+    if (!body) {
+        body = malloc(sizeof(HTTPBody) + needed);
+        if (!body) {
+            LOG_WARN("%s: Unable to allocate %zu bytes\n", __func__, needed);
+            return NULL;
+        }
+        body->capacity = needed;
+    }
+    return body->data;
+}
+
+void ACAP_HTTP_Release_Body(void* data) {
+    if (!data) {
+        return;
+    }
+    HTTPBody* body = ACAP_HTTP_Body_From_Data(data);
+
+    pthread_mutex_lock(&http_body_mutex);
+    if (http_body_pool_count < ACAP_HTTP_BODY_POOL &&
+        http_body_pool_bytes + body->capacity <= ACAP_HTTP_BODY_POOL_BYTES) {
+        http_body_pool[http_body_pool_count++] = body;
+        http_body_pool_bytes += body->capacity;
+        body = NULL;
+    }
+    pthread_mutex_unlock(&http_body_mutex);
+
+    free(body);
+}
+
+char* ACAP_HTTP_Take_Body(ACAP_HTTP_Request request, size_t* length) {
+    if (!request || !request->postData) {
+        if (length) *length = 0;
+        return NULL;
+    }
+    char* body = (char*)request->postData;
+    if (length) *length = request->postDataLength;
+    request->postData = NULL;
+    request->postDataLength = 0;
+    return body;
+}
+
+// Thread function for FastCGI processing (one per pool thread)
 void* fastcgi_thread_func(void* arg) {
     while (http_thread_running) {
         ACAP_HTTP_Process(); // Process FastCGI requests
@@ -276,14 +368,13 @@ static HTTPNode http_nodes[ACAP_MAX_HTTP_NODES];
 static int http_node_count = 0;
 
 
-static const char* get_path_without_query(const char* uri) {
-    static char path[ACAP_MAX_PATH_LENGTH];
+static const char* get_path_without_query(const char* uri, char* path, size_t path_size) {
     const char* query = strchr(uri, '?');
     
     if (query) {
         size_t path_length = query - uri;
-        if (path_length >= ACAP_MAX_PATH_LENGTH) {
-            path_length = ACAP_MAX_PATH_LENGTH - 1;
+        if (path_length >= path_size) {
+            path_length = path_size - 1;
         }
         strncpy(path, uri, path_length);
         path[path_length] = '\0';
@@ -292,6 +383,28 @@ static const char* get_path_without_query(const char* uri) {
     return uri;
 }
 
+// Opens the shared FastCGI socket once; all pool threads accept on it
+static int ACAP_HTTP_Socket(void) {
+    pthread_mutex_lock(&http_socket_mutex);
+    if (fcgi_sock == -1) {
+        const char* socket_path = getenv("FCGI_SOCKET_NAME");
+        if (!socket_path) {
+            LOG_WARN("Failed to get FCGI_SOCKET_NAME\n");
+        } else {
+            fcgi_sock = FCGX_OpenSocket(socket_path, 5);
+            if (fcgi_sock < 0) {
+                LOG_WARN("Failed to open FCGI socket\n");
+                fcgi_sock = -1;
+            } else {
+                chmod(socket_path, 0777);
+            }
+        }
+    }
+    int sock = fcgi_sock;
+    pthread_mutex_unlock(&http_socket_mutex);
+    return sock;
+}
+
 int ACAP_HTTP() {
 	LOG_TRACE("%s:\n",__func__);
     if (!initialized) {
@@ -301,17 +414,44 @@ int ACAP_HTTP() {
         }
         initialized = 1;
 
-        // Start the FastCGI thread
+        // Start the first FastCGI thread, ACAP_HTTP_Threads() grows the pool
         http_thread_running = 1;
-        if (pthread_create(&http_thread, NULL, fastcgi_thread_func, NULL) != 0) {
+        if (pthread_create(&http_threads[0], NULL, fastcgi_thread_func, NULL) != 0) {
             LOG_WARN("Failed to create FastCGI thread\n");
+            http_thread_running = 0;
             initialized = 0; // Roll back initialization
             return 0;
         }
+        http_thread_count = 1;
     }
     return 1;
 }
 
+int ACAP_HTTP_Threads(int count) {
+    if (!initialized || !http_thread_running) {
+        return 0;
+    }
+
+    if (count < 1) {
+        count = 1;
+    }
+    if (count > ACAP_MAX_HTTP_THREADS) {
+        LOG_WARN("%s: Limiting FastCGI pool to %d threads\n", __func__, ACAP_MAX_HTTP_THREADS);
+        count = ACAP_MAX_HTTP_THREADS;
+    }
+
+    while (http_thread_count < count) {
+        if (pthread_create(&http_threads[http_thread_count], NULL, fastcgi_thread_func, NULL) != 0) {
+            LOG_WARN("%s: Failed to create FastCGI thread %d\n", __func__, http_thread_count);
+            break;
+        }
+        http_thread_count++;
+    }
+
+    LOG_TRACE("%s: %d FastCGI threads\n", __func__, http_thread_count);
+    return http_thread_count;
+}
+
 void ACAP_HTTP_Cleanup() {
     LOG_TRACE("%s:", __func__);
 
@@ -319,17 +459,34 @@ void ACAP_HTTP_Cleanup() {
 		return;
 
     // Close the FastCGI socket
+    pthread_mutex_lock(&http_socket_mutex);
     if (fcgi_sock != -1) {
         close(fcgi_sock);
         fcgi_sock = -1;
     }
+    pthread_mutex_unlock(&http_socket_mutex);
 
-    // Stop the FastCGI thread
+    // Stop the FastCGI threads
     if (http_thread_running) {
-        http_thread_running = 0; // Signal the thread to stop
-		pthread_cancel(http_thread); // Request cancellation
-        pthread_join(http_thread, NULL); // Wait for the thread to finish
+        http_thread_running = 0; // Signal the threads to stop
+        for (int i = 0; i < http_thread_count; i++) {
+            pthread_cancel(http_threads[i]); // Request cancellation
+        }
+        for (int i = 0; i < http_thread_count; i++) {
+            pthread_join(http_threads[i], NULL); // Wait for the thread to finish
+        }
+        http_thread_count = 0;
+    }
+
+    // Drop pooled bodies; buffers still owned by requests are freed on release
+    pthread_mutex_lock(&http_body_mutex);
+    for (int i = 0; i < http_body_pool_count; i++) {
+        free(http_body_pool[i]);
     }
+    http_body_pool_count = 0;
+    http_body_pool_bytes = 0;
+    pthread_mutex_unlock(&http_body_mutex);
+
     initialized = 0;
 }
 
@@ -347,6 +504,36 @@ const char* ACAP_HTTP_Get_Content_Type(const ACAP_HTTP_Request request) {
     return FCGX_GetParam("CONTENT_TYPE", request->request->envp);
 }
 
+const char* ACAP_HTTP_Get_Accept(const ACAP_HTTP_Request request) {
+    if (!request || !request->request) {
+        return NULL;
+    }
+    return FCGX_GetParam("HTTP_ACCEPT", request->request->envp);
+}
+
+const char* ACAP_HTTP_Get_Header(const ACAP_HTTP_Request request, const char* name) {
+    if (!request || !request->request || !name) {
+        return NULL;
+    }
+
+    // FastCGI passes headers as HTTP_<NAME> with dashes turned into underscores
+    char param[128] = "HTTP_";
+    size_t len = strlen(param);
+    for (const char* p = name; *p && len < sizeof(param) - 1; p++) {
+        param[len++] = (*p == '-') ? '_' : (char)toupper((unsigned char)*p);
+    }
+    param[len] = '\0';
+    return FCGX_GetParam(param, request->request->envp);
+}
+
+int ACAP_HTTP_Match_ETag(const ACAP_HTTP_Request request, const char* etag) {
+    if (!etag) {
+        return 0;
+    }
+    const char* header = ACAP_HTTP_Get_Header(request, "If-None-Match");
+    return header && (strstr(header, etag) || strcmp(header, "*") == 0);
+}
+
 size_t ACAP_HTTP_Get_Content_Length(const ACAP_HTTP_Request request) {
     if (!request || !request->request) {
         return 0;
@@ -393,44 +580,51 @@ int ACAP_HTTP_Node(const char *nodename, ACAP_HTTP_Callback callback) {
 
 
 
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static void ACAP_HTTP_Unlock(void* mutex) {
+    pthread_mutex_unlock((pthread_mutex_t*)mutex);
+}
+
 void ACAP_HTTP_Process() {
 	FCGX_Request request;
     ACAP_HTTP_Request_DATA requestData = {0};
-    char* socket_path = NULL;
 
     if (!initialized)
 		return;
 
-    // Get socket path
-    socket_path = getenv("FCGI_SOCKET_NAME");
-    if (!socket_path) {
-        LOG_WARN("Failed to get FCGI_SOCKET_NAME\n");
-        return;
-    }
-
     // Open socket if not already open
-    if (fcgi_sock == -1) {
-        fcgi_sock = FCGX_OpenSocket(socket_path, 5);
-        if (fcgi_sock < 0) {
-            LOG_WARN("Failed to open FCGI socket\n");
-            return;
-        }
-        chmod(socket_path, 0777);
+    int sock = ACAP_HTTP_Socket();
+    if (sock < 0) {
+        sleep(1);
+        return;
     }
 
-    // Initialize request
-    if (FCGX_InitRequest(&request, fcgi_sock, 0) != 0) {
+    // Initialize request (each pool thread owns its own FCGX_Request)
+    if (FCGX_InitRequest(&request, sock, 0) != 0) {
         LOG_WARN("FCGX_InitRequest failed\n");
         return;
     }
 
-    // Accept the request
-    if (FCGX_Accept_r(&request) != 0) {
+    // Accept the request. Serialized as in the libfcgi threaded example;
+    // the cleanup handler releases the lock if the thread is cancelled here.
+    int accepted;
+    pthread_mutex_lock(&http_accept_mutex);
+    pthread_cleanup_push(ACAP_HTTP_Unlock, &http_accept_mutex);
+    accepted = FCGX_Accept_r(&request);
+    pthread_cleanup_pop(1);
+
+    if (accepted != 0) {
         FCGX_Free(&request, 1);
         return;
     }
 
     // Setup request data structure
+    requestData.startNs = monotonic_ns();
     requestData.request = &request;
     requestData.method = FCGX_GetParam("REQUEST_METHOD", request.envp);
     requestData.contentType = FCGX_GetParam("CONTENT_TYPE", request.envp);
@@ -439,11 +633,12 @@ void ACAP_HTTP_Process() {
     if (requestData.method && strcmp(requestData.method, "POST") == 0) {
         size_t contentLength = ACAP_HTTP_Get_Content_Length(&requestData);
         if (contentLength > 0 && contentLength < ACAP_MAX_BUFFER_SIZE) {
-            char* postData = malloc(contentLength + 1);
+            char* postData = ACAP_HTTP_Acquire_Body(contentLength);
 				if (postData) {
 					size_t bytesRead = FCGX_GetStr(postData, contentLength, request.in);
+					requestData.bodyReadNs = monotonic_ns() - requestData.startNs;
 					if (bytesRead < contentLength) {
-						free(postData);
+						ACAP_HTTP_Release_Body(postData);
 						goto cleanup;
 					}
 					postData[bytesRead] = '\0';
@@ -461,15 +656,18 @@ void ACAP_HTTP_Process() {
     }
 
     // Find and execute matching callback
-    const char* pathOnly = get_path_without_query(uriString);
+    char pathBuffer[ACAP_MAX_PATH_LENGTH];
+    const char* pathOnly = get_path_without_query(uriString, pathBuffer, sizeof(pathBuffer));
     ACAP_HTTP_Callback matching_callback = NULL;
 
+    pthread_mutex_lock(&http_nodes_mutex);
     for (int i = 0; i < http_node_count; i++) {
         if (strcmp(http_nodes[i].path, pathOnly) == 0) {
             matching_callback = http_nodes[i].callback;
             break;
         }
     }
+    pthread_mutex_unlock(&http_nodes_mutex);
 
     if (matching_callback) {
         matching_callback(&request, &requestData);
@@ -478,9 +676,8 @@ void ACAP_HTTP_Process() {
     }
 
 cleanup:
-    if (requestData.postData) {
-        free((void*)requestData.postData);
-    }
+    // NULL if the callback took ownership of the body
+    ACAP_HTTP_Release_Body((void*)requestData.postData);
     FCGX_Finish_r(&request);
     return;
 }
@@ -656,6 +853,19 @@ int ACAP_HTTP_Respond_JSON(ACAP_HTTP_Response response, cJSON* object) {
     return result;
 }
 
+int ACAP_HTTP_Respond_JSON_String(ACAP_HTTP_Response response, const char* json, size_t length) {
+    if (!response || !response->out || !json) {
+        return 0;
+    }
+
+    ACAP_HTTP_Respond_String(response,
+        "Content-Type: application/json; charset=utf-8\r\n"
+        "Content-Length: %zu\r\n"
+        "Cache-Control: no-cache\r\n\r\n", length);
+
+    return FCGX_PutStr(json, length, response->out) == (int)length;
+}
+
 int ACAP_HTTP_Respond_Data(ACAP_HTTP_Response response, size_t count, const void* data) {
     if (!response || !response->out || !data || count == 0) {
         LOG_WARN("Invalid response parameters\n");
@@ -684,6 +894,40 @@ int ACAP_HTTP_Respond_Error(ACAP_HTTP_Response response, int code, const char* m
     return 1;
 }
 
+int ACAP_HTTP_Respond_Error_Retry(ACAP_HTTP_Response response, int code, int retry_after, const char* message) {
+    if (retry_after <= 0) {
+        return ACAP_HTTP_Respond_Error(response, code, message);
+    }
+    if (!response || !message) {
+        return 0;
+    }
+
+    const char* error_type = (code < 500) ? "Client" : 
+                            (code < 600) ? "Server" : "Unknown";
+
+    ACAP_HTTP_Respond_String(response, 
+        "Status: %d %s Error\r\n"
+        "Retry-After: %d\r\n"
+        "Content-Type: text/plain\r\n"
+        "\r\n"
+        "%s", 
+        code, error_type, retry_after, message);
+
+    LOG_WARN("HTTP Error %d (retry after %d s): %s\n", code, retry_after, message);
+    return 1;
+}
+
+int ACAP_HTTP_Respond_Not_Modified(ACAP_HTTP_Response response, const char* etag) {
+    if (!response || !etag) {
+        return 0;
+    }
+
+    return ACAP_HTTP_Respond_String(response,
+        "Status: 304 Not Modified\r\n"
+        "ETag: %s\r\n"
+        "Cache-Control: no-cache\r\n\r\n", etag);
+}
+
 int ACAP_HTTP_Respond_Text(ACAP_HTTP_Response response, const char* message) {
     if (!response || !message) {
         return 0;
@@ -731,15 +975,18 @@ cJSON* ACAP_STATUS_Group(const char* name) {
         return NULL;
     }
 
+    pthread_mutex_lock(&status_mutex);
     cJSON* group = cJSON_GetObjectItem(status_container, name);
     if (!group) {
         group = cJSON_CreateObject();
         if (!group) {
+            pthread_mutex_unlock(&status_mutex);
             LOG_WARN("Failed to create status group: %s\n", name);
             return NULL;
         }
         cJSON_AddItemToObject(status_container, name, group);
     }
+    pthread_mutex_unlock(&status_mutex);
     return group;
 }
 
@@ -8,6 +8,7 @@
 #ifndef _ACAP_H_
 #define _ACAP_H_
 
+#include <stdint.h>
 #include <glib.h>
 #include "fcgi_stdio.h"
 #include "cJSON.h"
@@ -18,9 +19,12 @@ extern "C" {
 
 // Constants
 #define ACAP_MAX_HTTP_NODES 32
+#define ACAP_MAX_HTTP_THREADS 16
 #define ACAP_MAX_PATH_LENGTH 128
 #define ACAP_MAX_PACKAGE_NAME 30
 #define ACAP_MAX_BUFFER_SIZE (11 * 1024 * 1024)  // 11MB for image uploads
+#define ACAP_HTTP_BODY_POOL 4                    // Idle POST buffers kept for reuse
+#define ACAP_HTTP_BODY_POOL_BYTES (16 * 1024 * 1024)  // Upper bound on idle pooled memory
 
 
 // Return types
@@ -47,6 +51,8 @@ typedef struct {
     const char* method;      // Request method (GET, POST, etc.)
     const char* contentType; // Content-Type header
     const char* queryString; // Raw query string
+    uint64_t startNs;        // Accepted (CLOCK_MONOTONIC, ns)
+    uint64_t bodyReadNs;     // Time spent reading the POST body
 } ACAP_HTTP_Request_DATA;
 
 typedef ACAP_HTTP_Request_DATA* ACAP_HTTP_Request;
@@ -67,13 +73,24 @@ void		ACAP_Cleanup(void);
  * HTTP Functions
  *-----------------------------------------------------*/
 int 		ACAP_HTTP_Node(const char* nodename, ACAP_HTTP_Callback callback);
+// Grow the FastCGI accept pool to count threads (each serves one request at a time)
+int 		ACAP_HTTP_Threads(int count);
 
 // HTTP Request helpers
 const char* ACAP_HTTP_Get_Method(const ACAP_HTTP_Request request);
 const char* ACAP_HTTP_Get_Content_Type(const ACAP_HTTP_Request request);
+const char* ACAP_HTTP_Get_Accept(const ACAP_HTTP_Request request);
+// Request header by its HTTP name, e.g. "X-Deadline-Ms" (NULL if absent)
+const char* ACAP_HTTP_Get_Header(const ACAP_HTTP_Request request, const char* name);
+// If-None-Match names etag (quoted, as sent) or is "*", so the client's copy is current
+int 		ACAP_HTTP_Match_ETag(const ACAP_HTTP_Request request, const char* etag);
 size_t 		ACAP_HTTP_Get_Content_Length(const ACAP_HTTP_Request request);
 const char* ACAP_HTTP_Request_Param(const ACAP_HTTP_Request request, const char* param);
 cJSON* 		ACAP_HTTP_Request_JSON(const ACAP_HTTP_Request request, const char* param);
+// Take ownership of the POST body (NULL if none). Afterwards request->postData is NULL,
+// so read any body parameters first. Release with ACAP_HTTP_Release_Body from any thread.
+char*		ACAP_HTTP_Take_Body(ACAP_HTTP_Request request, size_t* length);
+void		ACAP_HTTP_Release_Body(void* body);
 
 // HTTP Response helpers
 int 		ACAP_HTTP_Header_XML(ACAP_HTTP_Response response);
@@ -85,8 +102,14 @@ int 		ACAP_HTTP_Header_FILE(ACAP_HTTP_Response response, const char* filename,
 // HTTP Response functions
 int 		ACAP_HTTP_Respond_String(ACAP_HTTP_Response response, const char* fmt, ...);
 int 		ACAP_HTTP_Respond_JSON(ACAP_HTTP_Response response, cJSON* object);
+// Already serialized JSON (length bytes, e.g. from a JsonWriter)
+int 		ACAP_HTTP_Respond_JSON_String(ACAP_HTTP_Response response, const char* json, size_t length);
 int 		ACAP_HTTP_Respond_Data(ACAP_HTTP_Response response, size_t count, const void* data);
 int 		ACAP_HTTP_Respond_Error(ACAP_HTTP_Response response, int code, const char* message);
+// Error with a Retry-After header of retry_after seconds (none when 0)
+int 		ACAP_HTTP_Respond_Error_Retry(ACAP_HTTP_Response response, int code, int retry_after, const char* message);
+// 304 Not Modified for a matching ACAP_HTTP_Match_ETag (no body)
+int 		ACAP_HTTP_Respond_Not_Modified(ACAP_HTTP_Response response, const char* etag);
 int 		ACAP_HTTP_Respond_Text(ACAP_HTTP_Response response, const char* message);
 
 /*-----------------------------------------------------
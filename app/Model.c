@@ -12,114 +12,262 @@
 #include <fcntl.h>
 #include <math.h>
 #include <sys/mman.h>
-#include <sys/time.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
 
 #include "larod.h"
 #include "ACAP.h"
 #include "Model.h"
 #include "jpeg_decoder.h"
+#include "preprocess.h"
+#include "resize.h"
 #include "labelparse.h"
-#include "model_params.h"
+#include "modelcache.h"
+#include "tflite.h"
 #include "cJSON.h"
+#include "jsonwriter.h"
+#include "latency.h"
+#include "applog.h"
 
-#define LOG(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args);}
-#define LOG_WARN(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args);}
+#define LOG(fmt, args...)    Log_Write(LOG_LEVEL_INFO, fmt, ## args)
+#define LOG_WARN(fmt, args...)    Log_Write(LOG_LEVEL_WARNING, fmt, ## args)
 #define LOG_TRACE(fmt, args...)   {}
 
 // Helper function prototypes
 static bool createAndMapTmpFile(char* fileName, size_t fileSize, void** mappedAddr, int* fd);
+static double elapsed_ms(const struct timespec* start);
 static float iou(float x1, float y1, float w1, float h1, float x2, float y2, float w2, float h2);
-static cJSON* non_maximum_suppression(cJSON* list);
-static cJSON* format_detections_for_api(cJSON* raw_detections, int image_index);
-static uint8_t* preprocess_rgb_letterbox(const uint8_t* rgb_in, int in_w, int in_h,
-                                         int out_w, int out_h);
-static int get_class_id_from_label(const char* label);
-
-// Model dimensions and parameters
-static unsigned int modelWidth = 640;
-static unsigned int modelHeight = 640;
-static unsigned int channels = 3;
-static unsigned int boxes = 0;
-static unsigned int classes = 0;
-static size_t inputs = 1;
-static size_t outputs = 1;
-static float quant = 1.0;
-static float quant_zero = 0;
-static float objectnessThreshold = 0.25;
-static float confidenceThreshold = 0.30;
-static float nms = 0.05;
-
-// Letterbox transformation tracking (for bbox coordinate conversion)
-static struct {
-    int original_width;
-    int original_height;
-    float scale;
-    int offset_x;
-    int offset_y;
-} letterbox_params = {0};
-
-// Larod handles
-static int larodModelFd = -1;
-static larodConnection* conn = NULL;
-static larodModel* InfModel = NULL;
-static larodJobRequest* infReq = NULL;
-static void* larodInputAddr = MAP_FAILED;
-static void* larodOutput1Addr = MAP_FAILED;
-static int larodInputFd = -1;
-static int larodOutput1Fd = -1;
-static larodTensor** inputTensors = NULL;
-static larodTensor** outputTensors = NULL;
-static size_t outputBufferSize = 0;
-
-// Labels
-static char** modelLabels = NULL;
-static size_t numLabels = 0;
-static const char* MODEL_PATH = "model/model.tflite";
-static const char* LABELS_PATH = "model/labels.txt";
+static void scale_transform(PreprocessScaleMode mode, int src_w, int src_h,
+                            int out_w, int out_h, ModelTransform* transform);
+static void region_transform(PreprocessScaleMode mode, int src_w, int src_h,
+                             const ModelRegion* region, int out_w, int out_h,
+                             ModelTransform* transform);
+static bool preprocess_rgb_scaled(ResizeFilter filter, const uint8_t* rgb_in, int in_w, int in_h,
+                                  uint8_t* out, int out_w, int out_h,
+                                  const ModelTransform* transform);
+static bool scaled_sink_begin(const DecodedImage* image, void* user_data);
+static void scaled_sink_row(const uint8_t* rgb, int y, void* user_data);
+
+// larod preprocessing jobs cached per slot, one per input geometry
+#define PREPROCESS_CACHE_SIZE 4
+
+// Raw output tensor -> candidates; one kernel per output data type, picked at load
+struct Candidates;
+typedef bool (*DecodeKernel)(const ModelContext* ctx, const uint8_t* output,
+                             struct Candidates* c);
+
+// Merged detections covering this much of a smaller box of their class
+// count as the same object (see Model_MergeDetections)
+#define MERGE_CONTAINED 0.8f
+
+typedef struct {
+    int width;
+    int height;
+    VdoFormat format;
+    int region_width;       // Cropped part of the frame (the whole frame if equal)
+    int region_height;
+    int item;               // Batch position written
+    PreprocessContext* pp;  // NULL if creation failed; not retried
+} PreprocessEntry;
+
+// Tensor slots: each owns a mapped input/output pair and its own job request,
+// so one frame can be written while another executes
+typedef struct {
+    ModelContext* ctx;
+    void* inputAddr;
+    void* outputAddr;
+    int inputFd;
+    int outputFd;
+    larodTensor** inputTensors;
+    larodTensor** outputTensors;
+    larodJobRequest* jobReq;
+    bool busy;              // Acquired by a request
+    ModelJobCallback callback;
+    void* userData;
+    PreprocessEntry preprocess[PREPROCESS_CACHE_SIZE];  // Write into inputFd
+    int preprocessCount;
+    int preprocessNext;     // Round-robin eviction
+} TensorSlot;
+
+// Everything a loaded model needs. Written once by Model_Create; afterwards
+// only the slot state (under slotLock) changes, so
+// all Model_* calls are safe from multiple threads.
+struct ModelContext {
+    // Model dimensions and parameters
+    unsigned int modelWidth;
+    unsigned int modelHeight;
+    unsigned int channels;
+    unsigned int batchSize;     // Images per job (input dims[0])
+    unsigned int boxes;
+    unsigned int classes;
+    size_t inputs;
+    size_t outputs;
+    float quant;
+    float quant_zero;
+    float objectnessThreshold;
+    int objectnessQuant;    // Smallest raw objectness passing the threshold (above range: none)
+    float confidenceThreshold;
+    float nms;
+    int nmsTopK;            // Highest-scoring candidates considered by NMS (0: all)
+    int maxDetections;      // Detections returned per output (0: all)
+    bool classAgnosticNms;  // Let boxes of different classes suppress each other
+    bool fusedDecode;       // Stream JPEG rows straight into the slot input
+    PreprocessScaleMode scaleMode;
+    bool larodPreprocess;   // Scale on larod cpu-proc instead of the CPU loop
+    ResizeFilter resizeFilter;  // CPU scaling filter
+
+    // Larod handles
+    char name[MODEL_NAME_SIZE];
+    char path[256];
+    char labelsPath[256];
+    cJSON* settings;            // Copy of the settings the context was created from
+    char device[MODEL_DEVICE_NAME_SIZE];    // larod device the model runs on
+    int dataType;               // larodTensorDataType of the output
+    size_t elementSize;         // Bytes per output value
+    DecodeKernel decode;        // Output decoder for dataType
+    double loadMs;              // Duration of Model_CreateFromSettings
+    int larodModelFd;
+    larodConnection* conn;
+    larodModel* InfModel;
+    size_t inputBufferSize;     // One image; slot tensors hold batchSize of them
+    size_t outputBufferSize;
+
+    // Tensor slots
+    TensorSlot slots[MAX_TENSOR_SLOTS];
+    int slotCount;
+    bool slotsStopped;
+    int jobsInFlight;       // Jobs submitted to larod and not yet completed
+    pthread_mutex_t slotLock;
+    pthread_cond_t slotChanged;
+
+    // Labels
+    char** modelLabels;
+    char* labelBuffer;
+    size_t numLabels;
+
+    // Postprocess statistics
+    pthread_mutex_t statsLock;
+    ModelPostprocessStats stats;
+};
+
+// Mapping from the tensor area covered by the image to a decoded (possibly
+// DCT-downscaled) image
+typedef struct {
+    int dst_x;              // Tensor rectangle covered by the image
+    int dst_y;
+    int dst_w;
+    int dst_h;
+    float src_x;            // Decoded position of the rectangle's top-left edge
+    float src_y;
+    float step_x;           // Decoded pixels per tensor pixel
+    float step_y;
+    int in_w;
+    int in_h;
+} Sampling;
+
+// State for scaling decoded JPEG rows straight into a tensor
+typedef struct {
+    uint8_t* tensor;
+    int out_w;
+    int out_h;
+    int expected_w;         // Dimensions the request claimed
+    int expected_h;
+    const ModelTransform* transform;
+    ResizeFilter filter;
+    Sampling sampling;
+    Resizer* resizer;       // Created once the decoded size is known
+    int in_w;               // Decoded (DCT-scaled) dimensions
+    int in_h;
+    bool mismatch;
+    bool failed;            // Resizer allocation failed
+} ScaledSink;
+
+static bool setup_slot(ModelContext* ctx, TensorSlot* slot, larodTensor** inputTensors,
+                       larodTensor** outputTensors);
+static void destroy_slot(TensorSlot* slot);
+static bool decode_candidates_u8(const ModelContext* ctx, const uint8_t* output,
+                                 struct Candidates* c);
+static bool decode_candidates_i8(const ModelContext* ctx, const uint8_t* output,
+                                 struct Candidates* c);
+static bool decode_candidates_f32(const ModelContext* ctx, const uint8_t* output,
+                                  struct Candidates* c);
+static bool slot_preprocess(ModelContext* ctx, TensorSlot* slot, int item,
+                            const uint8_t* frame, size_t frame_size,
+                            int width, int height, VdoFormat format,
+                            int original_width, int original_height,
+                            const ModelRegion* region, ModelTransform* transform);
 
 // Temp file patterns
-static char OBJECT_DETECTOR_INPUT_FILE_PATTERN[] = "/tmp/larod.in.test-XXXXXX";
-static char OBJECT_DETECTOR_OUT1_FILE_PATTERN[]  = "/tmp/larod.out1.test-XXXXXX";
-
-// Reference ID counter
-static int currentRefId = 0;
+static const char OBJECT_DETECTOR_INPUT_FILE_PATTERN[] = "/tmp/larod.in.test-XXXXXX";
+static const char OBJECT_DETECTOR_OUT1_FILE_PATTERN[]  = "/tmp/larod.out1.test-XXXXXX";
 
 //-----------------------------------------------------------------------------
 // Model Setup
 //-----------------------------------------------------------------------------
 
-bool Model_Setup(void) {
-    larodError* error = NULL;
+static const char* settings_string(const cJSON* settings, const char* key, const char* fallback) {
+    const cJSON* item = settings ? cJSON_GetObjectItem(settings, key) : NULL;
+    return cJSON_IsString(item) && item->valuestring[0] ? item->valuestring : fallback;
+}
 
-    // Connect to larod
-    if (!larodConnect(&conn, &error)) {
-        LOG_WARN("%s: Could not connect to larod\n", __func__);
-        larodClearError(&error);
-        return false;
+// Numeric setting; a value of another type is ignored with a warning
+static double settings_number(const cJSON* settings, const char* key, double fallback) {
+    const cJSON* item = settings ? cJSON_GetObjectItem(settings, key) : NULL;
+    if (!item) {
+        return fallback;
     }
+    if (!cJSON_IsNumber(item)) {
+        LOG_WARN("Setting %s is not a number, using %g\n", key, fallback);
+        return fallback;
+    }
+    return item->valuedouble;
+}
 
-    // Open model file
-    larodModelFd = open(MODEL_PATH, O_RDONLY);
-    if (larodModelFd < 0) {
-        LOG_WARN("%s: Could not open model %s: %s\n", __func__, MODEL_PATH, strerror(errno));
-        Model_Cleanup();
-        return false;
+static bool settings_bool(const cJSON* settings, const char* key, bool fallback) {
+    const cJSON* item = settings ? cJSON_GetObjectItem(settings, key) : NULL;
+    if (!item) {
+        return fallback;
+    }
+    if (!cJSON_IsBool(item)) {
+        LOG_WARN("Setting %s is not true or false, using %s\n", key, fallback ? "true" : "false");
+        return fallback;
+    }
+    return cJSON_IsTrue(item);
+}
+
+// The larod device to load on: cached (when still present), requested
+// (which must exist), else the first preferred device found. Sets ctx->device.
+static const larodDevice* select_device(ModelContext* ctx, const char* device_name,
+                                        const char* cached_device) {
+    larodError* error = NULL;
+
+    if (cached_device && cached_device[0]) {
+        const larodDevice* device = larodGetDevice(ctx->conn, cached_device, 0, &error);
+        larodClearError(&error);
+        if (device) {
+            snprintf(ctx->device, sizeof(ctx->device), "%s", cached_device);
+            LOG("Selected cached device: %s\n", ctx->device);
+            return device;
+        }
+        LOG_WARN("%s: Cached device %s not available, probing\n", __func__, cached_device);
     }
 
-    // Enumerate available devices and select the best one
     const char* chipString = NULL;
     const larodDevice* device = NULL;
 
     // List all available devices
     size_t numDevices = 0;
-    const larodDevice** deviceList = larodListDevices(conn, &numDevices, &error);
+    const larodDevice** deviceList = larodListDevices(ctx->conn, &numDevices, &error);
     if (!deviceList) {
         LOG_WARN("%s: Could not list devices: %s\n", __func__,
                  error ? error->msg : "unknown");
         larodClearError(&error);
-        Model_Cleanup();
-        return false;
+        return NULL;
     }
 
     LOG("Available larod devices: %zu\n", numDevices);
@@ -141,6 +289,23 @@ bool Model_Setup(void) {
         "cpu-tflite"                // CPU fallback
     };
 
+    // A requested device must exist; it is not replaced by another one
+    if (device_name) {
+        for (size_t i = 0; i < numDevices; i++) {
+            const char* name = larodGetDeviceName(deviceList[i], &error);
+            larodClearError(&error);
+            if (name && strcmp(name, device_name) == 0) {
+                device = deviceList[i];
+                chipString = name;
+                LOG("Selected device: %s\n", chipString);
+                goto device_selected;
+            }
+        }
+        LOG_WARN("%s: Device %s not available\n", __func__, device_name);
+        free(deviceList);
+        return NULL;
+    }
+
     // Try each preferred device in order
     for (size_t p = 0; p < sizeof(preferredDevices) / sizeof(preferredDevices[0]); p++) {
         for (size_t i = 0; i < numDevices; i++) {
@@ -168,584 +333,1753 @@ device_selected:
     if (!device) {
         LOG_WARN("%s: No larod devices available\n", __func__);
         free(deviceList);
-        Model_Cleanup();
-        return false;
+        return NULL;
     }
 
-    // Load model
-    InfModel = larodLoadModel(conn, larodModelFd, device, LAROD_ACCESS_PRIVATE,
-                             "object_detection", NULL, &error);
+    snprintf(ctx->device, sizeof(ctx->device), "%s", chipString ? chipString : "unknown");
 
-    // Clean up device list (just free the array, devices are managed by larod)
+    // Devices are owned by the connection; only the list is freed
     free(deviceList);
+    return device;
+}
+
+ModelContext* Model_Create(const char* model_path) {
+    return Model_CreateOnDevice(model_path, NULL);
+}
+
+// The "model" settings with path replaced by model_path
+ModelContext* Model_CreateOnDevice(const char* model_path, const char* device_name) {
+    cJSON* settings = ACAP_Get_Config("settings");
+    cJSON* model_settings = settings ? cJSON_GetObjectItem(settings, "model") : NULL;
+    cJSON* copy = model_settings ? cJSON_Duplicate(model_settings, 1) : cJSON_CreateObject();
+    if (!copy) {
+        LOG_WARN("%s: Could not allocate model settings\n", __func__);
+        return NULL;
+    }
+    cJSON_DeleteItemFromObject(copy, "path");
+    cJSON_AddStringToObject(copy, "path", model_path);
+
+    ModelContext* ctx = Model_CreateFromSettings("default", copy, device_name);
+    cJSON_Delete(copy);
+    return ctx;
+}
+
+ModelContext* Model_CreateFromSettings(const char* name, const cJSON* settings,
+                                       const char* device_name) {
+    larodError* error = NULL;
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    ModelContext* ctx = calloc(1, sizeof(ModelContext));
+    if (!ctx) {
+        LOG_WARN("%s: Could not allocate model context\n", __func__);
+        return NULL;
+    }
+
+    const char* model_path = settings_string(settings, "path", DEFAULT_MODEL_PATH);
+    const char* labels_path = settings_string(settings, "labels", DEFAULT_LABELS_PATH);
+    if (!device_name) {
+        device_name = settings_string(settings, "device", NULL);
+    }
+
+    ctx->modelWidth = 640;
+    ctx->modelHeight = 640;
+    ctx->channels = 3;
+    ctx->batchSize = 1;
+    ctx->inputs = 1;
+    ctx->outputs = 1;
+    ctx->quant = 1.0;
+    ctx->quant_zero = 0;
+    ctx->objectnessThreshold = 0.25;
+    ctx->confidenceThreshold = 0.30;
+    ctx->nms = 0.05;
+    ctx->fusedDecode = true;
+    ctx->scaleMode = SCALE_MODE_LETTERBOX;
+    ctx->larodPreprocess = true;
+    ctx->resizeFilter = RESIZE_BILINEAR;
+    ctx->larodModelFd = -1;
+    snprintf(ctx->name, sizeof(ctx->name), "%s", name ? name : "default");
+    snprintf(ctx->path, sizeof(ctx->path), "%s", model_path);
+    snprintf(ctx->labelsPath, sizeof(ctx->labelsPath), "%s", labels_path);
+    ctx->settings = settings ? cJSON_Duplicate(settings, 1) : cJSON_CreateObject();
+    pthread_mutex_init(&ctx->slotLock, NULL);
+    pthread_cond_init(&ctx->slotChanged, NULL);
+    pthread_mutex_init(&ctx->statsLock, NULL);
+    LOG("Loading model %s from %s\n", ctx->name, model_path);
+
+    // Connect to larod
+    if (!larodConnect(&ctx->conn, &error)) {
+        LOG_WARN("%s: Could not connect to larod\n", __func__);
+        larodClearError(&error);
+        Model_Destroy(ctx);
+        return NULL;
+    }
+
+    // Open model file
+    ctx->larodModelFd = open(model_path, O_RDONLY);
+    if (ctx->larodModelFd < 0) {
+        LOG_WARN("%s: Could not open model %s: %s\n", __func__, model_path, strerror(errno));
+        Model_Destroy(ctx);
+        return NULL;
+    }
+
+    // A previous load of the same file on the same device setting names the
+    // device to use, which skips probing the device list
+    char hash[MODEL_HASH_SIZE];
+    ModelDescription cached;
+    bool hashed = ModelCache_HashFile(ctx->larodModelFd, hash);
+    bool known = hashed && ModelCache_Lookup(hash, device_name, &cached);
+
+    const larodDevice* device = select_device(ctx, device_name, known ? cached.device : NULL);
+    if (!device) {
+        Model_Destroy(ctx);
+        return NULL;
+    }
 
-    if (!InfModel) {
+    // Load model
+    ctx->InfModel = larodLoadModel(ctx->conn, ctx->larodModelFd, device, LAROD_ACCESS_PRIVATE,
+                             "object_detection", NULL, &error);
+    if (!ctx->InfModel) {
         LOG_WARN("%s: Unable to load model: %s\n", __func__, error->msg);
         larodClearError(&error);
-        Model_Cleanup();
-        return false;
+        Model_Destroy(ctx);
+        return NULL;
     }
 
-    // Create model tensors for introspection
-    larodTensor** tempInputTensors = larodCreateModelInputs(InfModel, &inputs, &error);
+    // Tensors for introspection, kept as the tensors of the first slot
+    larodTensor** tempInputTensors = larodCreateModelInputs(ctx->InfModel, &ctx->inputs, &error);
     if (!tempInputTensors) {
         LOG_WARN("%s: Failed retrieving input tensors: %s\n", __func__, error->msg);
         larodClearError(&error);
-        Model_Cleanup();
-        return false;
+        Model_Destroy(ctx);
+        return NULL;
     }
 
-    larodTensor** tempOutputTensors = larodCreateModelOutputs(InfModel, &outputs, &error);
+    larodTensor** tempOutputTensors = larodCreateModelOutputs(ctx->InfModel, &ctx->outputs, &error);
     if (!tempOutputTensors) {
         LOG_WARN("%s: Failed retrieving output tensors: %s\n", __func__, error->msg);
         larodClearError(&error);
-        larodDestroyTensors(conn, &tempInputTensors, inputs, NULL);
-        Model_Cleanup();
-        return false;
+        larodDestroyTensors(ctx->conn, &tempInputTensors, ctx->inputs, NULL);
+        Model_Destroy(ctx);
+        return NULL;
     }
 
     // Get input dimensions (NHWC: batch, height, width, channels)
     const larodTensorDims* inputDims = larodGetTensorDims(tempInputTensors[0], &error);
     if (!inputDims) {
         LOG_WARN("%s: Failed to get input tensor dimensions\n", __func__);
-        larodDestroyTensors(conn, &tempInputTensors, inputs, NULL);
-        larodDestroyTensors(conn, &tempOutputTensors, outputs, NULL);
-        Model_Cleanup();
-        return false;
+        larodDestroyTensors(ctx->conn, &tempInputTensors, ctx->inputs, NULL);
+        larodDestroyTensors(ctx->conn, &tempOutputTensors, ctx->outputs, NULL);
+        Model_Destroy(ctx);
+        return NULL;
     }
 
-    modelHeight = inputDims->dims[1];
-    modelWidth = inputDims->dims[2];
-    channels = inputDims->dims[3];
+    ctx->modelHeight = inputDims->dims[1];
+    ctx->modelWidth = inputDims->dims[2];
+    ctx->channels = inputDims->dims[3];
+    ctx->batchSize = inputDims->dims[0] > 1 ? inputDims->dims[0] : 1;
 
-    LOG("Model input: %ux%ux%u\n", modelWidth, modelHeight, channels);
+    LOG("Model input: %ux%ux%u, batch %u\n",
+        ctx->modelWidth, ctx->modelHeight, ctx->channels, ctx->batchSize);
 
     // Get output dimensions (YOLOv5: [batch, boxes, stride])
     const larodTensorDims* outputDims = larodGetTensorDims(tempOutputTensors[0], &error);
     if (!outputDims) {
         LOG_WARN("%s: Failed to get output tensor dimensions\n", __func__);
-        larodDestroyTensors(conn, &tempInputTensors, inputs, NULL);
-        larodDestroyTensors(conn, &tempOutputTensors, outputs, NULL);
-        Model_Cleanup();
-        return false;
+        larodDestroyTensors(ctx->conn, &tempInputTensors, ctx->inputs, NULL);
+        larodDestroyTensors(ctx->conn, &tempOutputTensors, ctx->outputs, NULL);
+        Model_Destroy(ctx);
+        return NULL;
     }
 
-    boxes = outputDims->dims[1];
+    ctx->boxes = outputDims->dims[1];
     int stride = outputDims->dims[2];
-    classes = stride - 5;  // YOLOv5 format: x,y,w,h,objectness,class1...classN
-
-    LOG("Model output: %u boxes, %u classes, stride=%d\n", boxes, classes, stride);
+    ctx->classes = stride - 5;  // YOLOv5 format: x,y,w,h,objectness,class1...classN
+
+    LOG("Model output: %u boxes, %u classes, stride=%d\n", ctx->boxes, ctx->classes, stride);
+
+    // Output type and quantization. larod reports the type only, so scale and
+    // zero point are read from the model file; settings override them.
+    TFLiteTensorInfo outputInfo;
+    char* tfliteError = NULL;
+    bool described = TFLite_GetTensorInfo(ctx->larodModelFd, true, 0, &outputInfo, &tfliteError);
+    if (!described) {
+        LOG_WARN("%s: Could not read output tensor from %s: %s\n", __func__, model_path,
+                 tfliteError ? tfliteError : "unknown");
+        free(tfliteError);
+    }
 
-    // Get quantization parameters
     larodTensorDataType dataType = larodGetTensorDataType(tempOutputTensors[0], &error);
+    larodClearError(&error);
+    if (dataType == LAROD_TENSOR_DATA_TYPE_UNSPECIFIED && described) {
+        dataType = outputInfo.type == TFLITE_TYPE_UINT8 ? LAROD_TENSOR_DATA_TYPE_UINT8
+                 : outputInfo.type == TFLITE_TYPE_INT8 ? LAROD_TENSOR_DATA_TYPE_INT8
+                 : outputInfo.type == TFLITE_TYPE_FLOAT32 ? LAROD_TENSOR_DATA_TYPE_FLOAT32
+                 : dataType;
+    }
+    ctx->dataType = dataType;
+
     if (dataType == LAROD_TENSOR_DATA_TYPE_INT8 || dataType == LAROD_TENSOR_DATA_TYPE_UINT8) {
-        quant = QUANTIZATION_SCALE;
-        quant_zero = QUANTIZATION_ZERO_POINT;
-        LOG("Quantized model: data_type=%d, scale=%.15f, zero_point=%d\n",
-            dataType, quant, (int)quant_zero);
+        const cJSON* scaleItem = settings ? cJSON_GetObjectItem(settings, "quant_scale") : NULL;
+        const cJSON* zeroItem = settings ? cJSON_GetObjectItem(settings, "quant_zero_point") : NULL;
+        bool quantized = described && outputInfo.quantized;
+        if (cJSON_IsNumber(scaleItem) && scaleItem->valuedouble > 0) {
+            ctx->quant = scaleItem->valuedouble;
+        } else if (quantized) {
+            ctx->quant = outputInfo.scale;
+        } else {
+            LOG_WARN("%s: %s has no output quantization; set quant_scale\n", __func__, model_path);
+            larodDestroyTensors(ctx->conn, &tempInputTensors, ctx->inputs, NULL);
+            larodDestroyTensors(ctx->conn, &tempOutputTensors, ctx->outputs, NULL);
+            Model_Destroy(ctx);
+            return NULL;
+        }
+        ctx->quant_zero = cJSON_IsNumber(zeroItem) ? zeroItem->valuedouble
+                        : quantized ? (float)outputInfo.zero_point : 0;
+        ctx->elementSize = 1;
+        ctx->decode = dataType == LAROD_TENSOR_DATA_TYPE_UINT8 ? decode_candidates_u8
+                                                              : decode_candidates_i8;
+        LOG("Quantized model: %s output, scale=%.15f, zero_point=%d\n",
+            dataType == LAROD_TENSOR_DATA_TYPE_UINT8 ? "uint8" : "int8",
+            ctx->quant, (int)ctx->quant_zero);
+    } else if (dataType == LAROD_TENSOR_DATA_TYPE_FLOAT32) {
+        ctx->quant = 1.0;
+        ctx->quant_zero = 0;
+        ctx->elementSize = sizeof(float);
+        ctx->decode = decode_candidates_f32;
+        LOG("Float model: float32 output\n");
     } else {
-        quant = 1.0;
-        quant_zero = 0;
-        LOG("Float model detected (data_type=%d)\n", dataType);
+        LOG_WARN("%s: Unsupported output data type %d (uint8, int8 or float32 expected)\n",
+                 __func__, dataType);
+        larodDestroyTensors(ctx->conn, &tempInputTensors, ctx->inputs, NULL);
+        larodDestroyTensors(ctx->conn, &tempOutputTensors, ctx->outputs, NULL);
+        Model_Destroy(ctx);
+        return NULL;
     }
 
-    // Clean up temporary tensors
-    larodDestroyTensors(conn, &tempInputTensors, inputs, &error);
-    larodDestroyTensors(conn, &tempOutputTensors, outputs, &error);
-
     // Read settings
-    cJSON* settings = ACAP_Get_Config("settings");
     if (settings) {
-        cJSON* model_settings = cJSON_GetObjectItem(settings, "model");
-        if (model_settings) {
-            cJSON* nmsItem = cJSON_GetObjectItem(model_settings, "nms");
-            if (nmsItem) nms = nmsItem->valuedouble;
-
-            cJSON* objectnessItem = cJSON_GetObjectItem(model_settings, "objectness");
-            if (objectnessItem) objectnessThreshold = objectnessItem->valuedouble;
+        ctx->nms = settings_number(settings, "nms", ctx->nms);
 
-            cJSON* confidenceItem = cJSON_GetObjectItem(model_settings, "confidence");
-            if (confidenceItem) confidenceThreshold = confidenceItem->valuedouble;
-        }
-    }
+        int topK = (int)settings_number(settings, "nms_top_k", ctx->nmsTopK);
+        if (topK > 0) ctx->nmsTopK = topK;
 
-    LOG("Thresholds: objectness=%.2f, confidence=%.2f, nms=%.2f\n",
-        objectnessThreshold, confidenceThreshold, nms);
-
-    // Load labels
-    if (!labelparse_get_labels(&modelLabels, (int*)&numLabels)) {
-        LOG_WARN("%s: Failed to load labels from %s\n", __func__, LABELS_PATH);
-        Model_Cleanup();
-        return false;
-    }
+        int maxDetections = (int)settings_number(settings, "max_detections", ctx->maxDetections);
+        if (maxDetections > 0) ctx->maxDetections = maxDetections;
 
-    LOG("Loaded %zu labels\n", numLabels);
+        ctx->classAgnosticNms = settings_bool(settings, "class_agnostic_nms", ctx->classAgnosticNms);
+        ctx->objectnessThreshold = settings_number(settings, "objectness", ctx->objectnessThreshold);
+        ctx->confidenceThreshold = settings_number(settings, "confidence", ctx->confidenceThreshold);
+        ctx->fusedDecode = settings_bool(settings, "fused_decode", ctx->fusedDecode);
 
-    // Initialize letterbox params to identity (no transformation by default)
-    letterbox_params.original_width = modelWidth;
-    letterbox_params.original_height = modelHeight;
-    letterbox_params.scale = 1.0f;
-    letterbox_params.offset_x = 0;
-    letterbox_params.offset_y = 0;
+        const cJSON* scaleItem = cJSON_GetObjectItem(settings, "scaleMode");
+        if (scaleItem && cJSON_IsString(scaleItem)) {
+            ctx->scaleMode = preprocess_mode_from_string(scaleItem->valuestring);
+        }
 
-    // Create input/output buffers
-    size_t inputBufferSize = modelWidth * modelHeight * channels;
-    outputBufferSize = boxes * (5 + classes);  // Each box has x,y,w,h,obj + classes
+        const cJSON* preprocessItem = cJSON_GetObjectItem(settings, "preprocess");
+        if (preprocessItem && cJSON_IsString(preprocessItem)) {
+            ctx->larodPreprocess = strcmp(preprocessItem->valuestring, "cpu") != 0;
+        }
 
-    if (!createAndMapTmpFile(OBJECT_DETECTOR_INPUT_FILE_PATTERN, inputBufferSize,
-                            &larodInputAddr, &larodInputFd)) {
-        LOG_WARN("%s: Failed to create input buffer\n", __func__);
-        Model_Cleanup();
-        return false;
+        const cJSON* resizeItem = cJSON_GetObjectItem(settings, "resize");
+        if (resizeItem && cJSON_IsString(resizeItem)) {
+            ctx->resizeFilter = RESIZE_FilterFromString(resizeItem->valuestring,
+                                                        ctx->resizeFilter);
+        }
     }
 
-    if (!createAndMapTmpFile(OBJECT_DETECTOR_OUT1_FILE_PATTERN, outputBufferSize,
-                            &larodOutput1Addr, &larodOutput1Fd)) {
-        LOG_WARN("%s: Failed to create output buffer\n", __func__);
-        Model_Cleanup();
-        return false;
+    // Quantized objectness threshold, so the decode loop rejects boxes without
+    // dequantizing (one past the range if no raw value passes)
+    if (ctx->elementSize == 1) {
+        int qmin = dataType == LAROD_TENSOR_DATA_TYPE_INT8 ? INT8_MIN : 0;
+        int qmax = dataType == LAROD_TENSOR_DATA_TYPE_INT8 ? INT8_MAX : UINT8_MAX;
+        ctx->objectnessQuant = qmax + 1;
+        for (int q = qmin; q <= qmax; q++) {
+            if ((float)(q - ctx->quant_zero) * ctx->quant >= ctx->objectnessThreshold) {
+                ctx->objectnessQuant = q;
+                break;
+            }
+        }
     }
 
-    // Create larod tensors
-    inputTensors = larodCreateModelInputs(InfModel, &inputs, &error);
-    if (!inputTensors) {
-        LOG_WARN("%s: Failed to create input tensors: %s\n", __func__, error->msg);
-        larodClearError(&error);
-        Model_Cleanup();
-        return false;
+    char rawThreshold[24] = "";
+    if (ctx->elementSize == 1) {
+        snprintf(rawThreshold, sizeof(rawThreshold), " (raw >= %d)", ctx->objectnessQuant);
     }
+    LOG("Thresholds: objectness=%.2f%s, confidence=%.2f, nms=%.2f\n",
+        ctx->objectnessThreshold, rawThreshold, ctx->confidenceThreshold, ctx->nms);
+    LOG("NMS: %s, top_k=%d, max_detections=%d (0: unlimited)\n",
+        ctx->classAgnosticNms ? "class-agnostic" : "per class", ctx->nmsTopK, ctx->maxDetections);
+    LOG("Preprocessing: %s scaling on %s (cpu filter %s)\n",
+        preprocess_mode_to_string(ctx->scaleMode),
+        ctx->larodPreprocess ? "larod" : "cpu", RESIZE_FilterName(ctx->resizeFilter));
 
-    outputTensors = larodCreateModelOutputs(InfModel, &outputs, &error);
-    if (!outputTensors) {
-        LOG_WARN("%s: Failed to create output tensors: %s\n", __func__, error->msg);
-        larodClearError(&error);
-        Model_Cleanup();
-        return false;
+    // Load labels
+    if (!labels_parse_file(labels_path, &ctx->modelLabels, &ctx->labelBuffer, &ctx->numLabels)) {
+        LOG_WARN("%s: Failed to load labels from %s\n", __func__, labels_path);
+        larodDestroyTensors(ctx->conn, &tempInputTensors, ctx->inputs, NULL);
+        larodDestroyTensors(ctx->conn, &tempOutputTensors, ctx->outputs, NULL);
+        Model_Destroy(ctx);
+        return NULL;
     }
 
-    // Set tensor file descriptors
-    if (!larodSetTensorFd(inputTensors[0], larodInputFd, &error)) {
-        LOG_WARN("%s: Failed to set input tensor fd: %s\n", __func__, error->msg);
-        larodClearError(&error);
-        Model_Cleanup();
-        return false;
-    }
+    LOG("Loaded %zu labels\n", ctx->numLabels);
 
-    if (!larodSetTensorFd(outputTensors[0], larodOutput1Fd, &error)) {
-        LOG_WARN("%s: Failed to set output tensor fd: %s\n", __func__, error->msg);
-        larodClearError(&error);
-        Model_Cleanup();
-        return false;
+    // Create input/output buffers
+    ctx->inputBufferSize = ctx->modelWidth * ctx->modelHeight * ctx->channels;
+    // Each box has x,y,w,h,obj + classes
+    ctx->outputBufferSize = ctx->boxes * (5 + ctx->classes) * ctx->elementSize;
+
+    int tensorSlots = DEFAULT_TENSOR_SLOTS;
+    const cJSON* slotsItem = settings ? cJSON_GetObjectItem(settings, "tensor_slots") : NULL;
+    if (slotsItem && cJSON_IsNumber(slotsItem)) tensorSlots = slotsItem->valueint;
+    if (tensorSlots < 1) tensorSlots = 1;
+    if (tensorSlots > MAX_TENSOR_SLOTS) tensorSlots = MAX_TENSOR_SLOTS;
+
+    for (ctx->slotCount = 0; ctx->slotCount < tensorSlots; ctx->slotCount++) {
+        bool first = ctx->slotCount == 0;
+        if (!setup_slot(ctx, &ctx->slots[ctx->slotCount], first ? tempInputTensors : NULL,
+                        first ? tempOutputTensors : NULL)) {
+            LOG_WARN("%s: Failed to create tensor slot %d\n", __func__, ctx->slotCount);
+            destroy_slot(&ctx->slots[ctx->slotCount]);
+            Model_Destroy(ctx);
+            return NULL;
+        }
     }
 
-    // Create inference job request
-    infReq = larodCreateJobRequest(InfModel, inputTensors, inputs,
-                                   outputTensors, outputs, NULL, &error);
-    if (!infReq) {
-        LOG_WARN("%s: Failed to create job request: %s\n", __func__, error->msg);
-        larodClearError(&error);
-        Model_Cleanup();
-        return false;
+    LOG("Tensor slots: %d\n", ctx->slotCount);
+
+    // Describe this load for the next start, unless the cache already does
+    ctx->loadMs = elapsed_ms(&started);
+    ModelDescription desc;
+    Model_GetDescription(ctx, &desc);
+    if (hashed && (!known || strcmp(cached.device, desc.device) != 0 ||
+                   cached.width != desc.width || cached.height != desc.height ||
+                   cached.batch_size != desc.batch_size || cached.classes != desc.classes ||
+                   cached.quant_scale != desc.quant_scale ||
+                   cached.quant_zero_point != desc.quant_zero_point)) {
+        ModelCache_Store(hash, device_name, &desc);
     }
 
-    LOG("Model setup complete\n");
-    return true;
+    LOG("Model %s setup complete in %.0f ms\n", ctx->name, ctx->loadMs);
+    return ctx;
 }
 
 //-----------------------------------------------------------------------------
 // Model Cleanup
 //-----------------------------------------------------------------------------
 
-void Model_Cleanup(void) {
-    larodError* error = NULL;
-
-    if (infReq) {
-        larodDestroyJobRequest(&infReq);
-        infReq = NULL;
+void Model_Destroy(ModelContext* ctx) {
+    if (!ctx) {
+        return;
     }
 
-    if (inputTensors) {
-        larodDestroyTensors(conn, &inputTensors, inputs, &error);
-        inputTensors = NULL;
+    // Wait for jobs still executing before their tensors go away
+    pthread_mutex_lock(&ctx->slotLock);
+    ctx->slotsStopped = true;
+    pthread_cond_broadcast(&ctx->slotChanged);
+    while (ctx->jobsInFlight > 0) {
+        pthread_cond_wait(&ctx->slotChanged, &ctx->slotLock);
     }
+    pthread_mutex_unlock(&ctx->slotLock);
 
-    if (outputTensors) {
-        larodDestroyTensors(conn, &outputTensors, outputs, &error);
-        outputTensors = NULL;
+    for (int i = 0; i < ctx->slotCount; i++) {
+        destroy_slot(&ctx->slots[i]);
     }
+    ctx->slotCount = 0;
 
-    if (InfModel) {
-        larodDestroyModel(&InfModel);
-        InfModel = NULL;
+    if (ctx->InfModel) {
+        larodDestroyModel(&ctx->InfModel);
+        ctx->InfModel = NULL;
     }
 
-    if (larodInputAddr != MAP_FAILED) {
-        munmap(larodInputAddr, modelWidth * modelHeight * channels);
-        larodInputAddr = MAP_FAILED;
+    if (ctx->larodModelFd >= 0) {
+        close(ctx->larodModelFd);
+        ctx->larodModelFd = -1;
     }
 
-    if (larodOutput1Addr != MAP_FAILED) {
-        munmap(larodOutput1Addr, outputBufferSize);
-        larodOutput1Addr = MAP_FAILED;
+    if (ctx->conn) {
+        larodDisconnect(&ctx->conn, NULL);
+        ctx->conn = NULL;
     }
 
-    if (larodInputFd >= 0) {
-        close(larodInputFd);
-        larodInputFd = -1;
-    }
+    labels_free(ctx->modelLabels, ctx->labelBuffer);
+    cJSON_Delete(ctx->settings);
 
-    if (larodOutput1Fd >= 0) {
-        close(larodOutput1Fd);
-        larodOutput1Fd = -1;
-    }
+    pthread_mutex_destroy(&ctx->slotLock);
+    pthread_cond_destroy(&ctx->slotChanged);
+    pthread_mutex_destroy(&ctx->statsLock);
+    free(ctx);
 
-    if (larodModelFd >= 0) {
-        close(larodModelFd);
-        larodModelFd = -1;
-    }
+    LOG("Model cleanup complete\n");
+}
 
-    if (conn) {
-        larodDisconnect(&conn, NULL);
-        conn = NULL;
+bool Model_Describe(const cJSON* settings, ModelDescription* desc) {
+    const char* model_path = settings_string(settings, "path", DEFAULT_MODEL_PATH);
+    int fd = open(model_path, O_RDONLY);
+    if (fd < 0) {
+        return false;
     }
+    char hash[MODEL_HASH_SIZE];
+    bool found = ModelCache_HashFile(fd, hash) &&
+                 ModelCache_Lookup(hash, settings_string(settings, "device", NULL), desc);
+    close(fd);
+
+    // The same file may be known under another path; labels are separate
+    if (found) {
+        snprintf(desc->path, sizeof(desc->path), "%s", model_path);
+        snprintf(desc->labels, sizeof(desc->labels), "%s",
+                 settings_string(settings, "labels", DEFAULT_LABELS_PATH));
+    }
+    return found;
+}
 
-    LOG("Model cleanup complete\n");
+void Model_GetDescription(const ModelContext* ctx, ModelDescription* desc) {
+    memset(desc, 0, sizeof(*desc));
+    snprintf(desc->path, sizeof(desc->path), "%s", ctx->path);
+    snprintf(desc->labels, sizeof(desc->labels), "%s", ctx->labelsPath);
+    snprintf(desc->device, sizeof(desc->device), "%s", ctx->device);
+    desc->width = (int)ctx->modelWidth;
+    desc->height = (int)ctx->modelHeight;
+    desc->channels = (int)ctx->channels;
+    desc->batch_size = (int)ctx->batchSize;
+    desc->boxes = (int)ctx->boxes;
+    desc->classes = (int)ctx->classes;
+    desc->data_type = ctx->dataType;
+    desc->quant_scale = ctx->quant;
+    desc->quant_zero_point = (int)ctx->quant_zero;
+    desc->load_ms = ctx->loadMs;
 }
 
 //-----------------------------------------------------------------------------
 // Accessor Functions
 //-----------------------------------------------------------------------------
 
-int Model_GetWidth(void) {
-    return (int)modelWidth;
+int Model_GetWidth(const ModelContext* ctx) {
+    return (int)ctx->modelWidth;
 }
 
-int Model_GetHeight(void) {
-    return (int)modelHeight;
+const char* Model_GetDevice(const ModelContext* ctx) {
+    return ctx->device;
 }
 
-//-----------------------------------------------------------------------------
-// Continue in next file due to length...
-//-----------------------------------------------------------------------------
-//-----------------------------------------------------------------------------
-// Inference Functions
-//-----------------------------------------------------------------------------
-
-cJSON* Model_InferenceTensor(const uint8_t* rgb_data, int width, int height,
-                             int image_index, char** error_msg) {
-    if (error_msg) *error_msg = NULL;
+const char* Model_GetPath(const ModelContext* ctx) {
+    return ctx->path;
+}
 
-    // Validate dimensions
-    if (width != (int)modelWidth || height != (int)modelHeight) {
-        if (error_msg) {
-            char buf[256];
-            snprintf(buf, sizeof(buf),
-                     "Invalid dimensions: expected %dx%d, got %dx%d",
-                     modelWidth, modelHeight, width, height);
-            *error_msg = strdup(buf);
-        }
-        return NULL;
-    }
+const char* Model_GetName(const ModelContext* ctx) {
+    return ctx->name;
+}
 
-    // Copy RGB data directly to larod input tensor
-    size_t data_size = width * height * 3;
-    memcpy(larodInputAddr, rgb_data, data_size);
+const cJSON* Model_GetSettings(const ModelContext* ctx) {
+    return ctx->settings;
+}
 
-    // Note: letterbox_params are already set by caller or initialized to identity in Model_Setup
-    // Do NOT overwrite them here, as Model_InferenceJPEG relies on preprocess_rgb_letterbox
-    // setting the correct transformation parameters before calling this function
+int Model_GetLabelCount(const ModelContext* ctx) {
+    return (int)ctx->numLabels;
+}
 
-    // Run inference
-    larodError* error = NULL;
-    if (lseek(larodOutput1Fd, 0, SEEK_SET) == -1) {
-        LOG_WARN("%s: Unable to rewind output file: %s\n", __func__, strerror(errno));
-        if (error_msg) *error_msg = strdup("Failed to prepare output buffer");
+const char* Model_GetLabel(const ModelContext* ctx, int class_id) {
+    if (!ctx->modelLabels || class_id < 0 || (size_t)class_id >= ctx->numLabels) {
         return NULL;
     }
+    return ctx->modelLabels[class_id];
+}
 
-    if (!larodRunJob(conn, infReq, &error)) {
-        LOG_WARN("%s: Inference failed: %s\n", __func__, error->msg);
-        if (error_msg) *error_msg = strdup("Inference execution failed");
+int Model_ListDevices(ModelContext* ctx, char names[][MODEL_DEVICE_NAME_SIZE], int max) {
+    larodError* error = NULL;
+    size_t numDevices = 0;
+    const larodDevice** deviceList = larodListDevices(ctx->conn, &numDevices, &error);
+    if (!deviceList) {
+        LOG_WARN("%s: Could not list devices: %s\n", __func__,
+                 error ? error->msg : "unknown");
         larodClearError(&error);
-        return NULL;
+        return 0;
     }
 
-    // Parse inference results
-    uint8_t* output_tensor = (uint8_t*)larodOutput1Addr;
-    cJSON* raw_detections = cJSON_CreateArray();
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    long long timestamp = tv.tv_sec * 1000LL + tv.tv_usec / 1000;
-
-    int detections = 0;
-    for (unsigned int i = 0; i < boxes; i++) {
-        int box = i * (5 + classes);
-
-        // Dequantize objectness
-        float objectness = (float)(output_tensor[box + 4] - quant_zero) * quant;
-
-        if (objectness >= objectnessThreshold) {
-            float x = (float)(output_tensor[box + 0] - quant_zero) * quant;
-            float y = (float)(output_tensor[box + 1] - quant_zero) * quant;
-            float w = (float)(output_tensor[box + 2] - quant_zero) * quant;
-            float h = (float)(output_tensor[box + 3] - quant_zero) * quant;
-
-            // Find best class
-            int classId = -1;
-            float maxConfidence = 0;
-            for (unsigned int c = 0; c < classes; c++) {
-                float confidence = (float)(output_tensor[box + 5 + c] - quant_zero) * quant * objectness;
-                if (confidence > maxConfidence) {
-                    classId = c;
-                    maxConfidence = confidence;
-                }
-            }
-
-            if (maxConfidence > confidenceThreshold) {
-                detections++;
-                cJSON* detection = cJSON_CreateObject();
-                const char* label = labels_get(modelLabels, numLabels, classId);
-                cJSON_AddStringToObject(detection, "label", label);
-                cJSON_AddNumberToObject(detection, "c", maxConfidence);
-
-                // Convert to top-left corner format
-                double x_norm = x - (w / 2);
-                double y_norm = y - (h / 2);
-
-                cJSON_AddNumberToObject(detection, "x", x_norm);
-                cJSON_AddNumberToObject(detection, "y", y_norm);
-                cJSON_AddNumberToObject(detection, "w", w);
-                cJSON_AddNumberToObject(detection, "h", h);
-                cJSON_AddNumberToObject(detection, "timestamp", timestamp);
-                cJSON_AddNumberToObject(detection, "refId", currentRefId++);
-                cJSON_AddItemToArray(raw_detections, detection);
-            }
+    int count = 0;
+    for (size_t i = 0; i < numDevices && count < max; i++) {
+        const char* name = larodGetDeviceName(deviceList[i], &error);
+        larodClearError(&error);
+        if (name) {
+            snprintf(names[count++], MODEL_DEVICE_NAME_SIZE, "%s", name);
         }
     }
+    free(deviceList);
+    return count;
+}
 
-    LOG("Found %d detections before NMS\n", detections);
+int Model_GetHeight(const ModelContext* ctx) {
+    return (int)ctx->modelHeight;
+}
 
-    // Apply NMS
-    cJSON* nms_detections = non_maximum_suppression(raw_detections);
-    cJSON_Delete(raw_detections);
+int Model_GetBatchSize(const ModelContext* ctx) {
+    return (int)ctx->batchSize;
+}
 
-    // Format for API
-    cJSON* formatted = format_detections_for_api(nms_detections, image_index);
-    cJSON_Delete(nms_detections);
+size_t Model_GetInputSize(const ModelContext* ctx) {
+    return ctx->inputBufferSize;
+}
 
-    return formatted;
+size_t Model_GetOutputSize(const ModelContext* ctx) {
+    return ctx->outputBufferSize;
 }
 
-cJSON* Model_InferenceJPEG(const uint8_t* jpeg_data, size_t jpeg_size,
-                           int image_index, int image_width, int image_height,
-                           char** error_msg) {
-    if (error_msg) *error_msg = NULL;
+void Model_IdentityTransform(const ModelContext* ctx, ModelTransform* transform) {
+    if (!transform) return;
+    transform->original_width = ctx->modelWidth;
+    transform->original_height = ctx->modelHeight;
+    transform->scale_x = 1.0f;
+    transform->scale_y = 1.0f;
+    transform->offset_x = 0.0f;
+    transform->offset_y = 0.0f;
+    transform->region = (ModelRegion){ 0, 0, ctx->modelWidth, ctx->modelHeight };
+}
 
-    // Decode JPEG
-    DecodedImage img;
-    if (!JPEG_Decode(jpeg_data, jpeg_size, &img)) {
+//-----------------------------------------------------------------------------
+// Pipeline Stages
+//-----------------------------------------------------------------------------
+
+// Decode a whole JPEG frame at least min_w x min_h, checking the claimed size.
+// A worker decoder owns the RGB buffer; a one-off decode must be freed by the caller.
+static bool decode_frame(JpegDecoder* decoder, const uint8_t* jpeg_data, size_t jpeg_size,
+                         int image_width, int image_height, int min_w, int min_h,
+                         DecodedImage* img, char** error_msg) {
+    bool decoded = decoder
+        ? JPEG_DecodeWith(decoder, jpeg_data, jpeg_size, min_w, min_h, img)
+        : JPEG_DecodeScaled(jpeg_data, jpeg_size, min_w, min_h, img);
+    if (!decoded) {
         if (error_msg) *error_msg = strdup("Failed to decode JPEG image");
-        return NULL;
+        return false;
     }
 
     // Validate dimensions match what was provided
-    if (img.width != image_width || img.height != image_height) {
-        LOG_WARN("JPEG dimension mismatch: expected %dx%d, got %dx%d\n",
-                 image_width, image_height, img.width, img.height);
-        JPEG_FreeImage(&img);
+    if (img->source_width != image_width || img->source_height != image_height) {
+        LOG_LIMITED(LOG_LEVEL_WARNING, "JPEG dimension mismatch: expected %dx%d, got %dx%d\n",
+                    image_width, image_height, img->source_width, img->source_height);
+        if (!decoder) JPEG_FreeImage(img);
         if (error_msg) *error_msg = strdup("JPEG dimension mismatch");
-        return NULL;
+        return false;
+    }
+
+    LOG_SAMPLED("Decoded JPEG: %dx%d (source %dx%d)\n",
+                img->width, img->height, img->source_width, img->source_height);
+    return true;
+}
+
+bool Model_PreprocessJPEG(ModelContext* ctx, JpegDecoder* decoder, int slot, int item,
+                          const uint8_t* jpeg_data, size_t jpeg_size,
+                          int image_width, int image_height,
+                          ModelTransform* transform, char** error_msg) {
+    if (error_msg) *error_msg = NULL;
+    if (slot < 0 || slot >= ctx->slotCount || item < 0 || item >= (int)ctx->batchSize) {
+        if (error_msg) *error_msg = strdup("Invalid tensor slot");
+        return false;
     }
+    TensorSlot* s = &ctx->slots[slot];
+    uint8_t* tensor = (uint8_t*)s->inputAddr + (size_t)item * ctx->inputBufferSize;
 
-    LOG("Decoded JPEG: %dx%d\n", img.width, img.height);
+    // Geometry is defined on the original image so the transform (and bbox
+    // back-projection) does not depend on the decode scale
+    scale_transform(ctx->scaleMode, image_width, image_height,
+                    ctx->modelWidth, ctx->modelHeight, transform);
+    int min_w = (int)lroundf(image_width * transform->scale_x);
+    int min_h = (int)lroundf(image_height * transform->scale_y);
 
     // Check aspect ratio (warning only)
-    float aspect = (float)img.width / (float)img.height;
+    float aspect = (float)image_width / (float)image_height;
     if (aspect < 0.9 || aspect > 1.1) {
-        LOG_WARN("Non-square image: %dx%d (aspect %.2f). Letterboxing applied.",
-               img.width, img.height, aspect);
+        LOG_SAMPLED("Non-square image: %dx%d (aspect %.2f). Scale mode %s applied.",
+                    image_width, image_height, aspect, preprocess_mode_to_string(ctx->scaleMode));
     }
 
-    // Preprocess RGB with letterboxing
-    uint8_t* preprocessed_rgb = preprocess_rgb_letterbox(
-        img.data, img.width, img.height, modelWidth, modelHeight
-    );
-
-    JPEG_FreeImage(&img);
+    // larod: decode a frame just above model resolution and let the cached
+    // cpu-proc job scale it into the slot input
+    if (ctx->larodPreprocess) {
+        DecodedImage img;
+        if (!decode_frame(decoder, jpeg_data, jpeg_size, image_width, image_height,
+                          min_w, min_h, &img, error_msg)) {
+            return false;
+        }
+        // transform is untouched on failure and still describes the CPU geometry
+        bool ok = slot_preprocess(ctx, s, item, img.data, (size_t)img.width * img.height * 3,
+                                  img.width, img.height, VDO_FORMAT_RGB,
+                                  image_width, image_height, NULL, transform) ||
+                  preprocess_rgb_scaled(ctx->resizeFilter, img.data, img.width, img.height,
+                                        tensor, ctx->modelWidth, ctx->modelHeight, transform);
+        if (!decoder) JPEG_FreeImage(&img);
+        if (!ok && error_msg) *error_msg = strdup("Preprocessing failed");
+        return ok;
+    }
 
-    if (!preprocessed_rgb) {
-        if (error_msg) *error_msg = strdup("Preprocessing failed");
-        return NULL;
+    // Fused: decoded rows are scaled as they arrive, so the tensor is the
+    // only full-size buffer written
+    if (decoder && ctx->fusedDecode) {
+        ScaledSink state = {
+            .tensor = tensor,
+            .out_w = ctx->modelWidth,
+            .out_h = ctx->modelHeight,
+            .expected_w = image_width,
+            .expected_h = image_height,
+            .transform = transform,
+            .filter = ctx->resizeFilter,
+        };
+        JpegRowSink sink = { scaled_sink_begin, scaled_sink_row, &state };
+        DecodedImage geometry;
+        bool decoded = JPEG_DecodeRows(decoder, jpeg_data, jpeg_size, min_w, min_h,
+                                       &sink, &geometry);
+        RESIZE_Destroy(state.resizer);
+        if (!decoded) {
+            if (state.failed) {
+                if (error_msg) *error_msg = strdup("Preprocessing failed");
+            } else if (state.mismatch) {
+                LOG_LIMITED(LOG_LEVEL_WARNING, "JPEG dimension mismatch: expected %dx%d, got %dx%d\n",
+                            image_width, image_height, state.in_w, state.in_h);
+                if (error_msg) *error_msg = strdup("JPEG dimension mismatch");
+            } else if (error_msg) {
+                *error_msg = strdup("Failed to decode JPEG image");
+            }
+            return false;
+        }
+        LOG_SAMPLED("Streamed JPEG: %dx%d (source %dx%d)\n",
+                    geometry.width, geometry.height, geometry.source_width, geometry.source_height);
+        return true;
     }
 
-    // Run inference with preprocessed data
-    cJSON* result = Model_InferenceTensor(preprocessed_rgb, modelWidth, modelHeight,
-                                         image_index, error_msg);
+    // Decode JPEG, downscaled in the DCT domain to just above the scaled size
+    DecodedImage img;
+    if (!decode_frame(decoder, jpeg_data, jpeg_size, image_width, image_height,
+                      min_w, min_h, &img, error_msg)) {
+        return false;
+    }
 
-    free(preprocessed_rgb);
+    // Scale RGB straight into the slot input
+    bool ok = preprocess_rgb_scaled(ctx->resizeFilter, img.data, img.width, img.height,
+                                    tensor, ctx->modelWidth, ctx->modelHeight, transform);
 
-    return result;
+    if (!decoder) JPEG_FreeImage(&img);
+    if (!ok && error_msg) *error_msg = strdup("Preprocessing failed");
+    return ok;
 }
 
-//-----------------------------------------------------------------------------
-// Helper Functions
-//-----------------------------------------------------------------------------
-
-static uint8_t* preprocess_rgb_letterbox(const uint8_t* rgb_in, int in_w, int in_h,
-                                         int out_w, int out_h) {
-    uint8_t* out = calloc(out_w * out_h * 3, 1);  // Black background
-    if (!out) {
-        LOG_WARN("%s: Failed to allocate output buffer\n", __func__);
-        return NULL;
+size_t Model_FrameSize(int width, int height, VdoFormat format) {
+    if (width <= 0 || height <= 0) return 0;
+    size_t pixels = (size_t)width * height;
+    switch (format) {
+        case VDO_FORMAT_YUV:
+            return pixels * 3 / 2;  // NV12
+        case VDO_FORMAT_RGB:
+        case VDO_FORMAT_PLANAR_RGB:
+            return pixels * 3;
+        default:
+            return 0;
     }
+}
 
-    // Calculate scale to fit inside output while preserving aspect ratio
-    float scale = fminf((float)out_w / in_w, (float)out_h / in_h);
-    int scaled_w = (int)(in_w * scale);
-    int scaled_h = (int)(in_h * scale);
+bool Model_PreprocessFrame(ModelContext* ctx, int slot, int item,
+                           const uint8_t* frame, size_t frame_size,
+                           int width, int height, VdoFormat format,
+                           ModelTransform* transform, char** error_msg) {
+    if (error_msg) *error_msg = NULL;
+    if (slot < 0 || slot >= ctx->slotCount || item < 0 || item >= (int)ctx->batchSize) {
+        if (error_msg) *error_msg = strdup("Invalid tensor slot");
+        return false;
+    }
 
-    // Center the image
-    int offset_x = (out_w - scaled_w) / 2;
-    int offset_y = (out_h - scaled_h) / 2;
+    size_t expected = Model_FrameSize(width, height, format);
+    if (expected == 0) {
+        if (error_msg) *error_msg = strdup("Unsupported frame format");
+        return false;
+    }
+    if (frame_size < expected) {
+        if (error_msg) *error_msg = strdup("Frame data too small");
+        return false;
+    }
 
-    // Store letterbox parameters for bbox transformation
-    letterbox_params.original_width = in_w;
-    letterbox_params.original_height = in_h;
-    letterbox_params.scale = scale;
-    letterbox_params.offset_x = offset_x;
-    letterbox_params.offset_y = offset_y;
+    // model.preprocess "cpu" only applies to RGB; YUV needs the larod conversion
+    TensorSlot* s = &ctx->slots[slot];
+    if ((ctx->larodPreprocess || format != VDO_FORMAT_RGB) &&
+        slot_preprocess(ctx, s, item, frame, expected, width, height, format,
+                        width, height, NULL, transform)) {
+        return true;
+    }
 
-    LOG_TRACE("Letterbox: %dx%d -> %dx%d (scale %.3f, offset %d,%d)\n",
-              in_w, in_h, scaled_w, scaled_h, scale, offset_x, offset_y);
+    // Only interleaved RGB can be scaled without larod
+    if (format != VDO_FORMAT_RGB) {
+        if (error_msg) *error_msg = strdup("Frame preprocessing failed");
+        return false;
+    }
 
-    // Nearest-neighbor scaling
-    for (int y = 0; y < scaled_h; y++) {
-        for (int x = 0; x < scaled_w; x++) {
-            int src_x = (int)((float)x / scale);
-            int src_y = (int)((float)y / scale);
+    scale_transform(ctx->scaleMode, width, height,
+                    ctx->modelWidth, ctx->modelHeight, transform);
+    uint8_t* tensor = (uint8_t*)s->inputAddr + (size_t)item * ctx->inputBufferSize;
+    if (!preprocess_rgb_scaled(ctx->resizeFilter, frame, width, height, tensor,
+                               ctx->modelWidth, ctx->modelHeight, transform)) {
+        if (error_msg) *error_msg = strdup("Preprocessing failed");
+        return false;
+    }
+    return true;
+}
 
-            // Clamp to input bounds
-            if (src_x >= in_w) src_x = in_w - 1;
-            if (src_y >= in_h) src_y = in_h - 1;
+bool Model_DecodeJPEG(ModelContext* ctx, const uint8_t* jpeg_data, size_t jpeg_size,
+                      int image_width, int image_height, const ModelRegion* region,
+                      DecodedImage* image, char** error_msg) {
+    if (error_msg) *error_msg = NULL;
 
-            int dst_idx = ((offset_y + y) * out_w + (offset_x + x)) * 3;
-            int src_idx = (src_y * in_w + src_x) * 3;
+    // Only the region size matters for the scale
+    ModelRegion whole = { 0, 0, image_width, image_height };
+    ModelTransform transform;
+    region_transform(ctx->scaleMode, image_width, image_height, region ? region : &whole,
+                     ctx->modelWidth, ctx->modelHeight, &transform);
+    int min_w = (int)lroundf(image_width * transform.scale_x);
+    int min_h = (int)lroundf(image_height * transform.scale_y);
+
+    // Other workers preprocess from the frame, so it cannot be a decoder's buffer
+    return decode_frame(NULL, jpeg_data, jpeg_size, image_width, image_height,
+                        min_w, min_h, image, error_msg);
+}
 
-            out[dst_idx + 0] = rgb_in[src_idx + 0];  // R
-            out[dst_idx + 1] = rgb_in[src_idx + 1];  // G
-            out[dst_idx + 2] = rgb_in[src_idx + 2];  // B
-        }
+bool Model_PreprocessRegion(ModelContext* ctx, int slot, int item,
+                            const uint8_t* frame, size_t frame_size,
+                            int width, int height, VdoFormat format,
+                            int original_width, int original_height,
+                            const ModelRegion* region,
+                            ModelTransform* transform, char** error_msg) {
+    if (error_msg) *error_msg = NULL;
+    if (slot < 0 || slot >= ctx->slotCount || item < 0 || item >= (int)ctx->batchSize) {
+        if (error_msg) *error_msg = strdup("Invalid tensor slot");
+        return false;
+    }
+    if (!region || region->width <= 0 || region->height <= 0 || region->x < 0 || region->y < 0 ||
+        region->x > original_width - region->width || region->y > original_height - region->height) {
+        if (error_msg) *error_msg = strdup("Region is outside the image");
+        return false;
     }
 
-    return out;
-}
+    size_t expected = Model_FrameSize(width, height, format);
+    if (expected == 0) {
+        if (error_msg) *error_msg = strdup("Unsupported frame format");
+        return false;
+    }
+    if (frame_size < expected) {
+        if (error_msg) *error_msg = strdup("Frame data too small");
+        return false;
+    }
 
-static cJSON* format_detections_for_api(cJSON* raw_detections, int image_index) {
-    cJSON* formatted = cJSON_CreateArray();
+    TensorSlot* s = &ctx->slots[slot];
+    if ((ctx->larodPreprocess || format != VDO_FORMAT_RGB) &&
+        slot_preprocess(ctx, s, item, frame, expected, width, height, format,
+                        original_width, original_height, region, transform)) {
+        return true;
+    }
 
-    cJSON* detection;
-    cJSON_ArrayForEach(detection, raw_detections) {
-        cJSON* formatted_det = cJSON_CreateObject();
+    // Only interleaved RGB can be scaled without larod
+    if (format != VDO_FORMAT_RGB) {
+        if (error_msg) *error_msg = strdup("Frame preprocessing failed");
+        return false;
+    }
 
-        // Add image index
-        cJSON_AddNumberToObject(formatted_det, "index", image_index);
+    // The sampling reads the region straight out of the whole frame
+    region_transform(ctx->scaleMode, original_width, original_height, region,
+                     ctx->modelWidth, ctx->modelHeight, transform);
+    uint8_t* tensor = (uint8_t*)s->inputAddr + (size_t)item * ctx->inputBufferSize;
+    if (!preprocess_rgb_scaled(ctx->resizeFilter, frame, width, height, tensor,
+                               ctx->modelWidth, ctx->modelHeight, transform)) {
+        if (error_msg) *error_msg = strdup("Preprocessing failed");
+        return false;
+    }
+    return true;
+}
 
-        // Add original image dimensions for client reference
-        cJSON* image_info = cJSON_CreateObject();
-        cJSON_AddNumberToObject(image_info, "width", letterbox_params.original_width);
-        cJSON_AddNumberToObject(image_info, "height", letterbox_params.original_height);
-        cJSON_AddItemToObject(formatted_det, "image", image_info);
-
-        // Copy label
-        cJSON* label = cJSON_GetObjectItem(detection, "label");
-        if (label && label->valuestring) {
-            cJSON_AddStringToObject(formatted_det, "label", label->valuestring);
-
-            // Lookup class_id
-            int class_id = get_class_id_from_label(label->valuestring);
-            cJSON_AddNumberToObject(formatted_det, "class_id", class_id);
-        }
-
-        // Copy confidence
-        cJSON* conf = cJSON_GetObjectItem(detection, "c");
-        if (conf) {
-            cJSON_AddNumberToObject(formatted_det, "confidence", conf->valuedouble);
-        }
-
-        // Get coordinates (DetectX format: top-left, normalized 0-1)
-        cJSON* x_item = cJSON_GetObjectItem(detection, "x");
-        cJSON* y_item = cJSON_GetObjectItem(detection, "y");
-        cJSON* w_item = cJSON_GetObjectItem(detection, "w");
-        cJSON* h_item = cJSON_GetObjectItem(detection, "h");
-
-        if (x_item && y_item && w_item && h_item) {
-            // Coordinates are normalized 0-1 in model space
-            double x_norm = x_item->valuedouble;
-            double y_norm = y_item->valuedouble;
-            double w_norm = w_item->valuedouble;
-            double h_norm = h_item->valuedouble;
-
-            // Convert to model pixel coordinates
-            double x_model = x_norm * modelWidth;
-            double y_model = y_norm * modelHeight;
-            double w_model = w_norm * modelWidth;
-            double h_model = h_norm * modelHeight;
-
-            // Transform back to original image coordinates
-            // (accounting for letterbox offset and scale)
-            double x_orig = (x_model - letterbox_params.offset_x) / letterbox_params.scale;
-            double y_orig = (y_model - letterbox_params.offset_y) / letterbox_params.scale;
-            double w_orig = w_model / letterbox_params.scale;
-            double h_orig = h_model / letterbox_params.scale;
-
-            // Clamp to original image bounds
-            if (x_orig < 0) x_orig = 0;
-            if (y_orig < 0) y_orig = 0;
-            if (x_orig + w_orig > letterbox_params.original_width) {
-                w_orig = letterbox_params.original_width - x_orig;
-            }
-            if (y_orig + h_orig > letterbox_params.original_height) {
-                h_orig = letterbox_params.original_height - y_orig;
+int Model_GetSlotCount(const ModelContext* ctx) {
+    return ctx->slotCount;
+}
+
+int Model_AcquireSlot(ModelContext* ctx) {
+    pthread_mutex_lock(&ctx->slotLock);
+    for (;;) {
+        if (ctx->slotsStopped) {
+            pthread_mutex_unlock(&ctx->slotLock);
+            return -1;
+        }
+        for (int i = 0; i < ctx->slotCount; i++) {
+            if (!ctx->slots[i].busy) {
+                ctx->slots[i].busy = true;
+                pthread_mutex_unlock(&ctx->slotLock);
+                return i;
             }
+        }
+        pthread_cond_wait(&ctx->slotChanged, &ctx->slotLock);
+    }
+}
+
+void Model_ReleaseSlot(ModelContext* ctx, int slot) {
+    if (slot < 0 || slot >= ctx->slotCount) return;
+    pthread_mutex_lock(&ctx->slotLock);
+    ctx->slots[slot].busy = false;
+    pthread_cond_broadcast(&ctx->slotChanged);
+    pthread_mutex_unlock(&ctx->slotLock);
+}
+
+void Model_StopSlots(ModelContext* ctx) {
+    pthread_mutex_lock(&ctx->slotLock);
+    ctx->slotsStopped = true;
+    pthread_cond_broadcast(&ctx->slotChanged);
+    pthread_mutex_unlock(&ctx->slotLock);
+}
+
+uint8_t* Model_GetSlotInput(ModelContext* ctx, int slot) {
+    return (slot >= 0 && slot < ctx->slotCount) ? (uint8_t*)ctx->slots[slot].inputAddr : NULL;
+}
+
+const uint8_t* Model_GetSlotOutput(const ModelContext* ctx, int slot) {
+    return (slot >= 0 && slot < ctx->slotCount) ? (const uint8_t*)ctx->slots[slot].outputAddr : NULL;
+}
+
+static void jobs_in_flight_add(ModelContext* ctx, int delta) {
+    pthread_mutex_lock(&ctx->slotLock);
+    ctx->jobsInFlight += delta;
+    pthread_cond_broadcast(&ctx->slotChanged);
+    pthread_mutex_unlock(&ctx->slotLock);
+}
+
+static bool slot_prepare(TensorSlot* slot, char** error_msg) {
+    if (lseek(slot->outputFd, 0, SEEK_SET) == -1) {
+        LOG_WARN("%s: Unable to rewind output file: %s\n", __func__, strerror(errno));
+        if (error_msg) *error_msg = strdup("Failed to prepare output buffer");
+        return false;
+    }
+    return true;
+}
+
+// Runs on a larod thread when an async job finishes
+static void slot_job_done(void* userData, larodError* error) {
+    TensorSlot* slot = (TensorSlot*)userData;
+    ModelContext* ctx = slot->ctx;
+    int index = (int)(slot - ctx->slots);
+
+    if (error) {
+        LOG_LIMITED(LOG_LEVEL_WARNING, "%s: Inference failed: %s\n", __func__, error->msg);
+    }
+
+    // The callback may release the slot, so it must not be touched afterwards
+    slot->callback(index, error == NULL, slot->userData);
+    jobs_in_flight_add(ctx, -1);
+}
+
+bool Model_RunAsync(ModelContext* ctx, int slot, ModelJobCallback callback,
+                    void* user_data, char** error_msg) {
+    if (error_msg) *error_msg = NULL;
+    if (slot < 0 || slot >= ctx->slotCount || !callback) {
+        if (error_msg) *error_msg = strdup("Invalid tensor slot");
+        return false;
+    }
+
+    TensorSlot* s = &ctx->slots[slot];
+    if (!slot_prepare(s, error_msg)) {
+        return false;
+    }
+
+    s->callback = callback;
+    s->userData = user_data;
+    jobs_in_flight_add(ctx, 1);
+
+    larodError* error = NULL;
+    if (!larodRunJobAsync(ctx->conn, s->jobReq, slot_job_done, s, &error)) {
+        jobs_in_flight_add(ctx, -1);
+        LOG_LIMITED(LOG_LEVEL_WARNING, "%s: Inference failed: %s\n", __func__, error ? error->msg : "unknown");
+        if (error_msg) *error_msg = strdup("Inference execution failed");
+        larodClearError(&error);
+        return false;
+    }
 
-            // bbox_pixels (top-left, absolute pixels in ORIGINAL image coordinates)
-            cJSON* bbox_pixels = cJSON_CreateObject();
-            cJSON_AddNumberToObject(bbox_pixels, "x", (int)x_orig);
-            cJSON_AddNumberToObject(bbox_pixels, "y", (int)y_orig);
-            cJSON_AddNumberToObject(bbox_pixels, "w", (int)w_orig);
-            cJSON_AddNumberToObject(bbox_pixels, "h", (int)h_orig);
-            cJSON_AddItemToObject(formatted_det, "bbox_pixels", bbox_pixels);
+    return true;
+}
 
-            // bbox_yolo (center, normalized 0-1 in ORIGINAL image space)
-            double cx_orig_norm = (x_orig + w_orig / 2.0) / letterbox_params.original_width;
-            double cy_orig_norm = (y_orig + h_orig / 2.0) / letterbox_params.original_height;
-            double w_orig_norm = w_orig / letterbox_params.original_width;
-            double h_orig_norm = h_orig / letterbox_params.original_height;
+// Blocking inference on an acquired slot whose input is already filled
+static bool slot_run(ModelContext* ctx, TensorSlot* s, char** error_msg) {
+    if (!slot_prepare(s, error_msg)) {
+        return false;
+    }
+
+    larodError* error = NULL;
+    jobs_in_flight_add(ctx, 1);
+    bool ok = larodRunJob(ctx->conn, s->jobReq, &error);
+    jobs_in_flight_add(ctx, -1);
 
-            cJSON* bbox_yolo = cJSON_CreateObject();
-            cJSON_AddNumberToObject(bbox_yolo, "x", cx_orig_norm);  // center x
-            cJSON_AddNumberToObject(bbox_yolo, "y", cy_orig_norm);  // center y
-            cJSON_AddNumberToObject(bbox_yolo, "w", w_orig_norm);
-            cJSON_AddNumberToObject(bbox_yolo, "h", h_orig_norm);
-            cJSON_AddItemToObject(formatted_det, "bbox_yolo", bbox_yolo);
+    if (!ok) {
+        LOG_LIMITED(LOG_LEVEL_WARNING, "%s: Inference failed: %s\n", __func__, error->msg);
+        if (error_msg) *error_msg = strdup("Inference execution failed");
+        larodClearError(&error);
+        return false;
+    }
+    return true;
+}
+
+bool Model_RunSlot(ModelContext* ctx, int slot, char** error_msg) {
+    if (error_msg) *error_msg = NULL;
+    if (slot < 0 || slot >= ctx->slotCount) {
+        if (error_msg) *error_msg = strdup("Invalid tensor slot");
+        return false;
+    }
+    return slot_run(ctx, &ctx->slots[slot], error_msg);
+}
+
+bool Model_Run(ModelContext* ctx, const uint8_t* tensor, uint8_t* output, char** error_msg) {
+    if (error_msg) *error_msg = NULL;
+
+    int slot = Model_AcquireSlot(ctx);
+    if (slot < 0) {
+        if (error_msg) *error_msg = strdup("Model is shutting down");
+        return false;
+    }
+    TensorSlot* s = &ctx->slots[slot];
+
+    // Copy RGB data directly to larod input tensor
+    memcpy(s->inputAddr, tensor, ctx->inputBufferSize);
+
+    bool ok = slot_run(ctx, s, error_msg);
+    if (ok) {
+        memcpy(output, s->outputAddr, ctx->outputBufferSize);
+    }
+    Model_ReleaseSlot(ctx, slot);
+    return ok;
+}
+
+// Typical number of boxes passing the objectness threshold; grown on demand
+#define CANDIDATES_INITIAL 64
+
+// Decoded detections as struct-of-arrays; boxes are normalized top-left x,y,w,h
+typedef struct Candidates {
+    float* x;
+    float* y;
+    float* w;
+    float* h;
+    float* score;
+    int* class_id;
+    int count;
+    int capacity;
+} Candidates;
+
+typedef struct {
+    float score;
+    int index;
+} ScoredIndex;
+
+// Postprocessing scratch, grown on demand and kept between calls
+struct ModelDetector {
+    Candidates candidates;
+
+    // NMS arrays, room for capacity candidates and bucket_capacity classes
+    ScoredIndex* order;
+    int* bucketed;
+    bool* suppressed;
+    int* kept;
+    int capacity;
+    int* bucket_end;
+    int bucket_capacity;
+
+    ModelDetection* detections;
+    int detection_capacity;
+};
+
+static int non_maximum_suppression(const ModelContext* ctx, ModelDetector* d);
+static void map_detections(const ModelContext* ctx, const Candidates* c,
+                           const int* kept, int count,
+                           const ModelTransform* transform, ModelDetection* out);
+
+static void candidates_free(Candidates* c) {
+    free(c->x);
+    free(c->y);
+    free(c->w);
+    free(c->h);
+    free(c->score);
+    free(c->class_id);
+    memset(c, 0, sizeof(*c));
+}
+
+static bool candidates_grow(Candidates* c) {
+    int capacity = c->capacity ? c->capacity * 2 : CANDIDATES_INITIAL;
+    float* x = realloc(c->x, capacity * sizeof(float));
+    if (x) c->x = x;
+    float* y = realloc(c->y, capacity * sizeof(float));
+    if (y) c->y = y;
+    float* w = realloc(c->w, capacity * sizeof(float));
+    if (w) c->w = w;
+    float* h = realloc(c->h, capacity * sizeof(float));
+    if (h) c->h = h;
+    float* score = realloc(c->score, capacity * sizeof(float));
+    if (score) c->score = score;
+    int* class_id = realloc(c->class_id, capacity * sizeof(int));
+    if (class_id) c->class_id = class_id;
+    if (!x || !y || !w || !h || !score || !class_id) {
+        return false;
+    }
+    c->capacity = capacity;
+    return true;
+}
+
+// Highest byte in p[0..n) and the index of its first occurrence
+static uint8_t argmax_u8(const uint8_t* p, int n, int* index) {
+    uint8_t best = 0;
+    int i = 0;
+#ifdef __ARM_NEON
+    uint8x16_t vmax = vdupq_n_u8(0);
+    for (; i + 16 <= n; i += 16) {
+        vmax = vmaxq_u8(vmax, vld1q_u8(p + i));
+    }
+    uint8x8_t m = vpmax_u8(vget_low_u8(vmax), vget_high_u8(vmax));
+    m = vpmax_u8(m, m);
+    m = vpmax_u8(m, m);
+    m = vpmax_u8(m, m);
+    best = vget_lane_u8(m, 0);
+#endif
+    for (; i < n; i++) {
+        if (p[i] > best) best = p[i];
+    }
+    const uint8_t* first = memchr(p, best, n);
+    *index = first ? (int)(first - p) : 0;
+    return best;
+}
+
+// Same for signed bytes
+static int8_t argmax_s8(const int8_t* p, int n, int* index) {
+    int8_t best = INT8_MIN;
+    int i = 0;
+#ifdef __ARM_NEON
+    int8x16_t vmax = vdupq_n_s8(INT8_MIN);
+    for (; i + 16 <= n; i += 16) {
+        vmax = vmaxq_s8(vmax, vld1q_s8(p + i));
+    }
+    int8x8_t m = vpmax_s8(vget_low_s8(vmax), vget_high_s8(vmax));
+    m = vpmax_s8(m, m);
+    m = vpmax_s8(m, m);
+    m = vpmax_s8(m, m);
+    best = vget_lane_s8(m, 0);
+#endif
+    for (; i < n; i++) {
+        if (p[i] > best) best = p[i];
+    }
+    const int8_t* first = memchr(p, (uint8_t)best, n);
+    *index = first ? (int)(first - p) : 0;
+    return best;
+}
+
+// Highest float in p[0..n) and the index of its first occurrence
+static float argmax_f32(const float* p, int n, int* index) {
+    float best = p[0];
+    int bestIndex = 0;
+    for (int i = 1; i < n; i++) {
+        if (p[i] > best) {
+            best = p[i];
+            bestIndex = i;
         }
+    }
+    *index = bestIndex;
+    return best;
+}
 
-        cJSON_AddItemToArray(formatted, formatted_det);
+// Append a center-format box as top-left x,y,w,h
+static bool add_candidate(Candidates* c, float x, float y, float w, float h,
+                          float score, int classId) {
+    if (c->count == c->capacity && !candidates_grow(c)) {
+        LOG_WARN("%s: Out of memory after %d candidates\n", __func__, c->count);
+        return false;
     }
+    int n = c->count++;
+    c->x[n] = x - (w / 2);
+    c->y[n] = y - (h / 2);
+    c->w[n] = w;
+    c->h[n] = h;
+    c->score[n] = score;
+    c->class_id[n] = classId;
+    return true;
+}
 
+static bool decode_candidates_u8(const ModelContext* ctx, const uint8_t* output,
+                                 Candidates* c) {
+    const size_t stride = 5 + ctx->classes;
+    const int objectness_min = ctx->objectnessQuant;
+    const float zero = ctx->quant_zero;
+    const float scale = ctx->quant;
+
+    c->count = 0;
+    if (ctx->classes == 0) {
+        return true;
+    }
+
+    for (unsigned int i = 0; i < ctx->boxes; i++) {
+        const uint8_t* box = output + i * stride;
+
+        // Quantized compare: nearly every box stops here
+        if (box[4] < objectness_min) {
+            continue;
+        }
+
+        // Dequantization is monotonic, so the best class can be found on raw bytes
+        int classId;
+        uint8_t best = argmax_u8(box + 5, ctx->classes, &classId);
+        float objectness = (float)(box[4] - zero) * scale;
+        float confidence = (float)(best - zero) * scale * objectness;
+        if (!(confidence > ctx->confidenceThreshold)) {
+            continue;
+        }
+
+        if (!add_candidate(c, (float)(box[0] - zero) * scale, (float)(box[1] - zero) * scale,
+                           (float)(box[2] - zero) * scale, (float)(box[3] - zero) * scale,
+                           confidence, classId)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool decode_candidates_i8(const ModelContext* ctx, const uint8_t* output,
+                                 Candidates* c) {
+    const size_t stride = 5 + ctx->classes;
+    const int objectness_min = ctx->objectnessQuant;
+    const float zero = ctx->quant_zero;
+    const float scale = ctx->quant;
+
+    c->count = 0;
+    if (ctx->classes == 0) {
+        return true;
+    }
+
+    for (unsigned int i = 0; i < ctx->boxes; i++) {
+        const int8_t* box = (const int8_t*)output + i * stride;
+
+        if (box[4] < objectness_min) {
+            continue;
+        }
+
+        int classId;
+        int8_t best = argmax_s8(box + 5, ctx->classes, &classId);
+        float objectness = (float)(box[4] - zero) * scale;
+        float confidence = (float)(best - zero) * scale * objectness;
+        if (!(confidence > ctx->confidenceThreshold)) {
+            continue;
+        }
+
+        if (!add_candidate(c, (float)(box[0] - zero) * scale, (float)(box[1] - zero) * scale,
+                           (float)(box[2] - zero) * scale, (float)(box[3] - zero) * scale,
+                           confidence, classId)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool decode_candidates_f32(const ModelContext* ctx, const uint8_t* output,
+                                  Candidates* c) {
+    const size_t stride = 5 + ctx->classes;
+    const float objectness_min = ctx->objectnessThreshold;
+
+    c->count = 0;
+    if (ctx->classes == 0) {
+        return true;
+    }
+
+    for (unsigned int i = 0; i < ctx->boxes; i++) {
+        const float* box = (const float*)output + i * stride;
+
+        if (!(box[4] >= objectness_min)) {
+            continue;
+        }
+
+        int classId;
+        float confidence = argmax_f32(box + 5, ctx->classes, &classId) * box[4];
+        if (!(confidence > ctx->confidenceThreshold)) {
+            continue;
+        }
+
+        if (!add_candidate(c, box[0], box[1], box[2], box[3], confidence, classId)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static double elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+           (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static void record_postprocess(ModelContext* ctx, int candidates, int detections,
+                               double decode_ms, double nms_ms) {
+    Latency_Record(LATENCY_OUTPUT_DECODE, (uint64_t)(decode_ms * 1e6));
+    Latency_Record(LATENCY_NMS, (uint64_t)(nms_ms * 1e6));
+    pthread_mutex_lock(&ctx->statsLock);
+    ModelPostprocessStats* stats = &ctx->stats;
+    stats->count++;
+    stats->candidates += candidates;
+    stats->detections += detections;
+    stats->decode_total_ms += decode_ms;
+    stats->nms_total_ms += nms_ms;
+    if (nms_ms > stats->nms_max_ms) stats->nms_max_ms = nms_ms;
+    pthread_mutex_unlock(&ctx->statsLock);
+}
+
+void Model_GetPostprocessStats(ModelContext* ctx, ModelPostprocessStats* stats) {
+    pthread_mutex_lock(&ctx->statsLock);
+    *stats = ctx->stats;
+    pthread_mutex_unlock(&ctx->statsLock);
+}
+
+// Grow the NMS arrays to hold size candidates in buckets classes
+static bool detector_reserve(ModelDetector* d, int size, int buckets) {
+    if (size > d->capacity) {
+        int capacity = d->capacity ? d->capacity : CANDIDATES_INITIAL;
+        while (capacity < size) capacity *= 2;
+        ScoredIndex* order = realloc(d->order, capacity * sizeof(ScoredIndex));
+        if (order) d->order = order;
+        int* bucketed = realloc(d->bucketed, capacity * sizeof(int));
+        if (bucketed) d->bucketed = bucketed;
+        bool* suppressed = realloc(d->suppressed, capacity * sizeof(bool));
+        if (suppressed) d->suppressed = suppressed;
+        int* kept = realloc(d->kept, capacity * sizeof(int));
+        if (kept) d->kept = kept;
+        if (!order || !bucketed || !suppressed || !kept) {
+            return false;
+        }
+        d->capacity = capacity;
+    }
+    if (buckets + 1 > d->bucket_capacity) {
+        int* bucket_end = realloc(d->bucket_end, (buckets + 1) * sizeof(int));
+        if (!bucket_end) {
+            return false;
+        }
+        d->bucket_end = bucket_end;
+        d->bucket_capacity = buckets + 1;
+    }
+    return true;
+}
+
+ModelDetector* Model_CreateDetector(void) {
+    return calloc(1, sizeof(ModelDetector));
+}
+
+void Model_DestroyDetector(ModelDetector* d) {
+    if (!d) return;
+    candidates_free(&d->candidates);
+    free(d->order);
+    free(d->bucketed);
+    free(d->suppressed);
+    free(d->kept);
+    free(d->bucket_end);
+    free(d->detections);
+    free(d);
+}
+
+int Model_DetectWith(ModelContext* ctx, ModelDetector* d, const uint8_t* output,
+                     const ModelTransform* transform, const ModelDetection** detections) {
+    *detections = NULL;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Candidates* candidates = &d->candidates;
+    if (!ctx->decode(ctx, output, candidates)) {
+        return -1;
+    }
+    double decode_ms = elapsed_ms(&start);
+
+    LOG_SAMPLED("Found %d detections before NMS\n", candidates->count);
+
+    // Apply NMS
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int count = non_maximum_suppression(ctx, d);
+    if (count < 0) {
+        return -1;
+    }
+    record_postprocess(ctx, candidates->count, count, decode_ms, elapsed_ms(&start));
+
+    // Only the survivors are mapped; formatting is left to the response
+    if (count > d->detection_capacity) {
+        ModelDetection* grown = realloc(d->detections, count * sizeof(ModelDetection));
+        if (!grown) {
+            return -1;
+        }
+        d->detections = grown;
+        d->detection_capacity = count;
+    }
+    if (count > 0) {
+        map_detections(ctx, candidates, d->kept, count, transform, d->detections);
+        *detections = d->detections;
+    }
+    return count;
+}
+
+int Model_Detect(ModelContext* ctx, const uint8_t* output,
+                 const ModelTransform* transform, ModelDetection** detections) {
+    *detections = NULL;
+
+    ModelDetector* d = Model_CreateDetector();
+    if (!d) {
+        return -1;
+    }
+    const ModelDetection* found;
+    int count = Model_DetectWith(ctx, d, output, transform, &found);
+    if (count > 0) {
+        *detections = malloc(count * sizeof(ModelDetection));
+        if (*detections) {
+            memcpy(*detections, found, count * sizeof(ModelDetection));
+        } else {
+            count = -1;
+        }
+    }
+    Model_DestroyDetector(d);
+    return count;
+}
+
+cJSON* Model_Postprocess(ModelContext* ctx, const uint8_t* output,
+                         const ModelTransform* transform, int image_index) {
+    ModelDetection* detections;
+    int count = Model_Detect(ctx, output, transform, &detections);
+    if (count < 0) {
+        return NULL;
+    }
+    cJSON* formatted = Model_FormatDetections(ctx, detections, count,
+                                              transform->original_width, transform->original_height,
+                                              image_index, MODEL_FORMAT_FULL);
+    free(detections);
     return formatted;
 }
 
-static int get_class_id_from_label(const char* label) {
-    if (!label || !modelLabels) return -1;
+//-----------------------------------------------------------------------------
+// Inference Functions
+//-----------------------------------------------------------------------------
+
+cJSON* Model_InferenceTensor(ModelContext* ctx, const uint8_t* rgb_data, int width, int height,
+                             int image_index, char** error_msg) {
+    if (error_msg) *error_msg = NULL;
+
+    // Validate dimensions
+    if (width != (int)ctx->modelWidth || height != (int)ctx->modelHeight) {
+        if (error_msg) {
+            char buf[256];
+            snprintf(buf, sizeof(buf),
+                     "Invalid dimensions: expected %dx%d, got %dx%d",
+                     ctx->modelWidth, ctx->modelHeight, width, height);
+            *error_msg = strdup(buf);
+        }
+        return NULL;
+    }
+
+    uint8_t* output = malloc(ctx->outputBufferSize);
+    if (!output) {
+        if (error_msg) *error_msg = strdup("Failed to allocate output buffer");
+        return NULL;
+    }
+
+    if (!Model_Run(ctx, rgb_data, output, error_msg)) {
+        free(output);
+        return NULL;
+    }
+
+    // Tensor input is already in model space
+    ModelTransform transform;
+    Model_IdentityTransform(ctx, &transform);
+
+    cJSON* result = Model_Postprocess(ctx, output, &transform, image_index);
+    free(output);
+    return result;
+}
+
+cJSON* Model_InferenceJPEG(ModelContext* ctx, const uint8_t* jpeg_data, size_t jpeg_size,
+                           int image_index, int image_width, int image_height,
+                           char** error_msg) {
+    if (error_msg) *error_msg = NULL;
+
+    int slot = Model_AcquireSlot(ctx);
+    if (slot < 0) {
+        if (error_msg) *error_msg = strdup("Model is shutting down");
+        return NULL;
+    }
+
+    // Preprocessing writes the slot input directly, so nothing is copied
+    ModelTransform transform;
+    cJSON* result = NULL;
+    if (Model_PreprocessJPEG(ctx, NULL, slot, 0, jpeg_data, jpeg_size, image_width, image_height,
+                             &transform, error_msg) &&
+        slot_run(ctx, &ctx->slots[slot], error_msg)) {
+        result = Model_Postprocess(ctx, ctx->slots[slot].outputAddr, &transform, image_index);
+    }
+
+    Model_ReleaseSlot(ctx, slot);
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+// Helper Functions
+//-----------------------------------------------------------------------------
+
+// Model space = original * scale + offset, matching preprocess.c's geometry
+static void scale_transform(PreprocessScaleMode mode, int src_w, int src_h,
+                            int out_w, int out_h, ModelTransform* transform) {
+    float ratio_x = (float)out_w / src_w;
+    float ratio_y = (float)out_h / src_h;
+
+    transform->original_width = src_w;
+    transform->original_height = src_h;
+    transform->region = (ModelRegion){ 0, 0, src_w, src_h };
+
+    switch (mode) {
+        case SCALE_MODE_STRETCH:
+            transform->scale_x = ratio_x;
+            transform->scale_y = ratio_y;
+            transform->offset_x = 0.0f;
+            transform->offset_y = 0.0f;
+            break;
+
+        case SCALE_MODE_CROP: {
+            // Fill the output; the overflowing axis is cut equally on both sides
+            float scale = fmaxf(ratio_x, ratio_y);
+            transform->scale_x = scale;
+            transform->scale_y = scale;
+            transform->offset_x = (out_w - src_w * scale) / 2.0f;
+            transform->offset_y = (out_h - src_h * scale) / 2.0f;
+            break;
+        }
+
+        case SCALE_MODE_LETTERBOX:
+        default: {
+            // Fit inside the output and center on whole pixels
+            float scale = fminf(ratio_x, ratio_y);
+            int scaled_w = (int)lroundf(src_w * scale);
+            int scaled_h = (int)lroundf(src_h * scale);
+            transform->scale_x = scale;
+            transform->scale_y = scale;
+            transform->offset_x = (float)((out_w - scaled_w) / 2);
+            transform->offset_y = (float)((out_h - scaled_h) / 2);
+            break;
+        }
+    }
+}
+
+// region as if it were the whole src_w x src_h image, offset so that the
+// transform still maps the whole image
+static void region_transform(PreprocessScaleMode mode, int src_w, int src_h,
+                             const ModelRegion* region, int out_w, int out_h,
+                             ModelTransform* transform) {
+    scale_transform(mode, region->width, region->height, out_w, out_h, transform);
+    transform->offset_x -= region->x * transform->scale_x;
+    transform->offset_y -= region->y * transform->scale_y;
+    transform->original_width = src_w;
+    transform->original_height = src_h;
+    transform->region = *region;
+}
+
+// Tensor pixels covered by region_start .. region_start + region_len of the image
+static void sampling_axis(float scale, float offset, int region_start, int region_len,
+                          int original, int decoded, int out,
+                          int* dst, int* dst_len, float* src, float* step) {
+    int start = (int)lroundf(offset + region_start * scale);
+    int end = (int)lroundf(offset + (region_start + region_len) * scale);
+    if (start < 0) start = 0;
+    if (end > out) end = out;
+
+    // Tensor pixel -> decoded pixel
+    float ratio = (float)decoded / original;
+    *dst = start;
+    *dst_len = end > start ? end - start : 0;
+    *step = ratio / scale;
+    *src = (start - offset) / scale * ratio;
+}
+
+// rgb_in may be a DCT-downscaled decode of the image described by transform
+static void sampling_init(const ModelTransform* transform, int in_w, int in_h,
+                          int out_w, int out_h, Sampling* sampling) {
+    sampling->in_w = in_w;
+    sampling->in_h = in_h;
+    sampling_axis(transform->scale_x, transform->offset_x,
+                  transform->region.x, transform->region.width, transform->original_width,
+                  in_w, out_w, &sampling->dst_x, &sampling->dst_w,
+                  &sampling->src_x, &sampling->step_x);
+    sampling_axis(transform->scale_y, transform->offset_y,
+                  transform->region.y, transform->region.height, transform->original_height,
+                  in_h, out_h, &sampling->dst_y, &sampling->dst_h,
+                  &sampling->src_y, &sampling->step_y);
+}
+
+// Black padding around the image area; the image area is written by the rows
+static void clear_borders(uint8_t* out, int out_w, int out_h, const Sampling* sampling) {
+    int x0 = sampling->dst_x;
+    int y0 = sampling->dst_y;
+    int w = sampling->dst_w;
+    int h = sampling->dst_h;
+    size_t stride = (size_t)out_w * 3;
+
+    memset(out, 0, y0 * stride);
+    memset(out + (size_t)(y0 + h) * stride, 0, (out_h - y0 - h) * stride);
+    if (x0 == 0 && w == out_w) return;
+    for (int y = y0; y < y0 + h; y++) {
+        uint8_t* row = out + y * stride;
+        memset(row, 0, x0 * 3);
+        memset(row + (x0 + w) * 3, 0, (out_w - x0 - w) * 3);
+    }
+}
+
+static Resizer* sampling_resizer(ResizeFilter filter, const Sampling* sampling) {
+    return RESIZE_Create(filter, sampling->in_w, sampling->in_h,
+                         sampling->dst_w, sampling->dst_h,
+                         sampling->src_x, sampling->src_y,
+                         sampling->step_x, sampling->step_y);
+}
+
+static bool preprocess_rgb_scaled(ResizeFilter filter, const uint8_t* rgb_in, int in_w, int in_h,
+                                  uint8_t* out, int out_w, int out_h,
+                                  const ModelTransform* transform) {
+    Sampling sampling;
+    sampling_init(transform, in_w, in_h, out_w, out_h, &sampling);
+    clear_borders(out, out_w, out_h, &sampling);
+    if (sampling.dst_w == 0 || sampling.dst_h == 0) {
+        return true;
+    }
+
+    Resizer* resizer = sampling_resizer(filter, &sampling);
+    if (!resizer) {
+        LOG_WARN("%s: Failed to create resizer\n", __func__);
+        return false;
+    }
+
+    LOG_TRACE("Scale: %dx%d (decoded %dx%d) -> %dx%d at %d,%d (scale %.3fx%.3f, %s)\n",
+              transform->original_width, transform->original_height, in_w, in_h,
+              sampling.dst_w, sampling.dst_h, sampling.dst_x, sampling.dst_y,
+              transform->scale_x, transform->scale_y, RESIZE_FilterName(filter));
+
+    size_t stride = (size_t)out_w * 3;
+    RESIZE_Frame(resizer, rgb_in, (size_t)in_w * 3,
+                 out + sampling.dst_y * stride + sampling.dst_x * 3, stride);
+    RESIZE_Destroy(resizer);
+    return true;
+}
+
+static bool scaled_sink_begin(const DecodedImage* image, void* user_data) {
+    ScaledSink* state = (ScaledSink*)user_data;
+    state->in_w = image->source_width;
+    state->in_h = image->source_height;
+    if (image->source_width != state->expected_w || image->source_height != state->expected_h) {
+        state->mismatch = true;
+        return false;
+    }
 
-    for (size_t i = 0; i < numLabels; i++) {
-        if (strcmp(modelLabels[i], label) == 0) {
-            return (int)i;
+    state->in_w = image->width;
+    state->in_h = image->height;
+    sampling_init(state->transform, image->width, image->height,
+                  state->out_w, state->out_h, &state->sampling);
+    clear_borders(state->tensor, state->out_w, state->out_h, &state->sampling);
+
+    if (state->sampling.dst_w > 0 && state->sampling.dst_h > 0) {
+        state->resizer = sampling_resizer(state->filter, &state->sampling);
+        if (!state->resizer) {
+            LOG_WARN("%s: Failed to create resizer\n", __func__);
+            state->failed = true;
+            return false;
         }
     }
+    return true;
+}
 
-    return -1;
+// Rows arrive top to bottom; the resizer writes each tensor row once all the
+// decoded rows it samples have been seen. Rows outside a crop are skipped.
+static void scaled_sink_row(const uint8_t* rgb, int y, void* user_data) {
+    ScaledSink* state = (ScaledSink*)user_data;
+    if (!state->resizer) {
+        return;
+    }
+
+    const Sampling* sampling = &state->sampling;
+    size_t stride = (size_t)state->out_w * 3;
+    RESIZE_PushRow(state->resizer, rgb, y,
+                   state->tensor + sampling->dst_y * stride + sampling->dst_x * 3, stride);
+}
+
+// Map the kept candidates back to original image pixels
+static void map_detections(const ModelContext* ctx, const Candidates* c,
+                           const int* kept, int count,
+                           const ModelTransform* transform, ModelDetection* out) {
+    for (int k = 0; k < count; k++) {
+        int i = kept[k];
+
+        // Coordinates are normalized 0-1 in model space (top-left);
+        // convert to model pixel coordinates
+        double x_model = c->x[i] * ctx->modelWidth;
+        double y_model = c->y[i] * ctx->modelHeight;
+        double w_model = c->w[i] * ctx->modelWidth;
+        double h_model = c->h[i] * ctx->modelHeight;
+
+        // Transform back to original image coordinates
+        // (accounting for padding/crop offset and per-axis scale)
+        double x_orig = (x_model - transform->offset_x) / transform->scale_x;
+        double y_orig = (y_model - transform->offset_y) / transform->scale_y;
+        double w_orig = w_model / transform->scale_x;
+        double h_orig = h_model / transform->scale_y;
+
+        // Clamp to the part of the image in the input (normally all of it)
+        const ModelRegion* region = &transform->region;
+        if (x_orig < region->x) x_orig = region->x;
+        if (y_orig < region->y) y_orig = region->y;
+        if (x_orig + w_orig > region->x + region->width) {
+            w_orig = region->x + region->width - x_orig;
+        }
+        if (y_orig + h_orig > region->y + region->height) {
+            h_orig = region->y + region->height - y_orig;
+        }
+
+        out[k].class_id = c->class_id[i];
+        out[k].confidence = c->score[i];
+        out[k].x = (float)x_orig;
+        out[k].y = (float)y_orig;
+        out[k].w = (float)w_orig;
+        out[k].h = (float)h_orig;
+    }
+}
+
+void Model_WriteDetections(ModelContext* ctx, JsonWriter* w, const char* key,
+                           const ModelDetection* detections, int count,
+                           int image_width, int image_height, int image_index,
+                           ModelResultFormat format) {
+    JSONW_BeginArray(w, key);
+
+    for (int k = 0; k < count; k++) {
+        const ModelDetection* d = &detections[k];
+        JSONW_BeginObject(w, NULL);
+
+        // Label and class_id (-1 when the model has more classes than labels).
+        // The fallback name is built here: labels_get's buffer is shared
+        // and this runs on several HTTP threads
+        int class_id = d->class_id;
+        char fallback[32];
+        const char* label;
+        if (ctx->modelLabels && class_id >= 0 && (size_t)class_id < ctx->numLabels) {
+            label = ctx->modelLabels[class_id];
+        } else {
+            snprintf(fallback, sizeof(fallback), "class_%d", class_id);
+            label = fallback;
+            class_id = -1;
+        }
+
+        if (format == MODEL_FORMAT_LEAN) {
+            // Nothing that repeats per detection or can be derived from the rest;
+            // confidence rounded so it prints short
+            JSONW_String(w, "label", label);
+            JSONW_Int(w, "class_id", class_id);
+            JSONW_Double(w, "confidence", round(d->confidence * 1000.0) / 1000.0);
+            JSONW_BeginArray(w, "bbox");
+            JSONW_Int(w, NULL, (int)d->x);
+            JSONW_Int(w, NULL, (int)d->y);
+            JSONW_Int(w, NULL, (int)d->w);
+            JSONW_Int(w, NULL, (int)d->h);
+            JSONW_EndArray(w);
+            JSONW_EndObject(w);
+            continue;
+        }
+
+        // Add image index
+        JSONW_Int(w, "index", image_index);
+
+        // Add original image dimensions for client reference
+        JSONW_BeginObject(w, "image");
+        JSONW_Int(w, "width", image_width);
+        JSONW_Int(w, "height", image_height);
+        JSONW_EndObject(w);
+
+        JSONW_String(w, "label", label);
+        JSONW_Int(w, "class_id", class_id);
+        JSONW_Double(w, "confidence", d->confidence);
+
+        // bbox_pixels (top-left, absolute pixels in ORIGINAL image coordinates)
+        JSONW_BeginObject(w, "bbox_pixels");
+        JSONW_Int(w, "x", (int)d->x);
+        JSONW_Int(w, "y", (int)d->y);
+        JSONW_Int(w, "w", (int)d->w);
+        JSONW_Int(w, "h", (int)d->h);
+        JSONW_EndObject(w);
+
+        // bbox_yolo (center, normalized 0-1 in ORIGINAL image space)
+        JSONW_BeginObject(w, "bbox_yolo");
+        JSONW_Double(w, "x", (d->x + d->w / 2.0) / image_width);  // center x
+        JSONW_Double(w, "y", (d->y + d->h / 2.0) / image_height); // center y
+        JSONW_Double(w, "w", (double)d->w / image_width);
+        JSONW_Double(w, "h", (double)d->h / image_height);
+        JSONW_EndObject(w);
+
+        JSONW_EndObject(w);
+    }
+
+    JSONW_EndArray(w);
+}
+
+cJSON* Model_FormatDetections(ModelContext* ctx, const ModelDetection* detections, int count,
+                              int image_width, int image_height, int image_index,
+                              ModelResultFormat format) {
+    // Own writer: the caller may be in the middle of a JSONW_Thread() document
+    JsonWriter w = {0};
+    Model_WriteDetections(ctx, &w, NULL, detections, count,
+                          image_width, image_height, image_index, format);
+    cJSON* formatted = JSONW_Data(&w) ? cJSON_Parse(JSONW_Data(&w)) : NULL;
+    JSONW_Free(&w);
+    return formatted;
+}
+
+static void put_u16(uint8_t* p, unsigned int v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static unsigned int clamp_u16(float v) {
+    if (v <= 0.0f) return 0;
+    if (v >= 65535.0f) return 65535;
+    return (unsigned int)v;
+}
+
+// IEEE half precision, round to nearest; enough for confidences in [0, 1]
+static uint16_t float_to_half(float value) {
+    union { float f; uint32_t u; } bits = { value };
+    uint32_t sign = (bits.u >> 16) & 0x8000;
+    int exponent = (int)((bits.u >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits.u & 0x7FFFFF;
+
+    if (exponent >= 31) return sign | 0x7C00;       // Overflow (or NaN) to infinity
+    if (exponent <= 0) {
+        if (exponent < -10) return sign;            // Underflow to zero
+        mantissa |= 0x800000;                       // Subnormal
+        int shift = 14 - exponent;
+        return sign | ((mantissa + (1u << (shift - 1))) >> shift);
+    }
+    // A mantissa carry rolls into the exponent, which is the right result
+    return sign | (((uint32_t)exponent << 10) + ((mantissa + 0x1000) >> 13));
+}
+
+size_t Model_PackDetections(const ModelDetection* detections, int count,
+                            int image_width, int image_height, int image_index,
+                            uint8_t* out) {
+    out[0] = 'D';
+    out[1] = 'X';
+    out[2] = MODEL_PACKED_VERSION;
+    out[3] = MODEL_PACKED_RECORD_SIZE;
+    put_u16(out + 4, count);
+    put_u16(out + 6, 0);
+    put_u16(out + 8, (uint32_t)image_index & 0xFFFF);
+    put_u16(out + 10, (uint32_t)image_index >> 16);
+    put_u16(out + 12, image_width);
+    put_u16(out + 14, image_height);
+
+    uint8_t* record = out + MODEL_PACKED_HEADER_SIZE;
+    for (int k = 0; k < count; k++, record += MODEL_PACKED_RECORD_SIZE) {
+        const ModelDetection* d = &detections[k];
+        put_u16(record, (d->class_id >= 0 && d->class_id < 0xFFFF) ? (unsigned int)d->class_id : 0xFFFF);
+        put_u16(record + 2, float_to_half(d->confidence));
+        put_u16(record + 4, clamp_u16(d->x));
+        put_u16(record + 6, clamp_u16(d->y));
+        put_u16(record + 8, clamp_u16(d->w));
+        put_u16(record + 10, clamp_u16(d->h));
+    }
+    return MODEL_PACKED_SIZE(count);
 }
 
 // NMS implementation (from DetectX)
@@ -767,76 +2101,362 @@ static float iou(float x1, float y1, float w1, float h1, float x2, float y2, flo
     return (union_area > 0) ? (intersection_area / union_area) : 0;
 }
 
-static cJSON* non_maximum_suppression(cJSON* list) {
-    if (!list || cJSON_GetArraySize(list) == 0) {
-        return cJSON_CreateArray();
+// Highest score first; ties keep decode order so results are deterministic
+static int compare_score_desc(const void* a, const void* b) {
+    const ScoredIndex* sa = a;
+    const ScoredIndex* sb = b;
+    if (sa->score != sb->score) {
+        return sa->score > sb->score ? -1 : 1;
     }
+    return sa->index - sb->index;
+}
 
-    cJSON* result = cJSON_CreateArray();
-    int size = cJSON_GetArraySize(list);
+// Greedy NMS: candidates are sorted by score once, bucketed by class (stable,
+// so each bucket stays sorted) and every kept box suppresses the lower-scoring
+// boxes of its bucket. Writes the surviving indices into d->kept, highest
+// score first. Returns -1 if the scratch arrays cannot grow.
+static int non_maximum_suppression(const ModelContext* ctx, ModelDetector* d) {
+    const Candidates* c = &d->candidates;
+    int size = c->count;
+    if (size == 0) {
+        return 0;
+    }
 
-    // Track which detections to keep
-    bool* keep = calloc(size, sizeof(bool));
-    if (!keep) return list;
+    int buckets = ctx->classAgnosticNms ? 1 : (int)ctx->classes;
+    if (!detector_reserve(d, size, buckets)) {
+        LOG_WARN("%s: Out of memory for %d candidates\n", __func__, size);
+        return -1;
+    }
+    ScoredIndex* order = d->order;
+    int* bucketed = d->bucketed;
+    int* bucket_end = d->bucket_end;
+    bool* suppressed = d->suppressed;
+    int* kept = d->kept;
+    memset(bucket_end, 0, (buckets + 1) * sizeof(int));
+    memset(suppressed, 0, size * sizeof(bool));
 
     for (int i = 0; i < size; i++) {
-        keep[i] = true;
+        order[i].score = c->score[i];
+        order[i].index = i;
     }
+    qsort(order, size, sizeof(ScoredIndex), compare_score_desc);
 
-    // Compare each detection with every other detection
-    for (int i = 0; i < size; i++) {
-        if (!keep[i]) continue;
-
-        cJSON* det1 = cJSON_GetArrayItem(list, i);
-        float x1 = cJSON_GetObjectItem(det1, "x")->valuedouble;
-        float y1 = cJSON_GetObjectItem(det1, "y")->valuedouble;
-        float w1 = cJSON_GetObjectItem(det1, "w")->valuedouble;
-        float h1 = cJSON_GetObjectItem(det1, "h")->valuedouble;
-        float c1 = cJSON_GetObjectItem(det1, "c")->valuedouble;
-
-        for (int j = i + 1; j < size; j++) {
-            if (!keep[j]) continue;
-
-            cJSON* det2 = cJSON_GetArrayItem(list, j);
-            
-            // Only suppress if same class
-            const char* label1 = cJSON_GetObjectItem(det1, "label")->valuestring;
-            const char* label2 = cJSON_GetObjectItem(det2, "label")->valuestring;
-            if (strcmp(label1, label2) != 0) continue;
-
-            float x2 = cJSON_GetObjectItem(det2, "x")->valuedouble;
-            float y2 = cJSON_GetObjectItem(det2, "y")->valuedouble;
-            float w2 = cJSON_GetObjectItem(det2, "w")->valuedouble;
-            float h2 = cJSON_GetObjectItem(det2, "h")->valuedouble;
-            float c2 = cJSON_GetObjectItem(det2, "c")->valuedouble;
-
-            float iou_val = iou(x1, y1, w1, h1, x2, y2, w2, h2);
-
-            if (iou_val > nms) {
-                // Suppress the one with lower confidence
-                if (c1 > c2) {
-                    keep[j] = false;
-                } else {
-                    keep[i] = false;
-                    break;
+    int considered = size;
+    if (ctx->nmsTopK > 0 && ctx->nmsTopK < considered) {
+        considered = ctx->nmsTopK;
+    }
+
+    // Counting sort by class: bucket b ends up in bucketed[bucket_end[b - 1] .. bucket_end[b])
+    for (int k = 0; k < considered; k++) {
+        int b = ctx->classAgnosticNms ? 0 : c->class_id[order[k].index];
+        bucket_end[b + 1]++;
+    }
+    for (int b = 0; b < buckets; b++) {
+        bucket_end[b + 1] += bucket_end[b];
+    }
+    for (int k = 0; k < considered; k++) {
+        int b = ctx->classAgnosticNms ? 0 : c->class_id[order[k].index];
+        bucketed[bucket_end[b]++] = order[k].index;
+    }
+
+    int begin = 0;
+    for (int b = 0; b < buckets; b++) {
+        int end = bucket_end[b];
+        for (int p = begin; p < end; p++) {
+            int i = bucketed[p];
+            if (suppressed[i]) continue;
+
+            for (int q = p + 1; q < end; q++) {
+                int j = bucketed[q];
+                if (suppressed[j]) continue;
+
+                if (iou(c->x[i], c->y[i], c->w[i], c->h[i],
+                        c->x[j], c->y[j], c->w[j], c->h[j]) > ctx->nms) {
+                    suppressed[j] = true;
                 }
             }
         }
+        begin = end;
     }
 
-    // Build result array
-    for (int i = 0; i < size; i++) {
-        if (keep[i]) {
-            cJSON* det = cJSON_GetArrayItem(list, i);
-            cJSON_AddItemToArray(result, cJSON_Duplicate(det, 1));
+    // Collect survivors across classes in score order
+    int count = 0;
+    for (int k = 0; k < considered; k++) {
+        int i = order[k].index;
+        if (suppressed[i]) continue;
+
+        kept[count++] = i;
+        if (ctx->maxDetections > 0 && count == ctx->maxDetections) break;
+    }
+
+    LOG_SAMPLED("NMS: %d -> %d detections\n", size, count);
+
+    return count;
+}
+
+static int compare_confidence_desc(const void* a, const void* b) {
+    float ca = ((const ModelDetection*)a)->confidence;
+    float cb = ((const ModelDetection*)b)->confidence;
+    return (ca < cb) - (ca > cb);
+}
+
+// Share of the smaller box's area inside the other box
+static float covered(const ModelDetection* a, const ModelDetection* b) {
+    float iw = fminf(a->x + a->w, b->x + b->w) - fmaxf(a->x, b->x);
+    float ih = fminf(a->y + a->h, b->y + b->h) - fmaxf(a->y, b->y);
+    float smaller = fminf(a->w * a->h, b->w * b->h);
+    return (iw > 0 && ih > 0 && smaller > 0) ? iw * ih / smaller : 0;
+}
+
+int Model_MergeDetections(const ModelContext* ctx, ModelDetection* detections, int count) {
+    if (count <= 0) {
+        return 0;
+    }
+    qsort(detections, count, sizeof(ModelDetection), compare_confidence_desc);
+
+    // Survivors are compacted to the front; each is checked against those kept before it
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        const ModelDetection* d = &detections[i];
+        bool suppressed = false;
+        for (int k = 0; k < kept && !suppressed; k++) {
+            const ModelDetection* s = &detections[k];
+            if (!ctx->classAgnosticNms && s->class_id != d->class_id) continue;
+            suppressed = iou(s->x, s->y, s->w, s->h, d->x, d->y, d->w, d->h) > ctx->nms ||
+                         covered(s, d) > MERGE_CONTAINED;
         }
+        if (suppressed) continue;
+
+        detections[kept++] = *d;
+        if (ctx->maxDetections > 0 && kept == ctx->maxDetections) break;
     }
 
-    free(keep);
+    LOG_SAMPLED("Merge: %d -> %d detections\n", count, kept);
+    return kept;
+}
 
-    LOG("NMS: %d -> %d detections\n", size, cJSON_GetArraySize(result));
+// Map the slot buffers and create its job. Tensors passed in (those used to
+// introspect the model) are taken over, also on failure; NULL creates them.
+static bool setup_slot(ModelContext* ctx, TensorSlot* slot, larodTensor** inputTensors,
+                       larodTensor** outputTensors) {
+    larodError* error = NULL;
+    char inputPattern[sizeof(OBJECT_DETECTOR_INPUT_FILE_PATTERN)];
+    char outputPattern[sizeof(OBJECT_DETECTOR_OUT1_FILE_PATTERN)];
+
+    memset(slot, 0, sizeof(*slot));
+    slot->ctx = ctx;
+    slot->inputAddr = MAP_FAILED;
+    slot->outputAddr = MAP_FAILED;
+    slot->inputFd = -1;
+    slot->outputFd = -1;
+    slot->inputTensors = inputTensors;
+    slot->outputTensors = outputTensors;
+
+    // mkstemp rewrites the pattern, so every slot gets a fresh copy
+    memcpy(inputPattern, OBJECT_DETECTOR_INPUT_FILE_PATTERN, sizeof(inputPattern));
+    memcpy(outputPattern, OBJECT_DETECTOR_OUT1_FILE_PATTERN, sizeof(outputPattern));
+
+    if (!createAndMapTmpFile(inputPattern, ctx->inputBufferSize * ctx->batchSize,
+                            &slot->inputAddr, &slot->inputFd)) {
+        LOG_WARN("%s: Failed to create input buffer\n", __func__);
+        return false;
+    }
 
-    return result;
+    if (!createAndMapTmpFile(outputPattern, ctx->outputBufferSize * ctx->batchSize,
+                            &slot->outputAddr, &slot->outputFd)) {
+        LOG_WARN("%s: Failed to create output buffer\n", __func__);
+        return false;
+    }
+
+    // Create larod tensors
+    if (!slot->inputTensors) {
+        slot->inputTensors = larodCreateModelInputs(ctx->InfModel, &ctx->inputs, &error);
+    }
+    if (!slot->inputTensors) {
+        LOG_WARN("%s: Failed to create input tensors: %s\n", __func__, error->msg);
+        larodClearError(&error);
+        return false;
+    }
+
+    if (!slot->outputTensors) {
+        slot->outputTensors = larodCreateModelOutputs(ctx->InfModel, &ctx->outputs, &error);
+    }
+    if (!slot->outputTensors) {
+        LOG_WARN("%s: Failed to create output tensors: %s\n", __func__, error->msg);
+        larodClearError(&error);
+        return false;
+    }
+
+    // Set tensor file descriptors
+    if (!larodSetTensorFd(slot->inputTensors[0], slot->inputFd, &error)) {
+        LOG_WARN("%s: Failed to set input tensor fd: %s\n", __func__, error->msg);
+        larodClearError(&error);
+        return false;
+    }
+
+    if (!larodSetTensorFd(slot->outputTensors[0], slot->outputFd, &error)) {
+        LOG_WARN("%s: Failed to set output tensor fd: %s\n", __func__, error->msg);
+        larodClearError(&error);
+        return false;
+    }
+
+    // Create inference job request
+    slot->jobReq = larodCreateJobRequest(ctx->InfModel, slot->inputTensors, ctx->inputs,
+                                         slot->outputTensors, ctx->outputs, NULL, &error);
+    if (!slot->jobReq) {
+        LOG_WARN("%s: Failed to create job request: %s\n", __func__, error->msg);
+        larodClearError(&error);
+        return false;
+    }
+
+    return true;
+}
+
+// Cached larod job scaling a region_width x region_height part of width x
+// height frames of format into batch position item of the slot input,
+// created on first use
+static PreprocessContext* slot_get_preprocess(ModelContext* ctx, TensorSlot* slot, int item,
+                                              int width, int height, VdoFormat format,
+                                              int region_width, int region_height) {
+    for (int i = 0; i < slot->preprocessCount; i++) {
+        PreprocessEntry* entry = &slot->preprocess[i];
+        if (entry->width == width && entry->height == height && entry->format == format &&
+            entry->region_width == region_width && entry->region_height == region_height &&
+            entry->item == item) {
+            return entry->pp;
+        }
+    }
+
+    PreprocessEntry* entry;
+    if (slot->preprocessCount < PREPROCESS_CACHE_SIZE) {
+        entry = &slot->preprocess[slot->preprocessCount++];
+    } else {
+        entry = &slot->preprocess[slot->preprocessNext];
+        slot->preprocessNext = (slot->preprocessNext + 1) % PREPROCESS_CACHE_SIZE;
+        preprocess_destroy(entry->pp);
+    }
+
+    entry->width = width;
+    entry->height = height;
+    entry->format = format;
+    entry->region_width = region_width;
+    entry->region_height = region_height;
+    entry->item = item;
+    size_t offset = (size_t)item * ctx->inputBufferSize;
+    entry->pp = preprocess_create_region(ctx->conn, width, height, format,
+                                         region_width, region_height,
+                                         ctx->modelWidth, ctx->modelHeight,
+                                         VDO_FORMAT_RGB, ctx->scaleMode,
+                                         slot->inputFd, offset,
+                                         (uint8_t*)slot->inputAddr + offset);
+    if (!entry->pp) {
+        LOG_WARN("%s: larod preprocessing unavailable for %dx%d (region %dx%d) format %d\n",
+                 __func__, width, height, region_width, region_height, format);
+    }
+    return entry->pp;
+}
+
+// Scale a frame, or region of it (NULL: all of it), into the slot input on
+// larod. transform and region describe the original image; frame may be a
+// downscaled decode of it.
+static bool slot_preprocess(ModelContext* ctx, TensorSlot* slot, int item,
+                            const uint8_t* frame, size_t frame_size,
+                            int width, int height, VdoFormat format,
+                            int original_width, int original_height,
+                            const ModelRegion* region, ModelTransform* transform) {
+    // Region in frame pixels; NV12 chroma is subsampled, so it is kept even
+    int x = 0, y = 0, w = width, h = height;
+    if (region) {
+        float ratio_x = (float)width / original_width;
+        float ratio_y = (float)height / original_height;
+        x = (int)(region->x * ratio_x);
+        y = (int)(region->y * ratio_y);
+        w = (int)lroundf(region->width * ratio_x);
+        h = (int)lroundf(region->height * ratio_y);
+        if (format == VDO_FORMAT_YUV) {
+            x &= ~1;
+            y &= ~1;
+            w &= ~1;
+            h &= ~1;
+        }
+        if (w > width - x) w = width - x;
+        if (h > height - y) h = height - y;
+        if (w < 2 || h < 2) {
+            return false;
+        }
+    }
+
+    PreprocessContext* pp = slot_get_preprocess(ctx, slot, item, width, height, format, w, h);
+    if (!pp || !preprocess_set_region(pp, x, y)) {
+        return false;
+    }
+
+    if (lseek(slot->inputFd, 0, SEEK_SET) == -1) {
+        LOG_WARN("%s: Unable to rewind input file: %s\n", __func__, strerror(errno));
+        return false;
+    }
+    if (!preprocess_run(pp, frame, frame_size)) {
+        return false;
+    }
+
+    float scale_x, scale_y, offset_x, offset_y;
+    preprocess_get_mapping(pp, &scale_x, &scale_y, &offset_x, &offset_y);
+    transform->original_width = original_width;
+    transform->original_height = original_height;
+    transform->scale_x = scale_x * width / original_width;
+    transform->scale_y = scale_y * height / original_height;
+    transform->offset_x = offset_x;
+    transform->offset_y = offset_y;
+    transform->region = region ? *region : (ModelRegion){ 0, 0, original_width, original_height };
+    return true;
+}
+
+static void destroy_slot(TensorSlot* slot) {
+    ModelContext* ctx = slot->ctx;
+    larodError* error = NULL;
+
+    // Preprocessing jobs write into inputFd, so they go first
+    for (int i = 0; i < slot->preprocessCount; i++) {
+        preprocess_destroy(slot->preprocess[i].pp);
+    }
+    slot->preprocessCount = 0;
+
+    if (slot->jobReq) {
+        larodDestroyJobRequest(&slot->jobReq);
+        slot->jobReq = NULL;
+    }
+
+    if (slot->inputTensors) {
+        larodDestroyTensors(ctx->conn, &slot->inputTensors, ctx->inputs, &error);
+        slot->inputTensors = NULL;
+    }
+
+    if (slot->outputTensors) {
+        larodDestroyTensors(ctx->conn, &slot->outputTensors, ctx->outputs, &error);
+        slot->outputTensors = NULL;
+    }
+
+    if (slot->inputAddr != MAP_FAILED) {
+        munmap(slot->inputAddr, ctx->inputBufferSize * ctx->batchSize);
+        slot->inputAddr = MAP_FAILED;
+    }
+
+    if (slot->outputAddr != MAP_FAILED) {
+        munmap(slot->outputAddr, ctx->outputBufferSize * ctx->batchSize);
+        slot->outputAddr = MAP_FAILED;
+    }
+
+    if (slot->inputFd >= 0) {
+        close(slot->inputFd);
+        slot->inputFd = -1;
+    }
+
+    if (slot->outputFd >= 0) {
+        close(slot->outputFd);
+        slot->outputFd = -1;
+    }
+
+    larodClearError(&error);
 }
 
 static bool createAndMapTmpFile(char* fileName, size_t fileSize, void** mappedAddr, int* fd) {
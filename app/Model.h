@@ -3,35 +3,497 @@
 
 #include "larod.h"
 #include "cJSON.h"
+#include "jsonwriter.h"
+#include "jpeg_decoder.h"
+#include "preprocess.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define DEFAULT_TENSOR_SLOTS 2
+#define MAX_TENSOR_SLOTS 4
+#define MODEL_DEVICE_NAME_SIZE 64
+#define MODEL_NAME_SIZE 32
+#define DEFAULT_MODEL_PATH "model/model.tflite"
+#define DEFAULT_LABELS_PATH "model/labels.txt"
+
+/**
+ * @brief A loaded model with its larod connection, tensor slots and settings.
+ *
+ * Opaque; all Model_* functions taking a context are safe to call from
+ * multiple threads once it has been created.
+ */
+typedef struct ModelContext ModelContext;
+
+/**
+ * @brief Rectangle of an image in original pixels (a region of interest or tile)
+ */
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+} ModelRegion;
+
+/**
+ * @brief Mapping from model input space back to the original image.
+ *
+ * Filled per request by the preprocessing stage so that concurrent requests
+ * never share scaling state. Model space = original * scale + offset, per
+ * axis; offsets are the padding in letterbox mode and negative when cropping.
+ */
+typedef struct {
+    int original_width;
+    int original_height;
+    float scale_x;
+    float scale_y;
+    float offset_x;
+    float offset_y;
+    ModelRegion region;     // Part of the image in the input (all of it unless cropped to a region)
+} ModelTransform;
+
+/**
+ * @brief One detection surviving NMS, in original image pixels.
+ */
+typedef struct {
+    int class_id;           // Model class; may be beyond the label count
+    float confidence;
+    float x;                // Top-left corner
+    float y;
+    float w;
+    float h;
+} ModelDetection;
+
+/**
+ * @brief Response layouts for a list of detections
+ */
+typedef enum {
+    MODEL_FORMAT_FULL = 0,  // Objects with index, image, label, class_id, confidence, bbox_pixels, bbox_yolo
+    MODEL_FORMAT_LEAN,      // Objects with label, class_id, confidence and bbox [x, y, w, h] pixels
+    MODEL_FORMAT_BINARY     // Packed records, see Model_PackDetections
+} ModelResultFormat;
+
+// Packed layout (little-endian). Header: "DX", u8 version, u8 record size,
+// u16 count, u16 reserved, i32 image index, u16 image width, u16 image height.
+// Record: u16 class_id (model class, also beyond the labels), f16 confidence,
+// u16 x, y, w, h (pixels, top-left corner).
+#define MODEL_PACKED_VERSION 1
+#define MODEL_PACKED_HEADER_SIZE 16
+#define MODEL_PACKED_RECORD_SIZE 12
+#define MODEL_PACKED_SIZE(count) (MODEL_PACKED_HEADER_SIZE + (size_t)(count) * MODEL_PACKED_RECORD_SIZE)
+
+/**
+ * @brief Cumulative postprocessing counters (all threads)
+ */
+typedef struct {
+    uint64_t count;         // Outputs postprocessed
+    uint64_t candidates;    // Boxes entering NMS, summed
+    uint64_t detections;    // Boxes surviving NMS, summed
+    double decode_total_ms;
+    double nms_total_ms;
+    double nms_max_ms;
+} ModelPostprocessStats;
+
+/**
+ * @brief What loading a model found out, known without loading it again.
+ *
+ * Filled from a loaded context, or from the cache a previous load of the
+ * same model file wrote (see modelcache.h).
+ */
+typedef struct {
+    char path[256];
+    char labels[256];
+    char device[MODEL_DEVICE_NAME_SIZE];    // larod device the model runs on
+    int width;
+    int height;
+    int channels;
+    int batch_size;
+    int boxes;
+    int classes;
+    int data_type;          // larodTensorDataType of the output
+    float quant_scale;
+    int quant_zero_point;
+    double load_ms;         // Duration of the load, 0 if unknown
+} ModelDescription;
+
+/**
+ * @brief Load a model and allocate its tensor slots.
+ *
+ * Connects to larod, selects the best device, reads model parameters and the
+ * "model" section of the settings.
+ *
+ * @param model_path  Path to the .tflite file
+ * @return New context, or NULL on failure. Free with Model_Destroy.
+ */
+ModelContext* Model_Create(const char* model_path);
+
+/**
+ * @brief Model_Create on a named larod device (e.g. "cpu-tflite").
+ *
+ * @param device_name  Device to load the model on, or NULL for the preferred one
+ * @return New context, or NULL if the device does not exist or loading fails
+ */
+ModelContext* Model_CreateOnDevice(const char* model_path, const char* device_name);
+
 /**
- * @brief Initializes and configures the detection model for inference.
+ * @brief Load a model described by a settings object of the "model" layout.
  *
- * This function sets up the neural network, allocates all required buffers,
- * and reads model parameters and configuration.
- * It must be called before any inference or image processing.
+ * Reads "path" and "labels" (DEFAULT_MODEL_PATH and DEFAULT_LABELS_PATH if
+ * missing), "device", thresholds, scaling and tensor slots from settings,
+ * which is copied; the global settings are not consulted.
  *
- * @return true on success, false on failure.
+ * @param name  Name the model is known by (copied, truncated to MODEL_NAME_SIZE)
+ * @param settings  Model settings, or NULL for the defaults
+ * @param device_name  Device to load on, overriding settings "device" (NULL: none)
+ * @return New context, or NULL on failure. Free with Model_Destroy.
+ */
+ModelContext* Model_CreateFromSettings(const char* name, const cJSON* settings,
+                                       const char* device_name);
+
+/**
+ * @brief Release a context; waits for jobs still running on it.
+ */
+void Model_Destroy(ModelContext* ctx);
+
+/**
+ * @brief Describe the model of settings from the cache, without larod
+ *
+ * Hashes the model file, so a replaced file is not described by the
+ * previous one's entry.
+ *
+ * @return false if the file was never loaded with this device setting
+ */
+bool Model_Describe(const cJSON* settings, ModelDescription* desc);
+
+/**
+ * @brief Description of a loaded model
  */
-bool Model_Setup(void);
+void Model_GetDescription(const ModelContext* ctx, ModelDescription* desc);
+
+/**
+ * @brief Name given at creation ("default" for Model_Create)
+ */
+const char* Model_GetName(const ModelContext* ctx);
+
+/**
+ * @brief Settings the context was created from (owned by the context)
+ */
+const cJSON* Model_GetSettings(const ModelContext* ctx);
+
+/**
+ * @brief Name of the larod device the model was loaded on
+ */
+const char* Model_GetDevice(const ModelContext* ctx);
+
+/**
+ * @brief Path the model was loaded from
+ */
+const char* Model_GetPath(const ModelContext* ctx);
+
+/**
+ * @brief Number of class labels loaded with the model
+ */
+int Model_GetLabelCount(const ModelContext* ctx);
+
+/**
+ * @brief Label of a class (NULL beyond Model_GetLabelCount)
+ */
+const char* Model_GetLabel(const ModelContext* ctx, int class_id);
+
+/**
+ * @brief Names of the larod devices on this camera
+ * @return Number of names written (at most max)
+ */
+int Model_ListDevices(ModelContext* ctx, char names[][MODEL_DEVICE_NAME_SIZE], int max);
 
 /**
  * @brief Get model input width
  * @return Width in pixels
  */
-int Model_GetWidth(void);
+int Model_GetWidth(const ModelContext* ctx);
 
 /**
  * @brief Get model input height
  * @return Height in pixels
  */
-int Model_GetHeight(void);
+int Model_GetHeight(const ModelContext* ctx);
+
+/**
+ * @brief Images per inference job (the model input's batch dimension, usually 1)
+ */
+int Model_GetBatchSize(const ModelContext* ctx);
+
+/**
+ * @brief Size in bytes of one model input tensor (width * height * channels)
+ */
+size_t Model_GetInputSize(const ModelContext* ctx);
+
+/**
+ * @brief Size in bytes of one raw model output tensor
+ */
+size_t Model_GetOutputSize(const ModelContext* ctx);
+
+/**
+ * @brief Snapshot of the decode/NMS timings of Model_Postprocess
+ */
+void Model_GetPostprocessStats(ModelContext* ctx, ModelPostprocessStats* stats);
+
+/**
+ * @brief Reset a transform to identity (input already in model space)
+ */
+void Model_IdentityTransform(const ModelContext* ctx, ModelTransform* transform);
+
+/**
+ * @brief Completion callback for Model_RunAsync.
+ *
+ * Runs on a larod thread; keep it short (hand the slot to another thread).
+ *
+ * @param slot  Slot whose job finished; its output is valid until released
+ * @param success  false if larod reported an error
+ */
+typedef void (*ModelJobCallback)(int slot, bool success, void* user_data);
+
+/**
+ * @brief Number of tensor slots (settings model.tensor_slots)
+ */
+int Model_GetSlotCount(const ModelContext* ctx);
+
+/**
+ * @brief Claim a free tensor slot, blocking until one is released.
+ * @return Slot index, or -1 once Model_StopSlots/Model_Destroy was called
+ */
+int Model_AcquireSlot(ModelContext* ctx);
+
+/**
+ * @brief Return a slot acquired with Model_AcquireSlot
+ */
+void Model_ReleaseSlot(ModelContext* ctx, int slot);
+
+/**
+ * @brief Wake all threads blocked in Model_AcquireSlot (they get -1)
+ */
+void Model_StopSlots(ModelContext* ctx);
+
+/**
+ * @brief Mapped input tensor of a slot
+ *
+ * Holds Model_GetBatchSize() images of Model_GetInputSize() bytes back to back.
+ */
+uint8_t* Model_GetSlotInput(ModelContext* ctx, int slot);
+
+/**
+ * @brief Mapped output tensor of a slot
+ *
+ * Holds Model_GetBatchSize() raw outputs of Model_GetOutputSize() bytes back to back.
+ */
+const uint8_t* Model_GetSlotOutput(const ModelContext* ctx, int slot);
+
+/**
+ * @brief Pipeline stage 2: submit the job of a filled slot without waiting for it.
+ *
+ * While it executes, other slots can be filled and submitted.
+ *
+ * @param slot  Acquired slot with its input tensor written
+ * @param callback  Called once when the job completes
+ * @param error_msg  Output: Error message if submission fails (can be NULL)
+ * @return true if the job was submitted (callback will follow)
+ */
+bool Model_RunAsync(ModelContext* ctx, int slot, ModelJobCallback callback,
+                    void* user_data, char** error_msg);
+
+/**
+ * @brief Pipeline stage 1: decode and scale a JPEG into a slot's input tensor.
+ *
+ * Scales according to model.scaleMode. With model.preprocess "larod" the
+ * decoded frame is scaled by a cached larod cpu-proc job that writes straight
+ * into the slot input; otherwise (or if that fails) on the CPU.
+ * Thread-safe for distinct slots; may run on several workers while inference is busy.
+ *
+ * @param decoder  Calling worker's decoder (needed for the fused row path), or NULL for a one-off libjpeg decode
+ * @param slot  Acquired slot whose input tensor receives the image
+ * @param item  Position in the slot's batch (0 .. Model_GetBatchSize() - 1)
+ * @param transform  Output: mapping needed later by Model_Postprocess
+ * @param error_msg  Output: Error message on failure (can be NULL)
+ * @return true on success
+ */
+bool Model_PreprocessJPEG(ModelContext* ctx, JpegDecoder* decoder, int slot, int item,
+                          const uint8_t* jpeg_data, size_t jpeg_size,
+                          int image_width, int image_height,
+                          ModelTransform* transform, char** error_msg);
+
+/**
+ * @brief Pipeline stage 1 for raw frames: convert and scale into a slot's input tensor.
+ *
+ * Runs a larod cpu-proc job (cached per slot and frame geometry) that does the
+ * format conversion and model.scaleMode scaling. Interleaved RGB frames fall
+ * back to the CPU path when larod preprocessing is unavailable (or
+ * model.preprocess is "cpu"); other formats (e.g. VDO_FORMAT_YUV, NV12) always
+ * use larod and fail without it.
+ *
+ * @param slot  Acquired slot whose input tensor receives the image
+ * @param item  Position in the slot's batch (0 .. Model_GetBatchSize() - 1)
+ * @param frame  Frame data (NV12: width*height*3/2 bytes, RGB: width*height*3)
+ * @param format  VDO_FORMAT_YUV (NV12), VDO_FORMAT_RGB or VDO_FORMAT_PLANAR_RGB
+ * @param transform  Output: mapping needed later by Model_Postprocess
+ * @param error_msg  Output: Error message on failure (can be NULL)
+ * @return true on success
+ */
+bool Model_PreprocessFrame(ModelContext* ctx, int slot, int item,
+                           const uint8_t* frame, size_t frame_size,
+                           int width, int height, VdoFormat format,
+                           ModelTransform* transform, char** error_msg);
+
+/**
+ * @brief Decode a JPEG once for several Model_PreprocessRegion calls
+ *
+ * Downscaled in the DCT domain only as far as regions of region's size still
+ * get the full model resolution.
+ *
+ * @param region  Size of the regions that will be scaled (NULL: the whole image)
+ * @param image  Output: decoded frame; free with JPEG_FreeImage
+ * @param error_msg  Output: Error message on failure (can be NULL)
+ * @return true on success
+ */
+bool Model_DecodeJPEG(ModelContext* ctx, const uint8_t* jpeg_data, size_t jpeg_size,
+                      int image_width, int image_height, const ModelRegion* region,
+                      DecodedImage* image, char** error_msg);
+
+/**
+ * @brief Pipeline stage 1 for part of an image: scale region into a slot's input tensor.
+ *
+ * region is scaled according to model.scaleMode as if it were the whole image.
+ * On larod the cached cpu-proc job crops it (image.input.crop), so the tiles
+ * of one grid share a job and only move the crop; otherwise (RGB only) on the
+ * CPU. The transform maps back to the whole image, so detections come out in
+ * image coordinates, clamped to the region.
+ *
+ * @param frame  width x height frame of the original_width x original_height
+ *               image: a raw frame, or a (downscaled) Model_DecodeJPEG decode
+ * @param format  VDO_FORMAT_RGB for decoded JPEGs, otherwise as in Model_PreprocessFrame
+ * @param region  Part of the image in original pixels
+ * @param transform  Output: mapping needed later by Model_Postprocess
+ * @param error_msg  Output: Error message on failure (can be NULL)
+ * @return true on success
+ */
+bool Model_PreprocessRegion(ModelContext* ctx, int slot, int item,
+                            const uint8_t* frame, size_t frame_size,
+                            int width, int height, VdoFormat format,
+                            int original_width, int original_height,
+                            const ModelRegion* region,
+                            ModelTransform* transform, char** error_msg);
+
+/**
+ * @brief Expected byte size of a raw frame (0 for unsupported formats)
+ */
+size_t Model_FrameSize(int width, int height, VdoFormat format);
+
+/**
+ * @brief Run a blocking larod job on a caller-owned input tensor.
+ *
+ * Borrows a tensor slot for the duration of the job and copies the raw
+ * output to the caller. The server pipeline uses Model_RunAsync instead.
+ *
+ * @param tensor  Input tensor of Model_GetInputSize() bytes
+ * @param output  Output buffer of Model_GetOutputSize() bytes
+ * @param error_msg  Output: Error message on failure (can be NULL)
+ * @return true on success
+ */
+bool Model_Run(ModelContext* ctx, const uint8_t* tensor, uint8_t* output, char** error_msg);
+
+/**
+ * @brief Run a blocking larod job on an acquired slot whose input is filled
+ *
+ * The output is left in Model_GetSlotOutput(). Used where one job is timed
+ * on its own, e.g. the benchmark.
+ *
+ * @return true on success
+ */
+bool Model_RunSlot(ModelContext* ctx, int slot, char** error_msg);
+
+/**
+ * @brief Pipeline stage 3: decode a raw output tensor into detections.
+ *
+ * Boxes are mapped back to the original image and clamped to it; they are
+ * returned highest confidence first.
+ *
+ * @param output  Raw output from Model_Run or Model_GetSlotOutput()
+ * @param transform  Mapping from Model_PreprocessJPEG/Frame (or identity for tensors)
+ * @param detections  Output: malloc'd array (NULL when none), caller frees
+ * @return Number of detections, or -1 if out of memory
+ */
+int Model_Detect(ModelContext* ctx, const uint8_t* output,
+                 const ModelTransform* transform, ModelDetection** detections);
+
+// Decode/NMS scratch buffers for repeated Model_DetectWith calls. Not thread-safe.
+typedef struct ModelDetector ModelDetector;
+
+ModelDetector* Model_CreateDetector(void);
+void Model_DestroyDetector(ModelDetector* detector);
+
+/**
+ * @brief Model_Detect reusing the buffers of detector
+ *
+ * @param detections  Output: array owned by detector, valid until its next call
+ * @return Number of detections, or -1 if out of memory
+ */
+int Model_DetectWith(ModelContext* ctx, ModelDetector* detector, const uint8_t* output,
+                     const ModelTransform* transform, const ModelDetection** detections);
+
+/**
+ * @brief NMS over detections of several outputs of one image, e.g. its tiles
+ *
+ * Uses model.nms and the class-agnostic setting like the per-output NMS. A
+ * box mostly inside a stronger one of its class is dropped as well, since an
+ * object cut by a tile edge is found whole by the overlapping tile.
+ *
+ * @param detections  Image coordinates; reordered in place, highest confidence first
+ * @return Number of detections kept at the start of detections
+ */
+int Model_MergeDetections(const ModelContext* ctx, ModelDetection* detections, int count);
+
+/**
+ * @brief Write detections as a JSON array (MODEL_FORMAT_FULL or _LEAN).
+ *
+ * @param key  Member name when writing into an object, NULL inside an array
+ * @param image_width  Original image size, as in the transform
+ * @param image_index  Image index for dataset validation (-1 if not applicable)
+ */
+void Model_WriteDetections(ModelContext* ctx, JsonWriter* w, const char* key,
+                           const ModelDetection* detections, int count,
+                           int image_width, int image_height, int image_index,
+                           ModelResultFormat format);
+
+/**
+ * @brief Model_WriteDetections as a cJSON tree, for callers that keep it.
+ *
+ * @return cJSON array (NULL if out of memory); caller frees (cJSON_Delete)
+ */
+cJSON* Model_FormatDetections(ModelContext* ctx, const ModelDetection* detections, int count,
+                              int image_width, int image_height, int image_index,
+                              ModelResultFormat format);
+
+/**
+ * @brief Write detections in the packed layout.
+ *
+ * @param out  Buffer of at least MODEL_PACKED_SIZE(count) bytes
+ * @return Bytes written
+ */
+size_t Model_PackDetections(const ModelDetection* detections, int count,
+                            int image_width, int image_height, int image_index,
+                            uint8_t* out);
+
+/**
+ * @brief Model_Detect followed by Model_FormatDetections (full format).
+ *
+ * @return A cJSON array of detection objects (same format as InferenceJPEG).
+ *         Caller is responsible for freeing (cJSON_Delete).
+ */
+cJSON* Model_Postprocess(ModelContext* ctx, const uint8_t* output,
+                         const ModelTransform* transform, int image_index);
 
 /**
  * @brief Perform inference on JPEG image data and return detected objects.
@@ -60,7 +522,7 @@ int Model_GetHeight(void);
  * @return A cJSON array of detection objects, or NULL on error.
  *         Caller is responsible for freeing (cJSON_Delete).
  */
-cJSON* Model_InferenceJPEG(const uint8_t* jpeg_data, size_t jpeg_size,
+cJSON* Model_InferenceJPEG(ModelContext* ctx, const uint8_t* jpeg_data, size_t jpeg_size,
                            int image_index, int image_width, int image_height,
                            char** error_msg);
 
@@ -84,16 +546,9 @@ cJSON* Model_InferenceJPEG(const uint8_t* jpeg_data, size_t jpeg_size,
  * @return A cJSON array of detection objects, or NULL on error.
  *         Caller is responsible for freeing (cJSON_Delete).
  */
-cJSON* Model_InferenceTensor(const uint8_t* rgb_data, int width, int height,
+cJSON* Model_InferenceTensor(ModelContext* ctx, const uint8_t* rgb_data, int width, int height,
                              int image_index, char** error_msg);
 
-/**
- * @brief Clean up and free all model resources and buffers.
- *
- * Call this once on shutdown to properly release all memory and handles used by the model.
- */
-void Model_Cleanup(void);
-
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,149 @@
+/**
+ * applog.c - Runtime Log Levels Implementation
+ */
+
+#include "applog.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+_Atomic int Log_CurrentLevel = LOG_LEVEL_INFO;
+
+static _Atomic int rate_per_second = LOG_DEFAULT_RATE;
+static _Atomic int summary_interval = LOG_DEFAULT_SUMMARY_SECONDS;
+
+static const char* level_names[] = {
+    [LOG_LEVEL_ERROR] = "error",
+    [LOG_LEVEL_WARNING] = "warning",
+    [LOG_LEVEL_INFO] = "info",
+    [LOG_LEVEL_DEBUG] = "debug",
+};
+
+static const int syslog_priorities[] = {
+    [LOG_LEVEL_ERROR] = LOG_ERR,
+    [LOG_LEVEL_WARNING] = LOG_WARNING,
+    [LOG_LEVEL_INFO] = LOG_INFO,
+    [LOG_LEVEL_DEBUG] = LOG_DEBUG,
+};
+
+void Log_SetLevel(LogLevel level) {
+    if (level < LOG_LEVEL_ERROR || level > LOG_LEVEL_DEBUG) {
+        return;
+    }
+    atomic_store(&Log_CurrentLevel, (int)level);
+    setlogmask(LOG_UPTO(syslog_priorities[level]));
+}
+
+LogLevel Log_GetLevel(void) {
+    return (LogLevel)atomic_load(&Log_CurrentLevel);
+}
+
+const char* Log_LevelName(LogLevel level) {
+    if (level < LOG_LEVEL_ERROR || level > LOG_LEVEL_DEBUG) {
+        return "unknown";
+    }
+    return level_names[level];
+}
+
+bool Log_LevelFromString(const char* name, LogLevel* level) {
+    for (int i = LOG_LEVEL_ERROR; i <= LOG_LEVEL_DEBUG; i++) {
+        if (strcmp(name, level_names[i]) == 0) {
+            *level = (LogLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int Log_GetSummaryInterval(void) {
+    return atomic_load(&summary_interval);
+}
+
+void Log_Configure(const cJSON* settings) {
+    if (!settings) {
+        return;
+    }
+
+    const cJSON* item = cJSON_GetObjectItem(settings, "level");
+    if (cJSON_IsString(item)) {
+        LogLevel level;
+        if (Log_LevelFromString(item->valuestring, &level)) {
+            Log_SetLevel(level);
+        } else {
+            syslog(LOG_WARNING, "Unknown log level '%s', keeping %s",
+                   item->valuestring, Log_LevelName(Log_GetLevel()));
+        }
+    }
+
+    item = cJSON_GetObjectItem(settings, "rate_per_second");
+    if (cJSON_IsNumber(item) && item->valueint >= 1) {
+        atomic_store(&rate_per_second, item->valueint);
+    }
+
+    item = cJSON_GetObjectItem(settings, "summary_interval");
+    if (cJSON_IsNumber(item) && item->valueint >= 0) {
+        atomic_store(&summary_interval, item->valueint);
+    }
+}
+
+// Messages may or may not end in a newline (LOG vs syslog style)
+static void write_message(LogLevel level, const char* message) {
+    size_t length = strlen(message);
+    bool newline = length > 0 && message[length - 1] == '\n';
+    syslog(syslog_priorities[level], "%s", message);
+    printf("%s%s", message, newline ? "" : "\n");
+}
+
+void Log_Write(LogLevel level, const char* fmt, ...) {
+    if (!Log_Enabled(level)) {
+        return;
+    }
+    char message[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(message, sizeof(message), fmt, args);
+    va_end(args);
+    write_message(level, message);
+}
+
+static uint64_t current_second(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec;
+}
+
+void Log_Limited(LogLimit* limit, LogLevel level, const char* fmt, ...) {
+    if (!Log_Enabled(level)) {
+        return;
+    }
+
+    // The first caller of a new second resets the budget; a race between
+    // two of them costs at most one extra message
+    uint64_t second = current_second();
+    uint64_t window = atomic_load_explicit(&limit->window, memory_order_relaxed);
+    if (window != second &&
+        atomic_compare_exchange_strong(&limit->window, &window, second)) {
+        atomic_store_explicit(&limit->used, 0, memory_order_relaxed);
+    }
+    if (atomic_fetch_add_explicit(&limit->used, 1, memory_order_relaxed) >=
+        (uint32_t)atomic_load_explicit(&rate_per_second, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&limit->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    char message[512];
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf(message, sizeof(message), fmt, args);
+    va_end(args);
+
+    uint64_t dropped = atomic_exchange_explicit(&limit->dropped, 0, memory_order_relaxed);
+    if (dropped > 0 && length >= 0 && (size_t)length < sizeof(message)) {
+        if (length > 0 && message[length - 1] == '\n') length--;
+        snprintf(message + length, sizeof(message) - length,
+                 " (%llu similar suppressed)", (unsigned long long)dropped);
+    }
+    write_message(level, message);
+}
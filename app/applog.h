@@ -0,0 +1,83 @@
+/**
+ * applog.h - Runtime Log Levels
+ *
+ * One process-wide level from settings.json ("log": {"level": ...}), applied
+ * to the LOG macros and, through setlogmask(), to plain syslog() calls.
+ * Messages that fire per request or per frame go through LOG_LIMITED or
+ * LOG_SAMPLED instead: each call site prints at most log.rate_per_second
+ * messages a second and notes how many it dropped in between.
+ *
+ *   LOG_SAMPLED("NMS: %d -> %d detections\n", size, count);
+ */
+
+#ifndef APPLOG_H
+#define APPLOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "cJSON.h"
+
+#define LOG_DEFAULT_RATE 5              // Messages per second and call site
+#define LOG_DEFAULT_SUMMARY_SECONDS 60
+
+typedef enum {
+    LOG_LEVEL_ERROR = 0,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+} LogLevel;
+
+// State of one rate-limited call site (zero-initialized static)
+typedef struct {
+    _Atomic uint64_t window;        // Second the counts below belong to
+    _Atomic uint32_t used;          // Messages printed in that second
+    _Atomic uint64_t dropped;       // Not printed since the last message
+} LogLimit;
+
+extern _Atomic int Log_CurrentLevel;
+
+static inline bool Log_Enabled(LogLevel level) {
+    return (int)level <= atomic_load_explicit(&Log_CurrentLevel, memory_order_relaxed);
+}
+
+/**
+ * @brief Apply the "log" settings object: level, rate_per_second, summary_interval
+ *
+ * Missing members keep their value; NULL leaves everything unchanged.
+ */
+void Log_Configure(const cJSON* settings);
+
+void Log_SetLevel(LogLevel level);
+LogLevel Log_GetLevel(void);
+
+// "error", "warning", "info", "debug"
+const char* Log_LevelName(LogLevel level);
+bool Log_LevelFromString(const char* name, LogLevel* level);
+
+/**
+ * @brief Seconds between aggregate summaries (0: none)
+ */
+int Log_GetSummaryInterval(void);
+
+/**
+ * @brief Write to syslog and stdout if level is enabled
+ */
+void Log_Write(LogLevel level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Log_Write limited to the rate of log.rate_per_second for this call site
+ */
+void Log_Limited(LogLimit* limit, LogLevel level, const char* fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// Rate limited at level; arguments are not evaluated when the level is off
+#define LOG_LIMITED(level, fmt, args...) do { \
+        static LogLimit log_limit_; \
+        if (Log_Enabled(level)) Log_Limited(&log_limit_, level, fmt, ## args); \
+    } while (0)
+
+// Per-request detail, debug level only
+#define LOG_SAMPLED(fmt, args...) LOG_LIMITED(LOG_LEVEL_DEBUG, fmt, ## args)
+
+#endif // APPLOG_H
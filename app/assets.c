@@ -0,0 +1,270 @@
+/**
+ * assets.c - Static Asset Cache Implementation
+ *
+ * Cached files are immutable and reference counted, so a response is sent
+ * outside the lock while a reload swaps in a new copy.
+ */
+
+#include "assets.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <gio/gio.h>
+
+#define ASSET_MIN_GZIP_SIZE 256     // Smaller files are sent as they are
+#define ASSET_PATH_SIZE 128
+
+typedef struct {
+    _Atomic int refs;
+    char* data;
+    size_t size;
+    char* gzip;                     // NULL when compression does not pay off
+    size_t gzip_size;
+    const char* content_type;
+    char etag[48];
+    time_t mtime;
+} Asset;
+
+typedef struct {
+    char path[ASSET_PATH_SIZE];
+    Asset* current;                 // NULL while the file is missing
+    time_t checked;                 // Monotonic seconds of the last stat()
+} AssetEntry;
+
+static AssetEntry entries[ASSETS_MAX];
+static int entry_count = 0;
+static pthread_mutex_t assets_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct {
+    const char* extension;
+    const char* content_type;
+    bool compress;
+} content_types[] = {
+    { ".html", "text/html; charset=utf-8", true },
+    { ".js", "application/javascript; charset=utf-8", true },
+    { ".css", "text/css; charset=utf-8", true },
+    { ".json", "application/json; charset=utf-8", true },
+    { ".svg", "image/svg+xml", true },
+    { ".png", "image/png", false },
+    { ".jpg", "image/jpeg", false },
+    { ".ico", "image/x-icon", false },
+};
+
+static time_t monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+static void asset_release(Asset* asset) {
+    if (asset && atomic_fetch_sub(&asset->refs, 1) == 1) {
+        free(asset->data);
+        free(asset->gzip);
+        free(asset);
+    }
+}
+
+// Keep a gzip copy when it is smaller than the original
+static void compress_asset(Asset* asset) {
+    if (asset->size < ASSET_MIN_GZIP_SIZE) {
+        return;
+    }
+
+    GZlibCompressor* compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, 9);
+    char* out = malloc(asset->size);
+    if (!compressor || !out) {
+        if (compressor) g_object_unref(compressor);
+        free(out);
+        return;
+    }
+
+    // Running out of room (a converter error) means it does not pay off
+    gsize in_total = 0, out_total = 0;
+    GConverterResult result = G_CONVERTER_CONVERTED;
+    GError* error = NULL;
+    while (result == G_CONVERTER_CONVERTED) {
+        gsize read = 0, written = 0;
+        result = g_converter_convert(G_CONVERTER(compressor),
+                                     asset->data + in_total, asset->size - in_total,
+                                     out + out_total, asset->size - out_total,
+                                     G_CONVERTER_INPUT_AT_END, &read, &written, &error);
+        in_total += read;
+        out_total += written;
+    }
+    if (error) {
+        g_error_free(error);
+    }
+    g_object_unref(compressor);
+
+    if (result == G_CONVERTER_FINISHED && out_total < asset->size) {
+        asset->gzip = out;
+        asset->gzip_size = out_total;
+    } else {
+        free(out);
+    }
+}
+
+static Asset* read_asset(const char* path, const struct stat* st) {
+    if (st->st_size > ASSET_MAX_SIZE) {
+        syslog(LOG_WARNING, "Asset %s is too large (%lld bytes)", path, (long long)st->st_size);
+        return NULL;
+    }
+
+    FILE* fp = ACAP_FILE_Open(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    Asset* asset = calloc(1, sizeof(Asset));
+    char* data = malloc(st->st_size + 1);
+    size_t size = data ? fread(data, 1, st->st_size, fp) : 0;
+    fclose(fp);
+    if (!asset || !data || size != (size_t)st->st_size) {
+        syslog(LOG_WARNING, "Failed to read asset %s", path);
+        free(asset);
+        free(data);
+        return NULL;
+    }
+    data[size] = '\0';
+
+    atomic_init(&asset->refs, 1);
+    asset->data = data;
+    asset->size = size;
+    asset->mtime = st->st_mtime;
+    asset->content_type = "application/octet-stream";
+    bool compress = false;
+    const char* extension = strrchr(path, '.');
+    for (size_t i = 0; extension && i < sizeof(content_types) / sizeof(content_types[0]); i++) {
+        if (strcmp(extension, content_types[i].extension) == 0) {
+            asset->content_type = content_types[i].content_type;
+            compress = content_types[i].compress;
+            break;
+        }
+    }
+    snprintf(asset->etag, sizeof(asset->etag), "\"%llx-%zx\"",
+             (unsigned long long)st->st_mtime, size);
+    if (compress) {
+        compress_asset(asset);
+    }
+
+    syslog(LOG_INFO, "Cached %s: %zu bytes, gzip %zu", path, size, asset->gzip_size);
+    return asset;
+}
+
+static AssetEntry* find_entry(const char* path) {
+    for (int i = 0; i < entry_count; i++) {
+        if (strcmp(entries[i].path, path) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Entry for path, (re)loaded if force or due for a check; call with assets_lock
+static AssetEntry* refresh_locked(const char* path, bool force) {
+    AssetEntry* entry = find_entry(path);
+    time_t now = monotonic_seconds();
+    if (entry && !force && now - entry->checked < ASSET_CHECK_SECONDS) {
+        return entry;
+    }
+    if (!entry) {
+        if (entry_count >= ASSETS_MAX || strlen(path) >= ASSET_PATH_SIZE) {
+            syslog(LOG_WARNING, "Cannot cache asset %s", path);
+            return NULL;
+        }
+        entry = &entries[entry_count++];
+        snprintf(entry->path, sizeof(entry->path), "%s", path);
+        entry->current = NULL;
+    }
+    entry->checked = now;
+
+    char fullpath[512];
+    snprintf(fullpath, sizeof(fullpath), "%s%s", ACAP_FILE_AppPath(), path);
+    struct stat st;
+    if (stat(fullpath, &st) != 0 || !S_ISREG(st.st_mode)) {
+        asset_release(entry->current);
+        entry->current = NULL;
+        return entry;
+    }
+
+    Asset* current = entry->current;
+    if (current && current->mtime == st.st_mtime && current->size == (size_t)st.st_size) {
+        return entry;
+    }
+    // A failed read keeps serving the previous copy
+    Asset* asset = read_asset(path, &st);
+    if (asset) {
+        entry->current = asset;
+        asset_release(current);
+    }
+    return entry;
+}
+
+bool Assets_Load(const char* path) {
+    if (!path) {
+        return false;
+    }
+    pthread_mutex_lock(&assets_lock);
+    AssetEntry* entry = refresh_locked(path, true);
+    bool loaded = entry && entry->current;
+    pthread_mutex_unlock(&assets_lock);
+    return loaded;
+}
+
+static Asset* asset_acquire(const char* path) {
+    pthread_mutex_lock(&assets_lock);
+    AssetEntry* entry = refresh_locked(path, false);
+    Asset* asset = entry ? entry->current : NULL;
+    if (asset) {
+        atomic_fetch_add(&asset->refs, 1);
+    }
+    pthread_mutex_unlock(&assets_lock);
+    return asset;
+}
+
+void Assets_Respond(ACAP_HTTP_Response response, const ACAP_HTTP_Request request,
+                    const char* path) {
+    Asset* asset = path ? asset_acquire(path) : NULL;
+    if (!asset) {
+        ACAP_HTTP_Respond_Error(response, 404, "Not found");
+        return;
+    }
+
+    if (ACAP_HTTP_Match_ETag(request, asset->etag)) {
+        ACAP_HTTP_Respond_Not_Modified(response, asset->etag);
+        asset_release(asset);
+        return;
+    }
+
+    const char* accept = ACAP_HTTP_Get_Header(request, "Accept-Encoding");
+    bool gzip = asset->gzip && accept && strstr(accept, "gzip");
+    const char* body = gzip ? asset->gzip : asset->data;
+    size_t size = gzip ? asset->gzip_size : asset->size;
+
+    ACAP_HTTP_Respond_String(response,
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "%s"
+        "ETag: %s\r\n"
+        "Vary: Accept-Encoding\r\n"
+        "Cache-Control: no-cache\r\n\r\n",
+        asset->content_type, size, gzip ? "Content-Encoding: gzip\r\n" : "", asset->etag);
+    if (size > 0) {
+        ACAP_HTTP_Respond_Data(response, size, body);
+    }
+    asset_release(asset);
+}
+
+void Assets_Cleanup(void) {
+    pthread_mutex_lock(&assets_lock);
+    for (int i = 0; i < entry_count; i++) {
+        asset_release(entries[i].current);
+        entries[i].current = NULL;
+    }
+    entry_count = 0;
+    pthread_mutex_unlock(&assets_lock);
+}
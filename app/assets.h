@@ -0,0 +1,44 @@
+/**
+ * assets.h - Static Asset Cache
+ *
+ * Web UI files served through FastCGI (the /monitor page) are read once into
+ * memory together with a gzip copy, and answered without touching the disk:
+ * gzip when the client accepts it, an ETag from the file's mtime and size,
+ * and 304 Not Modified for a matching If-None-Match. A file is stat()ed at
+ * most every ASSET_CHECK_SECONDS and reloaded when it changed.
+ *
+ * Files under html/ that the camera's web server serves directly (index.html,
+ * js/, css/) do not pass through here.
+ */
+
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stdbool.h>
+#include "ACAP.h"
+
+#define ASSETS_MAX 16
+#define ASSET_CHECK_SECONDS 2
+#define ASSET_MAX_SIZE (4 * 1024 * 1024)
+
+/**
+ * @brief Load path (relative to the package) into the cache, or reload it
+ *
+ * Called at startup for the files the endpoints serve, so the first request
+ * does not pay for reading and compressing.
+ *
+ * @return false if the file cannot be read or the cache is full
+ */
+bool Assets_Load(const char* path);
+
+/**
+ * @brief Respond with a cached file: 200 (gzip if accepted), 304 or 404
+ *
+ * Loads path on first use. Content-Type follows the extension.
+ */
+void Assets_Respond(ACAP_HTTP_Response response, const ACAP_HTTP_Request request,
+                    const char* path);
+
+void Assets_Cleanup(void);
+
+#endif // ASSETS_H
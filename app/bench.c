@@ -0,0 +1,131 @@
+/**
+ * bench.c - Preprocessing Microbenchmark
+ *
+ * Times the CPU resize kernels against the original per-pixel letterbox
+ * loop on a synthetic frame. Built with `make bench`; runs on the camera or
+ * the build host:
+ *
+ *   ./resize_bench [iterations] [in_w in_h] [model_size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "resize.h"
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// The letterbox loop Model.c used before the resize kernels, kept for comparison
+static void legacy_letterbox(const uint8_t* rgb_in, int in_w, int in_h,
+                             uint8_t* out, int out_w, int out_h) {
+    float scale = fminf((float)out_w / in_w, (float)out_h / in_h);
+    int scaled_w = (int)(in_w * scale);
+    int scaled_h = (int)(in_h * scale);
+    int offset_x = (out_w - scaled_w) / 2;
+    int offset_y = (out_h - scaled_h) / 2;
+
+    memset(out, 0, (size_t)out_w * out_h * 3);
+    for (int y = 0; y < scaled_h; y++) {
+        for (int x = 0; x < scaled_w; x++) {
+            int src_x = (int)((x + 0.5f) * in_w / scaled_w);
+            int src_y = (int)((y + 0.5f) * in_h / scaled_h);
+            if (src_x >= in_w) src_x = in_w - 1;
+            if (src_y >= in_h) src_y = in_h - 1;
+
+            const uint8_t* src = rgb_in + ((size_t)src_y * in_w + src_x) * 3;
+            uint8_t* dst = out + ((size_t)(offset_y + y) * out_w + offset_x + x) * 3;
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    }
+}
+
+// Letterbox through a resizer, clearing only the padding rows/columns
+static void resize_letterbox(ResizeFilter filter, const uint8_t* rgb_in, int in_w, int in_h,
+                             uint8_t* out, int out_w, int out_h) {
+    float scale = fminf((float)out_w / in_w, (float)out_h / in_h);
+    int scaled_w = (int)lroundf(in_w * scale);
+    int scaled_h = (int)lroundf(in_h * scale);
+    int offset_x = (out_w - scaled_w) / 2;
+    int offset_y = (out_h - scaled_h) / 2;
+    size_t stride = (size_t)out_w * 3;
+
+    memset(out, 0, offset_y * stride);
+    memset(out + (size_t)(offset_y + scaled_h) * stride, 0, (out_h - offset_y - scaled_h) * stride);
+    if (offset_x > 0 || scaled_w < out_w) {
+        for (int y = offset_y; y < offset_y + scaled_h; y++) {
+            memset(out + y * stride, 0, offset_x * 3);
+            memset(out + y * stride + (offset_x + scaled_w) * 3, 0, (out_w - offset_x - scaled_w) * 3);
+        }
+    }
+
+    Resizer* resizer = RESIZE_Create(filter, in_w, in_h, scaled_w, scaled_h, 0.0f, 0.0f,
+                                     (float)in_w / scaled_w, (float)in_h / scaled_h);
+    if (!resizer) {
+        fprintf(stderr, "Failed to create %s resizer\n", RESIZE_FilterName(filter));
+        exit(1);
+    }
+    RESIZE_Frame(resizer, rgb_in, (size_t)in_w * 3, out + offset_y * stride + offset_x * 3, stride);
+    RESIZE_Destroy(resizer);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    int in_w = argc > 3 ? atoi(argv[2]) : 1920;
+    int in_h = argc > 3 ? atoi(argv[3]) : 1080;
+    int model = argc > 4 ? atoi(argv[4]) : 640;
+    if (iterations < 1 || in_w < 1 || in_h < 1 || model < 1) {
+        fprintf(stderr, "Usage: %s [iterations] [in_w in_h] [model_size]\n", argv[0]);
+        return 1;
+    }
+
+    // Gradient plus noise, so filters cannot shortcut flat areas
+    size_t in_size = (size_t)in_w * in_h * 3;
+    size_t out_size = (size_t)model * model * 3;
+    uint8_t* frame = malloc(in_size);
+    uint8_t* out = malloc(out_size);
+    if (!frame || !out) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    unsigned int seed = 1;
+    for (size_t i = 0; i < in_size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        frame[i] = (uint8_t)((i / 3 % in_w) * 255 / in_w + (seed >> 28));
+    }
+
+    printf("Letterbox %dx%d -> %dx%d, %d iterations\n", in_w, in_h, model, model, iterations);
+
+    // Warm up caches and page in the output once
+    legacy_letterbox(frame, in_w, in_h, out, model, model);
+
+    double start = now_ms();
+    for (int i = 0; i < iterations; i++) {
+        legacy_letterbox(frame, in_w, in_h, out, model, model);
+    }
+    double legacy = (now_ms() - start) / iterations;
+    printf("  %-16s %8.3f ms/frame\n", "legacy nearest", legacy);
+
+    for (int f = 0; f < RESIZE_FILTER_COUNT; f++) {
+        resize_letterbox((ResizeFilter)f, frame, in_w, in_h, out, model, model);
+        start = now_ms();
+        for (int i = 0; i < iterations; i++) {
+            resize_letterbox((ResizeFilter)f, frame, in_w, in_h, out, model, model);
+        }
+        double ms = (now_ms() - start) / iterations;
+        printf("  %-16s %8.3f ms/frame (%.2fx legacy)\n",
+               RESIZE_FilterName((ResizeFilter)f), ms, legacy / ms);
+    }
+
+    free(frame);
+    free(out);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * bench_pipeline.c - Standalone Pipeline Benchmark
+ *
+ * The /benchmark measurements without the HTTP server, linked from the same
+ * Model.c and jpeg_decoder.c. Built with `make bench`; run from the package
+ * directory on the camera (settings.json is not read, model defaults apply):
+ *
+ *   ./detectx_bench [-n iterations] [-r WxH,...] [-d all|device,...]
+ *                   [-j image.jpg] [-t] [model.tflite]
+ *
+ * -t skips the raw tensor path. The JSON report goes to stdout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "Model.h"
+#include "jsonwriter.h"
+
+static uint8_t* read_file(const char* path, size_t* size) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t* data = length > 0 ? malloc(length) : NULL;
+    if (data && fread(data, 1, length, fp) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    *size = data ? (size_t)length : 0;
+    return data;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-n iterations] [-r WxH,...] [-d all|device,...] "
+                    "[-j image.jpg] [-t] [model.tflite]\n", program);
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    Benchmark_DefaultOptions(&options);
+    const char* devices = NULL;
+    const char* jpeg_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:d:j:t")) != -1) {
+        switch (opt) {
+            case 'n':
+                options.iterations = atoi(optarg);
+                break;
+            case 'r':
+                if (!Benchmark_ParseResolutions(optarg, &options)) {
+                    fprintf(stderr, "Invalid resolutions: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'd':
+                devices = optarg;
+                break;
+            case 'j':
+                jpeg_path = optarg;
+                break;
+            case 't':
+                options.tensor = false;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    const char* model_path = optind < argc ? argv[optind] : "model/model.tflite";
+
+    uint8_t* jpeg = NULL;
+    if (jpeg_path) {
+        jpeg = read_file(jpeg_path, &options.jpeg_size);
+        if (!jpeg) {
+            fprintf(stderr, "Cannot read %s\n", jpeg_path);
+            return 1;
+        }
+        options.jpeg = jpeg;
+    }
+
+    // Model logging goes to stdout as well; keep the report on its own
+    fflush(stdout);
+    ModelContext* ctx = Model_Create(model_path);
+    if (!ctx) {
+        fprintf(stderr, "Failed to load %s\n", model_path);
+        free(jpeg);
+        return 1;
+    }
+
+    JsonWriter w = {0};
+    char* error_msg = NULL;
+    bool ok = Benchmark_RunDevices(ctx, devices, &options, &w, NULL, &error_msg);
+    if (ok && JSONW_Data(&w)) {
+        printf("\n%s\n", JSONW_Data(&w));
+    } else {
+        fprintf(stderr, "Benchmark failed: %s\n", error_msg ? error_msg : "out of memory");
+        ok = false;
+    }
+
+    free(error_msg);
+    JSONW_Free(&w);
+    Model_Destroy(ctx);
+    free(jpeg);
+    return ok ? 0 : 1;
+}
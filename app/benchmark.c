@@ -0,0 +1,505 @@
+/**
+ * benchmark.c - Built-in Pipeline Benchmark Implementation
+ *
+ * Each input gets one untimed warm-up pass (the first larod job of a model
+ * loads it onto the device), then the stages of every iteration are timed on
+ * the monotonic clock. Results are gathered first and written at the end, so
+ * a failed run never leaves a half-written report.
+ */
+
+#include "benchmark.h"
+#include "imgutils.h"
+#include "latency.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#define BENCH_MAX_DEVICES 8
+
+typedef enum {
+    BENCH_JPEG_DECODE = 0,  // Full-size decode to RGB, on its own
+    BENCH_PREPROCESS,       // Decode and scale into the slot (tensors: copy)
+    BENCH_INFERENCE,
+    BENCH_POSTPROCESS,      // Output decode and NMS
+    BENCH_TOTAL,            // Preprocess + inference + postprocess
+    BENCH_STAGE_COUNT
+} BenchStage;
+
+static const char* stage_names[BENCH_STAGE_COUNT] = {
+    [BENCH_JPEG_DECODE] = "jpeg_decode",
+    [BENCH_PREPROCESS] = "preprocess",
+    [BENCH_INFERENCE] = "inference",
+    [BENCH_POSTPROCESS] = "postprocess",
+    [BENCH_TOTAL] = "total",
+};
+
+typedef struct {
+    double mean_ms;
+    double min_ms;
+    double p50_ms;
+    double p90_ms;
+    double p99_ms;
+    double max_ms;
+} StageResult;
+
+typedef struct {
+    const char* input;      // "jpeg" or "tensor"
+    const char* source;     // "synthetic" or "upload"
+    int width;
+    int height;
+    size_t bytes;
+    int detections;         // Of the last iteration
+    bool timed[BENCH_STAGE_COUNT];
+    StageResult stages[BENCH_STAGE_COUNT];
+} RunResult;
+
+// Scratch shared by the runs of one Benchmark_Run
+typedef struct {
+    ModelContext* ctx;
+    int slot;
+    JpegDecoder* decoder;
+    ModelDetector* detector;
+    int iterations;
+    double* samples[BENCH_STAGE_COUNT];
+} Bench;
+
+void Benchmark_DefaultOptions(BenchmarkOptions* options) {
+    memset(options, 0, sizeof(*options));
+    options->iterations = BENCH_DEFAULT_ITERATIONS;
+    options->resolution_count = 3;
+    options->widths[0] = 640;
+    options->heights[0] = 480;
+    options->widths[1] = 1280;
+    options->heights[1] = 720;
+    options->widths[2] = 1920;
+    options->heights[2] = 1080;
+    options->tensor = true;
+    options->jpeg_backend = JPEG_BACKEND_TURBOJPEG;
+}
+
+bool Benchmark_ParseResolutions(const char* list, BenchmarkOptions* options) {
+    int count = 0;
+    const char* p = list;
+    while (*p) {
+        int width, height, used;
+        if (count == BENCH_MAX_RESOLUTIONS ||
+            sscanf(p, "%dx%d%n", &width, &height, &used) != 2 ||
+            width < 16 || height < 16 || width > 8192 || height > 8192) {
+            return false;
+        }
+        options->widths[count] = width;
+        options->heights[count] = height;
+        count++;
+        p += used;
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            return false;
+        }
+    }
+    if (count == 0) {
+        return false;
+    }
+    options->resolution_count = count;
+    return true;
+}
+
+static uint32_t next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Gradient with a few solid boxes and noise, so entropy decoding has real work
+static uint8_t* synthetic_jpeg(int width, int height, size_t* size) {
+    uint8_t* rgb = malloc((size_t)width * height * 3);
+    if (!rgb) {
+        return NULL;
+    }
+    uint32_t seed = 0x2545F491u;
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = rgb + (size_t)y * width * 3;
+        for (int x = 0; x < width; x++) {
+            int noise = (int)(next_random(&seed) & 31) - 16;
+            int r = x * 255 / width + noise;
+            int g = y * 255 / height + noise;
+            int b = 128 + noise;
+            if (((x / (width / 8 + 1)) + (y / (height / 6 + 1))) % 5 == 0) {
+                r = 230 - noise;
+                g = 40;
+                b = 40;
+            }
+            row[x * 3] = (uint8_t)(r < 0 ? 0 : r > 255 ? 255 : r);
+            row[x * 3 + 1] = (uint8_t)(g < 0 ? 0 : g > 255 ? 255 : g);
+            row[x * 3 + 2] = (uint8_t)(b < 0 ? 0 : b > 255 ? 255 : b);
+        }
+    }
+
+    struct jpeg_compress_struct conf;
+    unsigned char* jpeg = NULL;
+    unsigned long jpeg_size = 0;
+    set_jpeg_configuration(width, height, 3, BENCH_JPEG_QUALITY, &conf);
+    buffer_to_jpeg(rgb, &conf, &jpeg_size, &jpeg);
+    jpeg_destroy_compress(&conf);
+    free(rgb);
+
+    *size = jpeg_size;
+    return jpeg;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static double percentile(const double* sorted, int count, double q) {
+    int rank = (int)(q * count + 0.999999);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+static void summarize(double* samples, int count, StageResult* result) {
+    qsort(samples, count, sizeof(double), compare_double);
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    result->mean_ms = sum / count;
+    result->min_ms = samples[0];
+    result->p50_ms = percentile(samples, count, 0.50);
+    result->p90_ms = percentile(samples, count, 0.90);
+    result->p99_ms = percentile(samples, count, 0.99);
+    result->max_ms = samples[count - 1];
+}
+
+static double ms_since(uint64_t start_ns) {
+    return (Latency_Now() - start_ns) / 1e6;
+}
+
+// One pass of the JPEG path; samples of iteration i are stored unless i < 0
+static bool jpeg_pass(Bench* b, const uint8_t* jpeg, size_t size, int width, int height,
+                      int i, int* detections, char** error_msg) {
+    uint64_t start = Latency_Now();
+    DecodedImage image;
+    if (!JPEG_DecodeWith(b->decoder, jpeg, size, 0, 0, &image)) {
+        *error_msg = strdup("JPEG decode failed");
+        return false;
+    }
+    double decode_ms = ms_since(start);
+
+    ModelTransform transform;
+    start = Latency_Now();
+    if (!Model_PreprocessJPEG(b->ctx, b->decoder, b->slot, 0, jpeg, size, width, height,
+                              &transform, error_msg)) {
+        return false;
+    }
+    double preprocess_ms = ms_since(start);
+
+    start = Latency_Now();
+    if (!Model_RunSlot(b->ctx, b->slot, error_msg)) {
+        return false;
+    }
+    double inference_ms = ms_since(start);
+
+    const ModelDetection* found;
+    start = Latency_Now();
+    *detections = Model_DetectWith(b->ctx, b->detector, Model_GetSlotOutput(b->ctx, b->slot),
+                                   &transform, &found);
+    if (*detections < 0) {
+        *error_msg = strdup("Postprocessing failed");
+        return false;
+    }
+    double postprocess_ms = ms_since(start);
+
+    if (i >= 0) {
+        b->samples[BENCH_JPEG_DECODE][i] = decode_ms;
+        b->samples[BENCH_PREPROCESS][i] = preprocess_ms;
+        b->samples[BENCH_INFERENCE][i] = inference_ms;
+        b->samples[BENCH_POSTPROCESS][i] = postprocess_ms;
+        b->samples[BENCH_TOTAL][i] = preprocess_ms + inference_ms + postprocess_ms;
+    }
+    return true;
+}
+
+static bool tensor_pass(Bench* b, const uint8_t* tensor, int i, int* detections,
+                        char** error_msg) {
+    ModelTransform transform;
+    uint64_t start = Latency_Now();
+    memcpy(Model_GetSlotInput(b->ctx, b->slot), tensor, Model_GetInputSize(b->ctx));
+    Model_IdentityTransform(b->ctx, &transform);
+    double preprocess_ms = ms_since(start);
+
+    start = Latency_Now();
+    if (!Model_RunSlot(b->ctx, b->slot, error_msg)) {
+        return false;
+    }
+    double inference_ms = ms_since(start);
+
+    const ModelDetection* found;
+    start = Latency_Now();
+    *detections = Model_DetectWith(b->ctx, b->detector, Model_GetSlotOutput(b->ctx, b->slot),
+                                   &transform, &found);
+    if (*detections < 0) {
+        *error_msg = strdup("Postprocessing failed");
+        return false;
+    }
+    double postprocess_ms = ms_since(start);
+
+    if (i >= 0) {
+        b->samples[BENCH_PREPROCESS][i] = preprocess_ms;
+        b->samples[BENCH_INFERENCE][i] = inference_ms;
+        b->samples[BENCH_POSTPROCESS][i] = postprocess_ms;
+        b->samples[BENCH_TOTAL][i] = preprocess_ms + inference_ms + postprocess_ms;
+    }
+    return true;
+}
+
+static void finish_run(Bench* b, RunResult* run, bool jpeg) {
+    for (int s = 0; s < BENCH_STAGE_COUNT; s++) {
+        run->timed[s] = jpeg || s != BENCH_JPEG_DECODE;
+        if (run->timed[s]) {
+            summarize(b->samples[s], b->iterations, &run->stages[s]);
+        }
+    }
+}
+
+static bool run_jpeg(Bench* b, const uint8_t* jpeg, size_t size, const char* source,
+                     RunResult* run, char** error_msg) {
+    int width, height;
+    if (!JPEG_GetDimensions(jpeg, size, &width, &height)) {
+        *error_msg = strdup("Invalid JPEG image");
+        return false;
+    }
+    run->input = "jpeg";
+    run->source = source;
+    run->width = width;
+    run->height = height;
+    run->bytes = size;
+
+    for (int i = -1; i < b->iterations; i++) {
+        if (!jpeg_pass(b, jpeg, size, width, height, i, &run->detections, error_msg)) {
+            return false;
+        }
+    }
+    finish_run(b, run, true);
+    return true;
+}
+
+static bool run_tensor(Bench* b, RunResult* run, char** error_msg) {
+    size_t size = Model_GetInputSize(b->ctx);
+    uint8_t* tensor = malloc(size);
+    if (!tensor) {
+        *error_msg = strdup("Out of memory");
+        return false;
+    }
+    uint32_t seed = 0x9E3779B9u;
+    for (size_t i = 0; i < size; i++) {
+        tensor[i] = (uint8_t)next_random(&seed);
+    }
+    run->input = "tensor";
+    run->source = "synthetic";
+    run->width = Model_GetWidth(b->ctx);
+    run->height = Model_GetHeight(b->ctx);
+    run->bytes = size;
+
+    bool ok = true;
+    for (int i = -1; ok && i < b->iterations; i++) {
+        ok = tensor_pass(b, tensor, i, &run->detections, error_msg);
+    }
+    free(tensor);
+    if (ok) {
+        finish_run(b, run, false);
+    }
+    return ok;
+}
+
+static void write_report(ModelContext* ctx, const BenchmarkOptions* options,
+                         const RunResult* runs, int run_count,
+                         JsonWriter* w, const char* key) {
+    JSONW_BeginObject(w, key);
+    JSONW_String(w, "device", Model_GetDevice(ctx));
+    JSONW_BeginObject(w, "model");
+    JSONW_Int(w, "input_width", Model_GetWidth(ctx));
+    JSONW_Int(w, "input_height", Model_GetHeight(ctx));
+    JSONW_Int(w, "batch_size", Model_GetBatchSize(ctx));
+    JSONW_EndObject(w);
+    JSONW_Int(w, "iterations", options->iterations);
+    JSONW_String(w, "jpeg_backend", JPEG_BackendName(options->jpeg_backend));
+
+    JSONW_BeginArray(w, "runs");
+    for (int r = 0; r < run_count; r++) {
+        const RunResult* run = &runs[r];
+        JSONW_BeginObject(w, NULL);
+        JSONW_String(w, "input", run->input);
+        JSONW_String(w, "source", run->source);
+        JSONW_Int(w, "width", run->width);
+        JSONW_Int(w, "height", run->height);
+        JSONW_Uint(w, "bytes", run->bytes);
+        JSONW_Int(w, "detections", run->detections);
+        JSONW_BeginObject(w, "stages");
+        for (int s = 0; s < BENCH_STAGE_COUNT; s++) {
+            if (!run->timed[s]) {
+                continue;
+            }
+            const StageResult* st = &run->stages[s];
+            JSONW_BeginObject(w, stage_names[s]);
+            JSONW_Double(w, "mean_ms", st->mean_ms);
+            JSONW_Double(w, "min_ms", st->min_ms);
+            JSONW_Double(w, "p50_ms", st->p50_ms);
+            JSONW_Double(w, "p90_ms", st->p90_ms);
+            JSONW_Double(w, "p99_ms", st->p99_ms);
+            JSONW_Double(w, "max_ms", st->max_ms);
+            JSONW_Double(w, "per_second", st->mean_ms > 0.0 ? 1000.0 / st->mean_ms : 0.0);
+            JSONW_EndObject(w);
+        }
+        JSONW_EndObject(w);
+        JSONW_EndObject(w);
+    }
+    JSONW_EndArray(w);
+    JSONW_EndObject(w);
+}
+
+bool Benchmark_Run(ModelContext* ctx, const BenchmarkOptions* options,
+                   JsonWriter* w, const char* key, char** error_msg) {
+    char* local_error = NULL;
+    if (!error_msg) error_msg = &local_error;
+    *error_msg = NULL;
+
+    if (options->iterations < 1 || options->iterations > BENCH_MAX_ITERATIONS) {
+        *error_msg = strdup("Iterations out of range");
+        return false;
+    }
+
+    Bench b = { .ctx = ctx, .slot = -1, .iterations = options->iterations };
+    RunResult runs[BENCH_MAX_RESOLUTIONS + 2];
+    int run_count = 0;
+    memset(runs, 0, sizeof(runs));
+    bool ok = false;
+
+    b.decoder = JPEG_CreateDecoder(options->jpeg_backend, options->jpeg_fast);
+    b.detector = Model_CreateDetector();
+    for (int s = 0; s < BENCH_STAGE_COUNT; s++) {
+        b.samples[s] = malloc(options->iterations * sizeof(double));
+        if (!b.samples[s]) {
+            *error_msg = strdup("Out of memory");
+            goto done;
+        }
+    }
+    if (!b.decoder || !b.detector) {
+        *error_msg = strdup("Out of memory");
+        goto done;
+    }
+
+    b.slot = Model_AcquireSlot(ctx);
+    if (b.slot < 0) {
+        *error_msg = strdup("Model is shutting down");
+        goto done;
+    }
+    syslog(LOG_INFO, "Benchmark on %s: %d iterations", Model_GetDevice(ctx), options->iterations);
+
+    for (int i = 0; i < options->resolution_count; i++) {
+        size_t size;
+        uint8_t* jpeg = synthetic_jpeg(options->widths[i], options->heights[i], &size);
+        if (!jpeg) {
+            *error_msg = strdup("Failed to create test image");
+            goto done;
+        }
+        bool run_ok = run_jpeg(&b, jpeg, size, "synthetic", &runs[run_count], error_msg);
+        free(jpeg);
+        if (!run_ok) goto done;
+        run_count++;
+    }
+    if (options->jpeg) {
+        if (!run_jpeg(&b, options->jpeg, options->jpeg_size, "upload", &runs[run_count], error_msg)) {
+            goto done;
+        }
+        run_count++;
+    }
+    if (options->tensor) {
+        if (!run_tensor(&b, &runs[run_count], error_msg)) {
+            goto done;
+        }
+        run_count++;
+    }
+
+    write_report(ctx, options, runs, run_count, w, key);
+    ok = true;
+
+done:
+    if (!ok) {
+        syslog(LOG_WARNING, "Benchmark on %s failed: %s", Model_GetDevice(ctx),
+               *error_msg ? *error_msg : "unknown error");
+    }
+    if (b.slot >= 0) Model_ReleaseSlot(ctx, b.slot);
+    for (int s = 0; s < BENCH_STAGE_COUNT; s++) {
+        free(b.samples[s]);
+    }
+    Model_DestroyDetector(b.detector);
+    JPEG_DestroyDecoder(b.decoder);
+    free(local_error);
+    return ok;
+}
+
+// Device names selected by devices, as in Benchmark_RunDevices
+static int select_devices(ModelContext* ctx, const char* devices,
+                          char names[][MODEL_DEVICE_NAME_SIZE]) {
+    if (!devices) {
+        snprintf(names[0], MODEL_DEVICE_NAME_SIZE, "%s", Model_GetDevice(ctx));
+        return 1;
+    }
+    if (strcmp(devices, "all") == 0) {
+        return Model_ListDevices(ctx, names, BENCH_MAX_DEVICES);
+    }
+
+    int count = 0;
+    const char* p = devices;
+    while (*p && count < BENCH_MAX_DEVICES) {
+        size_t length = strcspn(p, ",");
+        if (length > 0 && length < MODEL_DEVICE_NAME_SIZE) {
+            memcpy(names[count], p, length);
+            names[count++][length] = '\0';
+        }
+        p += length;
+        if (*p == ',') p++;
+    }
+    return count;
+}
+
+bool Benchmark_RunDevices(ModelContext* ctx, const char* devices, const BenchmarkOptions* options,
+                          JsonWriter* w, const char* key, char** error_msg) {
+    if (error_msg) *error_msg = NULL;
+
+    char names[BENCH_MAX_DEVICES][MODEL_DEVICE_NAME_SIZE];
+    int count = select_devices(ctx, devices, names);
+    if (count == 0) {
+        if (error_msg) *error_msg = strdup("No larod device selected");
+        return false;
+    }
+
+    JSONW_BeginArray(w, key);
+    for (int i = 0; i < count; i++) {
+        bool own = strcmp(names[i], Model_GetDevice(ctx)) == 0;
+        ModelContext* target = own ? ctx
+            : Model_CreateFromSettings(Model_GetName(ctx), Model_GetSettings(ctx), names[i]);
+        char* run_error = NULL;
+        if (!target) {
+            run_error = strdup("Model could not be loaded on this device");
+        } else {
+            Benchmark_Run(target, options, w, NULL, &run_error);
+        }
+        if (run_error) {
+            JSONW_BeginObject(w, NULL);
+            JSONW_String(w, "device", names[i]);
+            JSONW_String(w, "error", run_error);
+            JSONW_EndObject(w);
+            free(run_error);
+        }
+        if (!own) Model_Destroy(target);
+    }
+    JSONW_EndArray(w);
+    return true;
+}
@@ -0,0 +1,82 @@
+/**
+ * benchmark.h - Built-in Pipeline Benchmark
+ *
+ * Times each stage of the inference pipeline on this camera without network
+ * jitter: JPEG decode, preprocess into a tensor slot, the larod job and
+ * postprocessing, for JPEGs at several resolutions and for raw tensors.
+ * Input JPEGs are synthetic (a noisy test pattern) unless one is supplied.
+ *
+ * Iterations run one after another on a single slot, so per_second is the
+ * rate of one request at a time; the server overlaps stages and gets more.
+ * Used by GET/POST /benchmark and the standalone detectx_bench binary.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "Model.h"
+#include "jpeg_decoder.h"
+#include "jsonwriter.h"
+
+#define BENCH_DEFAULT_ITERATIONS 20
+#define BENCH_MAX_ITERATIONS 1000
+#define BENCH_MAX_RESOLUTIONS 4
+#define BENCH_JPEG_QUALITY 85
+
+typedef struct {
+    int iterations;                 // Per stage and input
+    int resolution_count;           // Synthetic JPEG sizes
+    int widths[BENCH_MAX_RESOLUTIONS];
+    int heights[BENCH_MAX_RESOLUTIONS];
+    const uint8_t* jpeg;            // Supplied JPEG, benchmarked as well (NULL: none)
+    size_t jpeg_size;
+    bool tensor;                    // Also time the raw tensor path
+    JpegBackend jpeg_backend;
+    bool jpeg_fast;
+} BenchmarkOptions;
+
+/**
+ * @brief Defaults: 20 iterations of 640x480, 1280x720 and 1920x1080 plus tensors
+ */
+void Benchmark_DefaultOptions(BenchmarkOptions* options);
+
+/**
+ * @brief Parse "WxH[,WxH...]" into the resolutions of options
+ * @return false if the list is malformed, empty or too long
+ */
+bool Benchmark_ParseResolutions(const char* list, BenchmarkOptions* options);
+
+/**
+ * @brief Benchmark one model context and write its report as a JSON object
+ *
+ * The report is {"device", "model", "iterations", "runs": [...]}; every run
+ * names its input and has per stage count, mean, min, p50/p90/p99, max (ms)
+ * and per_second. Borrows one tensor slot of ctx for the whole run, so on the
+ * live model it waits for and competes with regular requests.
+ *
+ * @param key  Member name when w is inside an object (NULL otherwise)
+ * @param error_msg  Output: strdup'd message on failure (can be NULL)
+ * @return false if the run could not start or a stage failed
+ */
+bool Benchmark_Run(ModelContext* ctx, const BenchmarkOptions* options,
+                   JsonWriter* w, const char* key, char** error_msg);
+
+/**
+ * @brief Benchmark_Run on several larod devices, writing an array of reports
+ *
+ * Devices other than the one of ctx get the same model loaded for the run and
+ * unloaded afterwards. A device that fails gets {"device", "error"} in place
+ * of its report.
+ *
+ * @param devices  "all", a comma-separated list of device names, or NULL for
+ *                 the device of ctx only
+ * @param error_msg  Output: strdup'd message on failure (can be NULL)
+ * @return false (nothing written) if devices names no device
+ */
+bool Benchmark_RunDevices(ModelContext* ctx, const char* devices, const BenchmarkOptions* options,
+                          JsonWriter* w, const char* key, char** error_msg);
+
+#endif // BENCHMARK_H
@@ -3,13 +3,18 @@
  */
 
 #include "jpeg_decoder.h"
+#include "latency.h"
+#include "applog.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
 #include <setjmp.h>
+#include <time.h>
+#include <pthread.h>
 #include <jpeglib.h>
 #include <jerror.h>
+#include <turbojpeg.h>
 
 // Error handler for libjpeg
 struct my_error_mgr {
@@ -25,14 +30,103 @@ static void my_error_exit(j_common_ptr cinfo) {
     longjmp(myerr->setjmp_buffer, 1);
 }
 
-bool JPEG_Decode(const uint8_t* jpeg_data, size_t jpeg_size, DecodedImage* out_image) {
-    if (!jpeg_data || jpeg_size == 0 || !out_image) {
-        syslog(LOG_ERR, "JPEG_Decode: Invalid parameters");
+//-----------------------------------------------------------------------------
+// Backend statistics
+//-----------------------------------------------------------------------------
+
+static const char* backend_names[JPEG_BACKEND_COUNT] = {
+    [JPEG_BACKEND_LIBJPEG] = "libjpeg",
+    [JPEG_BACKEND_TURBOJPEG] = "turbojpeg",
+};
+
+static JpegDecodeStats backend_stats[JPEG_BACKEND_COUNT];
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+           (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static void record_decode(JpegBackend backend, bool success, double ms) {
+    if (success) {
+        Latency_Record(LATENCY_JPEG_DECODE, (uint64_t)(ms * 1e6));
+    }
+    pthread_mutex_lock(&stats_lock);
+    JpegDecodeStats* stats = &backend_stats[backend];
+    if (success) {
+        if (stats->count == 0 || ms < stats->min_ms) stats->min_ms = ms;
+        if (ms > stats->max_ms) stats->max_ms = ms;
+        stats->total_ms += ms;
+        stats->count++;
+    } else {
+        stats->failures++;
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+const char* JPEG_BackendName(JpegBackend backend) {
+    if (backend < 0 || backend >= JPEG_BACKEND_COUNT) {
+        return "unknown";
+    }
+    return backend_names[backend];
+}
+
+bool JPEG_BackendFromString(const char* name, JpegBackend* backend) {
+    if (!name || !backend) {
         return false;
     }
+    for (int i = 0; i < JPEG_BACKEND_COUNT; i++) {
+        if (strcmp(name, backend_names[i]) == 0) {
+            *backend = (JpegBackend)i;
+            return true;
+        }
+    }
+    return false;
+}
 
-    memset(out_image, 0, sizeof(DecodedImage));
+void JPEG_GetStats(JpegBackend backend, JpegDecodeStats* stats) {
+    if (!stats || backend < 0 || backend >= JPEG_BACKEND_COUNT) {
+        return;
+    }
+    pthread_mutex_lock(&stats_lock);
+    *stats = backend_stats[backend];
+    pthread_mutex_unlock(&stats_lock);
+}
+
+//-----------------------------------------------------------------------------
+// Buffers
+//-----------------------------------------------------------------------------
+
+// Grows a reusable output buffer; contents are not preserved
+static bool reserve_buffer(uint8_t** buffer, size_t* capacity, size_t size) {
+    if (*buffer && *capacity >= size) {
+        return true;
+    }
+    uint8_t* grown = malloc(size);
+    if (!grown) {
+        syslog(LOG_ERR, "Failed to allocate image buffer (%zu bytes)", size);
+        return false;
+    }
+    free(*buffer);
+    *buffer = grown;
+    *capacity = size;
+    return true;
+}
 
+//-----------------------------------------------------------------------------
+// libjpeg backend
+//-----------------------------------------------------------------------------
+
+// Scanline decode. Without a sink the frame goes into *buffer (grown when it
+// does not fit); with one, *buffer only holds the rows of one read call and
+// each row is handed to the sink as soon as it is decoded.
+static bool libjpeg_decode(const uint8_t* jpeg_data, size_t jpeg_size,
+                           int min_width, int min_height, bool fast,
+                           const JpegRowSink* sink,
+                           uint8_t** buffer, size_t* capacity,
+                           DecodedImage* out_image) {
     struct jpeg_decompress_struct cinfo;
     struct my_error_mgr jerr;
 
@@ -41,13 +135,10 @@ bool JPEG_Decode(const uint8_t* jpeg_data, size_t jpeg_size, DecodedImage* out_i
     jerr.pub.error_exit = my_error_exit;
 
     if (setjmp(jerr.setjmp_buffer)) {
-        // Error occurred during JPEG decoding
-        syslog(LOG_ERR, "JPEG decode error");
+        // Error occurred during JPEG decoding; the buffer stays with the caller
+        LOG_LIMITED(LOG_LEVEL_ERROR, "JPEG decode error");
         jpeg_destroy_decompress(&cinfo);
-        if (out_image->data) {
-            free(out_image->data);
-            out_image->data = NULL;
-        }
+        memset(out_image, 0, sizeof(DecodedImage));
         return false;
     }
 
@@ -59,7 +150,7 @@ bool JPEG_Decode(const uint8_t* jpeg_data, size_t jpeg_size, DecodedImage* out_i
 
     // Read JPEG header
     if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
-        syslog(LOG_ERR, "Invalid JPEG header");
+        LOG_LIMITED(LOG_LEVEL_ERROR, "Invalid JPEG header");
         jpeg_destroy_decompress(&cinfo);
         return false;
     }
@@ -67,10 +158,29 @@ bool JPEG_Decode(const uint8_t* jpeg_data, size_t jpeg_size, DecodedImage* out_i
     // Set output format to RGB
     cinfo.out_color_space = JCS_RGB;
 
+    // Same trade-off as TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE
+    if (fast) {
+        cinfo.dct_method = JDCT_IFAST;
+        cinfo.do_fancy_upsampling = FALSE;
+    }
+
+    // Smallest M/8 scale that still covers the requested size
+    if (min_width > 0 && min_height > 0) {
+        for (unsigned int m = 1; m <= 8; m++) {
+            cinfo.scale_num = m;
+            cinfo.scale_denom = 8;
+            jpeg_calc_output_dimensions(&cinfo);
+            if ((int)cinfo.output_width >= min_width && (int)cinfo.output_height >= min_height) {
+                break;
+            }
+        }
+    }
+
     // Start decompression
     jpeg_start_decompress(&cinfo);
 
-    // Allocate output buffer
+    out_image->source_width = cinfo.image_width;
+    out_image->source_height = cinfo.image_height;
     out_image->width = cinfo.output_width;
     out_image->height = cinfo.output_height;
     out_image->channels = cinfo.output_components;  // Should be 3 for RGB
@@ -82,28 +192,271 @@ bool JPEG_Decode(const uint8_t* jpeg_data, size_t jpeg_size, DecodedImage* out_i
         return false;
     }
 
-    out_image->data = malloc(out_image->size);
-    if (!out_image->data) {
-        syslog(LOG_ERR, "Failed to allocate image buffer (%zu bytes)", out_image->size);
-        jpeg_destroy_decompress(&cinfo);
-        return false;
-    }
-
-    // Read scanlines
     int row_stride = cinfo.output_width * cinfo.output_components;
-    JSAMPROW row_pointer[1];
 
-    while (cinfo.output_scanline < cinfo.output_height) {
-        row_pointer[0] = &out_image->data[cinfo.output_scanline * row_stride];
-        jpeg_read_scanlines(&cinfo, row_pointer, 1);
+    if (sink) {
+        if (!sink->begin(out_image, sink->user_data)) {
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
+
+        // Read as many rows per call as the upsampler produces at once
+        int batch = cinfo.rec_outbuf_height > 0 ? cinfo.rec_outbuf_height : 1;
+        if (batch > 4) batch = 4;
+        if (!reserve_buffer(buffer, capacity, (size_t)row_stride * batch)) {
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
+
+        JSAMPROW row_pointers[4];
+        for (int i = 0; i < batch; i++) {
+            row_pointers[i] = *buffer + (size_t)i * row_stride;
+        }
+
+        while (cinfo.output_scanline < cinfo.output_height) {
+            int y = cinfo.output_scanline;
+            int rows = jpeg_read_scanlines(&cinfo, row_pointers, batch);
+            for (int i = 0; i < rows; i++) {
+                sink->row(row_pointers[i], y + i, sink->user_data);
+            }
+        }
+    } else {
+        if (!reserve_buffer(buffer, capacity, out_image->size)) {
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
+        out_image->data = *buffer;
+
+        // Read scanlines
+        JSAMPROW row_pointer[1];
+
+        while (cinfo.output_scanline < cinfo.output_height) {
+            row_pointer[0] = &out_image->data[cinfo.output_scanline * row_stride];
+            jpeg_read_scanlines(&cinfo, row_pointer, 1);
+        }
     }
 
     // Finish decompression
     jpeg_finish_decompress(&cinfo);
     jpeg_destroy_decompress(&cinfo);
 
-    syslog(LOG_DEBUG, "JPEG decoded: %dx%d, %d channels, %zu bytes",
-           out_image->width, out_image->height, out_image->channels, out_image->size);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// TurboJPEG backend
+//-----------------------------------------------------------------------------
+
+struct JpegDecoder {
+    JpegBackend backend;   // Preferred backend
+    bool fast;             // TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE
+    tjhandle handle;       // NULL when TurboJPEG is not in use
+    uint8_t* buffer;       // Reusable RGB frame (or row batch), shared by both backends
+    size_t capacity;
+};
+
+// Smallest supported scaling factor (at most 1/1) that still covers the requested size
+static tjscalingfactor pick_scaling_factor(int width, int height, int min_width, int min_height) {
+    tjscalingfactor best = {1, 1};
+    if (min_width <= 0 || min_height <= 0) {
+        return best;
+    }
+
+    int count = 0;
+    tjscalingfactor* factors = tjGetScalingFactors(&count);
+    for (int i = 0; factors && i < count; i++) {
+        tjscalingfactor sf = factors[i];
+        if (sf.num > sf.denom) {
+            continue;
+        }
+        if (TJSCALED(width, sf) < min_width || TJSCALED(height, sf) < min_height) {
+            continue;
+        }
+        if (sf.num * best.denom < best.num * sf.denom) {
+            best = sf;
+        }
+    }
+    return best;
+}
+
+static bool turbojpeg_decode(JpegDecoder* decoder,
+                             const uint8_t* jpeg_data, size_t jpeg_size,
+                             int min_width, int min_height,
+                             DecodedImage* out_image) {
+    int width, height, subsamp, colorspace;
+    if (tjDecompressHeader3(decoder->handle, jpeg_data, (unsigned long)jpeg_size,
+                            &width, &height, &subsamp, &colorspace) != 0) {
+        LOG_LIMITED(LOG_LEVEL_WARNING, "TurboJPEG header error: %s", tjGetErrorStr2(decoder->handle));
+        return false;
+    }
+
+    tjscalingfactor sf = pick_scaling_factor(width, height, min_width, min_height);
+    out_image->source_width = width;
+    out_image->source_height = height;
+    out_image->width = TJSCALED(width, sf);
+    out_image->height = TJSCALED(height, sf);
+    out_image->channels = 3;
+    out_image->size = (size_t)out_image->width * out_image->height * out_image->channels;
+
+    if (!reserve_buffer(&decoder->buffer, &decoder->capacity, out_image->size)) {
+        return false;
+    }
+    out_image->data = decoder->buffer;
+
+    int flags = decoder->fast ? (TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) : 0;
+    if (tjDecompress2(decoder->handle, jpeg_data, (unsigned long)jpeg_size,
+                      out_image->data, out_image->width, 0, out_image->height,
+                      TJPF_RGB, flags) != 0) {
+        // Warnings (e.g. truncated entropy data) still leave a usable frame
+        if (tjGetErrorCode(decoder->handle) != TJERR_WARNING) {
+            LOG_LIMITED(LOG_LEVEL_WARNING, "TurboJPEG decode error: %s", tjGetErrorStr2(decoder->handle));
+            return false;
+        }
+        LOG_SAMPLED("TurboJPEG warning: %s", tjGetErrorStr2(decoder->handle));
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Public API
+//-----------------------------------------------------------------------------
+
+bool JPEG_Decode(const uint8_t* jpeg_data, size_t jpeg_size, DecodedImage* out_image) {
+    return JPEG_DecodeScaled(jpeg_data, jpeg_size, 0, 0, out_image);
+}
+
+bool JPEG_DecodeScaled(const uint8_t* jpeg_data, size_t jpeg_size,
+                       int min_width, int min_height, DecodedImage* out_image) {
+    if (!jpeg_data || jpeg_size == 0 || !out_image) {
+        syslog(LOG_ERR, "JPEG_Decode: Invalid parameters");
+        return false;
+    }
+
+    memset(out_image, 0, sizeof(DecodedImage));
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    uint8_t* buffer = NULL;
+    size_t capacity = 0;
+    bool ok = libjpeg_decode(jpeg_data, jpeg_size, min_width, min_height, false,
+                             NULL, &buffer, &capacity, out_image);
+    record_decode(JPEG_BACKEND_LIBJPEG, ok, elapsed_ms(&start));
+    if (!ok) {
+        free(buffer);
+        memset(out_image, 0, sizeof(DecodedImage));
+        return false;
+    }
+
+    LOG_SAMPLED("JPEG decoded: %dx%d (source %dx%d), %d channels, %zu bytes",
+                out_image->width, out_image->height, out_image->source_width,
+                out_image->source_height, out_image->channels, out_image->size);
+
+    return true;
+}
+
+JpegDecoder* JPEG_CreateDecoder(JpegBackend backend, bool fast) {
+    JpegDecoder* decoder = calloc(1, sizeof(JpegDecoder));
+    if (!decoder) {
+        syslog(LOG_ERR, "Failed to allocate JPEG decoder");
+        return NULL;
+    }
+    decoder->backend = backend;
+    decoder->fast = fast;
+
+    if (backend == JPEG_BACKEND_TURBOJPEG) {
+        decoder->handle = tjInitDecompress();
+        if (!decoder->handle) {
+            syslog(LOG_WARNING, "tjInitDecompress failed, using libjpeg: %s",
+                   tjGetErrorStr2(NULL));
+            decoder->backend = JPEG_BACKEND_LIBJPEG;
+        }
+    }
+    return decoder;
+}
+
+void JPEG_DestroyDecoder(JpegDecoder* decoder) {
+    if (!decoder) {
+        return;
+    }
+    if (decoder->handle) {
+        tjDestroy(decoder->handle);
+    }
+    free(decoder->buffer);
+    free(decoder);
+}
+
+JpegBackend JPEG_GetDecoderBackend(const JpegDecoder* decoder) {
+    return decoder->backend;
+}
+
+bool JPEG_DecodeWith(JpegDecoder* decoder, const uint8_t* jpeg_data, size_t jpeg_size,
+                     int min_width, int min_height, DecodedImage* out_image) {
+    if (!decoder || !jpeg_data || jpeg_size == 0 || !out_image) {
+        syslog(LOG_ERR, "JPEG_DecodeWith: Invalid parameters");
+        return false;
+    }
+
+    memset(out_image, 0, sizeof(DecodedImage));
+
+    struct timespec start;
+    bool ok = false;
+    JpegBackend used = decoder->backend;
+
+    if (decoder->backend == JPEG_BACKEND_TURBOJPEG) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ok = turbojpeg_decode(decoder, jpeg_data, jpeg_size, min_width, min_height, out_image);
+        record_decode(JPEG_BACKEND_TURBOJPEG, ok, elapsed_ms(&start));
+        if (!ok) {
+            // Retry with the scanline decoder, which tolerates more odd streams
+            memset(out_image, 0, sizeof(DecodedImage));
+            used = JPEG_BACKEND_LIBJPEG;
+        }
+    }
+
+    if (!ok) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ok = libjpeg_decode(jpeg_data, jpeg_size, min_width, min_height, decoder->fast,
+                            NULL, &decoder->buffer, &decoder->capacity, out_image);
+        record_decode(JPEG_BACKEND_LIBJPEG, ok, elapsed_ms(&start));
+        if (!ok) {
+            memset(out_image, 0, sizeof(DecodedImage));
+            return false;
+        }
+    }
+
+    LOG_SAMPLED("JPEG decoded (%s): %dx%d (source %dx%d), %zu bytes",
+                JPEG_BackendName(used), out_image->width, out_image->height,
+                out_image->source_width, out_image->source_height, out_image->size);
+
+    return true;
+}
+
+bool JPEG_DecodeRows(JpegDecoder* decoder, const uint8_t* jpeg_data, size_t jpeg_size,
+                     int min_width, int min_height, const JpegRowSink* sink,
+                     DecodedImage* out_image) {
+    if (!decoder || !jpeg_data || jpeg_size == 0 || !sink || !out_image) {
+        syslog(LOG_ERR, "JPEG_DecodeRows: Invalid parameters");
+        return false;
+    }
+
+    memset(out_image, 0, sizeof(DecodedImage));
+
+    // tjDecompress2 only produces whole frames, so rows always come from libjpeg
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool ok = libjpeg_decode(jpeg_data, jpeg_size, min_width, min_height, decoder->fast,
+                             sink, &decoder->buffer, &decoder->capacity, out_image);
+    record_decode(JPEG_BACKEND_LIBJPEG, ok, elapsed_ms(&start));
+    if (!ok) {
+        memset(out_image, 0, sizeof(DecodedImage));
+        return false;
+    }
+
+    LOG_SAMPLED("JPEG streamed: %dx%d (source %dx%d)",
+                out_image->width, out_image->height,
+                out_image->source_width, out_image->source_height);
 
     return true;
 }
@@ -136,7 +489,7 @@ bool JPEG_GetDimensions(const uint8_t* jpeg_data, size_t jpeg_size,
     jerr.pub.error_exit = my_error_exit;
 
     if (setjmp(jerr.setjmp_buffer)) {
-        syslog(LOG_ERR, "JPEG header read error");
+        LOG_LIMITED(LOG_LEVEL_ERROR, "JPEG header read error");
         jpeg_destroy_decompress(&cinfo);
         return false;
     }
@@ -149,7 +502,7 @@ bool JPEG_GetDimensions(const uint8_t* jpeg_data, size_t jpeg_size,
 
     // Read JPEG header only
     if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
-        syslog(LOG_ERR, "Invalid JPEG header");
+        LOG_LIMITED(LOG_LEVEL_ERROR, "Invalid JPEG header");
         jpeg_destroy_decompress(&cinfo);
         return false;
     }
@@ -17,8 +17,36 @@ typedef struct {
     int height;
     int channels;       // Always 3 for RGB
     size_t size;        // Total buffer size in bytes
+    int source_width;   // Dimensions stored in the JPEG header (before
+    int source_height;  // any DCT-domain downscaling)
 } DecodedImage;
 
+typedef enum {
+    JPEG_BACKEND_LIBJPEG = 0,   // Classic scanline API (always available)
+    JPEG_BACKEND_TURBOJPEG,     // tjDecompress2 into a reusable buffer
+    JPEG_BACKEND_COUNT
+} JpegBackend;
+
+typedef struct {
+    uint64_t count;     // Successful decodes
+    uint64_t failures;
+    double total_ms;
+    double min_ms;
+    double max_ms;
+} JpegDecodeStats;
+
+// Receives decoded rows in order for JPEG_DecodeRows
+typedef struct {
+    // Called once with the output geometry (data is NULL); return false to abort
+    bool (*begin)(const DecodedImage* image, void* user_data);
+    // Called for every output row y (width * 3 bytes, valid only during the call)
+    void (*row)(const uint8_t* rgb, int y, void* user_data);
+    void* user_data;
+} JpegRowSink;
+
+// Per-worker decoder state (TurboJPEG handle and output buffer). Not thread-safe.
+typedef struct JpegDecoder JpegDecoder;
+
 /**
  * @brief Decode JPEG data to RGB format
  *
@@ -29,6 +57,99 @@ typedef struct {
  */
 bool JPEG_Decode(const uint8_t* jpeg_data, size_t jpeg_size, DecodedImage* out_image);
 
+/**
+ * @brief Decode JPEG data to RGB, letting libjpeg downscale in the DCT domain
+ *
+ * Picks the smallest scale M/8 whose output is still at least
+ * min_width x min_height, so large snapshots are never decoded at full size
+ * only to be shrunk afterwards. Pass 0 to decode at full resolution.
+ *
+ * @param jpeg_data  Input JPEG buffer
+ * @param jpeg_size  Size of JPEG data
+ * @param min_width  Minimum output width (0 = full size)
+ * @param min_height  Minimum output height (0 = full size)
+ * @param out_image  Output decoded image structure
+ * @return true on success, false on error
+ */
+bool JPEG_DecodeScaled(const uint8_t* jpeg_data, size_t jpeg_size,
+                       int min_width, int min_height, DecodedImage* out_image);
+
+/**
+ * @brief Create a reusable decoder for one worker thread
+ *
+ * Falls back to libjpeg when the TurboJPEG handle cannot be created.
+ *
+ * @param backend  Preferred backend
+ * @param fast  Use TurboJPEG fast DCT and fast upsampling (slightly lower quality)
+ * @return Decoder, or NULL on allocation failure
+ */
+JpegDecoder* JPEG_CreateDecoder(JpegBackend backend, bool fast);
+
+/**
+ * @brief Destroy a decoder and its output buffer
+ */
+void JPEG_DestroyDecoder(JpegDecoder* decoder);
+
+/**
+ * @brief Backend the decoder actually uses (after any init fallback)
+ */
+JpegBackend JPEG_GetDecoderBackend(const JpegDecoder* decoder);
+
+/**
+ * @brief Decode JPEG data to RGB into the decoder's reusable buffer
+ *
+ * Same scaling rule as JPEG_DecodeScaled. If the TurboJPEG decode fails the
+ * frame is retried with libjpeg. out_image->data belongs to the decoder and
+ * stays valid until its next decode; do not pass it to JPEG_FreeImage.
+ *
+ * @param decoder  Decoder owned by the calling thread
+ * @param jpeg_data  Input JPEG buffer
+ * @param jpeg_size  Size of JPEG data
+ * @param min_width  Minimum output width (0 = full size)
+ * @param min_height  Minimum output height (0 = full size)
+ * @param out_image  Output decoded image structure
+ * @return true on success, false on error
+ */
+bool JPEG_DecodeWith(JpegDecoder* decoder, const uint8_t* jpeg_data, size_t jpeg_size,
+                     int min_width, int min_height, DecodedImage* out_image);
+
+/**
+ * @brief Decode JPEG data and stream RGB rows to a sink instead of a frame
+ *
+ * Uses the libjpeg scanline API (TurboJPEG has no row output), so only a few
+ * rows are ever buffered. out_image receives the geometry; its data is NULL.
+ * A sink abort from begin() or a corrupt stream returns false.
+ *
+ * @param decoder  Decoder owned by the calling thread
+ * @param jpeg_data  Input JPEG buffer
+ * @param jpeg_size  Size of JPEG data
+ * @param min_width  Minimum output width (0 = full size)
+ * @param min_height  Minimum output height (0 = full size)
+ * @param sink  Row consumer
+ * @param out_image  Output geometry
+ * @return true on success, false on error
+ */
+bool JPEG_DecodeRows(JpegDecoder* decoder, const uint8_t* jpeg_data, size_t jpeg_size,
+                     int min_width, int min_height, const JpegRowSink* sink,
+                     DecodedImage* out_image);
+
+/**
+ * @brief Name of a backend as used in settings.json ("libjpeg", "turbojpeg")
+ */
+const char* JPEG_BackendName(JpegBackend backend);
+
+/**
+ * @brief Parse a backend name
+ *
+ * @return false if the name is unknown (backend is left untouched)
+ */
+bool JPEG_BackendFromString(const char* name, JpegBackend* backend);
+
+/**
+ * @brief Snapshot of decode timings for one backend (all threads)
+ */
+void JPEG_GetStats(JpegBackend backend, JpegDecodeStats* stats);
+
 /**
  * @brief Free resources allocated for decoded image
  *
@@ -0,0 +1,225 @@
+/**
+ * jsonwriter.c - Streaming JSON Writer Implementation
+ *
+ * The buffer doubles from 4 KB as needed and stays allocated between
+ * documents, so steady-state responses only write bytes.
+ */
+
+#include "jsonwriter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#define INITIAL_CAPACITY 4096
+
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+
+static void thread_writer_free(void* ptr) {
+    JsonWriter* w = ptr;
+    JSONW_Free(w);
+    free(w);
+}
+
+static void thread_key_create(void) {
+    pthread_key_create(&thread_key, thread_writer_free);
+}
+
+JsonWriter* JSONW_Thread(void) {
+    pthread_once(&thread_key_once, thread_key_create);
+    JsonWriter* w = pthread_getspecific(thread_key);
+    if (!w) {
+        w = calloc(1, sizeof(*w));
+        if (!w || pthread_setspecific(thread_key, w) != 0) {
+            // Fall back to a writer that reports failure on every document
+            free(w);
+            static __thread JsonWriter failed_writer;
+            failed_writer.failed = true;
+            return &failed_writer;
+        }
+    }
+    JSONW_Reset(w);
+    return w;
+}
+
+void JSONW_Reset(JsonWriter* w) {
+    if (!w) return;
+    w->length = 0;
+    w->depth = 0;
+    w->objects = 0;
+    w->has_items = 0;
+    w->failed = false;
+    if (w->data) w->data[0] = '\0';
+}
+
+void JSONW_Free(JsonWriter* w) {
+    if (!w) return;
+    free(w->data);
+    w->data = NULL;
+    w->length = 0;
+    w->capacity = 0;
+}
+
+// Room for n more bytes plus the terminator
+static bool reserve(JsonWriter* w, size_t n) {
+    if (w->failed) return false;
+    if (w->length + n + 1 <= w->capacity) return true;
+
+    size_t capacity = w->capacity ? w->capacity : INITIAL_CAPACITY;
+    while (capacity < w->length + n + 1) capacity *= 2;
+    char* data = realloc(w->data, capacity);
+    if (!data) {
+        w->failed = true;
+        return false;
+    }
+    w->data = data;
+    w->capacity = capacity;
+    return true;
+}
+
+static void append(JsonWriter* w, const char* s, size_t n) {
+    if (!reserve(w, n)) return;
+    memcpy(w->data + w->length, s, n);
+    w->length += n;
+    w->data[w->length] = '\0';
+}
+
+static void append_string(JsonWriter* w, const char* s) {
+    static const char hex[] = "0123456789abcdef";
+
+    append(w, "\"", 1);
+    const char* run = s;
+    for (const unsigned char* p = (const unsigned char*)s; *p; p++) {
+        if (*p >= 0x20 && *p != '"' && *p != '\\') continue;
+
+        append(w, run, (const char*)p - run);
+        char esc[6] = { '\\', 0 };
+        size_t n = 2;
+        switch (*p) {
+            case '"':  esc[1] = '"'; break;
+            case '\\': esc[1] = '\\'; break;
+            case '\b': esc[1] = 'b'; break;
+            case '\f': esc[1] = 'f'; break;
+            case '\n': esc[1] = 'n'; break;
+            case '\r': esc[1] = 'r'; break;
+            case '\t': esc[1] = 't'; break;
+            default:
+                esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+                esc[4] = hex[*p >> 4]; esc[5] = hex[*p & 0xF];
+                n = 6;
+                break;
+        }
+        append(w, esc, n);
+        run = (const char*)p + 1;
+    }
+    append(w, run, strlen(run));
+    append(w, "\"", 1);
+}
+
+// Separator and key for the next member of the current container
+static void begin_value(JsonWriter* w, const char* key) {
+    if (w->failed) return;
+    if (w->depth == 0) {
+        if (w->length > 0) w->failed = true;    // One value per document
+        return;
+    }
+
+    uint32_t bit = 1u << (w->depth - 1);
+    if (w->has_items & bit) append(w, ",", 1);
+    w->has_items |= bit;
+
+    if (w->objects & bit) {
+        if (!key) {
+            w->failed = true;
+            return;
+        }
+        append_string(w, key);
+        append(w, ":", 1);
+    }
+}
+
+static void open_container(JsonWriter* w, const char* key, bool object) {
+    begin_value(w, key);
+    if (w->failed) return;
+    if (w->depth >= JSONW_MAX_DEPTH) {
+        w->failed = true;
+        return;
+    }
+    append(w, object ? "{" : "[", 1);
+
+    uint32_t bit = 1u << w->depth;
+    w->depth++;
+    w->has_items &= ~bit;
+    if (object) w->objects |= bit;
+    else w->objects &= ~bit;
+}
+
+static void close_container(JsonWriter* w, bool object) {
+    if (w->failed) return;
+    uint32_t bit = w->depth > 0 ? 1u << (w->depth - 1) : 0;
+    if (!bit || ((w->objects & bit) != 0) != object) {
+        w->failed = true;
+        return;
+    }
+    append(w, object ? "}" : "]", 1);
+    w->depth--;
+}
+
+void JSONW_BeginObject(JsonWriter* w, const char* key) { open_container(w, key, true); }
+void JSONW_EndObject(JsonWriter* w) { close_container(w, true); }
+void JSONW_BeginArray(JsonWriter* w, const char* key) { open_container(w, key, false); }
+void JSONW_EndArray(JsonWriter* w) { close_container(w, false); }
+
+void JSONW_String(JsonWriter* w, const char* key, const char* value) {
+    begin_value(w, key);
+    if (value) append_string(w, value);
+    else append(w, "null", 4);
+}
+
+void JSONW_Int(JsonWriter* w, const char* key, int64_t value) {
+    char buf[24];
+    int n = snprintf(buf, sizeof(buf), "%" PRId64, value);
+    begin_value(w, key);
+    append(w, buf, n);
+}
+
+void JSONW_Uint(JsonWriter* w, const char* key, uint64_t value) {
+    char buf[24];
+    int n = snprintf(buf, sizeof(buf), "%" PRIu64, value);
+    begin_value(w, key);
+    append(w, buf, n);
+}
+
+void JSONW_Bool(JsonWriter* w, const char* key, bool value) {
+    begin_value(w, key);
+    if (value) append(w, "true", 4);
+    else append(w, "false", 5);
+}
+
+void JSONW_Double(JsonWriter* w, const char* key, double value) {
+    begin_value(w, key);
+    if (isnan(value) || isinf(value)) {
+        append(w, "null", 4);
+        return;
+    }
+
+    // 15 significant digits, or 17 when that does not read back exactly
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%1.15g", value);
+    if (strtod(buf, NULL) != value) {
+        n = snprintf(buf, sizeof(buf), "%1.17g", value);
+    }
+    append(w, buf, n);
+}
+
+const char* JSONW_Data(const JsonWriter* w) {
+    if (!w || w->failed || w->depth != 0 || w->length == 0) return NULL;
+    return w->data;
+}
+
+size_t JSONW_Length(const JsonWriter* w) {
+    return JSONW_Data(w) ? w->length : 0;
+}
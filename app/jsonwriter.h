@@ -0,0 +1,78 @@
+/**
+ * jsonwriter.h - Streaming JSON Writer
+ *
+ * Appends JSON text straight into a growable buffer, for responses that are
+ * built once and sent (detections, /health). No tree is built, so a response
+ * costs no allocations once the buffer has grown to size. cJSON is still used
+ * wherever JSON is parsed or kept around.
+ *
+ *   JsonWriter* w = JSONW_Thread();
+ *   JSONW_BeginObject(w, NULL);
+ *   JSONW_Int(w, "count", 3);
+ *   JSONW_EndObject(w);
+ *   send(JSONW_Data(w), JSONW_Length(w));
+ *
+ * Keys are ignored inside arrays and must be given inside objects. Nesting is
+ * limited to JSONW_MAX_DEPTH levels.
+ */
+
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSONW_MAX_DEPTH 32
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int depth;
+    uint32_t objects;       // Bit n: container at depth n is an object
+    uint32_t has_items;     // Bit n: container at depth n already has a member
+    bool failed;            // Out of memory or bad nesting; output is incomplete
+} JsonWriter;
+
+/**
+ * @brief Reusable writer of the calling thread, reset and ready for a document
+ *
+ * The buffer is kept between calls and freed when the thread exits.
+ */
+JsonWriter* JSONW_Thread(void);
+
+/**
+ * @brief Start a new document, keeping the buffer
+ */
+void JSONW_Reset(JsonWriter* w);
+
+/**
+ * @brief Release the buffer of a writer that is not a JSONW_Thread() one
+ */
+void JSONW_Free(JsonWriter* w);
+
+void JSONW_BeginObject(JsonWriter* w, const char* key);
+void JSONW_EndObject(JsonWriter* w);
+void JSONW_BeginArray(JsonWriter* w, const char* key);
+void JSONW_EndArray(JsonWriter* w);
+
+void JSONW_String(JsonWriter* w, const char* key, const char* value);  // NULL writes null
+void JSONW_Int(JsonWriter* w, const char* key, int64_t value);
+void JSONW_Uint(JsonWriter* w, const char* key, uint64_t value);
+void JSONW_Bool(JsonWriter* w, const char* key, bool value);
+
+/**
+ * @brief Number in the shortest form that reads back exactly (as cJSON prints)
+ *
+ * NaN and infinities are written as null.
+ */
+void JSONW_Double(JsonWriter* w, const char* key, double value);
+
+/**
+ * @brief NUL-terminated document (NULL if anything failed or it is unfinished)
+ */
+const char* JSONW_Data(const JsonWriter* w);
+size_t JSONW_Length(const JsonWriter* w);
+
+#endif // JSONWRITER_H
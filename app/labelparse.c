@@ -17,8 +17,8 @@
 #define MAX_LABEL_FILE_SIZE (1024 * 1024)  /* 1MB max */
 #define MAX_LABEL_LENGTH 60
 
-/* Static fallback buffer for unknown labels */
-static char fallback_label[32];
+/* Per-thread fallback buffer for unknown labels (postprocessing may run on several threads) */
+static __thread char fallback_label[32];
 
 /* Cached labels */
 static char** cached_labels = NULL;
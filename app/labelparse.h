@@ -30,7 +30,8 @@ bool labels_parse_file(const char* labels_path,
  * @param labels      Label array from labels_parse_file
  * @param num_labels  Number of labels in array
  * @param class_id    Class index to look up
- * @return Label string, or "class_N" if not found
+ * @return Label string, or "class_N" if not found (valid until the calling
+ *         thread's next lookup)
  */
 const char* labels_get(char** labels, size_t num_labels, int class_id);
 
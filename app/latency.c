@@ -0,0 +1,189 @@
+/**
+ * latency.c - Per-Stage Latency Histograms Implementation
+ *
+ * Bucket i below 4 holds i us; above that, bucket 4 * (msb - 1) + sub holds
+ * the values whose top bits are 1.sub (msb = index of the highest set bit).
+ */
+
+#include "latency.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#define SLOT_NS ((uint64_t)LATENCY_SLOT_SECONDS * 1000000000ull)
+
+typedef struct {
+    _Atomic uint64_t buckets[LATENCY_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum_ns;
+} Counters;
+
+typedef struct {
+    Counters total;
+    Counters slots[LATENCY_SLOTS];
+    _Atomic uint64_t slot_period[LATENCY_SLOTS];   // Period (now / SLOT_NS) a slot counts
+} StageHistogram;
+
+static StageHistogram stages[LATENCY_STAGE_COUNT];
+
+static const char* stage_names[LATENCY_STAGE_COUNT] = {
+    [LATENCY_UPLOAD] = "upload",
+    [LATENCY_QUEUE] = "queue",
+    [LATENCY_JPEG_DECODE] = "jpeg_decode",
+    [LATENCY_PREPROCESS] = "preprocess",
+    [LATENCY_INFERENCE] = "inference",
+    [LATENCY_OUTPUT_DECODE] = "output_decode",
+    [LATENCY_NMS] = "nms",
+    [LATENCY_RESPONSE] = "response",
+    [LATENCY_TOTAL] = "total",
+};
+
+uint64_t Latency_Now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static int bucket_of(uint64_t us) {
+    if (us < 4) {
+        return (int)us;
+    }
+    int msb = 63 - __builtin_clzll(us);
+    int bucket = 4 * (msb - 1) + (int)((us >> (msb - 2)) & 3);
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// Bucket range in us: [lower, upper)
+static uint64_t bucket_lower(int bucket) {
+    if (bucket < 4) {
+        return (uint64_t)bucket;
+    }
+    int msb = bucket / 4 + 1;
+    return (uint64_t)(4 + bucket % 4) << (msb - 2);
+}
+
+static uint64_t bucket_upper(int bucket) {
+    if (bucket < 4) {
+        return (uint64_t)bucket + 1;
+    }
+    return bucket_lower(bucket) + (1ull << (bucket / 4 - 1));
+}
+
+double Latency_BucketUpperMs(int bucket) {
+    if (bucket < 0 || bucket >= LATENCY_BUCKETS - 1) {
+        return INFINITY;
+    }
+    return bucket_upper(bucket) / 1000.0;
+}
+
+static void add(Counters* c, int bucket, uint64_t ns) {
+    atomic_fetch_add_explicit(&c->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->sum_ns, ns, memory_order_relaxed);
+}
+
+static void clear(Counters* c) {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        atomic_store_explicit(&c->buckets[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&c->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&c->sum_ns, 0, memory_order_relaxed);
+}
+
+void Latency_Record(LatencyStage stage, uint64_t ns) {
+    if (stage < 0 || stage >= LATENCY_STAGE_COUNT) {
+        return;
+    }
+    StageHistogram* h = &stages[stage];
+    int bucket = bucket_of(ns / 1000);
+    add(&h->total, bucket, ns);
+
+    // The first recorder of a new period recycles the slot it last held
+    uint64_t period = Latency_Now() / SLOT_NS;
+    int slot = (int)(period % LATENCY_SLOTS);
+    uint64_t seen = atomic_load_explicit(&h->slot_period[slot], memory_order_acquire);
+    if (seen != period &&
+        atomic_compare_exchange_strong(&h->slot_period[slot], &seen, period)) {
+        clear(&h->slots[slot]);
+    }
+    add(&h->slots[slot], bucket, ns);
+}
+
+void Latency_RecordSince(LatencyStage stage, uint64_t start_ns) {
+    uint64_t now = Latency_Now();
+    Latency_Record(stage, now > start_ns ? now - start_ns : 0);
+}
+
+const char* Latency_StageName(LatencyStage stage) {
+    if (stage < 0 || stage >= LATENCY_STAGE_COUNT) {
+        return "unknown";
+    }
+    return stage_names[stage];
+}
+
+// Middle of the bucket holding the sample at rank (1-based), in ms
+static double quantile_ms(const uint64_t* buckets, uint64_t count, double q) {
+    uint64_t rank = (uint64_t)ceil(q * count);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return (bucket_lower(i) + bucket_upper(i)) / 2000.0;
+        }
+    }
+    return 0.0;
+}
+
+void Latency_GetSummary(LatencyStage stage, LatencySummary* summary) {
+    memset(summary, 0, sizeof(*summary));
+    if (stage < 0 || stage >= LATENCY_STAGE_COUNT) {
+        return;
+    }
+    StageHistogram* h = &stages[stage];
+
+    uint64_t buckets[LATENCY_BUCKETS] = {0};
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+    uint64_t period = Latency_Now() / SLOT_NS;
+    for (int s = 0; s < LATENCY_SLOTS; s++) {
+        uint64_t slot_period = atomic_load_explicit(&h->slot_period[s], memory_order_acquire);
+        if (period - slot_period >= LATENCY_SLOTS) {
+            continue;   // Stale, or never used
+        }
+        Counters* c = &h->slots[s];
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+            uint64_t n = atomic_load_explicit(&c->buckets[i], memory_order_relaxed);
+            buckets[i] += n;
+            count += n;
+        }
+        sum_ns += atomic_load_explicit(&c->sum_ns, memory_order_relaxed);
+    }
+
+    summary->count = count;
+    if (count == 0) {
+        return;
+    }
+    summary->mean_ms = sum_ns / 1e6 / count;
+    summary->p50_ms = quantile_ms(buckets, count, 0.50);
+    summary->p90_ms = quantile_ms(buckets, count, 0.90);
+    summary->p99_ms = quantile_ms(buckets, count, 0.99);
+    summary->p999_ms = quantile_ms(buckets, count, 0.999);
+}
+
+void Latency_GetHistogram(LatencyStage stage, LatencyHistogram* histogram) {
+    memset(histogram, 0, sizeof(*histogram));
+    if (stage < 0 || stage >= LATENCY_STAGE_COUNT) {
+        return;
+    }
+    Counters* c = &stages[stage].total;
+
+    // Count is the sum of the buckets read, so le="+Inf" always matches it
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        histogram->buckets[i] = atomic_load_explicit(&c->buckets[i], memory_order_relaxed);
+        histogram->count += histogram->buckets[i];
+    }
+    histogram->sum_ms = atomic_load_explicit(&c->sum_ns, memory_order_relaxed) / 1e6;
+}
@@ -0,0 +1,77 @@
+/**
+ * latency.h - Per-Stage Latency Histograms
+ *
+ * Lock-free histograms of where a request spends its time, from upload to
+ * response. Durations come from the monotonic clock and fall into log-spaced
+ * buckets, four per power of two (about 19% wide), from 1 us to ~4 min.
+ *
+ * Every stage keeps an all-time histogram (exported for Prometheus) and a
+ * rolling window of LATENCY_SLOTS x LATENCY_SLOT_SECONDS used for the
+ * percentiles in /health. Recording is one atomic add per counter, so any
+ * thread can record at any time; samples landing while a window slot is
+ * being recycled may be lost.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+#define LATENCY_BUCKETS 108        // Last bucket also takes everything longer
+#define LATENCY_SLOTS 6
+#define LATENCY_SLOT_SECONDS 10    // Window of 60 s
+
+typedef enum {
+    LATENCY_UPLOAD = 0,     // Reading the POST body from the web server
+    LATENCY_QUEUE,          // Admission until a preprocess worker claims it
+    LATENCY_JPEG_DECODE,    // Whole-frame JPEG decode
+    LATENCY_PREPROCESS,     // Decode and scale into the tensor slot
+    LATENCY_INFERENCE,      // larod job, submit to completion
+    LATENCY_OUTPUT_DECODE,  // Candidates from the output tensor
+    LATENCY_NMS,
+    LATENCY_RESPONSE,       // Formatting and writing the response
+    LATENCY_TOTAL,          // Upload start to response written (HTTP only)
+    LATENCY_STAGE_COUNT
+} LatencyStage;
+
+// Rolling window percentiles
+typedef struct {
+    uint64_t count;
+    double mean_ms;
+    double p50_ms;
+    double p90_ms;
+    double p99_ms;
+    double p999_ms;
+} LatencySummary;
+
+// All-time histogram
+typedef struct {
+    uint64_t buckets[LATENCY_BUCKETS];
+    uint64_t count;
+    double sum_ms;
+} LatencyHistogram;
+
+/**
+ * @brief Monotonic clock in nanoseconds
+ */
+uint64_t Latency_Now(void);
+
+void Latency_Record(LatencyStage stage, uint64_t ns);
+
+/**
+ * @brief Record the time from start_ns (Latency_Now()) until now
+ */
+void Latency_RecordSince(LatencyStage stage, uint64_t start_ns);
+
+// e.g. "inference"; "unknown" when out of range
+const char* Latency_StageName(LatencyStage stage);
+
+void Latency_GetSummary(LatencyStage stage, LatencySummary* summary);
+void Latency_GetHistogram(LatencyStage stage, LatencyHistogram* histogram);
+
+/**
+ * @brief Upper bound of bucket in milliseconds (the last bucket is unbounded)
+ */
+double Latency_BucketUpperMs(int bucket);
+
+#endif // LATENCY_H
@@ -5,12 +5,16 @@
  * - GET  /capabilities    - Model information and requirements
  * - POST /inference/jpeg  - JPEG image inference endpoint
  * - POST /inference/tensor - Pre-processed tensor inference endpoint
+ * - POST /inference-batch - Several JPEGs/tensors in one request
  * - GET  /health          - Server health and statistics
+ *
+ * Persistent TCP streams (stream.c) are served when server.stream_port is set.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <syslog.h>
 #include <signal.h>
 #include <unistd.h>
@@ -20,16 +24,29 @@
 #include "server.h"
 #include "Model.h"
 #include "cJSON.h"
-#include "labelparse.h"
 #include "jpeg_decoder.h"
+#include "stream.h"
+#include "jsonwriter.h"
+#include "latency.h"
+#include "benchmark.h"
+#include "applog.h"
+#include "assets.h"
+#include "labelparse.h"
 
 
-#define LOG(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args);}
-#define LOG_WARN(fmt, args...)    { syslog(LOG_WARNING, fmt, ## args); printf(fmt, ## args);}
+#define LOG(fmt, args...)    Log_Write(LOG_LEVEL_INFO, fmt, ## args)
+#define LOG_WARN(fmt, args...)    Log_Write(LOG_LEVEL_WARNING, fmt, ## args)
 //#define LOG_TRACE(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args); }
 #define LOG_TRACE(fmt, args...)    {}
 
 #define APP_PACKAGE	"detectx"
+#define DEFAULT_HTTP_THREADS 4
+
+// /inference-batch framing: per item a little-endian int32 index and uint32
+// length, followed by that many bytes of JPEG or raw tensor
+#define BATCH_ITEM_HEADER 8
+
+#define MODEL_RETRY_SECONDS 5       // Retry-After while a model is loading, unless the cache knows better
 
 static GMainLoop* main_loop = NULL;
 
@@ -41,6 +58,63 @@ static void signal_handler(int signo) {
     }
 }
 
+// Aggregate of the per-request messages, which only debug level prints
+static gboolean log_summary(gpointer user_data) {
+    static uint64_t last_total, last_success, last_failed, last_busy;
+    static uint64_t last_expired, last_superseded;
+
+    uint64_t total, success, failed, busy;
+    Server_GetStats(&total, &success, &failed, &busy);
+    double wait_avg_ms, wait_max_ms;
+    uint64_t expired, superseded;
+    Server_GetQueueStats(&wait_avg_ms, &wait_max_ms, &expired, &superseded);
+
+    if (total != last_total || busy != last_busy) {
+        LatencySummary inference, end_to_end;
+        Latency_GetSummary(LATENCY_INFERENCE, &inference);
+        Latency_GetSummary(LATENCY_TOTAL, &end_to_end);
+        LOG("Last %d s: %llu requests, %llu successful, %llu failed, %llu busy, %llu dropped; "
+            "inference p50 %.1f ms, total p99 %.1f ms\n",
+            Log_GetSummaryInterval(),
+            (unsigned long long)(total - last_total), (unsigned long long)(success - last_success),
+            (unsigned long long)(failed - last_failed), (unsigned long long)(busy - last_busy),
+            (unsigned long long)(expired + superseded - last_expired - last_superseded),
+            inference.p50_ms, end_to_end.p99_ms);
+    }
+
+    last_total = total;
+    last_success = success;
+    last_failed = failed;
+    last_busy = busy;
+    last_expired = expired;
+    last_superseded = superseded;
+    return G_SOURCE_CONTINUE;
+}
+
+static guint summary_source = 0;
+
+static void schedule_summary(void) {
+    if (summary_source) {
+        g_source_remove(summary_source);
+        summary_source = 0;
+    }
+    if (Log_GetSummaryInterval() > 0) {
+        summary_source = g_timeout_add_seconds(Log_GetSummaryInterval(), log_summary, NULL);
+    }
+}
+
+// Settings changes: log settings apply at once, model changes load in the
+// background while the current models keep serving
+static void settings_updated(const char* service, cJSON* data) {
+    if (strcmp(service, "log") == 0) {
+        Log_Configure(data);
+        schedule_summary();
+    } else if ((strcmp(service, "model") == 0 || strcmp(service, "models") == 0) &&
+               Server_IsRunning()) {
+        Server_ConfigureModels();
+    }
+}
+
 // Update ACAP status information
 static void update_acap_status(void) {
     // Get statistics
@@ -67,19 +141,113 @@ static void update_acap_status(void) {
     ACAP_STATUS_SetNumber("performance", "min_inference_ms", min_ms);
     ACAP_STATUS_SetNumber("performance", "max_inference_ms", max_ms);
 
-    ACAP_STATUS_SetNumber("model", "input_width", Model_GetWidth());
-    ACAP_STATUS_SetNumber("model", "input_height", Model_GetHeight());
+    ServerModel* model = Server_AcquireModel(NULL);
+    if (model) {
+        ACAP_STATUS_SetString("model", "name", Model_GetName(model->ctx));
+        ACAP_STATUS_SetNumber("model", "input_width", Model_GetWidth(model->ctx));
+        ACAP_STATUS_SetNumber("model", "input_height", Model_GetHeight(model->ctx));
+        ACAP_STATUS_SetNumber("model", "generation", (double)model->generation);
+        Server_ReleaseModel(model);
+    }
+
+    // Rolling window percentiles per stage, e.g. latency.inference_p99_ms
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        LatencySummary ls;
+        Latency_GetSummary((LatencyStage)i, &ls);
+        char name[64];
+        snprintf(name, sizeof(name), "%s_p50_ms", Latency_StageName((LatencyStage)i));
+        ACAP_STATUS_SetNumber("latency", name, ls.p50_ms);
+        snprintf(name, sizeof(name), "%s_p99_ms", Latency_StageName((LatencyStage)i));
+        ACAP_STATUS_SetNumber("latency", name, ls.p99_ms);
+    }
 }
 
-// GET /capabilities - Return model capabilities and requirements
+// Registry entries with the geometry of each model, known from the cache of
+// a previous start while the first load is still running
+static cJSON* models_json(void) {
+    ServerModelInfo info[MAX_MODELS];
+    int count = Server_ListModels(info, MAX_MODELS);
+
+    cJSON* models = cJSON_CreateArray();
+    for (int i = 0; i < count; i++) {
+        cJSON* entry = cJSON_CreateObject();
+        cJSON_AddStringToObject(entry, "name", info[i].name);
+        cJSON_AddBoolToObject(entry, "default", info[i].is_default);
+        cJSON_AddBoolToObject(entry, "loaded", info[i].loaded);
+        cJSON_AddBoolToObject(entry, "loading", info[i].loading);
+
+        if (info[i].loaded) {
+            cJSON_AddNumberToObject(entry, "generation", (double)info[i].generation);
+        }
+        if (info[i].described) {
+            const ModelDescription* desc = &info[i].desc;
+            cJSON_AddStringToObject(entry, "path", desc->path);
+            cJSON_AddStringToObject(entry, "device", desc->device);
+            cJSON_AddNumberToObject(entry, "input_width", desc->width);
+            cJSON_AddNumberToObject(entry, "input_height", desc->height);
+            cJSON_AddNumberToObject(entry, "batch_size", desc->batch_size);
+            cJSON_AddNumberToObject(entry, "classes", desc->classes);
+        }
+        if (info[i].error[0]) {
+            cJSON_AddStringToObject(entry, "error", info[i].error);
+        }
+        cJSON_AddItemToArray(models, entry);
+    }
+    return models;
+}
+
+// Class objects from the labels of a loaded model, or the labels file of one
+// still loading
+static cJSON* classes_json(ServerModel* served, const char* labels_path) {
+    cJSON* classes = cJSON_CreateArray();
+    char** labels = NULL;
+    char* label_buffer = NULL;
+    size_t label_count = 0;
+    if (served) {
+        label_count = Model_GetLabelCount(served->ctx);
+    } else if (!labels_parse_file(labels_path, &labels, &label_buffer, &label_count)) {
+        LOG_WARN("%s: Failed to load labels from %s\n", __func__, labels_path);
+    }
+
+    for (size_t i = 0; i < label_count; i++) {
+        cJSON* class_obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(class_obj, "id", (double)i);
+        cJSON_AddStringToObject(class_obj, "name",
+                                served ? Model_GetLabel(served->ctx, (int)i) : labels[i]);
+        cJSON_AddItemToArray(classes, class_obj);
+    }
+    if (!served) {
+        labels_free(labels, label_buffer);
+    }
+    return classes;
+}
+
+// GET /capabilities - Return model capabilities and requirements. "model"
+// describes the default model, from the cache of a previous start while it
+// loads ("loaded": false); "models" lists every configured one.
 static void http_capabilities(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    ServerModelInfo info = {0};     // retry_after stays 0 if no model is configured
+    ServerModel* served = Server_AcquireModel(NULL);
+    if (!Server_GetModelInfo(NULL, &info) || !info.described) {
+        Server_ReleaseModel(served);
+        ACAP_HTTP_Respond_Error_Retry(response, 503,
+                                      info.retry_after > 0 ? info.retry_after : MODEL_RETRY_SECONDS,
+                                      "Service Unavailable: Model not loaded");
+        return;
+    }
+    ModelDescription desc = info.desc;
+    if (served) {
+        Model_GetDescription(served->ctx, &desc);
+    }
     cJSON* resp_json = cJSON_CreateObject();
 
     // Model information
     cJSON* model = cJSON_CreateObject();
-    int model_width = Model_GetWidth();
-    int model_height = Model_GetHeight();
+    int model_width = desc.width;
+    int model_height = desc.height;
 
+    cJSON_AddStringToObject(model, "name", info.name);
+    cJSON_AddBoolToObject(model, "loaded", served != NULL);
     cJSON_AddNumberToObject(model, "input_width", model_width);
     cJSON_AddNumberToObject(model, "input_height", model_height);
     cJSON_AddNumberToObject(model, "channels", 3);
@@ -113,25 +281,50 @@ static void http_capabilities(ACAP_HTTP_Response response, const ACAP_HTTP_Reque
     cJSON_AddBoolToObject(tensor_format, "strict_dimensions", true);
     cJSON_AddItemToArray(formats, tensor_format);
 
+    // Raw frame format (decoded video)
+    cJSON* frame_format = cJSON_CreateObject();
+    cJSON_AddStringToObject(frame_format, "endpoint", "/inference-frame");
+    cJSON_AddStringToObject(frame_format, "method", "POST");
+    cJSON_AddStringToObject(frame_format, "content_type", "application/octet-stream");
+    cJSON_AddStringToObject(frame_format, "description",
+                            "Raw frame of any resolution, ?width=W&height=H&pixel_format=nv12|rgb|planar_rgb");
+    cJSON* pixel_formats = cJSON_AddArrayToObject(frame_format, "pixel_formats");
+    cJSON_AddItemToArray(pixel_formats, cJSON_CreateString("nv12"));
+    cJSON_AddItemToArray(pixel_formats, cJSON_CreateString("rgb"));
+    cJSON_AddItemToArray(pixel_formats, cJSON_CreateString("planar_rgb"));
+    cJSON_AddNumberToObject(frame_format, "max_size_mb", MAX_FRAME_SIZE / (1024 * 1024));
+    cJSON_AddItemToArray(formats, frame_format);
+
+    // Region of interest and tiling (JPEG and frame endpoints)
+    cJSON* tiling = cJSON_CreateObject();
+    cJSON_AddStringToObject(tiling, "parameters", "roi=x,y,w,h&tiles=auto|CxR&overlap=F");
+    cJSON_AddNumberToObject(tiling, "max_tiles", MAX_TILES);
+    cJSON_AddNumberToObject(tiling, "default_overlap", DEFAULT_TILE_OVERLAP);
+    cJSON_AddNumberToObject(tiling, "max_overlap", MAX_TILE_OVERLAP);
+    cJSON_AddItemToObject(model, "tiling", tiling);
+
+    // Batch format (dataset runs)
+    cJSON* batch_format = cJSON_CreateObject();
+    cJSON_AddStringToObject(batch_format, "endpoint", "/inference-batch");
+    cJSON_AddStringToObject(batch_format, "method", "POST");
+    cJSON_AddStringToObject(batch_format, "content_type", "application/octet-stream");
+    cJSON_AddStringToObject(batch_format, "description",
+                            "Items of int32 index + uint32 length (little-endian) + JPEG or tensor bytes");
+    cJSON_AddNumberToObject(batch_format, "max_items", MAX_BATCH_ITEMS);
+    cJSON_AddNumberToObject(batch_format, "max_size_mb", MAX_BATCH_SIZE / (1024 * 1024));
+    cJSON_AddNumberToObject(batch_format, "model_batch_size", desc.batch_size);
+    cJSON_AddItemToArray(formats, batch_format);
+
     cJSON_AddItemToObject(model, "input_formats", formats);
 
     // Class labels
-    cJSON* classes = cJSON_CreateArray();
-    char** labels = NULL;
-    int num_classes = 0;
-
-    if (labelparse_get_labels(&labels, &num_classes)) {
-        for (int i = 0; i < num_classes; i++) {
-            cJSON* class_obj = cJSON_CreateObject();
-            cJSON_AddNumberToObject(class_obj, "id", i);
-            cJSON_AddStringToObject(class_obj, "name", labels[i]);
-            cJSON_AddItemToArray(classes, class_obj);
-        }
-    }
-
-    cJSON_AddItemToObject(model, "classes", classes);
-    cJSON_AddNumberToObject(model, "max_queue_size", MAX_QUEUE_SIZE);
+    cJSON_AddItemToObject(model, "classes", classes_json(served, desc.labels));
+    cJSON_AddNumberToObject(model, "max_queue_size", Server_GetQueueCapacity(PRIORITY_NORMAL));
     cJSON_AddItemToObject(resp_json, "model", model);
+    Server_ReleaseModel(served);
+
+    // Other models are chosen with ?model=NAME on the inference endpoints
+    cJSON_AddItemToObject(resp_json, "models", models_json());
 
     // Server information
     cJSON_AddStringToObject(resp_json, "server", "detectx");
@@ -141,90 +334,553 @@ static void http_capabilities(ACAP_HTTP_Response response, const ACAP_HTTP_Reque
     cJSON_Delete(resp_json);
 }
 
+// Send a finished JsonWriter document
+static void respond_writer(ACAP_HTTP_Response response, JsonWriter* w) {
+    const char* json = JSONW_Data(w);
+    if (!json) {
+        ACAP_HTTP_Respond_Error(response, 500, "Internal Server Error: Out of memory");
+        return;
+    }
+    ACAP_HTTP_Respond_JSON_String(response, json, JSONW_Length(w));
+}
+
 // GET /health - Return server health and statistics
 static void http_health(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
     // Update ACAP status
     update_acap_status();
 
-    cJSON* resp_json = cJSON_CreateObject();
+    JsonWriter* w = JSONW_Thread();
+    JSONW_BeginObject(w, NULL);
 
-    cJSON_AddBoolToObject(resp_json, "running", Server_IsRunning());
-    cJSON_AddNumberToObject(resp_json, "queue_size", Server_GetQueueSize());
-    cJSON_AddBoolToObject(resp_json, "queue_full", Server_IsQueueFull());
+    JSONW_Bool(w, "running", Server_IsRunning());
+    JSONW_Int(w, "queue_size", Server_GetQueueSize());
+    int queue_capacity = 0;
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        queue_capacity += Server_GetQueueCapacity((RequestPriority)i);
+    }
+    JSONW_Int(w, "queue_capacity", queue_capacity);
+    JSONW_Bool(w, "queue_full", Server_IsQueueFull());
 
     // Statistics
     uint64_t total, success, failed, busy;
     Server_GetStats(&total, &success, &failed, &busy);
-
-    cJSON* stats = cJSON_CreateObject();
-    cJSON_AddNumberToObject(stats, "total_requests", (double)total);
-    cJSON_AddNumberToObject(stats, "successful", (double)success);
-    cJSON_AddNumberToObject(stats, "failed", (double)failed);
-    cJSON_AddNumberToObject(stats, "busy", (double)busy);
-    cJSON_AddItemToObject(resp_json, "statistics", stats);
+    double p50_ms;
+    uint64_t deadline_rejected;
+    Server_GetAdmissionStats(&p50_ms, &deadline_rejected);
+    double wait_avg_ms, wait_max_ms;
+    uint64_t expired, superseded;
+    Server_GetQueueStats(&wait_avg_ms, &wait_max_ms, &expired, &superseded);
+
+    JSONW_BeginObject(w, "statistics");
+    JSONW_Uint(w, "total_requests", total);
+    JSONW_Uint(w, "successful", success);
+    JSONW_Uint(w, "failed", failed);
+    JSONW_Uint(w, "busy", busy);
+    JSONW_Uint(w, "deadline_rejected", deadline_rejected);
+    JSONW_Uint(w, "expired", expired);
+    JSONW_Uint(w, "superseded", superseded);
+    JSONW_EndObject(w);
 
     // Timing statistics
     double avg_ms, min_ms, max_ms;
     Server_GetTiming(&avg_ms, &min_ms, &max_ms);
 
-    cJSON* timing = cJSON_CreateObject();
-    cJSON_AddNumberToObject(timing, "average_ms", avg_ms);
-    cJSON_AddNumberToObject(timing, "min_ms", min_ms);
-    cJSON_AddNumberToObject(timing, "max_ms", max_ms);
-    cJSON_AddItemToObject(resp_json, "timing", timing);
+    JSONW_BeginObject(w, "timing");
+    JSONW_Double(w, "average_ms", avg_ms);
+    JSONW_Double(w, "min_ms", min_ms);
+    JSONW_Double(w, "max_ms", max_ms);
+    JSONW_Double(w, "p50_ms", p50_ms);
+    JSONW_Double(w, "queue_wait_average_ms", wait_avg_ms);
+    JSONW_Double(w, "queue_wait_max_ms", wait_max_ms);
+    JSONW_EndObject(w);
+
+    // JPEG decode timings per backend (libjpeg also counts TurboJPEG fallbacks)
+    JSONW_BeginObject(w, "jpeg_decoders");
+    for (int i = 0; i < JPEG_BACKEND_COUNT; i++) {
+        JpegDecodeStats ds;
+        JPEG_GetStats((JpegBackend)i, &ds);
+        JSONW_BeginObject(w, JPEG_BackendName((JpegBackend)i));
+        JSONW_Uint(w, "count", ds.count);
+        JSONW_Uint(w, "failures", ds.failures);
+        JSONW_Double(w, "average_ms", ds.count ? ds.total_ms / ds.count : 0.0);
+        JSONW_Double(w, "min_ms", ds.min_ms);
+        JSONW_Double(w, "max_ms", ds.max_ms);
+        JSONW_EndObject(w);
+    }
+    JSONW_EndObject(w);
+
+    // Registry state; a failed reload keeps the previous model serving
+    ServerModelInfo models[MAX_MODELS];
+    int model_count = Server_ListModels(models, MAX_MODELS);
+    JSONW_BeginArray(w, "models");
+    for (int i = 0; i < model_count; i++) {
+        JSONW_BeginObject(w, NULL);
+        JSONW_String(w, "name", models[i].name);
+        JSONW_Bool(w, "loaded", models[i].loaded);
+        JSONW_Bool(w, "loading", models[i].loading);
+        JSONW_Uint(w, "generation", models[i].generation);
+        JSONW_Int(w, "in_use", models[i].in_use);
+        if (models[i].error[0]) {
+            JSONW_String(w, "error", models[i].error);
+        }
+        JSONW_EndObject(w);
+    }
+    JSONW_EndArray(w);
+
+    // Output decoding and NMS of the default model, timed separately from inference
+    ModelPostprocessStats ps = { 0 };
+    ServerModel* model = Server_AcquireModel(NULL);
+    if (model) {
+        Model_GetPostprocessStats(model->ctx, &ps);
+        Server_ReleaseModel(model);
+    }
+    JSONW_BeginObject(w, "postprocess");
+    JSONW_Uint(w, "count", ps.count);
+    JSONW_Double(w, "decode_average_ms", ps.count ? ps.decode_total_ms / ps.count : 0.0);
+    JSONW_Double(w, "nms_average_ms", ps.count ? ps.nms_total_ms / ps.count : 0.0);
+    JSONW_Double(w, "nms_max_ms", ps.nms_max_ms);
+    JSONW_Double(w, "average_candidates", ps.count ? (double)ps.candidates / ps.count : 0.0);
+    JSONW_Double(w, "average_detections", ps.count ? (double)ps.detections / ps.count : 0.0);
+    JSONW_EndObject(w);
+
+    // Persistent TCP streams
+    int stream_port, stream_connections;
+    uint64_t stream_frames, stream_rejected;
+    Stream_GetStats(&stream_port, &stream_connections, &stream_frames, &stream_rejected);
+    JSONW_BeginObject(w, "stream");
+    JSONW_Int(w, "port", stream_port);
+    JSONW_Int(w, "connections", stream_connections);
+    JSONW_Uint(w, "frames", stream_frames);
+    JSONW_Uint(w, "rejected", stream_rejected);
+    JSONW_EndObject(w);
+
+    // Preallocated requests; overflow counts requests that used the heap
+    int pool_size, pool_in_use;
+    uint64_t pool_overflow;
+    Server_GetPoolStats(&pool_size, &pool_in_use, &pool_overflow);
+    JSONW_BeginObject(w, "request_pool");
+    JSONW_Int(w, "size", pool_size);
+    JSONW_Int(w, "in_use", pool_in_use);
+    JSONW_Uint(w, "overflow", pool_overflow);
+    JSONW_EndObject(w);
+
+    // Admission queue per scheduling class
+    JSONW_BeginObject(w, "priorities");
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        PriorityStats ps;
+        Server_GetPriorityStats((RequestPriority)i, &ps);
+        JSONW_BeginObject(w, Server_PriorityName((RequestPriority)i));
+        JSONW_Int(w, "queued", ps.queued);
+        JSONW_Int(w, "max_queue_size", ps.capacity);
+        JSONW_Int(w, "weight", ps.weight);
+        JSONW_Uint(w, "admitted", ps.admitted);
+        JSONW_Uint(w, "rejected", ps.rejected);
+        JSONW_Uint(w, "processed", ps.claimed);
+        JSONW_Double(w, "queue_wait_average_ms", ps.wait_average_ms);
+        JSONW_EndObject(w);
+    }
+    JSONW_EndObject(w);
+
+    // Per-stage percentiles over the rolling window
+    JSONW_BeginObject(w, "latency");
+    JSONW_Int(w, "window_seconds", LATENCY_SLOTS * LATENCY_SLOT_SECONDS);
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        LatencySummary ls;
+        Latency_GetSummary((LatencyStage)i, &ls);
+        JSONW_BeginObject(w, Latency_StageName((LatencyStage)i));
+        JSONW_Uint(w, "count", ls.count);
+        JSONW_Double(w, "mean_ms", ls.mean_ms);
+        JSONW_Double(w, "p50_ms", ls.p50_ms);
+        JSONW_Double(w, "p90_ms", ls.p90_ms);
+        JSONW_Double(w, "p99_ms", ls.p99_ms);
+        JSONW_Double(w, "p999_ms", ls.p999_ms);
+        JSONW_EndObject(w);
+    }
+    JSONW_EndObject(w);
 
-    ACAP_HTTP_Respond_JSON(response, resp_json);
-    cJSON_Delete(resp_json);
+    JSONW_EndObject(w);
+    respond_writer(response, w);
+}
+
+static void metric_header(GString* out, const char* name, const char* type, const char* help) {
+    g_string_append_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// GET /metrics - Prometheus text exposition of counters and stage histograms
+static void http_metrics(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    GString* out = g_string_sized_new(16384);
+
+    uint64_t total, success, failed, busy;
+    Server_GetStats(&total, &success, &failed, &busy);
+    double p50_ms;
+    uint64_t deadline_rejected;
+    Server_GetAdmissionStats(&p50_ms, &deadline_rejected);
+    double wait_avg_ms, wait_max_ms;
+    uint64_t expired, superseded;
+    Server_GetQueueStats(&wait_avg_ms, &wait_max_ms, &expired, &superseded);
+
+    metric_header(out, "detectx_requests_total", "counter", "Requests by outcome");
+    g_string_append_printf(out, "detectx_requests_total{outcome=\"admitted\"} %llu\n", (unsigned long long)total);
+    g_string_append_printf(out, "detectx_requests_total{outcome=\"successful\"} %llu\n", (unsigned long long)success);
+    g_string_append_printf(out, "detectx_requests_total{outcome=\"failed\"} %llu\n", (unsigned long long)failed);
+    g_string_append_printf(out, "detectx_requests_total{outcome=\"busy\"} %llu\n", (unsigned long long)busy);
+    g_string_append_printf(out, "detectx_requests_total{outcome=\"deadline_rejected\"} %llu\n", (unsigned long long)deadline_rejected);
+    g_string_append_printf(out, "detectx_requests_total{outcome=\"expired\"} %llu\n", (unsigned long long)expired);
+    g_string_append_printf(out, "detectx_requests_total{outcome=\"superseded\"} %llu\n", (unsigned long long)superseded);
+
+    metric_header(out, "detectx_queue_size", "gauge", "Requests waiting for a preprocess worker");
+    g_string_append_printf(out, "detectx_queue_size %d\n", Server_GetQueueSize());
+
+    metric_header(out, "detectx_running", "gauge", "1 while the inference pipeline accepts work");
+    g_string_append_printf(out, "detectx_running %d\n", Server_IsRunning() ? 1 : 0);
+
+    // All-time histograms; le bounds are every fourth bucket (powers of two in us)
+    metric_header(out, "detectx_stage_latency_seconds", "histogram", "Time spent per pipeline stage");
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        const char* stage = Latency_StageName((LatencyStage)i);
+        LatencyHistogram h;
+        Latency_GetHistogram((LatencyStage)i, &h);
+        uint64_t cumulative = 0;
+        for (int b = 0; b < LATENCY_BUCKETS - 1; b++) {
+            cumulative += h.buckets[b];
+            if (b % 4 == 3) {
+                g_string_append_printf(out, "detectx_stage_latency_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+                                       stage, Latency_BucketUpperMs(b) / 1000.0,
+                                       (unsigned long long)cumulative);
+            }
+        }
+        g_string_append_printf(out, "detectx_stage_latency_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n",
+                               stage, (unsigned long long)h.count);
+        g_string_append_printf(out, "detectx_stage_latency_seconds_sum{stage=\"%s\"} %.6f\n",
+                               stage, h.sum_ms / 1000.0);
+        g_string_append_printf(out, "detectx_stage_latency_seconds_count{stage=\"%s\"} %llu\n",
+                               stage, (unsigned long long)h.count);
+    }
+
+    // Same percentiles as /health, for dashboards without histogram_quantile
+    static const char* quantiles[] = { "0.5", "0.9", "0.99", "0.999" };
+    metric_header(out, "detectx_stage_latency_window_seconds", "gauge",
+                  "Stage latency percentiles over the last 60 seconds");
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        LatencySummary ls;
+        Latency_GetSummary((LatencyStage)i, &ls);
+        double values_ms[] = { ls.p50_ms, ls.p90_ms, ls.p99_ms, ls.p999_ms };
+        for (int q = 0; q < 4; q++) {
+            g_string_append_printf(out, "detectx_stage_latency_window_seconds{stage=\"%s\",quantile=\"%s\"} %.6f\n",
+                                   Latency_StageName((LatencyStage)i), quantiles[q], values_ms[q] / 1000.0);
+        }
+    }
+
+    ACAP_HTTP_Respond_String(response,
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: %zu\r\n"
+        "Cache-Control: no-cache\r\n\r\n", out->len);
+    ACAP_HTTP_Respond_Data(response, out->len, out->str);
+    g_string_free(out, TRUE);
+}
+
+// Detection layout a client asked for: ?format=full|lean|bin, or binary when
+// Accept names application/octet-stream (if binary is allowed).
+// Returns false for an unknown format.
+static bool parse_result_format(const ACAP_HTTP_Request request, bool binary,
+                                ModelResultFormat* format) {
+    *format = MODEL_FORMAT_FULL;
+
+    char* param = (char*)ACAP_HTTP_Request_Param(request, "format");
+    if (param) {
+        bool known = true;
+        if (strcmp(param, "lean") == 0) {
+            *format = MODEL_FORMAT_LEAN;
+        } else if (binary && (strcmp(param, "bin") == 0 || strcmp(param, "binary") == 0)) {
+            *format = MODEL_FORMAT_BINARY;
+        } else if (strcmp(param, "full") != 0) {
+            known = false;
+        }
+        free(param);
+        return known;
+    }
+
+    const char* accept = ACAP_HTTP_Get_Accept(request);
+    if (binary && accept && strstr(accept, "application/octet-stream")) {
+        *format = MODEL_FORMAT_BINARY;
+    }
+    return true;
+}
+
+// Latency budget from the X-Deadline-Ms header (0 when absent).
+// Returns false if the header is not a positive number of milliseconds.
+static bool parse_deadline(const ACAP_HTTP_Request request, int* deadline_ms) {
+    *deadline_ms = 0;
+
+    const char* header = ACAP_HTTP_Get_Header(request, "X-Deadline-Ms");
+    if (!header) {
+        return true;
+    }
+    char* end = NULL;
+    long value = strtol(header, &end, 10);
+    if (end == header || *end != '\0' || value <= 0 || value > INT_MAX) {
+        return false;
+    }
+    *deadline_ms = (int)value;
+    return true;
+}
+
+// Scheduling class from ?priority= or the X-Priority header, else the
+// endpoint's default. Returns false for an unknown class.
+static bool parse_priority(const ACAP_HTTP_Request request, RequestPriority fallback,
+                           RequestPriority* priority) {
+    *priority = fallback;
+
+    char* param = (char*)ACAP_HTTP_Request_Param(request, "priority");
+    if (param) {
+        bool known = Server_PriorityFromString(param, priority);
+        free(param);
+        return known;
+    }
+
+    const char* header = ACAP_HTTP_Get_Header(request, "X-Priority");
+    return !header || Server_PriorityFromString(header, priority);
+}
+
+// Latest-only stream from the X-Stream-Id header ("" when absent).
+// Returns false if the id does not fit.
+static bool parse_stream_id(const ACAP_HTTP_Request request, char* stream_id) {
+    stream_id[0] = '\0';
+
+    const char* header = ACAP_HTTP_Get_Header(request, "X-Stream-Id");
+    if (!header) {
+        return true;
+    }
+    if (strlen(header) >= STREAM_ID_SIZE) {
+        return false;
+    }
+    strcpy(stream_id, header);
+    return true;
+}
+
+// Region of interest and tile grid of a JPEG or frame request
+typedef struct {
+    bool tiled;             // roi or tiles given: use Server_CreateTiledRequest
+    ModelRegion roi;        // The whole image unless ?roi= is given
+    int cols;               // 0: automatic
+    int rows;
+    float overlap;
+} Tiling;
+
+// ?roi=x,y,w,h, ?tiles=CxR|auto and ?overlap=F. A roi alone is one tile.
+// Returns an error message, or NULL if the parameters are valid.
+static const char* parse_tiling(const ACAP_HTTP_Request request, int image_width, int image_height,
+                                Tiling* tiling) {
+    *tiling = (Tiling){ false, { 0, 0, image_width, image_height }, 1, 1, DEFAULT_TILE_OVERLAP };
+    const char* error = NULL;
+
+    char* param = (char*)ACAP_HTTP_Request_Param(request, "roi");
+    if (param) {
+        ModelRegion* roi = &tiling->roi;
+        int end = 0;
+        if (sscanf(param, "%d,%d,%d,%d%n", &roi->x, &roi->y, &roi->width, &roi->height, &end) != 4 ||
+            param[end] != '\0' || roi->width <= 0 || roi->height <= 0 || roi->x < 0 || roi->y < 0 ||
+            roi->x > image_width - roi->width || roi->y > image_height - roi->height) {
+            error = "roi must be x,y,width,height inside the image";
+        }
+        tiling->tiled = true;
+        free(param);
+    }
+
+    param = (char*)ACAP_HTTP_Request_Param(request, "tiles");
+    if (param && !error) {
+        int end = 0;
+        if (strcmp(param, "auto") == 0) {
+            tiling->cols = 0;
+            tiling->rows = 0;
+        } else if (sscanf(param, "%dx%d%n", &tiling->cols, &tiling->rows, &end) != 2 ||
+                   param[end] != '\0' || tiling->cols < 1 || tiling->rows < 1 ||
+                   tiling->cols > MAX_TILES || tiling->rows > MAX_TILES ||
+                   tiling->cols * tiling->rows > MAX_TILES) {
+            error = "tiles must be auto or COLSxROWS with at most 16 tiles";
+        }
+        tiling->tiled = true;
+    }
+    free(param);
+
+    param = (char*)ACAP_HTTP_Request_Param(request, "overlap");
+    if (param && !error) {
+        char* end = NULL;
+        tiling->overlap = strtof(param, &end);
+        if (end == param || *end != '\0' || !(tiling->overlap >= 0.0f) ||
+            tiling->overlap > MAX_TILE_OVERLAP) {
+            error = "overlap must be between 0 and 0.5";
+        }
+    }
+    free(param);
+    return error;
+}
+
+// Adopt the upload into a single or tiled request on model
+static InferenceRequest* create_image_request(const ACAP_HTTP_Request request, ServerModel* model,
+                                              RequestContent content, int image_index,
+                                              int image_width, int image_height,
+                                              const Tiling* tiling) {
+    size_t body_size = 0;
+    uint8_t* body = (uint8_t*)ACAP_HTTP_Take_Body(request, &body_size);
+    if (tiling->tiled) {
+        return Server_CreateTiledRequest(model, body, body_size, ACAP_HTTP_Release_Body, content,
+                                         image_index, image_width, image_height,
+                                         &tiling->roi, tiling->cols, tiling->rows,
+                                         tiling->overlap);
+    }
+    InferenceRequest* req = Server_AdoptRequest(body, body_size, ACAP_HTTP_Release_Body,
+                                                content, image_index, image_width, image_height);
+    Server_SetRequestModel(req, model);
+    return req;
+}
+
+// Model named by ?model= (the default without it). NULL after answering 404
+// for an unknown name, or 503 while the model is not loaded.
+static ServerModel* acquire_model(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    char* name = (char*)ACAP_HTTP_Request_Param(request, "model");
+    ServerModel* model = Server_AcquireModel(name);
+    if (!model) {
+        ServerModelInfo info;
+        if (!Server_IsRunning()) {
+            ACAP_HTTP_Respond_Error(response, 503, "Service Unavailable: Server shutting down");
+        } else if (Server_GetModelInfo(name, &info)) {
+            char error_msg[128];
+            snprintf(error_msg, sizeof(error_msg), "Service Unavailable: Model %s is %s",
+                     info.name, info.loading ? "loading" : "not loaded");
+            ACAP_HTTP_Respond_Error_Retry(response, 503,
+                                          info.retry_after > 0 ? info.retry_after : MODEL_RETRY_SECONDS,
+                                          error_msg);
+        } else {
+            ACAP_HTTP_Respond_Error(response, 404, "Not Found: Unknown model");
+        }
+    }
+    free(name);
+    return model;
+}
+
+typedef void (*ModelHandler)(ACAP_HTTP_Response response, const ACAP_HTTP_Request request,
+                             ServerModel* model);
+
+// Run an endpoint on the model of the request, holding it until the response is sent
+static void with_model(ACAP_HTTP_Response response, const ACAP_HTTP_Request request,
+                       ModelHandler handler) {
+    ServerModel* model = acquire_model(response, request);
+    if (model) {
+        handler(response, request, model);
+        Server_ReleaseModel(model);
+    }
+}
+
+// Hand a request to the queue; on rejection it is freed and answered with 503
+static bool admit(ACAP_HTTP_Response response, InferenceRequest* request) {
+    int retry_after = 0;
+    Admission admission = Server_AdmitRequest(request, &retry_after);
+    if (admission == ADMISSION_ACCEPTED) {
+        return true;
+    }
+
+    char error_msg[160];
+    switch (admission) {
+        case ADMISSION_QUEUE_FULL:
+            snprintf(error_msg, sizeof(error_msg),
+                     "Service Unavailable: Queue full (max %d concurrent %s priority requests)",
+                     Server_GetQueueCapacity(request->priority),
+                     Server_PriorityName(request->priority));
+            break;
+        case ADMISSION_DEADLINE:
+            snprintf(error_msg, sizeof(error_msg),
+                     "Service Unavailable: Estimated wait exceeds deadline of %d ms",
+                     request->deadline_ms);
+            break;
+        default:
+            snprintf(error_msg, sizeof(error_msg), "Service Unavailable: Server shutting down");
+            break;
+    }
+    Server_FreeRequest(request);
+    ACAP_HTTP_Respond_Error_Retry(response, 503, retry_after, error_msg);
+    return false;
+}
+
+static void respond_packed(ACAP_HTTP_Response response, InferenceRequest* request) {
+    size_t size = MODEL_PACKED_SIZE(request->detection_count);
+    uint8_t* packed = malloc(size);
+    if (!packed) {
+        ACAP_HTTP_Respond_Error(response, 500, "Internal Server Error: Out of memory");
+        return;
+    }
+    Model_PackDetections(request->detections, request->detection_count,
+                         request->transform.original_width, request->transform.original_height,
+                         request->image_index, packed);
+    ACAP_HTTP_Respond_String(response,
+        "Content-Type: application/octet-stream\r\n"
+        "Content-Length: %zu\r\n"
+        "Cache-Control: no-cache\r\n\r\n", size);
+    ACAP_HTTP_Respond_Data(response, size, packed);
+    free(packed);
+}
+
+// Upload, response and end-to-end time of an answered inference request
+static void record_http_latency(const ACAP_HTTP_Request http, uint64_t respond_start) {
+    Latency_Record(LATENCY_UPLOAD, http->bodyReadNs);
+    Latency_RecordSince(LATENCY_RESPONSE, respond_start);
+    Latency_RecordSince(LATENCY_TOTAL, http->startNs);
 }
 
 // Helper function to process inference request and send response
-static void process_and_respond(ACAP_HTTP_Response response, InferenceRequest* request) {
+static void process_and_respond(ACAP_HTTP_Response response, const ACAP_HTTP_Request http,
+                                InferenceRequest* request, ModelResultFormat format) {
     // Wait for processing to complete
     pthread_mutex_lock(&request->lock);
     while (!request->processed) {
         pthread_cond_wait(&request->done, &request->lock);
     }
     pthread_mutex_unlock(&request->lock);
+    uint64_t respond_start = Latency_Now();
 
     // Send response based on status
-    if (request->status_code == 200) {
-        // Detections found
-        cJSON* resp_json = cJSON_CreateObject();
-        cJSON_AddItemToObject(resp_json, "detections", (cJSON*)request->response_data);
-        request->response_data = NULL; // Transfer ownership
-
-        ACAP_HTTP_Respond_JSON(response, resp_json);
-        cJSON_Delete(resp_json);
+    if (request->status_code == 200 && format == MODEL_FORMAT_BINARY) {
+        respond_packed(response, request);
+    } else if (request->status_code == 200) {
+        // Detections found; formatted here rather than on the postprocess thread
+        JsonWriter* w = JSONW_Thread();
+        JSONW_BeginObject(w, NULL);
+        Model_WriteDetections(Server_GetRequestModel(request), w, "detections", request->detections,
+                              request->detection_count,
+                              request->transform.original_width,
+                              request->transform.original_height,
+                              request->image_index, format);
+        JSONW_EndObject(w);
+        respond_writer(response, w);
     } else if (request->status_code == 204) {
         // No detections
-        if (request->response_data) {
-            cJSON_Delete((cJSON*)request->response_data);
-            request->response_data = NULL;
-        }
         ACAP_HTTP_Respond_Error(response, 204, "No Content: No detections found");
     } else if (request->status_code == 400 && request->response_data) {
         // Validation error with message
-        char* error_msg = (char*)request->response_data;
         char full_msg[512];
-        snprintf(full_msg, sizeof(full_msg), "Bad Request: %s", error_msg);
+        snprintf(full_msg, sizeof(full_msg), "Bad Request: %s", request->response_data);
         ACAP_HTTP_Respond_Error(response, 400, full_msg);
-        free(error_msg);
-        request->response_data = NULL;
+    } else if (request->status_code == 504 && request->response_data) {
+        // Dropped unrun: deadline passed or superseded by a newer frame
+        char full_msg[512];
+        snprintf(full_msg, sizeof(full_msg), "Gateway Timeout: %s", request->response_data);
+        ACAP_HTTP_Respond_Error(response, 504, full_msg);
+    } else if (request->status_code == 503) {
+        // Pipeline stopped before the request completed
+        ACAP_HTTP_Respond_Error(response, 503, "Service Unavailable: Server shutting down");
     } else {
         // Inference failed
-        if (request->response_data) {
-            cJSON_Delete((cJSON*)request->response_data);
-            request->response_data = NULL;
-        }
         ACAP_HTTP_Respond_Error(response, 500, "Internal Server Error: Inference failed");
     }
 
     // Cleanup
     Server_FreeRequest(request);
+    record_http_latency(http, respond_start);
 }
 
 // POST /inference/jpeg - Process JPEG image inference
-static void http_inference_jpeg(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+static void inference_jpeg(ACAP_HTTP_Response response, const ACAP_HTTP_Request request,
+                           ServerModel* model) {
     const char* content_type = request->contentType;
 
     // Validate content type
@@ -233,6 +889,30 @@ static void http_inference_jpeg(ACAP_HTTP_Response response, const ACAP_HTTP_Req
         return;
     }
 
+    ModelResultFormat format;
+    if (!parse_result_format(request, true, &format)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: format must be full, lean or bin");
+        return;
+    }
+
+    int deadline_ms;
+    if (!parse_deadline(request, &deadline_ms)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: X-Deadline-Ms must be a positive number of milliseconds");
+        return;
+    }
+
+    RequestPriority priority;
+    if (!parse_priority(request, PRIORITY_NORMAL, &priority)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: priority must be high, normal or low");
+        return;
+    }
+
+    char stream_id[STREAM_ID_SIZE];
+    if (!parse_stream_id(request, stream_id)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: X-Stream-Id is longer than 31 characters");
+        return;
+    }
+
     // Get image index from query string (optional, format: ?index=N)
     int image_index = -1;
     if (request->queryString) {
@@ -256,12 +936,6 @@ static void http_inference_jpeg(ACAP_HTTP_Response response, const ACAP_HTTP_Req
         return;
     }
 
-    // Check if queue is full
-    if (Server_IsQueueFull()) {
-        ACAP_HTTP_Respond_Error(response, 503, "Service Unavailable: Queue full (max 3 concurrent requests)");
-        return;
-    }
-
     // Get JPEG dimensions
     int image_width, image_height;
     if (!JPEG_GetDimensions(body_data, body_size, &image_width, &image_height)) {
@@ -269,27 +943,38 @@ static void http_inference_jpeg(ACAP_HTTP_Response response, const ACAP_HTTP_Req
         return;
     }
 
-    // Create inference request
-    InferenceRequest* inf_request = Server_CreateRequest(body_data, body_size,
-                                                         "image/jpeg", image_index,
-                                                         image_width, image_height);
+    Tiling tiling;
+    const char* tiling_error = parse_tiling(request, image_width, image_height, &tiling);
+    if (tiling_error) {
+        char error_msg[128];
+        snprintf(error_msg, sizeof(error_msg), "Bad Request: %s", tiling_error);
+        ACAP_HTTP_Respond_Error(response, 400, error_msg);
+        return;
+    }
+
+    // Hand the upload buffer to the request instead of copying it
+    InferenceRequest* inf_request = create_image_request(request, model, REQUEST_CONTENT_JPEG,
+                                                         image_index, image_width, image_height,
+                                                         &tiling);
     if (!inf_request) {
         ACAP_HTTP_Respond_Error(response, 500, "Internal Server Error: Failed to create request");
         return;
     }
 
-    // Queue request
-    if (!Server_QueueRequest(inf_request)) {
-        Server_FreeRequest(inf_request);
-        ACAP_HTTP_Respond_Error(response, 503, "Service Unavailable: Queue full");
+    // Queue request; the whole admission decision is made under the queue lock
+    inf_request->deadline_ms = deadline_ms;
+    inf_request->priority = priority;
+    strcpy(inf_request->stream_id, stream_id);
+    if (!admit(response, inf_request)) {
         return;
     }
 
-    process_and_respond(response, inf_request);
+    process_and_respond(response, request, inf_request, format);
 }
 
 // POST /inference/tensor - Process pre-processed tensor inference
-static void http_inference_tensor(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+static void inference_tensor(ACAP_HTTP_Response response, const ACAP_HTTP_Request request,
+                             ServerModel* model) {
     const char* content_type = request->contentType;
 
     // Validate content type
@@ -298,6 +983,30 @@ static void http_inference_tensor(ACAP_HTTP_Response response, const ACAP_HTTP_R
         return;
     }
 
+    ModelResultFormat format;
+    if (!parse_result_format(request, true, &format)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: format must be full, lean or bin");
+        return;
+    }
+
+    int deadline_ms;
+    if (!parse_deadline(request, &deadline_ms)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: X-Deadline-Ms must be a positive number of milliseconds");
+        return;
+    }
+
+    RequestPriority priority;
+    if (!parse_priority(request, PRIORITY_NORMAL, &priority)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: priority must be high, normal or low");
+        return;
+    }
+
+    char stream_id[STREAM_ID_SIZE];
+    if (!parse_stream_id(request, stream_id)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: X-Stream-Id is longer than 31 characters");
+        return;
+    }
+
     // Get image index from query string (optional, format: ?index=N)
     int image_index = -1;
     if (request->queryString) {
@@ -317,125 +1026,561 @@ static void http_inference_tensor(ACAP_HTTP_Response response, const ACAP_HTTP_R
     }
 
     // Validate tensor size
-    int expected_size = Model_GetWidth() * Model_GetHeight() * 3;
+    ModelContext* ctx = model->ctx;
+    int expected_size = Model_GetWidth(ctx) * Model_GetHeight(ctx) * 3;
     if (body_size != expected_size) {
         char error_msg[256];
         snprintf(error_msg, sizeof(error_msg),
                  "Bad Request: Invalid tensor size. Expected %d bytes (%dx%dx3), got %zu bytes",
-                 expected_size, Model_GetWidth(), Model_GetHeight(), body_size);
+                 expected_size, Model_GetWidth(ctx), Model_GetHeight(ctx), body_size);
         ACAP_HTTP_Respond_Error(response, 400, error_msg);
         return;
     }
 
-    // Check if queue is full
-    if (Server_IsQueueFull()) {
-        ACAP_HTTP_Respond_Error(response, 503, "Service Unavailable: Queue full (max 3 concurrent requests)");
+    // For tensor input, dimensions are model dimensions
+    int tensor_width = Model_GetWidth(ctx);
+    int tensor_height = Model_GetHeight(ctx);
+
+    // Hand the upload buffer to the request instead of copying it
+    uint8_t* body = (uint8_t*)ACAP_HTTP_Take_Body(request, &body_size);
+    InferenceRequest* inf_request = Server_AdoptRequest(body, body_size, ACAP_HTTP_Release_Body,
+                                                        REQUEST_CONTENT_TENSOR, image_index,
+                                                        tensor_width, tensor_height);
+    Server_SetRequestModel(inf_request, model);
+    if (!inf_request) {
+        ACAP_HTTP_Respond_Error(response, 500, "Internal Server Error: Failed to create request");
+        return;
+    }
+
+    // Queue request; the whole admission decision is made under the queue lock
+    inf_request->deadline_ms = deadline_ms;
+    inf_request->priority = priority;
+    strcpy(inf_request->stream_id, stream_id);
+    if (!admit(response, inf_request)) {
         return;
     }
 
-    // For tensor input, dimensions are model dimensions
-    int tensor_width = Model_GetWidth();
-    int tensor_height = Model_GetHeight();
+    process_and_respond(response, request, inf_request, format);
+}
+
+// Integer query parameter in [min, max]; false if present but invalid
+static bool parse_int_param(const ACAP_HTTP_Request request, const char* name,
+                            int min, int max, int* value) {
+    char* param = (char*)ACAP_HTTP_Request_Param(request, name);
+    if (!param) {
+        return true;
+    }
+    char* end = NULL;
+    long parsed = strtol(param, &end, 10);
+    bool ok = end != param && *end == '\0' && parsed >= min && parsed <= max;
+    free(param);
+    if (ok) {
+        *value = (int)parsed;
+    }
+    return ok;
+}
+
+static bool parse_frame_format(const char* name, VdoFormat* format) {
+    if (strcmp(name, "nv12") == 0 || strcmp(name, "yuv") == 0) {
+        *format = VDO_FORMAT_YUV;
+    } else if (strcmp(name, "rgb") == 0) {
+        *format = VDO_FORMAT_RGB;
+    } else if (strcmp(name, "planar_rgb") == 0) {
+        *format = VDO_FORMAT_PLANAR_RGB;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// POST /inference-frame?width=W&height=H&pixel_format=nv12|rgb|planar_rgb - Raw frame
+// of any resolution, converted and scaled by larod straight into the model input
+static void inference_frame(ACAP_HTTP_Response response, const ACAP_HTTP_Request request,
+                            ServerModel* model) {
+    const char* content_type = request->contentType;
 
-    // Create inference request
-    InferenceRequest* inf_request = Server_CreateRequest(body_data, body_size,
-                                                         "application/octet-stream", image_index,
-                                                         tensor_width, tensor_height);
+    // Validate content type
+    if (!content_type || strncmp(content_type, "application/octet-stream", 24) != 0) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: Content-Type must be application/octet-stream");
+        return;
+    }
+
+    ModelResultFormat format;
+    if (!parse_result_format(request, true, &format)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: format must be full, lean or bin");
+        return;
+    }
+
+    int deadline_ms;
+    if (!parse_deadline(request, &deadline_ms)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: X-Deadline-Ms must be a positive number of milliseconds");
+        return;
+    }
+
+    RequestPriority priority;
+    if (!parse_priority(request, PRIORITY_NORMAL, &priority)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: priority must be high, normal or low");
+        return;
+    }
+
+    char stream_id[STREAM_ID_SIZE];
+    if (!parse_stream_id(request, stream_id)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: X-Stream-Id is longer than 31 characters");
+        return;
+    }
+
+    // Frame geometry; "format" is taken by the result format, so pixels use pixel_format
+    int width = 0, height = 0, image_index = -1;
+    if (!parse_int_param(request, "width", 1, MAX_FRAME_DIMENSION, &width) ||
+        !parse_int_param(request, "height", 1, MAX_FRAME_DIMENSION, &height) ||
+        width == 0 || height == 0) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: width and height are required (1-8192)");
+        return;
+    }
+    if (!parse_int_param(request, "index", INT_MIN, INT_MAX, &image_index)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: index must be an integer");
+        return;
+    }
+
+    VdoFormat frame_format = VDO_FORMAT_YUV;
+    char* param = (char*)ACAP_HTTP_Request_Param(request, "pixel_format");
+    bool known = !param || parse_frame_format(param, &frame_format);
+    free(param);
+    if (!known) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: pixel_format must be nv12, rgb or planar_rgb");
+        return;
+    }
+    if (frame_format == VDO_FORMAT_YUV && (width % 2 || height % 2)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: NV12 frames need an even width and height");
+        return;
+    }
+
+    // Read request body
+    size_t expected_size = Model_FrameSize(width, height, frame_format);
+    size_t body_size = request->postDataLength;
+    if (!request->postData || body_size == 0) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: Empty body");
+        return;
+    }
+    if (expected_size > MAX_FRAME_SIZE) {
+        ACAP_HTTP_Respond_Error(response, 413, "Payload Too Large: Maximum frame size is 32MB");
+        return;
+    }
+    if (body_size != expected_size) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg),
+                 "Bad Request: Invalid frame size. Expected %zu bytes for %dx%d, got %zu bytes",
+                 expected_size, width, height, body_size);
+        ACAP_HTTP_Respond_Error(response, 400, error_msg);
+        return;
+    }
+
+    Tiling tiling;
+    const char* tiling_error = parse_tiling(request, width, height, &tiling);
+    if (tiling_error) {
+        char error_msg[128];
+        snprintf(error_msg, sizeof(error_msg), "Bad Request: %s", tiling_error);
+        ACAP_HTTP_Respond_Error(response, 400, error_msg);
+        return;
+    }
+
+    // Hand the upload buffer to the request instead of copying it
+    InferenceRequest* inf_request = create_image_request(request, model, REQUEST_CONTENT_FRAME,
+                                                         image_index, width, height, &tiling);
     if (!inf_request) {
         ACAP_HTTP_Respond_Error(response, 500, "Internal Server Error: Failed to create request");
         return;
     }
 
-    // Queue request
-    if (!Server_QueueRequest(inf_request)) {
-        Server_FreeRequest(inf_request);
-        ACAP_HTTP_Respond_Error(response, 503, "Service Unavailable: Queue full");
+    // Queue request; the whole admission decision is made under the queue lock
+    inf_request->frame_format = frame_format;
+    inf_request->deadline_ms = deadline_ms;
+    inf_request->priority = priority;
+    strcpy(inf_request->stream_id, stream_id);
+    if (!admit(response, inf_request)) {
         return;
     }
 
-    process_and_respond(response, inf_request);
+    process_and_respond(response, request, inf_request, format);
 }
 
-// GET /monitor - Serve monitoring HTML page
-static void http_monitor(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
-    // Read the HTML file
-    FILE* fp = ACAP_FILE_Open("html/monitor.html", "r");
-    if (!fp) {
-        ACAP_HTTP_Respond_Error(response, 404, "Monitoring page not found");
+static uint32_t read_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+typedef struct {
+    size_t offset;
+    size_t size;
+    int index;
+    bool jpeg;
+    int width;
+    int height;
+} BatchItem;
+
+// Split a batch upload into items; JPEGs are recognized by their SOI marker,
+// anything else must be a tensor of exactly input_size bytes
+static int parse_batch(const uint8_t* body, size_t body_size, size_t input_size,
+                       BatchItem* items, char* error, size_t error_size) {
+    int count = 0;
+    size_t pos = 0;
+    while (pos < body_size) {
+        if (count >= MAX_BATCH_ITEMS) {
+            snprintf(error, error_size, "More than %d items", MAX_BATCH_ITEMS);
+            return -1;
+        }
+        if (body_size - pos < BATCH_ITEM_HEADER) {
+            snprintf(error, error_size, "Item %d: Truncated header", count);
+            return -1;
+        }
+
+        BatchItem* item = &items[count];
+        item->index = (int32_t)read_le32(body + pos);
+        item->size = read_le32(body + pos + 4);
+        item->offset = pos + BATCH_ITEM_HEADER;
+        if (item->size == 0 || item->size > body_size - item->offset) {
+            snprintf(error, error_size, "Item %d: Invalid length %zu", count, item->size);
+            return -1;
+        }
+
+        const uint8_t* data = body + item->offset;
+        item->jpeg = item->size >= 2 && data[0] == 0xFF && data[1] == 0xD8;
+        if (item->jpeg) {
+            if (item->size > MAX_IMAGE_SIZE ||
+                !JPEG_GetDimensions(data, item->size, &item->width, &item->height)) {
+                snprintf(error, error_size, "Item %d: Invalid JPEG image", count);
+                return -1;
+            }
+        } else if (item->size != input_size) {
+            snprintf(error, error_size, "Item %d: Not a JPEG and not a %zu byte tensor",
+                     count, input_size);
+            return -1;
+        }
+
+        pos = item->offset + item->size;
+        count++;
+    }
+    return count;
+}
+
+// POST /inference-batch - Several JPEGs or tensors, scheduled as one request
+static void inference_batch(ACAP_HTTP_Response response, const ACAP_HTTP_Request request,
+                            ServerModel* model) {
+    const char* content_type = request->contentType;
+
+    // Validate content type
+    if (!content_type || strncmp(content_type, "application/octet-stream", 24) != 0) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: Content-Type must be application/octet-stream");
+        return;
+    }
+
+    // Results are always a JSON list; detections can be lean
+    ModelResultFormat format;
+    if (!parse_result_format(request, false, &format)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: format must be full or lean");
+        return;
+    }
+
+    int deadline_ms;
+    if (!parse_deadline(request, &deadline_ms)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: X-Deadline-Ms must be a positive number of milliseconds");
+        return;
+    }
+
+    RequestPriority priority;
+    if (!parse_priority(request, PRIORITY_LOW, &priority)) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: priority must be high, normal or low");
         return;
     }
 
-    // Get file size
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    // Read request body
+    const uint8_t* body_data = (const uint8_t*)request->postData;
+    size_t body_size = request->postDataLength;
+
+    if (!body_data || body_size == 0) {
+        ACAP_HTTP_Respond_Error(response, 400, "Bad Request: Empty body");
+        return;
+    }
+
+    if (body_size > MAX_BATCH_SIZE) {
+        ACAP_HTTP_Respond_Error(response, 413, "Payload Too Large: Maximum batch size is 64MB");
+        return;
+    }
 
-    // Read file content
-    char* html_content = malloc(file_size + 1);
-    if (!html_content) {
-        fclose(fp);
-        ACAP_HTTP_Respond_Error(response, 500, "Memory allocation failed");
+    BatchItem items[MAX_BATCH_ITEMS];
+    char error[160];
+    int count = parse_batch(body_data, body_size, Model_GetInputSize(model->ctx),
+                            items, error, sizeof(error));
+    if (count <= 0) {
+        char error_msg[200];
+        snprintf(error_msg, sizeof(error_msg), "Bad Request: %s", count < 0 ? error : "No items");
+        ACAP_HTTP_Respond_Error(response, 400, error_msg);
         return;
     }
 
-    fread(html_content, 1, file_size, fp);
-    html_content[file_size] = '\0';
-    fclose(fp);
+    // Items reference the upload buffer, so nothing is copied
+    uint8_t* body = (uint8_t*)ACAP_HTTP_Take_Body(request, &body_size);
+    InferenceRequest* batch = Server_CreateBatch(body, body_size, ACAP_HTTP_Release_Body, count);
+    if (!batch) {
+        ACAP_HTTP_Respond_Error(response, 500, "Internal Server Error: Failed to create request");
+        return;
+    }
+    Server_SetRequestModel(batch, model);
+    int tensor_width = Model_GetWidth(model->ctx);
+    int tensor_height = Model_GetHeight(model->ctx);
+    for (int i = 0; i < count; i++) {
+        BatchItem* item = &items[i];
+        if (!Server_AddBatchItem(batch, item->offset, item->size,
+                                 item->jpeg ? REQUEST_CONTENT_JPEG : REQUEST_CONTENT_TENSOR,
+                                 item->index,
+                                 item->jpeg ? item->width : tensor_width,
+                                 item->jpeg ? item->height : tensor_height)) {
+            Server_FreeRequest(batch);
+            ACAP_HTTP_Respond_Error(response, 500, "Internal Server Error: Failed to create request");
+            return;
+        }
+    }
 
-    // Send HTML response
-    FCGX_FPrintF(response->out, "HTTP/1.1 200 OK\r\n");
-    FCGX_FPrintF(response->out, "Content-Type: text/html; charset=utf-8\r\n");
-    FCGX_FPrintF(response->out, "Content-Length: %ld\r\n", file_size);
-    FCGX_FPrintF(response->out, "\r\n");
-    FCGX_FPrintF(response->out, "%s", html_content);
+    // Queue request; the whole batch takes one queue entry
+    batch->deadline_ms = deadline_ms;
+    batch->priority = priority;
+    if (!admit(response, batch)) {
+        return;
+    }
+
+    // Wait until every item is done
+    pthread_mutex_lock(&batch->lock);
+    while (!batch->processed) {
+        pthread_cond_wait(&batch->done, &batch->lock);
+    }
+    pthread_mutex_unlock(&batch->lock);
+    uint64_t respond_start = Latency_Now();
+
+    // One result object per item, in upload order
+    JsonWriter* w = JSONW_Thread();
+    JSONW_BeginObject(w, NULL);
+    JSONW_Int(w, "batch_size", batch->item_count);
+    JSONW_BeginArray(w, "results");
+    for (int i = 0; i < batch->item_count; i++) {
+        Server_WriteResult(w, batch->items[i], format);
+    }
+    JSONW_EndArray(w);
+    JSONW_EndObject(w);
+    respond_writer(response, w);
 
-    free(html_content);
+    Server_FreeRequest(batch);
+    record_http_latency(request, respond_start);
+}
+
+// GET/POST /benchmark - Time every pipeline stage on this camera.
+// ?iterations=N&resolutions=WxH,...&devices=all|name,...&tensor=0&model=NAME;
+// a POSTed JPEG is benchmarked next to the synthetic ones.
+static void benchmark(ACAP_HTTP_Response response, const ACAP_HTTP_Request request,
+                      ServerModel* model) {
+    static pthread_mutex_t running = PTHREAD_MUTEX_INITIALIZER;
+
+    BenchmarkOptions options;
+    Benchmark_DefaultOptions(&options);
+    Server_GetJpegConfig(&options.jpeg_backend, &options.jpeg_fast);
+
+    char* param = (char*)ACAP_HTTP_Request_Param(request, "iterations");
+    if (param) {
+        options.iterations = atoi(param);
+        free(param);
+        if (options.iterations < 1 || options.iterations > BENCH_MAX_ITERATIONS) {
+            ACAP_HTTP_Respond_Error(response, 400, "Bad Request: iterations must be 1-1000");
+            return;
+        }
+    }
+    param = (char*)ACAP_HTTP_Request_Param(request, "resolutions");
+    if (param) {
+        bool valid = Benchmark_ParseResolutions(param, &options);
+        free(param);
+        if (!valid) {
+            ACAP_HTTP_Respond_Error(response, 400, "Bad Request: resolutions must be up to 4 WxH sizes, e.g. 640x480,1920x1080");
+            return;
+        }
+    }
+    param = (char*)ACAP_HTTP_Request_Param(request, "tensor");
+    if (param) {
+        options.tensor = strcmp(param, "0") != 0 && strcmp(param, "false") != 0;
+        free(param);
+    }
+
+    if (request->postData && request->postDataLength > 0) {
+        int width, height;
+        if (request->postDataLength > MAX_IMAGE_SIZE ||
+            !JPEG_GetDimensions((const uint8_t*)request->postData, request->postDataLength,
+                                &width, &height)) {
+            ACAP_HTTP_Respond_Error(response, 400, "Bad Request: body must be a JPEG image of at most 10MB");
+            return;
+        }
+        options.jpeg = (const uint8_t*)request->postData;
+        options.jpeg_size = request->postDataLength;
+    }
+
+    // Runs take seconds and borrow a tensor slot; one at a time
+    if (pthread_mutex_trylock(&running) != 0) {
+        ACAP_HTTP_Respond_Error_Retry(response, 503, 10, "Service Unavailable: A benchmark is already running");
+        return;
+    }
+
+    char* devices = (char*)ACAP_HTTP_Request_Param(request, "devices");
+    char* error_msg = NULL;
+    JsonWriter* w = JSONW_Thread();
+    JSONW_BeginObject(w, NULL);
+    bool ok = Benchmark_RunDevices(model->ctx, devices, &options, w, "devices", &error_msg);
+    JSONW_EndObject(w);
+    pthread_mutex_unlock(&running);
+    free(devices);
+
+    if (!ok) {
+        char full_msg[256];
+        snprintf(full_msg, sizeof(full_msg), "Bad Request: %s", error_msg ? error_msg : "Benchmark failed");
+        ACAP_HTTP_Respond_Error(response, 400, full_msg);
+    } else {
+        respond_writer(response, w);
+    }
+    free(error_msg);
+}
+
+// Endpoints that run on the model of ?model=
+static void http_inference_jpeg(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    with_model(response, request, inference_jpeg);
+}
+
+static void http_inference_tensor(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    with_model(response, request, inference_tensor);
+}
+
+static void http_inference_frame(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    with_model(response, request, inference_frame);
+}
+
+static void http_inference_batch(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    with_model(response, request, inference_batch);
+}
+
+static void http_benchmark(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    with_model(response, request, benchmark);
+}
+
+// GET /models - Model registry; POST /models?reload=NAME - Reload a model from
+// its settings in the background (202), swapped in once it is ready
+static void http_models(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    if (request->method && strcmp(request->method, "POST") == 0) {
+        char* name = (char*)ACAP_HTTP_Request_Param(request, "reload");
+        if (!name) {
+            ACAP_HTTP_Respond_Error(response, 400, "Bad Request: reload=NAME is required");
+            return;
+        }
+        if (!Server_ReloadModel(name)) {
+            free(name);
+            ACAP_HTTP_Respond_Error(response, 404, "Not Found: Unknown model");
+            return;
+        }
+        // Registry names are plain [A-Za-z0-9._-]
+        LOG("Reload of model %s requested\n", name);
+        ACAP_HTTP_Respond_String(response,
+            "Status: 202 Accepted\r\n"
+            "Content-Type: application/json\r\n"
+            "Cache-Control: no-cache\r\n\r\n"
+            "{\"model\":\"%s\",\"reloading\":true}", name);
+        free(name);
+        return;
+    }
+
+    cJSON* resp_json = cJSON_CreateObject();
+    cJSON_AddItemToObject(resp_json, "models", models_json());
+    ACAP_HTTP_Respond_JSON(response, resp_json);
+    cJSON_Delete(resp_json);
+}
+
+// GET /monitor - Serve monitoring HTML page
+static void http_monitor(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    Assets_Respond(response, request, "html/monitor.html");
 }
 
 // GET /monitor-latest - Return latest inference data as JSON
+// ?image=0 leaves out the base64 JPEG (fetch /monitor-latest.jpg instead)
 static void http_monitor_latest(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
-    uint8_t* image_data = NULL;
-    size_t image_size = 0;
-    char* detections_json = NULL;
-    time_t timestamp = 0;
-
-    // Get latest inference
-    if (!Server_GetLatestInference(&image_data, &image_size, &detections_json, &timestamp)) {
+    LatestInference* latest = Server_AcquireLatestInference();
+    if (!latest) {
         ACAP_HTTP_Respond_Error(response, 404, "No inference data available yet");
         return;
     }
 
-    // Base64 encode the JPEG image using glib
-    gchar* image_base64 = g_base64_encode(image_data, image_size);
-    if (!image_base64) {
-        free(image_data);
-        free(detections_json);
-        ACAP_HTTP_Respond_Error(response, 500, "Failed to encode image");
+    bool with_image = true;
+    char* param = (char*)ACAP_HTTP_Request_Param(request, "image");
+    if (param) {
+        with_image = strcmp(param, "0") != 0 && strcmp(param, "false") != 0;
+        free(param);
+    }
+
+    char etag[64];
+    Server_LatestETag(latest, etag, sizeof(etag));
+    if (ACAP_HTTP_Match_ETag(request, etag)) {
+        ACAP_HTTP_Respond_Not_Modified(response, etag);
+        Server_ReleaseLatestInference(latest);
         return;
     }
 
-    // Create response JSON
-    cJSON* resp = cJSON_CreateObject();
-    cJSON_AddStringToObject(resp, "image", image_base64);
+    // Base64 encode the JPEG image using glib, straight from the cached frame
+    gchar* image_base64 = NULL;
+    if (with_image) {
+        image_base64 = g_base64_encode(latest->image_data, latest->image_size);
+        if (!image_base64) {
+            Server_ReleaseLatestInference(latest);
+            ACAP_HTTP_Respond_Error(response, 500, "Failed to encode image");
+            return;
+        }
+    }
 
-    // Parse detections_json string and add as array
-    cJSON* detections_array = cJSON_Parse(detections_json);
-    if (detections_array) {
-        cJSON_AddItemToObject(resp, "detections", detections_array);
-    } else {
-        cJSON_AddArrayToObject(resp, "detections");  // Empty array if parsing fails
+    JsonWriter* w = JSONW_Thread();
+    JSONW_BeginObject(w, NULL);
+    if (image_base64) {
+        JSONW_String(w, "image", image_base64);
     }
+    Server_WriteLatestDetections(w, "detections", latest);
+    JSONW_Int(w, "timestamp", (int64_t)latest->timestamp);
+    JSONW_String(w, "etag", etag);
+    JSONW_EndObject(w);
+    g_free(image_base64);
+    Server_ReleaseLatestInference(latest);
 
-    cJSON_AddNumberToObject(resp, "timestamp", (double)timestamp);
+    if (!JSONW_Data(w)) {
+        ACAP_HTTP_Respond_Error(response, 500, "Failed to format response");
+        return;
+    }
+    ACAP_HTTP_Respond_String(response,
+        "Content-Type: application/json; charset=utf-8\r\n"
+        "Content-Length: %zu\r\n"
+        "ETag: %s\r\n"
+        "Cache-Control: no-cache\r\n\r\n", JSONW_Length(w), etag);
+    ACAP_HTTP_Respond_Data(response, JSONW_Length(w), JSONW_Data(w));
+}
 
-    // Send JSON response
-    ACAP_HTTP_Respond_JSON(response, resp);
+// GET /monitor-latest.jpg - The latest inferred JPEG as is, with an ETag
+static void http_monitor_latest_jpg(ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    LatestInference* latest = Server_AcquireLatestInference();
+    if (!latest) {
+        ACAP_HTTP_Respond_Error(response, 404, "No inference data available yet");
+        return;
+    }
 
-    // Cleanup
-    free(image_data);
-    g_free(image_base64);
-    free(detections_json);
-    cJSON_Delete(resp);
+    char etag[64];
+    Server_LatestETag(latest, etag, sizeof(etag));
+    if (ACAP_HTTP_Match_ETag(request, etag)) {
+        ACAP_HTTP_Respond_Not_Modified(response, etag);
+    } else {
+        // The reference keeps the buffer alive while it is sent
+        ACAP_HTTP_Respond_String(response,
+            "Content-Type: image/jpeg\r\n"
+            "Content-Length: %zu\r\n"
+            "ETag: %s\r\n"
+            "Cache-Control: no-cache\r\n\r\n", latest->image_size, etag);
+        ACAP_HTTP_Respond_Data(response, latest->image_size, latest->image_data);
+    }
+    Server_ReleaseLatestInference(latest);
 }
 
 int main(void) {
@@ -444,7 +1589,8 @@ int main(void) {
     LOG("-------------- %s --------------\n", APP_PACKAGE);
 
     // Initialize ACAP framework
-    if (!ACAP("detectx", NULL)) {
+    cJSON* settings = ACAP("detectx", settings_updated);
+    if (!settings) {
         LOG_WARN("Failed to initialize ACAP");
         return 1;
     }
@@ -460,13 +1606,39 @@ int main(void) {
     ACAP_HTTP_Node("capabilities", http_capabilities);
     ACAP_HTTP_Node("inference-jpeg", http_inference_jpeg);
     ACAP_HTTP_Node("inference-tensor", http_inference_tensor);
+    ACAP_HTTP_Node("inference-frame", http_inference_frame);
+    ACAP_HTTP_Node("inference-batch", http_inference_batch);
     ACAP_HTTP_Node("health", http_health);
+    ACAP_HTTP_Node("metrics", http_metrics);
+    ACAP_HTTP_Node("benchmark", http_benchmark);
+    ACAP_HTTP_Node("models", http_models);
     ACAP_HTTP_Node("monitor", http_monitor);
+    Assets_Load("html/monitor.html");
     ACAP_HTTP_Node("monitor-latest", http_monitor_latest);
+    ACAP_HTTP_Node("monitor-latest.jpg", http_monitor_latest_jpg);
+
+    // Grow the FastCGI pool so uploads are received while inference runs
+    int http_threads = DEFAULT_HTTP_THREADS;
+    cJSON* server_settings = cJSON_GetObjectItem(settings, "server");
+    cJSON* threads_item = server_settings ? cJSON_GetObjectItem(server_settings, "http_threads") : NULL;
+    if (threads_item && cJSON_IsNumber(threads_item)) {
+        http_threads = threads_item->valueint;
+    }
+    LOG("FastCGI threads: %d\n", ACAP_HTTP_Threads(http_threads));
+
+    // Optional persistent stream listener next to the FastCGI endpoints
+    cJSON* port_item = server_settings ? cJSON_GetObjectItem(server_settings, "stream_port") : NULL;
+    cJSON* token_item = server_settings ? cJSON_GetObjectItem(server_settings, "stream_token") : NULL;
+    int stream_port = (port_item && cJSON_IsNumber(port_item)) ? port_item->valueint : 0;
+    if (!Stream_Start(stream_port, cJSON_IsString(token_item) ? token_item->valuestring : NULL)) {
+        LOG_WARN("Failed to start stream listener on port %d\n", stream_port);
+    }
 
     // Initialize ACAP status
     update_acap_status();
 
+    schedule_summary();
+
     // Setup signal handlers
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
@@ -480,7 +1652,9 @@ int main(void) {
     // Cleanup
     LOG("Cleaning up...");
     g_main_loop_unref(main_loop);
+    Stream_Stop();
     Server_Cleanup();
+    Assets_Cleanup();
     ACAP_Cleanup();
 
     LOG("Server stopped");
@@ -0,0 +1,143 @@
+/**
+ * modelcache.c - Model Description Cache Implementation
+ *
+ * The cache is one JSON object of entries named "<hash>@<device>" ("*" for
+ * the preferred device), read and rewritten whole under a lock since loaders
+ * of several models may store at the same time.
+ */
+
+#include "modelcache.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include "ACAP.h"
+#include "cJSON.h"
+
+#define HASH_CHUNK_SIZE (64 * 1024)
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool ModelCache_HashFile(int fd, char hash[MODEL_HASH_SIZE]) {
+    uint8_t* chunk = malloc(HASH_CHUNK_SIZE);
+    if (!chunk) {
+        return false;
+    }
+    uint64_t h = 0xcbf29ce484222325ULL;
+    uint64_t size = 0;
+
+    ssize_t n;
+    while ((n = pread(fd, chunk, HASH_CHUNK_SIZE, (off_t)size)) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            h = (h ^ chunk[i]) * 0x100000001b3ULL;
+        }
+        size += (uint64_t)n;
+    }
+    free(chunk);
+    if (n < 0) {
+        return false;
+    }
+
+    snprintf(hash, MODEL_HASH_SIZE, "%016llx-%llx", (unsigned long long)h, (unsigned long long)size);
+    return size > 0;
+}
+
+static void entry_key(const char* hash, const char* device, char* key, size_t size) {
+    snprintf(key, size, "%s@%s", hash, device && device[0] ? device : "*");
+}
+
+static void copy_string(const cJSON* entry, const char* name, char* out, size_t size) {
+    const cJSON* item = cJSON_GetObjectItem(entry, name);
+    snprintf(out, size, "%s", cJSON_IsString(item) ? item->valuestring : "");
+}
+
+static int get_int(const cJSON* entry, const char* name) {
+    const cJSON* item = cJSON_GetObjectItem(entry, name);
+    return cJSON_IsNumber(item) ? item->valueint : 0;
+}
+
+bool ModelCache_Lookup(const char* hash, const char* device, ModelDescription* desc) {
+    char key[MODEL_HASH_SIZE + MODEL_DEVICE_NAME_SIZE + 2];
+    entry_key(hash, device, key, sizeof(key));
+
+    pthread_mutex_lock(&cache_lock);
+    cJSON* cache = ACAP_FILE_Read(MODEL_CACHE_FILE);
+    pthread_mutex_unlock(&cache_lock);
+
+    const cJSON* entry = cache ? cJSON_GetObjectItem(cache, key) : NULL;
+    const cJSON* scale = entry ? cJSON_GetObjectItem(entry, "quant_scale") : NULL;
+    bool found = cJSON_IsObject(entry) && get_int(entry, "width") > 0 &&
+                 get_int(entry, "height") > 0;
+    if (found) {
+        memset(desc, 0, sizeof(*desc));
+        copy_string(entry, "path", desc->path, sizeof(desc->path));
+        copy_string(entry, "device", desc->device, sizeof(desc->device));
+        desc->width = get_int(entry, "width");
+        desc->height = get_int(entry, "height");
+        desc->channels = get_int(entry, "channels");
+        desc->batch_size = get_int(entry, "batch_size");
+        desc->boxes = get_int(entry, "boxes");
+        desc->classes = get_int(entry, "classes");
+        desc->data_type = get_int(entry, "data_type");
+        desc->quant_scale = cJSON_IsNumber(scale) ? (float)scale->valuedouble : 1.0f;
+        desc->quant_zero_point = get_int(entry, "quant_zero_point");
+        const cJSON* load_ms = cJSON_GetObjectItem(entry, "load_ms");
+        desc->load_ms = cJSON_IsNumber(load_ms) ? load_ms->valuedouble : 0.0;
+    }
+    cJSON_Delete(cache);
+    return found;
+}
+
+void ModelCache_Store(const char* hash, const char* device, const ModelDescription* desc) {
+    char key[MODEL_HASH_SIZE + MODEL_DEVICE_NAME_SIZE + 2];
+    entry_key(hash, device, key, sizeof(key));
+
+    cJSON* entry = cJSON_CreateObject();
+    if (!entry) {
+        return;
+    }
+    cJSON_AddStringToObject(entry, "path", desc->path);
+    cJSON_AddStringToObject(entry, "device", desc->device);
+    cJSON_AddNumberToObject(entry, "width", desc->width);
+    cJSON_AddNumberToObject(entry, "height", desc->height);
+    cJSON_AddNumberToObject(entry, "channels", desc->channels);
+    cJSON_AddNumberToObject(entry, "batch_size", desc->batch_size);
+    cJSON_AddNumberToObject(entry, "boxes", desc->boxes);
+    cJSON_AddNumberToObject(entry, "classes", desc->classes);
+    cJSON_AddNumberToObject(entry, "data_type", desc->data_type);
+    cJSON_AddNumberToObject(entry, "quant_scale", desc->quant_scale);
+    cJSON_AddNumberToObject(entry, "quant_zero_point", desc->quant_zero_point);
+    cJSON_AddNumberToObject(entry, "load_ms", desc->load_ms);
+    cJSON_AddNumberToObject(entry, "stored", (double)time(NULL));
+
+    pthread_mutex_lock(&cache_lock);
+    cJSON* cache = ACAP_FILE_Read(MODEL_CACHE_FILE);
+    if (!cJSON_IsObject(cache)) {
+        cJSON_Delete(cache);
+        cache = cJSON_CreateObject();
+    }
+    cJSON_DeleteItemFromObject(cache, key);
+
+    // Make room by dropping the entry stored longest ago
+    while (cJSON_GetArraySize(cache) >= MODEL_CACHE_MAX_ENTRIES) {
+        cJSON* oldest = NULL;
+        cJSON* item;
+        cJSON_ArrayForEach(item, cache) {
+            if (!oldest || get_int(item, "stored") < get_int(oldest, "stored")) {
+                oldest = item;
+            }
+        }
+        cJSON_Delete(cJSON_DetachItemViaPointer(cache, oldest));
+    }
+
+    cJSON_AddItemToObject(cache, key, entry);
+    if (!ACAP_FILE_Write(MODEL_CACHE_FILE, cache)) {
+        syslog(LOG_WARNING, "Could not write %s", MODEL_CACHE_FILE);
+    }
+    pthread_mutex_unlock(&cache_lock);
+    cJSON_Delete(cache);
+}
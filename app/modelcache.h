@@ -0,0 +1,44 @@
+/**
+ * modelcache.h - Model Description Cache
+ *
+ * Loading a model tells what it looks like: the larod device picked, tensor
+ * dimensions and quantization. That is kept in a small sidecar file keyed by
+ * a hash of the model file and the device asked for, so after a restart the
+ * server describes its models at once (/capabilities answers while the DLPU
+ * still compiles) and the load opens the cached device directly instead of
+ * probing the device list. A replaced model file hashes differently and is
+ * probed again.
+ */
+
+#ifndef MODELCACHE_H
+#define MODELCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "Model.h"
+
+#define MODEL_CACHE_FILE "localdata/model_cache.json"
+#define MODEL_CACHE_MAX_ENTRIES 8
+#define MODEL_HASH_SIZE 40
+
+/**
+ * @brief Hash the contents of an open model file ("<fnv1a-64>-<size>" in hex)
+ *
+ * Reads with pread(), so the file offset is left alone.
+ *
+ * @return false if the file cannot be read
+ */
+bool ModelCache_HashFile(int fd, char hash[MODEL_HASH_SIZE]);
+
+/**
+ * @brief Description stored for hash when loaded on device (NULL: preferred)
+ * @return false if there is none
+ */
+bool ModelCache_Lookup(const char* hash, const char* device, ModelDescription* desc);
+
+/**
+ * @brief Store the description of a load, replacing the oldest entry when full
+ */
+void ModelCache_Store(const char* hash, const char* device, const ModelDescription* desc);
+
+#endif // MODELCACHE_H
@@ -30,6 +30,19 @@ struct PreprocessContext {
     /* Scale mode */
     PreprocessScaleMode scale_mode;
 
+    /* Part of the input that is scaled (all of it unless created for a region) */
+    unsigned int region_x;
+    unsigned int region_y;
+    unsigned int region_width;
+    unsigned int region_height;
+
+    /* image.input.crop relative to the region origin; crop_map is NULL when
+     * the whole input is used */
+    unsigned int crop_x;
+    unsigned int crop_y;
+    unsigned int crop_w;
+    unsigned int crop_h;
+
     /* Larod preprocessing model and tensors */
     larodModel* pp_model;
     larodTensor** pp_input_tensors;
@@ -46,8 +59,10 @@ struct PreprocessContext {
 
     /* Output buffer */
     int output_fd;
+    size_t output_offset;      /* Where output_addr lies within output_fd */
     void* output_addr;
     size_t output_size;
+    bool owns_output;          /* false when bound to a caller buffer */
 
     /* For letterbox: intermediate scaled buffer */
     int letterbox_fd;
@@ -67,6 +82,9 @@ struct PreprocessContext {
     float scale_y;
     float offset_x;
     float offset_y;
+
+    /* Consecutive LAROD_ERROR_POWER_NOT_AVAILABLE failures */
+    int power_retries;
 };
 
 /* Helper to get format string for larod */
@@ -234,6 +252,45 @@ PreprocessContext* preprocess_create(
     unsigned int output_height,
     VdoFormat output_format,
     PreprocessScaleMode scale_mode
+) {
+    return preprocess_create_with_output(conn, input_width, input_height, input_format,
+                                         output_width, output_height, output_format,
+                                         scale_mode, -1, 0, NULL);
+}
+
+PreprocessContext* preprocess_create_with_output(
+    larodConnection* conn,
+    unsigned int input_width,
+    unsigned int input_height,
+    VdoFormat input_format,
+    unsigned int output_width,
+    unsigned int output_height,
+    VdoFormat output_format,
+    PreprocessScaleMode scale_mode,
+    int output_fd,
+    size_t output_offset,
+    void* output_addr
+) {
+    return preprocess_create_region(conn, input_width, input_height, input_format,
+                                    input_width, input_height,
+                                    output_width, output_height, output_format,
+                                    scale_mode, output_fd, output_offset, output_addr);
+}
+
+PreprocessContext* preprocess_create_region(
+    larodConnection* conn,
+    unsigned int input_width,
+    unsigned int input_height,
+    VdoFormat input_format,
+    unsigned int region_width,
+    unsigned int region_height,
+    unsigned int output_width,
+    unsigned int output_height,
+    VdoFormat output_format,
+    PreprocessScaleMode scale_mode,
+    int output_fd,
+    size_t output_offset,
+    void* output_addr
 ) {
     larodError* error = NULL;
 
@@ -241,6 +298,13 @@ PreprocessContext* preprocess_create(
         syslog(LOG_ERR, "%s: NULL connection", __func__);
         return NULL;
     }
+    if (region_width == 0 || region_height == 0 ||
+        region_width > input_width || region_height > input_height) {
+        syslog(LOG_ERR, "%s: Invalid region %ux%u of %ux%u", __func__,
+               region_width, region_height, input_width, input_height);
+        return NULL;
+    }
+    bool whole_input = region_width == input_width && region_height == input_height;
 
     PreprocessContext* ctx = calloc(1, sizeof(PreprocessContext));
     if (!ctx) {
@@ -256,13 +320,17 @@ PreprocessContext* preprocess_create(
     ctx->output_height = output_height;
     ctx->output_format = output_format;
     ctx->scale_mode = scale_mode;
+    ctx->region_width = region_width;
+    ctx->region_height = region_height;
+    ctx->crop_w = region_width;
+    ctx->crop_h = region_height;
     ctx->input_fd = -1;
     ctx->output_fd = -1;
     ctx->letterbox_fd = -1;
 
     /* Default transform (stretch mode - no adjustment needed) */
-    ctx->scale_x = (float)input_width / (float)output_width;
-    ctx->scale_y = (float)input_height / (float)output_height;
+    ctx->scale_x = (float)region_width / (float)output_width;
+    ctx->scale_y = (float)region_height / (float)output_height;
     ctx->offset_x = 0.0f;
     ctx->offset_y = 0.0f;
 
@@ -270,63 +338,69 @@ PreprocessContext* preprocess_create(
     ctx->input_size = calculate_buffer_size(input_width, input_height, input_format);
     ctx->output_size = calculate_buffer_size(output_width, output_height, output_format);
 
-    /* Create output buffer */
-    if (!create_temp_buffer(ctx->output_size, &ctx->output_fd, &ctx->output_addr)) {
+    /* Create output buffer, unless the caller supplied one */
+    if (output_fd >= 0 && output_addr) {
+        ctx->output_fd = output_fd;
+        ctx->output_offset = output_offset;
+        ctx->output_addr = output_addr;
+        ctx->owns_output = false;
+    } else if (!create_temp_buffer(ctx->output_size, &ctx->output_fd, &ctx->output_addr)) {
         syslog(LOG_ERR, "%s: Failed to create output buffer", __func__);
         goto error;
+    } else {
+        ctx->owns_output = true;
     }
 
-    /* Mode-specific setup */
-    unsigned int crop_x = 0, crop_y = 0, crop_w = 0, crop_h = 0;
-
+    /* Mode-specific setup; a region is cropped by the job like the center crop */
     switch (scale_mode) {
         case SCALE_MODE_STRETCH:
-            /* Simple scaling - input directly to output */
+            /* Simple scaling - input (or region) directly to output */
             ctx->pp_model = create_pp_model(
                 conn,
                 input_width, input_height, input_format,
                 output_width, output_height, output_format,
-                NULL, 0, 0, 0, 0
+                whole_input ? NULL : &ctx->crop_map, 0, 0, ctx->crop_w, ctx->crop_h
             );
             break;
 
         case SCALE_MODE_CROP: {
             /* Calculate center crop region that matches output aspect ratio */
             float output_ratio = (float)output_width / (float)output_height;
-            float crop_w_f = (float)input_width;
+            float crop_w_f = (float)region_width;
             float crop_h_f = crop_w_f / output_ratio;
 
-            if (crop_h_f > (float)input_height) {
-                crop_h_f = (float)input_height;
+            if (crop_h_f > (float)region_height) {
+                crop_h_f = (float)region_height;
                 crop_w_f = crop_h_f * output_ratio;
             }
 
-            crop_w = (unsigned int)crop_w_f;
-            crop_h = (unsigned int)crop_h_f;
-            crop_x = (input_width - crop_w) / 2;
-            crop_y = (input_height - crop_h) / 2;
+            ctx->crop_w = (unsigned int)crop_w_f;
+            ctx->crop_h = (unsigned int)crop_h_f;
+            ctx->crop_x = (region_width - ctx->crop_w) / 2;
+            ctx->crop_y = (region_height - ctx->crop_h) / 2;
 
             /* Transform: model coords map to cropped region of input */
-            ctx->scale_x = (float)crop_w / (float)output_width;
-            ctx->scale_y = (float)crop_h / (float)output_height;
-            ctx->offset_x = (float)crop_x / (float)input_width;
-            ctx->offset_y = (float)crop_y / (float)input_height;
+            ctx->scale_x = (float)ctx->crop_w / (float)output_width;
+            ctx->scale_y = (float)ctx->crop_h / (float)output_height;
+            ctx->offset_x = (float)ctx->crop_x / (float)input_width;
+            ctx->offset_y = (float)ctx->crop_y / (float)input_height;
 
             syslog(LOG_INFO, "%s: Crop mode - region (%u,%u) %ux%u from %ux%u",
-                   __func__, crop_x, crop_y, crop_w, crop_h, input_width, input_height);
+                   __func__, ctx->crop_x, ctx->crop_y, ctx->crop_w, ctx->crop_h,
+                   region_width, region_height);
 
             ctx->pp_model = create_pp_model(
                 conn,
                 input_width, input_height, input_format,
                 output_width, output_height, output_format,
-                &ctx->crop_map, crop_x, crop_y, crop_w, crop_h
+                &ctx->crop_map, ctx->crop_x, ctx->crop_y, ctx->crop_w, ctx->crop_h
             );
             break;
         }
 
         case SCALE_MODE_LETTERBOX: {
             /* Calculate scaled dimensions preserving aspect ratio */
-            float input_ratio = (float)input_width / (float)input_height;
+            float input_ratio = (float)region_width / (float)region_height;
             float output_ratio = (float)output_width / (float)output_height;
 
             if (input_ratio > output_ratio) {
@@ -347,13 +421,13 @@ PreprocessContext* preprocess_create(
             unsigned int pad_y = (output_height - ctx->letterbox_height) / 2;
 
             /* Transform: model coords need to account for letterbox padding */
-            ctx->scale_x = (float)input_width / (float)ctx->letterbox_width;
-            ctx->scale_y = (float)input_height / (float)ctx->letterbox_height;
+            ctx->scale_x = (float)region_width / (float)ctx->letterbox_width;
+            ctx->scale_y = (float)region_height / (float)ctx->letterbox_height;
             ctx->offset_x = -(float)pad_x / (float)output_width;
             ctx->offset_y = -(float)pad_y / (float)output_height;
 
             syslog(LOG_INFO, "%s: Letterbox mode - scale %ux%u to %ux%u, pad (%u,%u)",
-                   __func__, input_width, input_height,
+                   __func__, region_width, region_height,
                    ctx->letterbox_width, ctx->letterbox_height, pad_x, pad_y);
 
             /* Create intermediate buffer for scaled image */
@@ -370,7 +444,7 @@ PreprocessContext* preprocess_create(
                 conn,
                 input_width, input_height, input_format,
                 ctx->letterbox_width, ctx->letterbox_height, output_format,
-                NULL, 0, 0, 0, 0
+                whole_input ? NULL : &ctx->crop_map, 0, 0, ctx->crop_w, ctx->crop_h
             );
 
             if (!ctx->letterbox_model) {
@@ -447,6 +521,11 @@ PreprocessContext* preprocess_create(
             syslog(LOG_ERR, "%s: Failed to set output fd: %s", __func__, error->msg);
             goto error;
         }
+        if (ctx->output_offset &&
+            !larodSetTensorFdOffset(ctx->pp_output_tensors[0], ctx->output_offset, &error)) {
+            syslog(LOG_ERR, "%s: Failed to set output offset: %s", __func__, error->msg);
+            goto error;
+        }
 
         /* Create job request */
         ctx->pp_request = larodCreateJobRequest(
@@ -494,7 +573,7 @@ PreprocessContext* preprocess_create(
             ctx->letterbox_model,
             ctx->letterbox_input_tensors, ctx->letterbox_num_inputs,
             ctx->letterbox_output_tensors, ctx->letterbox_num_outputs,
-            NULL,
+            ctx->crop_map,
             &error
         );
         if (!ctx->letterbox_request) {
@@ -503,9 +582,9 @@ PreprocessContext* preprocess_create(
         }
     }
 
-    syslog(LOG_INFO, "%s: Created preprocessing context, mode=%s, %ux%u -> %ux%u",
+    syslog(LOG_INFO, "%s: Created preprocessing context, mode=%s, %ux%u (region %ux%u) -> %ux%u",
            __func__, preprocess_mode_to_string(scale_mode),
-           input_width, input_height, output_width, output_height);
+           input_width, input_height, region_width, region_height, output_width, output_height);
 
     larodClearError(&error);
     return ctx;
@@ -522,11 +601,12 @@ bool preprocess_run(PreprocessContext* ctx, const void* input_data, size_t input
     }
 
     larodError* error = NULL;
-    static int power_retries = 0;
 
-    /* Copy input data to mapped buffer */
-    size_t copy_size = (input_size < ctx->input_size) ? input_size : ctx->input_size;
-    memcpy(ctx->input_addr, input_data, copy_size);
+    /* Copy input data to mapped buffer (producers may have written in place) */
+    if (input_data != ctx->input_addr) {
+        size_t copy_size = (input_size < ctx->input_size) ? input_size : ctx->input_size;
+        memcpy(ctx->input_addr, input_data, copy_size);
+    }
 
     if (ctx->scale_mode == SCALE_MODE_LETTERBOX) {
         /* Letterbox mode: scale to intermediate buffer, then copy centered */
@@ -535,65 +615,108 @@ bool preprocess_run(PreprocessContext* ctx, const void* input_data, size_t input
         if (!larodRunJob(ctx->conn, ctx->letterbox_request, &error)) {
             if (error->code == LAROD_ERROR_POWER_NOT_AVAILABLE) {
                 larodClearError(&error);
-                power_retries++;
-                if (power_retries > 50) {
+                ctx->power_retries++;
+                if (ctx->power_retries > 50) {
                     syslog(LOG_ERR, "%s: Power not available after %d retries",
-                           __func__, power_retries);
+                           __func__, ctx->power_retries);
                     return false;
                 }
-                usleep(250 * 1000 * power_retries);
+                usleep(250 * 1000 * ctx->power_retries);
                 return false;
             }
             syslog(LOG_ERR, "%s: Letterbox job failed: %s", __func__, error->msg);
             larodClearError(&error);
             return false;
         }
-        power_retries = 0;
-
-        /* Clear output buffer (black padding) */
-        memset(ctx->output_addr, 0, ctx->output_size);
+        ctx->power_retries = 0;
 
         /* Calculate padding offsets */
         unsigned int pad_x = (ctx->output_width - ctx->letterbox_width) / 2;
         unsigned int pad_y = (ctx->output_height - ctx->letterbox_height) / 2;
+        unsigned int pad_right = ctx->output_width - ctx->letterbox_width - pad_x;
+        unsigned int pad_bottom = ctx->output_height - ctx->letterbox_height - pad_y;
 
-        /* Copy scaled image to center of output buffer */
+        /* Copy scaled image to center of output buffer; only padding is cleared */
         size_t bpp = get_bytes_per_pixel(ctx->output_format);
         size_t src_stride = ctx->letterbox_width * bpp;
         size_t dst_stride = ctx->output_width * bpp;
 
         uint8_t* src = (uint8_t*)ctx->letterbox_addr;
-        uint8_t* dst = (uint8_t*)ctx->output_addr + (pad_y * dst_stride) + (pad_x * bpp);
+        uint8_t* row = (uint8_t*)ctx->output_addr;
 
+        memset(row, 0, pad_y * dst_stride);
+        row += pad_y * dst_stride;
         for (unsigned int y = 0; y < ctx->letterbox_height; y++) {
-            memcpy(dst, src, src_stride);
+            memset(row, 0, pad_x * bpp);
+            memcpy(row + pad_x * bpp, src, src_stride);
+            memset(row + pad_x * bpp + src_stride, 0, pad_right * bpp);
             src += src_stride;
-            dst += dst_stride;
+            row += dst_stride;
         }
+        memset(row, 0, pad_bottom * dst_stride);
     } else {
         /* Stretch or Crop mode: run single preprocessing job */
         if (!larodRunJob(ctx->conn, ctx->pp_request, &error)) {
             if (error->code == LAROD_ERROR_POWER_NOT_AVAILABLE) {
                 larodClearError(&error);
-                power_retries++;
-                if (power_retries > 50) {
+                ctx->power_retries++;
+                if (ctx->power_retries > 50) {
                     syslog(LOG_ERR, "%s: Power not available after %d retries",
-                           __func__, power_retries);
+                           __func__, ctx->power_retries);
                     return false;
                 }
-                usleep(250 * 1000 * power_retries);
+                usleep(250 * 1000 * ctx->power_retries);
                 return false;
             }
             syslog(LOG_ERR, "%s: Preprocessing job failed: %s", __func__, error->msg);
             larodClearError(&error);
             return false;
         }
-        power_retries = 0;
+        ctx->power_retries = 0;
     }
 
     return true;
 }
 
+bool preprocess_set_region(PreprocessContext* ctx, unsigned int x, unsigned int y) {
+    if (!ctx || x > ctx->input_width - ctx->region_width ||
+        y > ctx->input_height - ctx->region_height) {
+        return false;
+    }
+    if (x == ctx->region_x && y == ctx->region_y) {
+        return true;
+    }
+    if (!ctx->crop_map) {
+        /* Created for the whole input, which has only one position */
+        return false;
+    }
+
+    larodError* error = NULL;
+    larodJobRequest* request = ctx->scale_mode == SCALE_MODE_LETTERBOX
+        ? ctx->letterbox_request : ctx->pp_request;
+    if (!larodMapSetIntArr4(ctx->crop_map, "image.input.crop",
+                            x + ctx->crop_x, y + ctx->crop_y, ctx->crop_w, ctx->crop_h, &error) ||
+        !larodSetJobRequestParams(request, ctx->crop_map, &error)) {
+        syslog(LOG_ERR, "%s: Failed to move crop to (%u,%u): %s", __func__, x, y,
+               error ? error->msg : "unknown error");
+        larodClearError(&error);
+        return false;
+    }
+
+    ctx->region_x = x;
+    ctx->region_y = y;
+    if (ctx->scale_mode == SCALE_MODE_CROP) {
+        ctx->offset_x = (float)(x + ctx->crop_x) / (float)ctx->input_width;
+        ctx->offset_y = (float)(y + ctx->crop_y) / (float)ctx->input_height;
+    }
+    return true;
+}
+
+void* preprocess_get_input(PreprocessContext* ctx, size_t* size) {
+    if (size) *size = ctx ? ctx->input_size : 0;
+    return ctx ? ctx->input_addr : NULL;
+}
+
 void* preprocess_get_output(PreprocessContext* ctx) {
     return ctx ? ctx->output_addr : NULL;
 }
@@ -627,6 +750,47 @@ void preprocess_get_transform(
     if (offset_y) *offset_y = ctx->offset_y;
 }
 
+void preprocess_get_mapping(
+    PreprocessContext* ctx,
+    float* scale_x,
+    float* scale_y,
+    float* offset_x,
+    float* offset_y
+) {
+    float sx = 1.0f, sy = 1.0f, ox = 0.0f, oy = 0.0f;
+
+    if (ctx) {
+        switch (ctx->scale_mode) {
+            case SCALE_MODE_STRETCH:
+                sx = (float)ctx->output_width / ctx->region_width;
+                sy = (float)ctx->output_height / ctx->region_height;
+                ox = -(float)ctx->region_x * sx;
+                oy = -(float)ctx->region_y * sy;
+                break;
+
+            case SCALE_MODE_CROP:
+                /* scale_x/y are crop pixels per output pixel, offsets the normalized crop origin */
+                sx = 1.0f / ctx->scale_x;
+                sy = 1.0f / ctx->scale_y;
+                ox = -ctx->offset_x * ctx->input_width * sx;
+                oy = -ctx->offset_y * ctx->input_height * sy;
+                break;
+
+            case SCALE_MODE_LETTERBOX:
+                sx = (float)ctx->letterbox_width / ctx->region_width;
+                sy = (float)ctx->letterbox_height / ctx->region_height;
+                ox = (float)((ctx->output_width - ctx->letterbox_width) / 2) - ctx->region_x * sx;
+                oy = (float)((ctx->output_height - ctx->letterbox_height) / 2) - ctx->region_y * sy;
+                break;
+        }
+    }
+
+    if (scale_x) *scale_x = sx;
+    if (scale_y) *scale_y = sy;
+    if (offset_x) *offset_x = ox;
+    if (offset_y) *offset_y = oy;
+}
+
 bool preprocess_transform_detection(
     PreprocessContext* ctx,
     float* x,
@@ -779,7 +943,7 @@ void preprocess_destroy(PreprocessContext* ctx) {
     if (ctx->input_addr && ctx->input_addr != MAP_FAILED) {
         munmap(ctx->input_addr, ctx->input_size);
     }
-    if (ctx->output_addr && ctx->output_addr != MAP_FAILED) {
+    if (ctx->owns_output && ctx->output_addr && ctx->output_addr != MAP_FAILED) {
         munmap(ctx->output_addr, ctx->output_size);
     }
     if (ctx->letterbox_addr && ctx->letterbox_addr != MAP_FAILED) {
@@ -787,7 +951,7 @@ void preprocess_destroy(PreprocessContext* ctx) {
     }
 
     /* Close file descriptors - but NOT input_fd as it's owned by larod tensor */
-    if (ctx->output_fd >= 0) {
+    if (ctx->owns_output && ctx->output_fd >= 0) {
         close(ctx->output_fd);
     }
     if (ctx->letterbox_fd >= 0) {
@@ -50,16 +50,88 @@ PreprocessContext* preprocess_create(
     PreprocessScaleMode scale_mode
 );
 
+/**
+ * @brief Create a preprocessing context that writes into a caller-owned buffer
+ *
+ * Same as preprocess_create(), but the result lands in output_fd/output_addr
+ * (e.g. a model input tensor) instead of a private buffer, so no copy is
+ * needed between preprocessing and inference. The buffer must hold at least
+ * output_width * output_height of output_format and outlive the context.
+ *
+ * @param output_fd      File descriptor bound as the larod output tensor
+ * @param output_offset  Byte offset of the output within output_fd (e.g. a batch item)
+ * @param output_addr    Mapping of output_fd at output_offset
+ * @return Context pointer on success, NULL on failure
+ */
+PreprocessContext* preprocess_create_with_output(
+    larodConnection* conn,
+    unsigned int input_width,
+    unsigned int input_height,
+    VdoFormat input_format,
+    unsigned int output_width,
+    unsigned int output_height,
+    VdoFormat output_format,
+    PreprocessScaleMode scale_mode,
+    int output_fd,
+    size_t output_offset,
+    void* output_addr
+);
+
+/**
+ * @brief Create a context that scales a region_width x region_height part of its input
+ *
+ * Same as preprocess_create_with_output(), but scale_mode treats the region as
+ * if it were the whole frame. The job crops it with image.input.crop, so a
+ * region costs no copy. The region starts at the origin; move it between runs
+ * with preprocess_set_region(), e.g. once per tile of a grid.
+ *
+ * @param region_width   Width of the part of each input frame that is scaled
+ * @param region_height  Height of that part
+ * @return Context pointer on success, NULL on failure
+ */
+PreprocessContext* preprocess_create_region(
+    larodConnection* conn,
+    unsigned int input_width,
+    unsigned int input_height,
+    VdoFormat input_format,
+    unsigned int region_width,
+    unsigned int region_height,
+    unsigned int output_width,
+    unsigned int output_height,
+    VdoFormat output_format,
+    PreprocessScaleMode scale_mode,
+    int output_fd,
+    size_t output_offset,
+    void* output_addr
+);
+
+/**
+ * @brief Move the region of a context to x, y for the following runs
+ *
+ * @param ctx   Context from preprocess_create_region()
+ * @return false if the region would leave the input or the job rejects the crop
+ */
+bool preprocess_set_region(PreprocessContext* ctx, unsigned int x, unsigned int y);
+
 /**
  * @brief Run preprocessing on an input buffer
  *
  * @param ctx           Preprocessing context
- * @param input_data    Pointer to input image data
+ * @param input_data    Pointer to input image data (not copied if it is preprocess_get_input())
  * @param input_size    Size of input data in bytes
  * @return true on success, false on failure (check errno/syslog)
  */
 bool preprocess_run(PreprocessContext* ctx, const void* input_data, size_t input_size);
 
+/**
+ * @brief Get the mapped larod input buffer, for producers that can write in place
+ *
+ * @param ctx   Preprocessing context
+ * @param size  Output: buffer size in bytes (can be NULL)
+ * @return Pointer to input buffer
+ */
+void* preprocess_get_input(PreprocessContext* ctx, size_t* size);
+
 /**
  * @brief Get pointer to preprocessed output data
  *
@@ -104,6 +176,27 @@ void preprocess_get_transform(
     float* offset_y
 );
 
+/**
+ * @brief Get the pixel mapping from input frame to output (model) coordinates
+ *
+ * output_px = input_px * scale + offset, per axis. Offsets are negative when
+ * the input is cropped (including to a region) and equal the padding in
+ * letterbox mode.
+ *
+ * @param ctx       Preprocessing context
+ * @param scale_x   Output: output pixels per input pixel (X)
+ * @param scale_y   Output: output pixels per input pixel (Y)
+ * @param offset_x  Output: X offset in output pixels
+ * @param offset_y  Output: Y offset in output pixels
+ */
+void preprocess_get_mapping(
+    PreprocessContext* ctx,
+    float* scale_x,
+    float* scale_y,
+    float* offset_x,
+    float* offset_y
+);
+
 /**
  * @brief Transform detection coordinates from model space to input image space
  *
@@ -116,7 +209,8 @@ void preprocess_get_transform(
  * - LETTERBOX: Removes padding offset and scales to content region
  *
  * For LETTERBOX mode, detections with centers in the padding region are
- * considered invalid and the function returns false.
+ * considered invalid and the function returns false. Contexts created for a
+ * region use preprocess_get_mapping() instead.
  *
  * @param ctx   Preprocessing context
  * @param x     Detection X (0-1 normalized), modified in place
@@ -0,0 +1,361 @@
+/**
+ * resize.c - RGB Resize Kernels Implementation
+ *
+ * Separable filter: each needed source row is filtered horizontally into a
+ * small ring of 16-bit rows, and output rows are blended vertically from the
+ * ring as soon as all their taps have arrived. Weights are Q14 fixed point.
+ */
+
+#include "resize.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#define WEIGHT_BITS 14
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+#define MAX_TAPS 64             // Area filter down to 1/63 scale; larger ratios are truncated
+
+// Horizontal results keep 7 fraction bits (255 << 7 fits in 16 bits); the
+// vertical blend then drops 16 + 5 bits, rounding at both steps (as NEON does)
+#define H_SHIFT 7
+
+// Source taps for every output index along one axis
+typedef struct {
+    int taps;
+    int* start;         // First source index, clamped so start + taps <= size
+    int16_t* weights;   // taps weights per output index, summing to WEIGHT_ONE
+} ResizeAxis;
+
+struct Resizer {
+    ResizeFilter filter;
+    int in_w;
+    int in_h;
+    int out_w;
+    int out_h;
+    ResizeAxis x;
+    ResizeAxis y;
+    int* x_offset;      // Nearest: byte offset of the sampled source pixel
+    uint16_t* ring;     // y.taps horizontally filtered rows
+    int next_out;       // Next output row to write
+};
+
+static int clamp_index(int i, int size) {
+    if (i < 0) return 0;
+    if (i >= size) return size - 1;
+    return i;
+}
+
+// Quantize one output's float weights so they sum exactly to WEIGHT_ONE
+static void quantize_weights(const float* w, int taps, int16_t* out) {
+    int sum = 0;
+    int largest = 0;
+    for (int k = 0; k < taps; k++) {
+        out[k] = (int16_t)lroundf(w[k] * WEIGHT_ONE);
+        sum += out[k];
+        if (out[k] > out[largest]) largest = k;
+    }
+    out[largest] += WEIGHT_ONE - sum;
+}
+
+static bool axis_init(ResizeAxis* axis, ResizeFilter filter, int size, int out,
+                      float src, float step) {
+    // Area only differs from bilinear when several source pixels fall in one output pixel
+    bool area = filter == RESIZE_AREA && step > 1.0f;
+    int taps = filter == RESIZE_NEAREST ? 1 : area ? (int)ceilf(step) + 1 : 2;
+    if (taps > MAX_TAPS) taps = MAX_TAPS;
+    if (taps > size) taps = size;
+
+    axis->taps = taps;
+    axis->start = malloc(out * sizeof(int));
+    axis->weights = malloc((size_t)out * taps * sizeof(int16_t));
+    if (!axis->start || !axis->weights) {
+        return false;
+    }
+
+    float w[MAX_TAPS];
+    for (int i = 0; i < out; i++) {
+        int16_t* weights = axis->weights + (size_t)i * taps;
+
+        if (filter == RESIZE_NEAREST) {
+            axis->start[i] = clamp_index((int)(src + (i + 0.5f) * step), size);
+            weights[0] = WEIGHT_ONE;
+            continue;
+        }
+
+        // Raw taps (before clamping) with their weights
+        int first;
+        int count;
+        float raw[MAX_TAPS + 1];
+        if (area) {
+            float a = src + i * step;
+            float b = a + step;
+            first = (int)floorf(a);
+            count = (int)ceilf(b) - first;
+            if (count > MAX_TAPS) count = MAX_TAPS;
+            for (int k = 0; k < count; k++) {
+                float lo = fmaxf(a, (float)(first + k));
+                float hi = fminf(b, (float)(first + k + 1));
+                raw[k] = hi > lo ? (hi - lo) / step : 0.0f;
+            }
+        } else {
+            float c = src + (i + 0.5f) * step - 0.5f;
+            first = (int)floorf(c);
+            float f = c - first;
+            count = 2;
+            raw[0] = 1.0f - f;
+            raw[1] = f;
+        }
+
+        // Fold taps outside the image onto the edge pixels
+        int start = clamp_index(first, size);
+        if (start > size - taps) start = size - taps;
+        memset(w, 0, sizeof(w));
+        for (int k = 0; k < count; k++) {
+            int idx = clamp_index(first + k, size) - start;
+            if (idx < 0) idx = 0;
+            if (idx >= taps) idx = taps - 1;
+            w[idx] += raw[k];
+        }
+
+        // Renormalize (area weights lose a little when the count was capped)
+        float total = 0.0f;
+        for (int k = 0; k < taps; k++) total += w[k];
+        if (total <= 0.0f) {
+            w[0] = 1.0f;
+            total = 1.0f;
+        }
+        for (int k = 0; k < taps; k++) w[k] /= total;
+
+        axis->start[i] = start;
+        quantize_weights(w, taps, weights);
+    }
+    return true;
+}
+
+Resizer* RESIZE_Create(ResizeFilter filter, int in_w, int in_h, int out_w, int out_h,
+                       float src_x, float src_y, float step_x, float step_y) {
+    if (in_w <= 0 || in_h <= 0 || out_w <= 0 || out_h <= 0) {
+        return NULL;
+    }
+    if (filter < 0 || filter >= RESIZE_FILTER_COUNT) {
+        filter = RESIZE_BILINEAR;
+    }
+
+    Resizer* r = calloc(1, sizeof(Resizer));
+    if (!r) {
+        return NULL;
+    }
+    r->filter = filter;
+    r->in_w = in_w;
+    r->in_h = in_h;
+    r->out_w = out_w;
+    r->out_h = out_h;
+
+    if (!axis_init(&r->x, filter, in_w, out_w, src_x, step_x) ||
+        !axis_init(&r->y, filter, in_h, out_h, src_y, step_y)) {
+        RESIZE_Destroy(r);
+        return NULL;
+    }
+
+    if (filter == RESIZE_NEAREST) {
+        r->x_offset = malloc(out_w * sizeof(int));
+        if (!r->x_offset) {
+            RESIZE_Destroy(r);
+            return NULL;
+        }
+        for (int x = 0; x < out_w; x++) {
+            r->x_offset[x] = r->x.start[x] * 3;
+        }
+    } else {
+        r->ring = calloc((size_t)r->y.taps * out_w * 3, sizeof(uint16_t));
+        if (!r->ring) {
+            RESIZE_Destroy(r);
+            return NULL;
+        }
+    }
+    return r;
+}
+
+void RESIZE_Destroy(Resizer* resizer) {
+    if (!resizer) {
+        return;
+    }
+    free(resizer->x.start);
+    free(resizer->x.weights);
+    free(resizer->y.start);
+    free(resizer->y.weights);
+    free(resizer->x_offset);
+    free(resizer->ring);
+    free(resizer);
+}
+
+static void nearest_row(const Resizer* r, const uint8_t* src_row, uint8_t* dst) {
+    const int* offset = r->x_offset;
+    for (int x = 0; x < r->out_w; x++) {
+        const uint8_t* s = src_row + offset[x];
+        dst[0] = s[0];
+        dst[1] = s[1];
+        dst[2] = s[2];
+        dst += 3;
+    }
+}
+
+static void horizontal_row(const Resizer* r, const uint8_t* src_row, uint16_t* dst) {
+    const int taps = r->x.taps;
+    const int* start = r->x.start;
+    const int16_t* weights = r->x.weights;
+    const int round = 1 << (H_SHIFT - 1);
+
+    if (taps == 2) {
+        for (int x = 0; x < r->out_w; x++) {
+            const uint8_t* s = src_row + start[x] * 3;
+            int w0 = weights[0];
+            int w1 = weights[1];
+            dst[0] = (uint16_t)((s[0] * w0 + s[3] * w1 + round) >> H_SHIFT);
+            dst[1] = (uint16_t)((s[1] * w0 + s[4] * w1 + round) >> H_SHIFT);
+            dst[2] = (uint16_t)((s[2] * w0 + s[5] * w1 + round) >> H_SHIFT);
+            weights += 2;
+            dst += 3;
+        }
+        return;
+    }
+
+    for (int x = 0; x < r->out_w; x++) {
+        const uint8_t* s = src_row + start[x] * 3;
+        int r0 = round, g0 = round, b0 = round;
+        for (int k = 0; k < taps; k++) {
+            int w = weights[k];
+            r0 += s[0] * w;
+            g0 += s[1] * w;
+            b0 += s[2] * w;
+            s += 3;
+        }
+        dst[0] = (uint16_t)(r0 >> H_SHIFT);
+        dst[1] = (uint16_t)(g0 >> H_SHIFT);
+        dst[2] = (uint16_t)(b0 >> H_SHIFT);
+        weights += taps;
+        dst += 3;
+    }
+}
+
+// Blend the ring rows for output row n into dst
+static void vertical_row(const Resizer* r, int n, uint8_t* dst) {
+    const int taps = r->y.taps;
+    const int16_t* weights = r->y.weights + (size_t)n * taps;
+    const int len = r->out_w * 3;
+    const uint16_t* rows[MAX_TAPS];
+    for (int k = 0; k < taps; k++) {
+        rows[k] = r->ring + (size_t)((r->y.start[n] + k) % taps) * len;
+    }
+
+    int i = 0;
+#ifdef __ARM_NEON
+    for (; i + 8 <= len; i += 8) {
+        uint16x8_t v = vld1q_u16(rows[0] + i);
+        uint32x4_t lo = vmull_n_u16(vget_low_u16(v), (uint16_t)weights[0]);
+        uint32x4_t hi = vmull_n_u16(vget_high_u16(v), (uint16_t)weights[0]);
+        for (int k = 1; k < taps; k++) {
+            v = vld1q_u16(rows[k] + i);
+            lo = vmlal_n_u16(lo, vget_low_u16(v), (uint16_t)weights[k]);
+            hi = vmlal_n_u16(hi, vget_high_u16(v), (uint16_t)weights[k]);
+        }
+        uint16x8_t sum = vcombine_u16(vqrshrn_n_u32(lo, 16), vqrshrn_n_u32(hi, 16));
+        vst1_u8(dst + i, vqrshrn_n_u16(sum, WEIGHT_BITS + H_SHIFT - 16));
+    }
+#endif
+    if (taps == 2) {
+        const uint16_t* r0 = rows[0];
+        const uint16_t* r1 = rows[1];
+        const uint32_t w0 = (uint16_t)weights[0];
+        const uint32_t w1 = (uint16_t)weights[1];
+        for (; i < len; i++) {
+            uint32_t acc = r0[i] * w0 + r1[i] * w1;
+            uint32_t v = (((acc + (1u << 15)) >> 16) + (1u << 4)) >> (WEIGHT_BITS + H_SHIFT - 16);
+            dst[i] = v > 255 ? 255 : (uint8_t)v;
+        }
+        return;
+    }
+    for (; i < len; i++) {
+        uint32_t acc = 0;
+        for (int k = 0; k < taps; k++) {
+            acc += (uint32_t)rows[k][i] * (uint16_t)weights[k];
+        }
+        uint32_t v = (((acc + (1u << 15)) >> 16) + (1u << 4)) >> (WEIGHT_BITS + H_SHIFT - 16);
+        dst[i] = v > 255 ? 255 : (uint8_t)v;
+    }
+}
+
+bool RESIZE_PushRow(Resizer* r, const uint8_t* src_row, int y,
+                    uint8_t* out, size_t out_stride) {
+    if (r->next_out >= r->out_h) {
+        return true;
+    }
+
+    if (r->filter == RESIZE_NEAREST) {
+        // Rows sampling the same source row are copies of the first
+        uint8_t* first = NULL;
+        while (r->next_out < r->out_h && r->y.start[r->next_out] == y) {
+            uint8_t* dst = out + (size_t)r->next_out * out_stride;
+            if (first) {
+                memcpy(dst, first, (size_t)r->out_w * 3);
+            } else {
+                nearest_row(r, src_row, dst);
+                first = dst;
+            }
+            r->next_out++;
+        }
+        return r->next_out >= r->out_h;
+    }
+
+    // Rows above the next output row's first tap are not needed any more
+    if (y < r->y.start[r->next_out]) {
+        return false;
+    }
+
+    uint16_t* slot = r->ring + (size_t)(y % r->y.taps) * r->out_w * 3;
+    horizontal_row(r, src_row, slot);
+
+    while (r->next_out < r->out_h && r->y.start[r->next_out] + r->y.taps - 1 <= y) {
+        vertical_row(r, r->next_out, out + (size_t)r->next_out * out_stride);
+        r->next_out++;
+    }
+    return r->next_out >= r->out_h;
+}
+
+void RESIZE_Frame(Resizer* r, const uint8_t* src, size_t src_stride,
+                  uint8_t* out, size_t out_stride) {
+    r->next_out = 0;
+    int first = r->y.start[0];
+    int last = r->y.start[r->out_h - 1] + r->y.taps - 1;
+    for (int y = first; y <= last; y++) {
+        if (RESIZE_PushRow(r, src + (size_t)y * src_stride, y, out, out_stride)) {
+            break;
+        }
+    }
+}
+
+ResizeFilter RESIZE_FilterFromString(const char* name, ResizeFilter fallback) {
+    if (!name) {
+        return fallback;
+    }
+    for (int i = 0; i < RESIZE_FILTER_COUNT; i++) {
+        if (strcasecmp(name, RESIZE_FilterName((ResizeFilter)i)) == 0) {
+            return (ResizeFilter)i;
+        }
+    }
+    return fallback;
+}
+
+const char* RESIZE_FilterName(ResizeFilter filter) {
+    switch (filter) {
+        case RESIZE_NEAREST:  return "nearest";
+        case RESIZE_BILINEAR: return "bilinear";
+        case RESIZE_AREA:     return "area";
+        default:              return "unknown";
+    }
+}
@@ -0,0 +1,73 @@
+/**
+ * resize.h - RGB Resize Kernels
+ *
+ * Fixed-point separable resize of interleaved RGB for the CPU preprocessing
+ * path. Rows can be pushed one at a time, so it also works on scanlines
+ * straight out of the JPEG decoder.
+ */
+
+#ifndef RESIZE_H
+#define RESIZE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef enum {
+    RESIZE_NEAREST = 0,     // Pixel-center sampling, no filtering
+    RESIZE_BILINEAR,        // 2x2 taps
+    RESIZE_AREA,            // Box filter over the covered source pixels (bilinear when upscaling)
+    RESIZE_FILTER_COUNT
+} ResizeFilter;
+
+// Index/weight tables for one output rectangle. Not thread-safe.
+typedef struct Resizer Resizer;
+
+/**
+ * @brief Precompute tables mapping an out_w x out_h area onto an in_w x in_h image
+ *
+ * Output pixel (x, y) covers source [src_x + x * step_x, src_x + (x + 1) * step_x)
+ * horizontally (same for y); source pixels outside the image are clamped.
+ *
+ * @param src_x  Source position of the output area's left edge, in source pixels
+ * @param step_x  Source pixels per output pixel
+ * @return Resizer, or NULL on allocation failure
+ */
+Resizer* RESIZE_Create(ResizeFilter filter, int in_w, int in_h, int out_w, int out_h,
+                       float src_x, float src_y, float step_x, float step_y);
+
+/**
+ * @brief Free a resizer (NULL is ignored)
+ */
+void RESIZE_Destroy(Resizer* resizer);
+
+/**
+ * @brief Feed source row y; writes every output row that becomes complete
+ *
+ * Rows must arrive in increasing order; rows the output never samples may be
+ * skipped. Output row n is written to out + n * out_stride (out_w * 3 bytes).
+ *
+ * @return true once the last output row has been written
+ */
+bool RESIZE_PushRow(Resizer* resizer, const uint8_t* src_row, int y,
+                    uint8_t* out, size_t out_stride);
+
+/**
+ * @brief Resize a whole frame (only the sampled rows are read)
+ */
+void RESIZE_Frame(Resizer* resizer, const uint8_t* src, size_t src_stride,
+                  uint8_t* out, size_t out_stride);
+
+/**
+ * @brief Parse a filter name ("nearest", "bilinear", "area")
+ *
+ * @param fallback  Returned for NULL or unknown names
+ */
+ResizeFilter RESIZE_FilterFromString(const char* name, ResizeFilter fallback);
+
+/**
+ * @brief Filter name for logs and /health
+ */
+const char* RESIZE_FilterName(ResizeFilter filter);
+
+#endif // RESIZE_H
@@ -4,161 +4,1562 @@
 
 #include "server.h"
 #include "Model.h"
+#include "latency.h"
+#include "applog.h"
+#include "ACAP.h"
 #include "cJSON.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
+#include <math.h>
+#include <ctype.h>
 #include <unistd.h>
+#include <sched.h>
 #include <syslog.h>
 #include <sys/time.h>
 
 static ServerState g_server = {0};
 
-// Inference worker thread
+//-----------------------------------------------------------------------------
+// Request arenas
+//-----------------------------------------------------------------------------
+
+#define ARENA_ALIGN 16
+
+struct RequestArenaBlock {
+    struct RequestArenaBlock* next;
+    _Alignas(ARENA_ALIGN) uint8_t data[];
+};
+
+static void* arena_alloc(RequestArena* a, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (a->base && a->size - a->used >= size) {
+        void* p = a->base + a->used;
+        a->used += size;
+        return p;
+    }
+
+    // Out of room: a separate block until the next reset
+    struct RequestArenaBlock* block = malloc(sizeof(*block) + size);
+    if (!block) {
+        return NULL;
+    }
+    block->next = a->overflow;
+    a->overflow = block;
+    a->overflow_bytes += size;
+    return block->data;
+}
+
+static void arena_free_overflow(RequestArena* a) {
+    while (a->overflow) {
+        struct RequestArenaBlock* next = a->overflow->next;
+        free(a->overflow);
+        a->overflow = next;
+    }
+    a->overflow_bytes = 0;
+}
+
+// Forget every allocation; a base block that overflowed grows to the size used
+static void arena_reset(RequestArena* a) {
+    size_t wanted = a->size + a->overflow_bytes;
+    if (a->overflow && wanted <= REQUEST_ARENA_MAX) {
+        uint8_t* base = malloc(wanted);
+        if (base) {
+            free(a->base);
+            a->base = base;
+            a->size = wanted;
+        }
+    }
+    arena_free_overflow(a);
+    a->used = 0;
+}
+
+static void arena_destroy(RequestArena* a) {
+    arena_free_overflow(a);
+    free(a->base);
+    a->base = NULL;
+    a->size = 0;
+    a->used = 0;
+}
+
+// Items of a batch allocate from the batch, which outlives them
+static RequestArena* request_arena(InferenceRequest* req) {
+    return req->batch ? &req->batch->arena : &req->arena;
+}
+
+//-----------------------------------------------------------------------------
+// Request pool
+//-----------------------------------------------------------------------------
+
+static bool pool_init(int size) {
+    g_server.pool = calloc(size, sizeof(InferenceRequest));
+    g_server.pool_free = calloc(size, sizeof(InferenceRequest*));
+    if (!g_server.pool || !g_server.pool_free) {
+        free(g_server.pool);
+        free(g_server.pool_free);
+        g_server.pool = NULL;
+        g_server.pool_free = NULL;
+        return false;
+    }
+
+    for (int i = 0; i < size; i++) {
+        InferenceRequest* req = &g_server.pool[i];
+        pthread_mutex_init(&req->lock, NULL);
+        pthread_cond_init(&req->done, NULL);
+        req->arena.base = malloc(REQUEST_ARENA_SIZE);
+        req->arena.size = req->arena.base ? REQUEST_ARENA_SIZE : 0;
+        req->pooled = true;
+        g_server.pool_free[i] = req;
+    }
+    g_server.pool_size = size;
+    g_server.pool_free_count = size;
+    pthread_mutex_init(&g_server.pool_lock, NULL);
+    return true;
+}
+
+// Requests still out (HTTP threads answering after shutdown) keep the pool alive
+static void pool_destroy(void) {
+    pthread_mutex_lock(&g_server.pool_lock);
+    int in_use = g_server.pool_size - g_server.pool_free_count;
+    pthread_mutex_unlock(&g_server.pool_lock);
+    if (in_use > 0) {
+        syslog(LOG_WARNING, "%d pooled requests still in use, keeping the pool", in_use);
+        return;
+    }
+
+    for (int i = 0; i < g_server.pool_size; i++) {
+        InferenceRequest* req = &g_server.pool[i];
+        arena_destroy(&req->arena);
+        pthread_mutex_destroy(&req->lock);
+        pthread_cond_destroy(&req->done);
+    }
+    free(g_server.pool);
+    free(g_server.pool_free);
+    g_server.pool = NULL;
+    g_server.pool_free = NULL;
+    g_server.pool_size = 0;
+    g_server.pool_free_count = 0;
+    pthread_mutex_destroy(&g_server.pool_lock);
+}
+
+// A cleared request from the pool, or from the heap once the pool is empty
+static InferenceRequest* request_take(void) {
+    InferenceRequest* req = NULL;
+    pthread_mutex_lock(&g_server.pool_lock);
+    if (g_server.pool_free_count > 0) {
+        req = g_server.pool_free[--g_server.pool_free_count];
+    } else {
+        g_server.pool_overflow++;
+    }
+    pthread_mutex_unlock(&g_server.pool_lock);
+
+    if (req) {
+        memset(req, 0, offsetof(InferenceRequest, lock));
+    } else {
+        req = calloc(1, sizeof(InferenceRequest));
+        if (!req) {
+            return NULL;
+        }
+        pthread_mutex_init(&req->lock, NULL);
+        pthread_cond_init(&req->done, NULL);
+    }
+    req->slot = -1;
+    return req;
+}
+
+static void request_return(InferenceRequest* req) {
+    if (!req->pooled) {
+        arena_destroy(&req->arena);
+        pthread_mutex_destroy(&req->lock);
+        pthread_cond_destroy(&req->done);
+        free(req);
+        return;
+    }
+
+    arena_reset(&req->arena);
+    pthread_mutex_lock(&g_server.pool_lock);
+    g_server.pool_free[g_server.pool_free_count++] = req;
+    pthread_mutex_unlock(&g_server.pool_lock);
+}
+
+//-----------------------------------------------------------------------------
+// Stage queues
+//-----------------------------------------------------------------------------
+
+static bool queue_init(RequestQueue* q, int capacity) {
+    q->requests = calloc(capacity, sizeof(InferenceRequest*));
+    if (!q->requests) {
+        return false;
+    }
+    q->capacity = capacity;
+    q->head = 0;
+    q->tail = 0;
+    q->count = 0;
+    q->closed = false;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return true;
+}
+
+static void queue_destroy(RequestQueue* q) {
+    free(q->requests);
+    q->requests = NULL;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+}
+
+static void queue_close(RequestQueue* q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Blocks while the queue is full (backpressure). Returns false on shutdown.
+static bool queue_push(RequestQueue* q, InferenceRequest* req) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count >= q->capacity && !q->closed) {
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        return false;
+    }
+    q->requests[q->tail] = req;
+    q->tail = (q->tail + 1) % q->capacity;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return true;
+}
+
+// Blocks while the queue is empty. Returns NULL on shutdown.
+static InferenceRequest* queue_pop(RequestQueue* q) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        return NULL;
+    }
+    InferenceRequest* req = q->requests[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return req;
+}
+
+//-----------------------------------------------------------------------------
+// Admission queue
+//-----------------------------------------------------------------------------
+
+static const char* priority_names[PRIORITY_COUNT] = { "high", "normal", "low" };
+static const int default_weights[PRIORITY_COUNT] = { 8, 4, 1 };
+
+static bool admission_init(AdmissionQueue* q, const int* capacity, const int* weight) {
+    memset(q->classes, 0, sizeof(q->classes));
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        PriorityClass* c = &q->classes[i];
+        c->requests = calloc(capacity[i], sizeof(InferenceRequest*));
+        if (!c->requests) {
+            for (int j = 0; j < i; j++) free(q->classes[j].requests);
+            return false;
+        }
+        c->capacity = capacity[i];
+        c->weight = weight[i];
+    }
+    q->count = 0;
+    q->closed = false;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return true;
+}
+
+static void admission_destroy(AdmissionQueue* q) {
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        free(q->classes[i].requests);
+        q->classes[i].requests = NULL;
+    }
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+}
+
+static void admission_close(AdmissionQueue* q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void class_pop(AdmissionQueue* q, PriorityClass* c) {
+    c->head = (c->head + 1) % c->capacity;
+    c->count--;
+    q->count--;
+    if (c->count == 0) c->credit = 0;
+    pthread_cond_broadcast(&q->not_full);
+}
+
+// Take the request at ring position pos out of c, keeping the order of the rest
+static void class_remove(AdmissionQueue* q, PriorityClass* c, int pos) {
+    int last = (c->head + c->count - 1) % c->capacity;
+    while (pos != last) {
+        int next = (pos + 1) % c->capacity;
+        c->requests[pos] = c->requests[next];
+        pos = next;
+    }
+    c->tail = last;
+    c->count--;
+    q->count--;
+    if (c->count == 0) c->credit = 0;
+    pthread_cond_broadcast(&q->not_full);
+}
+
+// Smooth weighted round robin over the classes with queued requests: every
+// pick credits each waiting class its weight and charges the winner the
+// total, so high runs first but lower classes still get their share.
+// Called with the lock held and at least one request queued.
+static PriorityClass* pick_class(AdmissionQueue* q) {
+    PriorityClass* best = NULL;
+    int total = 0;
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        PriorityClass* c = &q->classes[i];
+        if (c->count == 0) continue;
+        c->credit += c->weight;
+        total += c->weight;
+        if (!best || c->credit > best->credit) best = c;
+    }
+    best->credit -= total;
+    return best;
+}
+
+// Model a request runs on; batch items run on their batch's
+static ServerModel* request_model(const InferenceRequest* req) {
+    return req->batch ? req->batch->model : req->model;
+}
+
+// Take work for a preprocess worker. A batch stays at the head of its class
+// until all of its items are claimed, so several workers share it; as many
+// consecutive items as its model runs in one job are claimed at once.
+// Returns the number of requests written to work, 0 on shutdown.
+static int admission_claim(AdmissionQueue* q, InferenceRequest** work) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        return 0;
+    }
+
+    PriorityClass* c = pick_class(q);
+    InferenceRequest* req = c->requests[c->head];
+    int n = 0;
+    if (req->items) {
+        int max_items = Model_GetBatchSize(req->model->ctx);
+        if (max_items > MAX_BATCH_ITEMS) max_items = MAX_BATCH_ITEMS;
+        while (n < max_items && req->items_claimed < req->item_count) {
+            work[n++] = req->items[req->items_claimed++];
+        }
+    } else {
+        work[n++] = req;
+    }
+
+    c->claimed += n;
+    c->total_wait_ms += n * ((Latency_Now() - req->enqueue_ns) / 1e6);
+
+    if (!req->items || req->items_claimed == req->item_count) {
+        class_pop(q, c);
+    }
+    if (q->count > 0) {
+        // Let the next worker take more items of the same batch, or the next request
+        pthread_cond_signal(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+//-----------------------------------------------------------------------------
+// Request completion
+//-----------------------------------------------------------------------------
+
+static void finish_tiles(InferenceRequest* image);
+
+static void complete_request(InferenceRequest* req) {
+    InferenceRequest* batch = req->batch;
+
+    // Nobody waits on a request with a callback; the callback owns it
+    if (req->on_complete) {
+        req->processed = true;
+        req->on_complete(req, req->user_data);
+        return;
+    }
+
+    // The waiter may free the request as soon as done is signalled
+    pthread_mutex_lock(&req->lock);
+    req->processed = true;
+    pthread_cond_signal(&req->done);
+    pthread_mutex_unlock(&req->lock);
+
+    // A batch is answered once its last item is done
+    if (batch) {
+        pthread_mutex_lock(&batch->lock);
+        if (--batch->items_pending == 0) {
+            if (batch->tiled) {
+                finish_tiles(batch);
+            }
+            batch->processed = true;
+            pthread_cond_signal(&batch->done);
+        }
+        pthread_mutex_unlock(&batch->lock);
+    }
+}
+
+static void release_slot(InferenceRequest* req) {
+    if (req->slot >= 0) {
+        Model_ReleaseSlot(request_model(req)->ctx, req->slot);
+        req->slot = -1;
+    }
+}
+
+// Fail a request in any stage; error_msg (if any) becomes the response body
+static void fail_request(InferenceRequest* req, int status_code, char* error_msg) {
+    release_slot(req);
+
+    if (error_msg) {
+        req->response_data = error_msg;
+        req->status_code = status_code ? status_code : 400;
+        LOG_LIMITED(LOG_LEVEL_WARNING, "Inference validation failed: %s", error_msg);
+    } else {
+        req->status_code = status_code ? status_code : 500;
+        LOG_LIMITED(LOG_LEVEL_ERROR, "Inference failed");
+    }
+
+    pthread_mutex_lock(&g_server.stats_lock);
+    g_server.failed_inferences++;
+    pthread_mutex_unlock(&g_server.stats_lock);
+
+    complete_request(req);
+}
+
+// Fail every request sharing the job of head; each gets its own copy of error_msg
+static void fail_job(InferenceRequest* head, int status_code, char* error_msg) {
+    release_slot(head);
+
+    InferenceRequest* next;
+    for (InferenceRequest* req = head; req; req = next) {
+        next = req->slot_next;
+        char* msg = (next && error_msg) ? strdup(error_msg) : error_msg;
+        fail_request(req, status_code, msg);
+    }
+}
+
+// Pipeline stopped while the job of head was being handed on
+static void abort_request(InferenceRequest* head) {
+    release_slot(head);
+
+    InferenceRequest* next;
+    for (InferenceRequest* req = head; req; req = next) {
+        next = req->slot_next;
+        req->status_code = 503;
+        complete_request(req);
+    }
+}
+
+// Requests still held by the admission queue when the pipeline stops
+static void drain_admission(AdmissionQueue* q) {
+    pthread_mutex_lock(&q->lock);
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        PriorityClass* c = &q->classes[i];
+        while (c->count > 0) {
+            InferenceRequest* req = c->requests[c->head];
+            class_pop(q, c);
+            if (req->items) {
+                // Items already claimed finish in their stage
+                while (req->items_claimed < req->item_count) {
+                    abort_request(req->items[req->items_claimed++]);
+                }
+            } else {
+                abort_request(req);
+            }
+        }
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Requests still held by a stage queue when the pipeline stops
+static void drain_queue(RequestQueue* q) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count > 0) {
+        InferenceRequest* req = q->requests[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        abort_request(req);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+static double elapsed_ms(uint64_t from_ns, uint64_t to_ns) {
+    return to_ns > from_ns ? (to_ns - from_ns) / 1e6 : 0.0;
+}
+
+// Answer a request that is dropped without being run
+static void drop_request(InferenceRequest* req, const char* reason) {
+    req->status_code = 504;
+    req->response_data = strdup(reason);
+    complete_request(req);
+}
+
+static const char* content_name(RequestContent content) {
+    switch (content) {
+        case REQUEST_CONTENT_JPEG: return "image/jpeg";
+        case REQUEST_CONTENT_FRAME: return "raw frame";
+        default: return "application/octet-stream";
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Pipeline stages
+//-----------------------------------------------------------------------------
+
+// Count the admission queue wait of a claimed request; true if its deadline
+// passed meanwhile
+static bool request_expired(InferenceRequest* req) {
+    const InferenceRequest* admitted = req->batch ? req->batch : req;
+    Latency_Record(LATENCY_QUEUE, req->start_ns - admitted->enqueue_ns);
+    double waited_ms = elapsed_ms(admitted->enqueue_ns, req->start_ns);
+
+    pthread_mutex_lock(&g_server.stats_lock);
+    g_server.total_queue_wait_ms += waited_ms;
+    if (waited_ms > g_server.max_queue_wait_ms) {
+        g_server.max_queue_wait_ms = waited_ms;
+    }
+    g_server.queue_wait_count++;
+    pthread_mutex_unlock(&g_server.stats_lock);
+
+    // Waiting for a tensor slot counts against the deadline as well
+    if (admitted->deadline_ms <= 0) {
+        return false;
+    }
+    uint64_t now = Latency_Now();
+    if (elapsed_ms(admitted->enqueue_ns, now) <= admitted->deadline_ms) {
+        return false;
+    }
+
+    pthread_mutex_lock(&g_server.stats_lock);
+    g_server.expired_requests++;
+    pthread_mutex_unlock(&g_server.stats_lock);
+    LOG_LIMITED(LOG_LEVEL_WARNING, "Request expired after %.0f ms in queue (deadline %d ms)",
+                elapsed_ms(admitted->enqueue_ns, now), admitted->deadline_ms);
+    return true;
+}
+
+// Tile of a tiled request; the first tile to get here decodes a JPEG for all
+// of them, the others wait for it on the request lock
+static bool preprocess_tile(InferenceRequest* req, int slot, int item) {
+    InferenceRequest* image = req->batch;
+    ModelContext* ctx = image->model->ctx;
+    const uint8_t* frame = image->image_data;
+    size_t frame_size = image->image_size;
+    int width = image->image_width;
+    int height = image->image_height;
+    VdoFormat format = image->frame_format;
+    char* error_msg = NULL;
+
+    if (image->content == REQUEST_CONTENT_JPEG) {
+        pthread_mutex_lock(&image->lock);
+        if (!image->decoded.data && !image->decode_failed) {
+            image->decode_failed = !Model_DecodeJPEG(ctx, image->image_data,
+                                                     image->image_size, width, height,
+                                                     &req->region, &image->decoded,
+                                                     &image->response_data);
+        }
+        bool failed = image->decode_failed;
+        if (failed && image->response_data) {
+            error_msg = strdup(image->response_data);
+        }
+        pthread_mutex_unlock(&image->lock);
+        if (failed) {
+            fail_request(req, 0, error_msg);
+            return false;
+        }
+        frame = image->decoded.data;
+        frame_size = image->decoded.size;
+        width = image->decoded.width;
+        height = image->decoded.height;
+        format = VDO_FORMAT_RGB;
+    }
+
+    // Tiles were validated against the image when the request was created
+    if (!Model_PreprocessRegion(ctx, slot, item, frame, frame_size,
+                                width, height, format,
+                                image->image_width, image->image_height,
+                                &req->region, &req->transform, &error_msg)) {
+        fail_request(req, 500, error_msg);
+        return false;
+    }
+    return true;
+}
+
+// Write one claimed request into batch position item of slot
+static bool preprocess_request(InferenceRequest* req, JpegDecoder* decoder, int slot, int item) {
+    ModelContext* ctx = request_model(req)->ctx;
+    char* error_msg = NULL;
+
+    if (req->batch && req->batch->tiled) {
+        return preprocess_tile(req, slot, item);
+    }
+
+    if (req->content == REQUEST_CONTENT_TENSOR) {
+        // Tensor is already in model space and used as-is; a reload may have
+        // changed the input size since the upload was checked
+        size_t size = Model_GetInputSize(ctx);
+        if (req->image_size != size) {
+            fail_request(req, 400, strdup("Tensor size does not match the model input"));
+            return false;
+        }
+        memcpy(Model_GetSlotInput(ctx, slot) + (size_t)item * size,
+               req->image_data, size);
+        Model_IdentityTransform(ctx, &req->transform);
+        return true;
+    }
+
+    if (req->content == REQUEST_CONTENT_FRAME) {
+        // Size and geometry were validated on upload, so failures are ours
+        if (!Model_PreprocessFrame(ctx, slot, item,
+                                   req->image_data, req->image_size,
+                                   req->image_width, req->image_height, req->frame_format,
+                                   &req->transform, &error_msg)) {
+            fail_request(req, 500, error_msg);
+            return false;
+        }
+        return true;
+    }
+
+    if (!Model_PreprocessJPEG(ctx, decoder, slot, item,
+                              req->image_data, req->image_size,
+                              req->image_width, req->image_height,
+                              &req->transform, &error_msg)) {
+        fail_request(req, 0, error_msg);
+        return false;
+    }
+    return true;
+}
+
+// Stage 1: decode + letterbox straight into a free tensor slot (several
+// workers, shared by all models). On models with a batch dimension,
+// consecutive items of a batch upload share a slot.
+static void* preprocess_worker(void* arg) {
+    syslog(LOG_INFO, "Preprocess worker thread started");
+
+    // One decoder per worker so the TurboJPEG handle and RGB buffer are reused
+    JpegDecoder* decoder = JPEG_CreateDecoder(g_server.jpeg_backend, g_server.jpeg_fast);
+
+    InferenceRequest* work[MAX_BATCH_ITEMS];
+    int claimed;
+    while ((claimed = admission_claim(&g_server.queue, work)) > 0) {
+        // Claimed items belong to one request, so to one model
+        ServerModel* model = request_model(work[0]);
+        InferenceRequest* head = NULL;
+        InferenceRequest* tail = NULL;
+        int slot = -1;
+        int filled = 0;
+
+        for (int i = 0; i < claimed; i++) {
+            InferenceRequest* req = work[i];
+            LOG_SAMPLED("Processing inference request (type: %s, index: %d, size: %zu bytes)",
+                        content_name(req->content), req->image_index, req->image_size);
+
+            // Start timing
+            req->start_ns = Latency_Now();
+
+            // Blocks while every slot is queued or executing
+            if (slot < 0) {
+                slot = Model_AcquireSlot(model->ctx);
+                if (slot < 0) {
+                    abort_request(req);
+                    continue;
+                }
+            }
+
+            // Stale frames are not worth accelerator time
+            if (request_expired(req)) {
+                drop_request(req, "Deadline passed while queued");
+                continue;
+            }
+
+            uint64_t preprocess_start = Latency_Now();
+            if (!preprocess_request(req, decoder, slot, filled)) {
+                continue;
+            }
+            Latency_RecordSince(LATENCY_PREPROCESS, preprocess_start);
+
+            req->slot_item = filled++;
+            if (tail) {
+                tail->slot_next = req;
+            } else {
+                head = req;
+            }
+            tail = req;
+        }
+
+        if (!head) {
+            if (slot >= 0) Model_ReleaseSlot(model->ctx, slot);
+            continue;
+        }
+
+        head->slot = slot;
+        if (!queue_push(&model->ready, head)) {
+            abort_request(head);
+        }
+    }
+
+    JPEG_DestroyDecoder(decoder);
+    syslog(LOG_INFO, "Preprocess worker thread stopped");
+    return NULL;
+}
+
+// Runs on a larod thread; the post queue holds one entry per slot so this never blocks
+static void on_job_done(int slot, bool success, void* user_data) {
+    InferenceRequest* req = (InferenceRequest*)user_data;
+
+    if (!success) {
+        fail_job(req, 0, strdup("Inference execution failed"));
+        return;
+    }
+    Latency_RecordSince(LATENCY_INFERENCE, req->submit_ns);
+
+    if (!queue_push(&request_model(req)->post, req)) {
+        abort_request(req);
+    }
+}
+
+// Stage 2: submit filled slots of one model to larod
 static void* inference_worker(void* arg) {
-    syslog(LOG_INFO, "Inference worker thread started");
+    ServerModel* model = (ServerModel*)arg;
+    syslog(LOG_INFO, "Inference worker thread started (%s)", Model_GetName(model->ctx));
+
+    InferenceRequest* req;
+    while ((req = queue_pop(&model->ready)) != NULL) {
+        char* error_msg = NULL;
+        req->submit_ns = Latency_Now();
+        if (!Model_RunAsync(model->ctx, req->slot, on_job_done, req, &error_msg)) {
+            fail_job(req, 0, error_msg);
+        }
+    }
+
+    syslog(LOG_INFO, "Inference worker thread stopped (%s)", Model_GetName(model->ctx));
+    return NULL;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+// Add one inference time to the window behind the admission estimate;
+// called with stats_lock held
+static void record_latency(double elapsed_ms) {
+    g_server.recent_ms[g_server.recent_next] = elapsed_ms;
+    g_server.recent_next = (g_server.recent_next + 1) % LATENCY_WINDOW;
+    if (g_server.recent_count < LATENCY_WINDOW) g_server.recent_count++;
+
+    double sorted[LATENCY_WINDOW];
+    memcpy(sorted, g_server.recent_ms, g_server.recent_count * sizeof(double));
+    qsort(sorted, g_server.recent_count, sizeof(double), compare_double);
+    g_server.p50_ms = sorted[g_server.recent_count / 2];
+}
+
+// Record a postprocessed request and hand it back to its HTTP thread
+static void finish_request(InferenceRequest* req) {
+    if (req->detection_count < 0) {
+        fail_request(req, 500, NULL);
+        return;
+    }
+
+    // Calculate inference time
+    double inference_ms = elapsed_ms(req->start_ns, Latency_Now());
+
+    req->status_code = (req->detection_count > 0) ? 200 : 204;
+
+    // Update timing statistics
+    pthread_mutex_lock(&g_server.stats_lock);
+    g_server.successful_inferences++;
+    g_server.total_inference_time_ms += inference_ms;
+    if (g_server.successful_inferences == 1) {
+        g_server.min_inference_time_ms = inference_ms;
+        g_server.max_inference_time_ms = inference_ms;
+    } else {
+        if (inference_ms < g_server.min_inference_time_ms) {
+            g_server.min_inference_time_ms = inference_ms;
+        }
+        if (inference_ms > g_server.max_inference_time_ms) {
+            g_server.max_inference_time_ms = inference_ms;
+        }
+    }
+    record_latency(inference_ms);
+    pthread_mutex_unlock(&g_server.stats_lock);
+
+    // Store latest inference for monitoring (JPEG only, best-effort); tiled
+    // requests store the merged result instead
+    if (req->content == REQUEST_CONTENT_JPEG && !(req->batch && req->batch->tiled)) {
+        Server_StoreLatestInference(req);
+    }
+
+    LOG_SAMPLED("Inference successful: %d detections (%.1f ms)",
+                req->detection_count, inference_ms);
+
+    complete_request(req);
+}
+
+// Last tile of a tiled request done: merge the detections of all tiles into
+// the request, or take the failure of the first failed tile. Called with the
+// request lock held; no tile uses the arena any more.
+static void finish_tiles(InferenceRequest* image) {
+    JPEG_FreeImage(&image->decoded);
+    image->transform = (ModelTransform){
+        .original_width = image->image_width,
+        .original_height = image->image_height,
+        .scale_x = 1.0f,
+        .scale_y = 1.0f,
+        .region = { 0, 0, image->image_width, image->image_height },
+    };
+
+    int total = 0;
+    for (int i = 0; i < image->item_count; i++) {
+        InferenceRequest* tile = image->items[i];
+        if (tile->status_code != 200 && tile->status_code != 204) {
+            image->status_code = tile->status_code;
+            if (!image->response_data && tile->response_data) {
+                image->response_data = strdup(tile->response_data);
+            }
+            image->detection_count = -1;
+            return;
+        }
+        total += tile->detection_count;
+    }
+
+    image->detections = total > 0 ? arena_alloc(&image->arena, total * sizeof(ModelDetection)) : NULL;
+    if (total > 0 && !image->detections) {
+        image->status_code = 500;
+        image->detection_count = -1;
+        return;
+    }
+    int count = 0;
+    for (int i = 0; i < image->item_count; i++) {
+        InferenceRequest* tile = image->items[i];
+        if (tile->detection_count > 0) {
+            memcpy(image->detections + count, tile->detections,
+                   tile->detection_count * sizeof(ModelDetection));
+            count += tile->detection_count;
+        }
+    }
+
+    image->detection_count = Model_MergeDetections(image->model->ctx, image->detections, count);
+    image->status_code = image->detection_count > 0 ? 200 : 204;
+    LOG_SAMPLED("Merged %d tiles: %d -> %d detections",
+                image->item_count, count, image->detection_count);
+
+    if (image->content == REQUEST_CONTENT_JPEG) {
+        Server_StoreLatestInference(image);
+    }
+}
+
+// Stage 3: decode output and NMS of one model; responses are formatted by
+// their own thread
+static void* postprocess_worker(void* arg) {
+    ServerModel* model = (ServerModel*)arg;
+    syslog(LOG_INFO, "Postprocess worker thread started (%s)", Model_GetName(model->ctx));
+
+    size_t output_size = Model_GetOutputSize(model->ctx);
+
+    // Decode/NMS buffers are reused; each request keeps a copy of its detections
+    ModelDetector* detector = Model_CreateDetector();
+    if (!detector) {
+        syslog(LOG_ERR, "Failed to allocate postprocess buffers");
+    }
+
+    InferenceRequest* req;
+    while ((req = queue_pop(&model->post)) != NULL) {
+        // Decode every image of the job before the slot is reused
+        const uint8_t* output = Model_GetSlotOutput(model->ctx, req->slot);
+        for (InferenceRequest* item = req; item; item = item->slot_next) {
+            const ModelDetection* found = NULL;
+            int count = detector ? Model_DetectWith(model->ctx, detector,
+                                                    output + (size_t)item->slot_item * output_size,
+                                                    &item->transform, &found) : -1;
+            if (count > 0) {
+                item->detections = arena_alloc(request_arena(item), count * sizeof(ModelDetection));
+                if (item->detections) {
+                    memcpy(item->detections, found, count * sizeof(ModelDetection));
+                } else {
+                    count = -1;
+                }
+            }
+            item->detection_count = count;
+        }
+        release_slot(req);
+
+        InferenceRequest* next;
+        for (InferenceRequest* item = req; item; item = next) {
+            next = item->slot_next;
+            finish_request(item);
+        }
+    }
+
+    Model_DestroyDetector(detector);
+    syslog(LOG_INFO, "Postprocess worker thread stopped (%s)", Model_GetName(model->ctx));
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Model registry
+//-----------------------------------------------------------------------------
+
+// Stop the threads of model; requests left in its queues are for drain_queue
+static void stop_model(ServerModel* model) {
+    Model_StopSlots(model->ctx);
+    queue_close(&model->ready);
+    queue_close(&model->post);
+    if (model->threads_started) {
+        pthread_join(model->inference_thread, NULL);
+        pthread_join(model->postprocess_thread, NULL);
+        model->threads_started = false;
+    }
+}
+
+static void model_destroy(ServerModel* model) {
+    syslog(LOG_INFO, "Unloading model %s (generation %llu)",
+           Model_GetName(model->ctx), (unsigned long long)model->generation);
+    stop_model(model);
+    drain_queue(&model->ready);
+    drain_queue(&model->post);
+    Model_Destroy(model->ctx);
+    queue_destroy(&model->ready);
+    queue_destroy(&model->post);
+    free(model);
+}
+
+// Load a model with its inference and postprocess threads; the registry
+// holds the first reference
+static ServerModel* model_create(const char* name, const cJSON* settings) {
+    ServerModel* model = calloc(1, sizeof(ServerModel));
+    ModelContext* ctx = model ? Model_CreateFromSettings(name, settings, NULL) : NULL;
+    if (!ctx) {
+        free(model);
+        return NULL;
+    }
+    model->ctx = ctx;
+    model->refs = 1;
+    model->loaded = time(NULL);
+
+    // Every slot must fit in the post queue
+    if (!queue_init(&model->ready, PIPELINE_DEPTH)) {
+        Model_Destroy(ctx);
+        free(model);
+        return NULL;
+    }
+    if (!queue_init(&model->post, Model_GetSlotCount(ctx))) {
+        queue_destroy(&model->ready);
+        Model_Destroy(ctx);
+        free(model);
+        return NULL;
+    }
+
+    if (pthread_create(&model->inference_thread, NULL, inference_worker, model) != 0) {
+        model_destroy(model);
+        return NULL;
+    }
+    if (pthread_create(&model->postprocess_thread, NULL, postprocess_worker, model) != 0) {
+        queue_close(&model->ready);
+        pthread_join(model->inference_thread, NULL);
+        model_destroy(model);
+        return NULL;
+    }
+    model->threads_started = true;
+    return model;
+}
+
+static bool valid_model_name(const cJSON* name) {
+    if (!cJSON_IsString(name) || !name->valuestring[0] ||
+        strlen(name->valuestring) >= MODEL_NAME_SIZE) {
+        return false;
+    }
+    for (const char* c = name->valuestring; *c; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '-' && *c != '_' && *c != '.') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Configured entry of name (NULL: the default); call with the model lock
+static ModelEntry* find_model_locked(const char* name) {
+    for (int i = 0; i < g_server.model_count; i++) {
+        ModelEntry* entry = &g_server.models[i];
+        if (entry->configured && (!name || strcmp(entry->name, name) == 0)) {
+            return entry;
+        }
+        if (!name) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Names and settings of the configured models, the default first: "model",
+// then each "models" object duplicated over "model". Returns the count;
+// the caller deletes the settings.
+static int configured_models(char names[MAX_MODELS][MODEL_NAME_SIZE], cJSON* settings[MAX_MODELS]) {
+    cJSON* all = ACAP_Get_Config("settings");
+    const cJSON* base = all ? cJSON_GetObjectItem(all, "model") : NULL;
+    const cJSON* list = all ? cJSON_GetObjectItem(all, "models") : NULL;
+    if (!cJSON_IsArray(list)) {
+        list = NULL;
+    }
+
+    settings[0] = cJSON_IsObject(base) ? cJSON_Duplicate(base, 1) : cJSON_CreateObject();
+    if (!settings[0]) {
+        return 0;
+    }
+    const cJSON* name = cJSON_GetObjectItem(settings[0], "name");
+    snprintf(names[0], MODEL_NAME_SIZE, "%s",
+             valid_model_name(name) ? name->valuestring : DEFAULT_MODEL_NAME);
+    int count = 1;
+
+    const cJSON* entry;
+    cJSON_ArrayForEach(entry, list) {
+        name = cJSON_GetObjectItem(entry, "name");
+        if (!cJSON_IsObject(entry) || !valid_model_name(name)) {
+            syslog(LOG_WARNING, "Ignoring a models entry without a valid name");
+            continue;
+        }
+        bool taken = false;
+        for (int i = 0; i < count; i++) {
+            taken = taken || strcmp(names[i], name->valuestring) == 0;
+        }
+        if (taken) {
+            syslog(LOG_WARNING, "Ignoring a second model named %s", name->valuestring);
+            continue;
+        }
+        if (count == MAX_MODELS) {
+            syslog(LOG_WARNING, "Only %d models can be loaded, ignoring %s",
+                   MAX_MODELS, name->valuestring);
+            continue;
+        }
+
+        cJSON* merged = cJSON_Duplicate(settings[0], 1);
+        if (!merged) {
+            continue;
+        }
+        const cJSON* member;
+        cJSON_ArrayForEach(member, entry) {
+            cJSON_DeleteItemFromObject(merged, member->string);
+            cJSON_AddItemToObject(merged, member->string, cJSON_Duplicate(member, 1));
+        }
+        snprintf(names[count], MODEL_NAME_SIZE, "%s", name->valuestring);
+        settings[count++] = merged;
+    }
+    return count;
+}
+
+// The monitor frame references its model; a retired model's frame is
+// dropped so that it does not keep the model loaded
+static void drop_latest_of(ServerModel* model) {
+    atomic_fetch_add(&g_server.latest_readers, 1);
+    LatestInference* latest = atomic_load(&g_server.latest);
+    bool match = latest && latest->model == model;
+    atomic_fetch_sub(&g_server.latest_readers, 1);
+
+    if (match && atomic_compare_exchange_strong(&g_server.latest, &latest, NULL)) {
+        while (atomic_load(&g_server.latest_readers) > 0) {
+            sched_yield();
+        }
+        Server_ReleaseLatestInference(latest);
+    }
+}
+
+// Take the registry's reference from old and wait for the requests still
+// using it; called and returns with the model lock held
+static void retire_model_locked(ServerModel* old) {
+    old->refs--;
+    while (old->refs > 0) {
+        pthread_mutex_unlock(&g_server.model_lock);
+        drop_latest_of(old);
+        pthread_mutex_lock(&g_server.model_lock);
+        if (old->refs > 0) {
+            pthread_cond_wait(&g_server.model_released, &g_server.model_lock);
+        }
+    }
+    pthread_mutex_unlock(&g_server.model_lock);
+    model_destroy(old);
+    pthread_mutex_lock(&g_server.model_lock);
+}
+
+// Loader thread of one entry: loads pending settings until there are none,
+// swapping each model in once it is ready. A failed load keeps the current
+// model serving.
+static void* model_loader(void* arg) {
+    ModelEntry* entry = (ModelEntry*)arg;
+    char name[MODEL_NAME_SIZE];
+
+    pthread_mutex_lock(&g_server.model_lock);
+    while (entry->pending || entry->unload) {
+        cJSON* settings = entry->pending;
+        bool unload = !settings;
+        entry->pending = NULL;
+        entry->unload = false;
+        bool describe = !entry->current && !entry->described;
+        snprintf(name, sizeof(name), "%s", entry->name);
+        pthread_mutex_unlock(&g_server.model_lock);
+
+        ServerModel* model = NULL;
+        if (settings) {
+            // A model not serving yet is described from the cache while
+            // larod loads it; load_models describes the first loads
+            ModelDescription desc;
+            bool described = describe && Model_Describe(settings, &desc);
+            pthread_mutex_lock(&g_server.model_lock);
+            if (described) {
+                entry->desc = desc;
+                entry->described = true;
+            }
+            entry->loading_since = Latency_Now();
+            pthread_mutex_unlock(&g_server.model_lock);
+
+            syslog(LOG_INFO, "Loading model %s in the background", name);
+            model = model_create(name, settings);
+            cJSON_Delete(settings);
+        }
+
+        pthread_mutex_lock(&g_server.model_lock);
+        if (!model && !unload) {
+            syslog(LOG_ERR, "Failed to load model %s, keeping the current one", name);
+            entry->described = entry->current != NULL;
+            free(entry->error);
+            entry->error = strdup("Model could not be loaded (see the log)");
+            continue;
+        }
+
+        ServerModel* old = entry->current;
+        entry->current = model;
+        free(entry->error);
+        entry->error = NULL;
+        entry->described = model != NULL;
+        if (model) {
+            model->generation = ++entry->loads;
+            Model_GetDescription(model->ctx, &entry->desc);
+            syslog(LOG_INFO, "Model %s swapped in (generation %llu)",
+                   name, (unsigned long long)model->generation);
+        }
+        if (old) {
+            retire_model_locked(old);
+        }
+    }
+    entry->loading = false;
+    pthread_mutex_unlock(&g_server.model_lock);
+    return NULL;
+}
+
+// Queue settings (NULL: unload) for entry and start its loader if idle;
+// call with the model lock held. Takes over settings.
+static void schedule_load_locked(ModelEntry* entry, cJSON* settings) {
+    free(entry->config);
+    entry->config = settings ? cJSON_PrintUnformatted(settings) : NULL;
+    cJSON_Delete(entry->pending);
+    entry->pending = settings;
+    entry->unload = !settings;
+    if (entry->loading || g_server.models_closed) {
+        return;
+    }
+
+    // The previous loader is done with the entry (loading is false)
+    if (entry->loader_joinable) {
+        pthread_join(entry->loader, NULL);
+        entry->loader_joinable = false;
+    }
+    if (pthread_create(&entry->loader, NULL, model_loader, entry) != 0) {
+        syslog(LOG_ERR, "Failed to start the loader of model %s", entry->name);
+        free(entry->error);
+        entry->error = strdup("Loader thread could not be started");
+        return;
+    }
+    entry->loading = true;
+    entry->loading_since = Latency_Now();
+    entry->loader_joinable = true;
+}
 
-    while (g_server.running) {
-        pthread_mutex_lock(&g_server.queue.lock);
+// Initial load, once the pipeline runs. Models load in the background like
+// reloads, so the endpoints answer (503 for inference) while larod loads;
+// the cache of a previous start describes them from the beginning.
+static void load_models(void) {
+    char names[MAX_MODELS][MODEL_NAME_SIZE];
+    cJSON* settings[MAX_MODELS];
+    int count = configured_models(names, settings);
+
+    ModelDescription desc[MAX_MODELS];
+    bool described[MAX_MODELS];
+    for (int i = 0; i < count; i++) {
+        described[i] = Model_Describe(settings[i], &desc[i]);
+    }
 
-        // Wait for requests
-        while (g_server.queue.count == 0 && g_server.running) {
-            pthread_cond_wait(&g_server.queue.not_empty, &g_server.queue.lock);
+    pthread_mutex_lock(&g_server.model_lock);
+    g_server.model_count = count;
+    for (int i = 0; i < count; i++) {
+        ModelEntry* entry = &g_server.models[i];
+        snprintf(entry->name, sizeof(entry->name), "%s", names[i]);
+        entry->configured = true;
+        entry->described = described[i];
+        if (described[i]) {
+            entry->desc = desc[i];
         }
+        schedule_load_locked(entry, settings[i]);
+    }
+    pthread_mutex_unlock(&g_server.model_lock);
+}
 
-        if (!g_server.running) {
-            pthread_mutex_unlock(&g_server.queue.lock);
-            break;
+// Drop the registry's references; a model still used by a request is kept
+// (and leaked) rather than freed under it. Returns false if one was kept.
+static bool unload_models(void) {
+    bool all = true;
+    for (int i = 0; i < g_server.model_count; i++) {
+        ModelEntry* entry = &g_server.models[i];
+        ServerModel* model = entry->current;
+        entry->current = NULL;
+        if (model) {
+            pthread_mutex_lock(&g_server.model_lock);
+            int refs = --model->refs;
+            pthread_mutex_unlock(&g_server.model_lock);
+            if (refs == 0) {
+                model_destroy(model);
+            } else {
+                syslog(LOG_WARNING, "Model %s still used by %d requests, not freed",
+                       entry->name, refs);
+                all = false;
+            }
         }
+        free(entry->config);
+        free(entry->error);
+        cJSON_Delete(entry->pending);
+        memset(entry, 0, sizeof(*entry));
+    }
+    g_server.model_count = 0;
+    return all;
+}
 
-        // Get request from queue
-        InferenceRequest* req = g_server.queue.requests[g_server.queue.head];
-        g_server.queue.head = (g_server.queue.head + 1) % MAX_QUEUE_SIZE;
-        g_server.queue.count--;
+ServerModel* Server_AcquireModel(const char* name) {
+    pthread_mutex_lock(&g_server.model_lock);
+    ModelEntry* entry = find_model_locked(name);
+    ServerModel* model = entry ? entry->current : NULL;
+    if (model) {
+        model->refs++;
+    }
+    pthread_mutex_unlock(&g_server.model_lock);
+    return model;
+}
 
-        pthread_cond_signal(&g_server.queue.not_full);
-        pthread_mutex_unlock(&g_server.queue.lock);
+// Every release wakes a retiring loader: the reference it waits for last
+// may be the monitor frame's
+void Server_ReleaseModel(ServerModel* model) {
+    if (!model) {
+        return;
+    }
+    pthread_mutex_lock(&g_server.model_lock);
+    model->refs--;
+    pthread_cond_broadcast(&g_server.model_released);
+    pthread_mutex_unlock(&g_server.model_lock);
+}
 
-        // Process inference
-        pthread_mutex_lock(&req->lock);
+void Server_SetRequestModel(InferenceRequest* request, ServerModel* model) {
+    if (!request || request->batch) {
+        return;
+    }
+    pthread_mutex_lock(&g_server.model_lock);
+    if (model) {
+        model->refs++;
+    }
+    ServerModel* previous = request->model;
+    request->model = model;
+    if (previous) {
+        previous->refs--;
+        pthread_cond_broadcast(&g_server.model_released);
+    }
+    pthread_mutex_unlock(&g_server.model_lock);
+}
 
-        syslog(LOG_INFO, "Processing inference request (type: %s, index: %d, size: %zu bytes)",
-               req->content_type ? req->content_type : "unknown",
-               req->image_index, req->image_size);
+ModelContext* Server_GetRequestModel(const InferenceRequest* request) {
+    ServerModel* model = request ? request_model(request) : NULL;
+    return model ? model->ctx : NULL;
+}
 
-        // Start timing
-        struct timeval start_time, end_time;
-        gettimeofday(&start_time, NULL);
+bool Server_ReloadModel(const char* name) {
+    char names[MAX_MODELS][MODEL_NAME_SIZE];
+    cJSON* settings[MAX_MODELS];
+    int count = configured_models(names, settings);
+
+    bool found = false;
+    pthread_mutex_lock(&g_server.model_lock);
+    ModelEntry* entry = find_model_locked(name);
+    for (int i = 0; i < count; i++) {
+        if (entry && !found && strcmp(names[i], entry->name) == 0) {
+            schedule_load_locked(entry, settings[i]);
+            found = true;
+        } else {
+            cJSON_Delete(settings[i]);
+        }
+    }
+    pthread_mutex_unlock(&g_server.model_lock);
+    return found;
+}
 
-        // Perform inference based on content type
-        cJSON* detections = NULL;
-        char* error_msg = NULL;
+void Server_ConfigureModels(void) {
+    char names[MAX_MODELS][MODEL_NAME_SIZE];
+    cJSON* settings[MAX_MODELS];
+    int count = configured_models(names, settings);
+    if (count == 0) {
+        return;
+    }
 
-        if (req->content_type && strcmp(req->content_type, "image/jpeg") == 0) {
-            // JPEG inference
-            detections = Model_InferenceJPEG(req->image_data, req->image_size,
-                                            req->image_index, req->image_width, req->image_height,
-                                            &error_msg);
-        } else if (req->content_type && strcmp(req->content_type, "application/octet-stream") == 0) {
-            // Tensor inference
-            int width = Model_GetWidth();
-            int height = Model_GetHeight();
-            detections = Model_InferenceTensor(req->image_data, width, height,
-                                              req->image_index, &error_msg);
+    pthread_mutex_lock(&g_server.model_lock);
+    bool wanted[MAX_MODELS] = { false };
+    for (int i = 0; i < count; i++) {
+        // The default model keeps entry 0, also when it is renamed
+        ModelEntry* entry = i == 0 ? &g_server.models[0] : NULL;
+        for (int j = 1; !entry && j < g_server.model_count; j++) {
+            if (g_server.models[j].configured && strcmp(g_server.models[j].name, names[i]) == 0) {
+                entry = &g_server.models[j];
+            }
+        }
+        // A new name takes a free entry whose loader is idle
+        for (int j = 1; !entry && j < MAX_MODELS; j++) {
+            ModelEntry* candidate = &g_server.models[j];
+            if (!candidate->configured && !candidate->loading && !candidate->current) {
+                entry = candidate;
+                if (j >= g_server.model_count) g_server.model_count = j + 1;
+            }
+        }
+        if (!entry) {
+            syslog(LOG_WARNING, "No free registry entry for model %s", names[i]);
+            cJSON_Delete(settings[i]);
+            continue;
+        }
+        wanted[entry - g_server.models] = true;
+
+        char* config = cJSON_PrintUnformatted(settings[i]);
+        bool changed = !entry->configured || !config || !entry->config ||
+                       strcmp(config, entry->config) != 0 || strcmp(entry->name, names[i]) != 0;
+        free(config);
+        if (!entry->configured || strcmp(entry->name, names[i]) != 0) {
+            snprintf(entry->name, sizeof(entry->name), "%s", names[i]);
+        }
+        entry->configured = true;
+        if (changed) {
+            syslog(LOG_INFO, "Settings of model %s changed, reloading", entry->name);
+            schedule_load_locked(entry, settings[i]);
         } else {
-            error_msg = strdup("Unsupported content type");
-            req->status_code = 400;
+            cJSON_Delete(settings[i]);
         }
+    }
 
-        // Calculate inference time
-        gettimeofday(&end_time, NULL);
-        double elapsed_ms = (end_time.tv_sec - start_time.tv_sec) * 1000.0 +
-                           (end_time.tv_usec - start_time.tv_usec) / 1000.0;
-
-        if (detections) {
-            req->response_data = detections;
-            req->status_code = (cJSON_GetArraySize(detections) > 0) ? 200 : 204;
-            g_server.successful_inferences++;
+    // Names no longer in the settings are retired
+    for (int j = 1; j < g_server.model_count; j++) {
+        ModelEntry* entry = &g_server.models[j];
+        if (entry->configured && !wanted[j]) {
+            syslog(LOG_INFO, "Model %s removed from the settings, unloading", entry->name);
+            entry->configured = false;
+            schedule_load_locked(entry, NULL);
+        }
+    }
+    pthread_mutex_unlock(&g_server.model_lock);
+}
 
-            // Update timing statistics
-            g_server.total_inference_time_ms += elapsed_ms;
-            if (g_server.successful_inferences == 1) {
-                g_server.min_inference_time_ms = elapsed_ms;
-                g_server.max_inference_time_ms = elapsed_ms;
-            } else {
-                if (elapsed_ms < g_server.min_inference_time_ms) {
-                    g_server.min_inference_time_ms = elapsed_ms;
-                }
-                if (elapsed_ms > g_server.max_inference_time_ms) {
-                    g_server.max_inference_time_ms = elapsed_ms;
-                }
-            }
+// Snapshot of entry; call with the model lock held
+static void model_info_locked(const ModelEntry* entry, ServerModelInfo* info) {
+    memset(info, 0, sizeof(*info));
+    snprintf(info->name, sizeof(info->name), "%s", entry->name);
+    info->is_default = entry == &g_server.models[0];
+    info->loading = entry->loading;
+    if (entry->current) {
+        info->loaded = true;
+        info->generation = entry->current->generation;
+        info->in_use = entry->current->refs - 1;
+        info->described = true;
+        Model_GetDescription(entry->current->ctx, &info->desc);
+    } else if (entry->described) {
+        info->described = true;
+        info->desc = entry->desc;
+    }
 
-            // Store latest inference for monitoring (JPEG only, best-effort)
-            if (req->content_type && strcmp(req->content_type, "image/jpeg") == 0) {
-                char* detections_str = cJSON_PrintUnformatted(detections);
-                if (detections_str) {
-                    Server_StoreLatestInference(req->image_data, req->image_size, detections_str);
-                    free(detections_str);
-                }
-            }
+    // The last load of the same file tells how long this one should take
+    if (entry->loading && entry->described && entry->desc.load_ms > 0) {
+        double remaining_ms = entry->desc.load_ms - (Latency_Now() - entry->loading_since) / 1e6;
+        info->retry_after = remaining_ms > 1000 ? (int)ceil(remaining_ms / 1000) : 1;
+    }
+    if (entry->error) {
+        snprintf(info->error, sizeof(info->error), "%s", entry->error);
+    }
+}
 
-            syslog(LOG_INFO, "Inference successful: %d detections (%.1f ms)",
-                   cJSON_GetArraySize(detections), elapsed_ms);
-        } else if (error_msg) {
-            // Validation error
-            req->response_data = error_msg;
-            if (req->status_code == 0) {
-                req->status_code = 400;
-            }
-            g_server.failed_inferences++;
-            syslog(LOG_WARNING, "Inference validation failed: %s", error_msg);
-        } else {
-            // Inference error
-            req->status_code = 500;
-            g_server.failed_inferences++;
-            syslog(LOG_ERR, "Inference failed");
+int Server_ListModels(ServerModelInfo* info, int max) {
+    int n = 0;
+    pthread_mutex_lock(&g_server.model_lock);
+    for (int i = 0; i < g_server.model_count && n < max; i++) {
+        if (g_server.models[i].configured) {
+            model_info_locked(&g_server.models[i], &info[n++]);
         }
+    }
+    pthread_mutex_unlock(&g_server.model_lock);
+    return n;
+}
 
-        req->processed = true;
-        pthread_cond_signal(&req->done);
-        pthread_mutex_unlock(&req->lock);
+bool Server_GetModelInfo(const char* name, ServerModelInfo* info) {
+    pthread_mutex_lock(&g_server.model_lock);
+    ModelEntry* entry = find_model_locked(name);
+    if (entry) {
+        model_info_locked(entry, info);
     }
+    pthread_mutex_unlock(&g_server.model_lock);
+    return entry != NULL;
+}
 
-    syslog(LOG_INFO, "Inference worker thread stopped");
-    return NULL;
+static void stop_pipeline(void) {
+    g_server.running = false;
+    for (int i = 0; i < g_server.model_count; i++) {
+        if (g_server.models[i].current) {
+            Model_StopSlots(g_server.models[i].current->ctx);
+        }
+    }
+    admission_close(&g_server.queue);
+    for (int i = 0; i < g_server.model_count; i++) {
+        if (g_server.models[i].current) {
+            queue_close(&g_server.models[i].current->ready);
+            queue_close(&g_server.models[i].current->post);
+        }
+    }
+
+    for (int i = 0; i < g_server.preprocess_thread_count; i++) {
+        pthread_join(g_server.preprocess_threads[i], NULL);
+    }
+    g_server.preprocess_thread_count = 0;
+    for (int i = 0; i < g_server.model_count; i++) {
+        if (g_server.models[i].current) {
+            stop_model(g_server.models[i].current);
+        }
+    }
 }
 
+//-----------------------------------------------------------------------------
+// Lifecycle
+//-----------------------------------------------------------------------------
+
 // Initialize server
 bool Server_Init(void) {
     memset(&g_server, 0, sizeof(ServerState));
 
-    // Initialize queue
-    pthread_mutex_init(&g_server.queue.lock, NULL);
-    pthread_cond_init(&g_server.queue.not_empty, NULL);
-    pthread_cond_init(&g_server.queue.not_full, NULL);
+    pthread_mutex_init(&g_server.stats_lock, NULL);
+    pthread_mutex_init(&g_server.model_lock, NULL);
+    pthread_cond_init(&g_server.model_released, NULL);
+    g_server.started = time(NULL);
+
+    int preprocess_threads = DEFAULT_PREPROCESS_THREADS;
+    cJSON* settings = ACAP_Get_Config("settings");
+    cJSON* server = settings ? cJSON_GetObjectItem(settings, "server") : NULL;
+    cJSON* item = server ? cJSON_GetObjectItem(server, "preprocess_threads") : NULL;
+    if (item && cJSON_IsNumber(item)) {
+        preprocess_threads = item->valueint;
+    }
+    if (preprocess_threads < 1) preprocess_threads = 1;
+    if (preprocess_threads > MAX_PREPROCESS_THREADS) preprocess_threads = MAX_PREPROCESS_THREADS;
+
+    g_server.jpeg_backend = JPEG_BACKEND_TURBOJPEG;
+    item = server ? cJSON_GetObjectItem(server, "jpeg_decoder") : NULL;
+    if (item && cJSON_IsString(item) &&
+        !JPEG_BackendFromString(item->valuestring, &g_server.jpeg_backend)) {
+        syslog(LOG_WARNING, "Unknown jpeg_decoder '%s', using %s",
+               item->valuestring, JPEG_BackendName(g_server.jpeg_backend));
+    }
+    item = server ? cJSON_GetObjectItem(server, "jpeg_fast_decode") : NULL;
+    g_server.jpeg_fast = item && cJSON_IsTrue(item);
+
+    g_server.max_queue_size = DEFAULT_QUEUE_SIZE;
+    item = server ? cJSON_GetObjectItem(server, "max_queue_size") : NULL;
+    if (item && cJSON_IsNumber(item)) {
+        g_server.max_queue_size = item->valueint;
+    }
+    if (g_server.max_queue_size < 1) g_server.max_queue_size = 1;
+    if (g_server.max_queue_size > MAX_QUEUE_LIMIT) g_server.max_queue_size = MAX_QUEUE_LIMIT;
+
+    // Per class overrides: "priorities": {"low": {"max_queue_size": 8, "weight": 1}, ...}
+    int class_capacity[PRIORITY_COUNT];
+    int class_weight[PRIORITY_COUNT];
+    int admission_capacity = 0;
+    cJSON* priorities = server ? cJSON_GetObjectItem(server, "priorities") : NULL;
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        cJSON* entry = priorities ? cJSON_GetObjectItem(priorities, priority_names[i]) : NULL;
+        class_capacity[i] = g_server.max_queue_size;
+        class_weight[i] = default_weights[i];
+        item = entry ? cJSON_GetObjectItem(entry, "max_queue_size") : NULL;
+        if (item && cJSON_IsNumber(item)) {
+            class_capacity[i] = item->valueint;
+        }
+        item = entry ? cJSON_GetObjectItem(entry, "weight") : NULL;
+        if (item && cJSON_IsNumber(item)) {
+            class_weight[i] = item->valueint;
+        }
+        if (class_capacity[i] < 1) class_capacity[i] = 1;
+        if (class_capacity[i] > MAX_QUEUE_LIMIT) class_capacity[i] = MAX_QUEUE_LIMIT;
+        if (class_weight[i] < 1) class_weight[i] = 1;
+        admission_capacity += class_capacity[i];
+    }
 
-    // Initialize latest inference cache
-    pthread_mutex_init(&g_server.latest.lock, NULL);
-    g_server.latest.has_data = false;
-    g_server.latest.image_data = NULL;
-    g_server.latest.detections_json = NULL;
+    // Initialize queues
+    if (!admission_init(&g_server.queue, class_capacity, class_weight)) {
+        syslog(LOG_ERR, "Failed to allocate request queues");
+        return false;
+    }
 
-    // Initialize model
-    if (!Model_Setup()) {
-        syslog(LOG_ERR, "Failed to initialize model");
+    // Requests live from upload until their response is written, so the pool
+    // covers the queue plus the stages behind it and answers in flight
+    if (!pool_init(admission_capacity * REQUEST_POOL_PER_QUEUE_ENTRY)) {
+        syslog(LOG_ERR, "Failed to allocate request pool");
+        admission_destroy(&g_server.queue);
         return false;
     }
 
-    // Start worker thread
+    // Start the preprocess workers; each model runs its own inference and
+    // postprocess threads
     g_server.running = true;
-    if (pthread_create(&g_server.inference_thread, NULL, inference_worker, NULL) != 0) {
-        syslog(LOG_ERR, "Failed to create inference worker thread");
-        Model_Cleanup();
+    bool started = true;
+    for (int i = 0; started && i < preprocess_threads; i++) {
+        if (pthread_create(&g_server.preprocess_threads[i], NULL, preprocess_worker, NULL) != 0) {
+            started = false;
+            break;
+        }
+        g_server.preprocess_thread_count++;
+    }
+    if (!started) {
+        syslog(LOG_ERR, "Failed to create pipeline worker threads");
+        stop_pipeline();
+        admission_destroy(&g_server.queue);
+        pool_destroy();
         return false;
     }
 
-    syslog(LOG_INFO, "Server initialized successfully");
+    load_models();
+
+    syslog(LOG_INFO, "Server initialized successfully (%d models loading, %d preprocess workers, %s decoder%s, queue %d/%d/%d, %d pooled requests)",
+           g_server.model_count, g_server.preprocess_thread_count, JPEG_BackendName(g_server.jpeg_backend),
+           g_server.jpeg_fast ? ", fast" : "", class_capacity[PRIORITY_HIGH],
+           class_capacity[PRIORITY_NORMAL], class_capacity[PRIORITY_LOW], g_server.pool_size);
     return true;
 }
 
@@ -170,40 +1571,41 @@ void Server_Cleanup(void) {
 
     syslog(LOG_INFO, "Shutting down server...");
 
-    // Stop worker thread
-    pthread_mutex_lock(&g_server.queue.lock);
-    g_server.running = false;
-    pthread_cond_signal(&g_server.queue.not_empty);
-    pthread_mutex_unlock(&g_server.queue.lock);
+    // No new loads; wait for those running (they may wait for a drain)
+    pthread_mutex_lock(&g_server.model_lock);
+    g_server.models_closed = true;
+    pthread_mutex_unlock(&g_server.model_lock);
+    for (int i = 0; i < g_server.model_count; i++) {
+        if (g_server.models[i].loader_joinable) {
+            pthread_join(g_server.models[i].loader, NULL);
+            g_server.models[i].loader_joinable = false;
+        }
+    }
 
-    pthread_join(g_server.inference_thread, NULL);
+    // Stop pipeline threads
+    stop_pipeline();
 
-    // Cleanup remaining requests
-    for (int i = 0; i < g_server.queue.count; i++) {
-        int idx = (g_server.queue.head + i) % MAX_QUEUE_SIZE;
-        if (g_server.queue.requests[idx]) {
-            Server_FreeRequest(g_server.queue.requests[idx]);
+    // Fail remaining requests so waiting HTTP threads can respond
+    drain_admission(&g_server.queue);
+    for (int i = 0; i < g_server.model_count; i++) {
+        if (g_server.models[i].current) {
+            drain_queue(&g_server.models[i].current->ready);
+            drain_queue(&g_server.models[i].current->post);
         }
     }
 
-    // Cleanup model
-    Model_Cleanup();
+    // Cleanup latest inference cache, which references its model
+    Server_ReleaseLatestInference(atomic_exchange(&g_server.latest, NULL));
 
-    // Cleanup latest inference cache
-    pthread_mutex_lock(&g_server.latest.lock);
-    if (g_server.latest.image_data) {
-        free(g_server.latest.image_data);
+    // Cleanup models and queues
+    bool models_freed = unload_models();
+    admission_destroy(&g_server.queue);
+    pthread_mutex_destroy(&g_server.stats_lock);
+    if (models_freed) {
+        pthread_mutex_destroy(&g_server.model_lock);
+        pthread_cond_destroy(&g_server.model_released);
     }
-    if (g_server.latest.detections_json) {
-        free(g_server.latest.detections_json);
-    }
-    pthread_mutex_unlock(&g_server.latest.lock);
-    pthread_mutex_destroy(&g_server.latest.lock);
-
-    // Cleanup queue
-    pthread_mutex_destroy(&g_server.queue.lock);
-    pthread_cond_destroy(&g_server.queue.not_empty);
-    pthread_cond_destroy(&g_server.queue.not_full);
+    pool_destroy();
 
     syslog(LOG_INFO, "Server shutdown complete");
 }
@@ -215,73 +1617,389 @@ bool Server_IsRunning(void) {
 
 // Create a new inference request
 InferenceRequest* Server_CreateRequest(const uint8_t* data, size_t size,
-                                      const char* content_type, int image_index,
+                                      RequestContent content, int image_index,
                                       int image_width, int image_height) {
-    if (!data || size == 0 || size > MAX_IMAGE_SIZE) {
+    size_t max_size = content == REQUEST_CONTENT_FRAME ? MAX_FRAME_SIZE : MAX_IMAGE_SIZE;
+    if (!data || size == 0 || size > max_size) {
         syslog(LOG_ERR, "Invalid request parameters (size: %zu)", size);
         return NULL;
     }
 
-    InferenceRequest* req = calloc(1, sizeof(InferenceRequest));
-    if (!req) {
-        syslog(LOG_ERR, "Failed to allocate request");
+    // Copy image data
+    uint8_t* copy = malloc(size);
+    if (!copy) {
+        syslog(LOG_ERR, "Failed to allocate image buffer");
         return NULL;
     }
+    memcpy(copy, data, size);
 
-    // Copy image data
-    req->image_data = malloc(size);
-    if (!req->image_data) {
-        syslog(LOG_ERR, "Failed to allocate image buffer");
-        free(req);
+    return Server_AdoptRequest(copy, size, NULL, content, image_index,
+                               image_width, image_height);
+}
+
+InferenceRequest* Server_AdoptRequest(uint8_t* data, size_t size,
+                                     void (*release)(void* data),
+                                     RequestContent content, int image_index,
+                                     int image_width, int image_height) {
+    void (*release_data)(void*) = release ? release : free;
+
+    size_t max_size = content == REQUEST_CONTENT_FRAME ? MAX_FRAME_SIZE : MAX_IMAGE_SIZE;
+    if (!data || size == 0 || size > max_size) {
+        syslog(LOG_ERR, "Invalid request parameters (size: %zu)", size);
+        if (data) release_data(data);
         return NULL;
     }
-    memcpy(req->image_data, data, size);
-    req->image_size = size;
 
-    // Copy content type
-    if (content_type) {
-        req->content_type = strdup(content_type);
+    InferenceRequest* req = request_take();
+    if (!req) {
+        syslog(LOG_ERR, "Failed to allocate request");
+        release_data(data);
+        return NULL;
     }
 
+    req->image_data = data;
+    req->image_size = size;
+    req->release_image = release;
+    req->content = content;
     req->image_index = image_index;
     req->image_width = image_width;
     req->image_height = image_height;
-    req->processed = false;
-    req->status_code = 0;
-    req->response_data = NULL;
-
-    pthread_mutex_init(&req->lock, NULL);
-    pthread_cond_init(&req->done, NULL);
+    req->priority = PRIORITY_NORMAL;
 
     return req;
 }
 
-// Queue a request for processing
-bool Server_QueueRequest(InferenceRequest* request) {
-    if (!request) {
+// Items point into their batch's data, which the batch releases
+static void keep_batch_data(void* data) {
+}
+
+InferenceRequest* Server_CreateBatch(uint8_t* data, size_t size,
+                                    void (*release)(void* data), int count) {
+    void (*release_data)(void*) = release ? release : free;
+
+    if (!data || size == 0 || size > MAX_BATCH_SIZE || count < 1 || count > MAX_BATCH_ITEMS) {
+        syslog(LOG_ERR, "Invalid batch parameters (size: %zu, items: %d)", size, count);
+        if (data) release_data(data);
+        return NULL;
+    }
+
+    InferenceRequest* batch = request_take();
+    if (!batch) {
+        syslog(LOG_ERR, "Failed to allocate batch");
+        release_data(data);
+        return NULL;
+    }
+
+    batch->image_data = data;
+    batch->image_size = size;
+    batch->release_image = release;
+    batch->image_index = -1;
+    batch->priority = PRIORITY_NORMAL;
+
+    // Items live in the batch's arena rather than taking pool slots
+    batch->items = arena_alloc(&batch->arena, count * sizeof(InferenceRequest*));
+    InferenceRequest* storage = arena_alloc(&batch->arena, count * sizeof(InferenceRequest));
+    if (!batch->items || !storage) {
+        syslog(LOG_ERR, "Failed to allocate batch");
+        batch->items = NULL;
+        Server_FreeRequest(batch);
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        batch->items[i] = &storage[i];
+    }
+
+    // Room for count items; item_count grows as they are added
+    batch->items_pending = count;
+    return batch;
+}
+
+// Next item of batch over size bytes at offset into the batch data
+static InferenceRequest* add_item(InferenceRequest* batch, size_t offset, size_t size,
+                                  RequestContent content, int image_index,
+                                  int image_width, int image_height) {
+    InferenceRequest* item = batch->items[batch->item_count++];
+    memset(item, 0, sizeof(*item));
+    pthread_mutex_init(&item->lock, NULL);
+    pthread_cond_init(&item->done, NULL);
+    item->image_data = batch->image_data + offset;
+    item->image_size = size;
+    item->release_image = keep_batch_data;
+    item->content = content;
+    item->image_index = image_index;
+    item->image_width = image_width;
+    item->image_height = image_height;
+    item->slot = -1;
+    item->batch = batch;
+    return item;
+}
+
+bool Server_AddBatchItem(InferenceRequest* batch, size_t offset, size_t size,
+                         RequestContent content, int image_index,
+                         int image_width, int image_height) {
+    if (!batch || !batch->items || batch->tiled || batch->item_count >= batch->items_pending ||
+        offset > batch->image_size || size == 0 || size > batch->image_size - offset ||
+        size > MAX_IMAGE_SIZE) {
         return false;
     }
 
-    pthread_mutex_lock(&g_server.queue.lock);
+    add_item(batch, offset, size, content, image_index, image_width, image_height);
+    return true;
+}
 
-    // Check if queue is full
-    if (g_server.queue.count >= MAX_QUEUE_SIZE) {
-        pthread_mutex_unlock(&g_server.queue.lock);
+// Tiles along one axis (at least 1) for tiles of at most model pixels
+static int auto_tiles(int length, int model, float overlap) {
+    int tiles = (int)ceilf(((float)length / model - overlap) / (1.0f - overlap));
+    return tiles > 1 ? tiles : 1;
+}
+
+// count tiles over length pixels from start, overlapping by overlap of a
+// tile and spread evenly with the last one flush with the end
+static void tile_axis(int start, int length, int count, float overlap,
+                      int* offsets, int* size) {
+    int tile = (int)ceilf(length / (count - (count - 1) * overlap));
+    if (tile > length) tile = length;
+    for (int i = 0; i < count; i++) {
+        offsets[i] = start + (count > 1 ? (int)lroundf((float)i * (length - tile) / (count - 1)) : 0);
+    }
+    *size = tile;
+}
+
+InferenceRequest* Server_CreateTiledRequest(ServerModel* model, uint8_t* data, size_t size,
+                                           void (*release)(void* data),
+                                           RequestContent content, int image_index,
+                                           int image_width, int image_height,
+                                           const ModelRegion* roi, int cols, int rows,
+                                           float overlap) {
+    ModelRegion whole = { 0, 0, image_width, image_height };
+    const ModelRegion* area = roi ? roi : &whole;
+    size_t max_size = content == REQUEST_CONTENT_FRAME ? MAX_FRAME_SIZE : MAX_IMAGE_SIZE;
+    if (content == REQUEST_CONTENT_TENSOR || size > max_size ||
+        area->width <= 0 || area->height <= 0 || area->x < 0 || area->y < 0 ||
+        area->x > image_width - area->width || area->y > image_height - area->height ||
+        cols < 0 || rows < 0 || overlap < 0.0f || overlap > MAX_TILE_OVERLAP) {
+        syslog(LOG_ERR, "Invalid tiling parameters (%dx%d tiles of %dx%d at %d,%d)",
+               cols, rows, area->width, area->height, area->x, area->y);
+        if (data) (release ? release : free)(data);
+        return NULL;
+    }
+
+    ServerModel* layout = model ? model : Server_AcquireModel(NULL);
+    if (!layout) {
+        syslog(LOG_ERR, "No model to lay out tiles for");
+        if (data) (release ? release : free)(data);
+        return NULL;
+    }
+
+    // Automatic axes: tiles of about the model input size, made coarser (the
+    // axis with more tiles first) until the grid fits
+    bool auto_cols = cols == 0;
+    bool auto_rows = rows == 0;
+    if (auto_cols) cols = auto_tiles(area->width, Model_GetWidth(layout->ctx), overlap);
+    if (auto_rows) rows = auto_tiles(area->height, Model_GetHeight(layout->ctx), overlap);
+    while (cols * rows > MAX_TILES) {
+        if (auto_cols && cols > 1 && (cols >= rows || !auto_rows || rows == 1)) {
+            cols--;
+        } else if (auto_rows && rows > 1) {
+            rows--;
+        } else {
+            break;
+        }
+    }
+    if (cols > area->width) cols = area->width;
+    if (rows > area->height) rows = area->height;
+    InferenceRequest* image = NULL;
+    if (cols * rows > MAX_TILES) {
+        syslog(LOG_ERR, "Too many tiles (%dx%d)", cols, rows);
+        if (data) (release ? release : free)(data);
+    } else {
+        image = Server_CreateBatch(data, size, release, cols * rows);
+    }
+    Server_SetRequestModel(image, layout);
+    if (!model) {
+        Server_ReleaseModel(layout);
+    }
+    if (!image) {
+        return NULL;
+    }
+    image->tiled = true;
+    image->content = content;
+    image->image_index = image_index;
+    image->image_width = image_width;
+    image->image_height = image_height;
+
+    int xs[MAX_TILES], ys[MAX_TILES], tile_w, tile_h;
+    tile_axis(area->x, area->width, cols, overlap, xs, &tile_w);
+    tile_axis(area->y, area->height, rows, overlap, ys, &tile_h);
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            InferenceRequest* tile = add_item(image, 0, size, content, image_index,
+                                              image_width, image_height);
+            tile->region = (ModelRegion){ xs[col], ys[row], tile_w, tile_h };
+        }
+    }
+    return image;
+}
+
+// Whole seconds until ms have passed, at least 1 (Retry-After granularity)
+static int retry_seconds(double ms) {
+    int seconds = (int)((ms + 999.0) / 1000.0);
+    return seconds < 1 ? 1 : seconds;
+}
+
+// Class and ring position of the queued request of stream_id, searched in
+// every class since a stream may change priority (-1 if none); called with
+// the queue lock held. Batches are never replaced, and claimed requests have
+// already left the queue.
+static int find_stream_request(AdmissionQueue* q, const char* stream_id, PriorityClass** found) {
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+        PriorityClass* c = &q->classes[p];
+        for (int i = 0, pos = c->head; i < c->count; i++, pos = (pos + 1) % c->capacity) {
+            const InferenceRequest* queued = c->requests[pos];
+            if (!queued->items && strcmp(queued->stream_id, stream_id) == 0) {
+                *found = c;
+                return pos;
+            }
+        }
+    }
+    return -1;
+}
+
+// Queue a request for processing
+static Admission admit_request(InferenceRequest* request, bool wait, int* retry_after) {
+    if (retry_after) *retry_after = 0;
+    if (!request || (request->items && request->item_count != request->items_pending) ||
+        request->priority < 0 || request->priority >= PRIORITY_COUNT) {
+        return ADMISSION_STOPPED;
+    }
+    if (!request->model) {
+        request->model = Server_AcquireModel(NULL);
+        if (!request->model) {
+            return ADMISSION_STOPPED;
+        }
+    }
+
+    pthread_mutex_lock(&g_server.stats_lock);
+    double p50_ms = g_server.p50_ms;
+    pthread_mutex_unlock(&g_server.stats_lock);
+
+    AdmissionQueue* q = &g_server.queue;
+    PriorityClass* c = &q->classes[request->priority];
+    pthread_mutex_lock(&q->lock);
+
+    while (wait && c->count >= c->capacity && !q->closed) {
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        return ADMISSION_STOPPED;
+    }
+
+    // Latest-only streams: a newer frame replaces the queued frame of its
+    // stream, taking its place when the priority is unchanged
+    PriorityClass* stream_class = NULL;
+    int pos = request->stream_id[0] ? find_stream_request(q, request->stream_id, &stream_class) : -1;
+    bool in_place = pos >= 0 && stream_class == c;
+
+    // Check if the class is full; a slot frees up with the next claim. Taking
+    // the place of a queued frame does not grow the class.
+    if (!in_place && c->count >= c->capacity) {
+        c->rejected++;
         g_server.busy_responses++;
-        syslog(LOG_WARNING, "Queue full, rejecting request");
-        return false;
+        pthread_mutex_unlock(&q->lock);
+        if (retry_after) *retry_after = retry_seconds(p50_ms);
+        LOG_LIMITED(LOG_LEVEL_WARNING, "Queue full (%s priority), rejecting request",
+                    priority_names[request->priority]);
+        return ADMISSION_QUEUE_FULL;
+    }
+
+    // Latency policy: requests of this and higher classes go first and are
+    // expected to take p50 each
+    int ahead = 0;
+    for (int i = 0; i < (int)request->priority; i++) {
+        ahead += q->classes[i].count;
+    }
+    if (in_place) {
+        ahead += (pos - c->head + c->capacity) % c->capacity;
+    } else {
+        ahead += c->count;
+        if (pos >= 0 && stream_class < c) ahead--;  // Leaves a class that goes first
+    }
+    double wait_ms = ahead * p50_ms;
+    if (request->deadline_ms > 0 && wait_ms > request->deadline_ms) {
+        c->rejected++;
+        g_server.busy_responses++;
+        g_server.deadline_rejections++;
+        pthread_mutex_unlock(&q->lock);
+        if (retry_after) *retry_after = retry_seconds(wait_ms - request->deadline_ms);
+        LOG_LIMITED(LOG_LEVEL_WARNING, "Estimated wait %.0f ms exceeds deadline %d ms, rejecting request",
+                    wait_ms, request->deadline_ms);
+        return ADMISSION_DEADLINE;
     }
 
-    // Add to queue
-    g_server.queue.requests[g_server.queue.tail] = request;
-    g_server.queue.tail = (g_server.queue.tail + 1) % MAX_QUEUE_SIZE;
-    g_server.queue.count++;
-    g_server.total_requests++;
+    InferenceRequest* superseded = NULL;
+    if (pos >= 0) {
+        superseded = stream_class->requests[pos];
+        g_server.superseded_requests++;
+    }
 
-    pthread_cond_signal(&g_server.queue.not_empty);
-    pthread_mutex_unlock(&g_server.queue.lock);
+    request->enqueue_ns = Latency_Now();
+    if (in_place) {
+        c->requests[pos] = request;
+    } else {
+        if (superseded) {
+            class_remove(q, stream_class, pos);
+        }
 
-    return true;
+        // Add to queue
+        c->requests[c->tail] = request;
+        c->tail = (c->tail + 1) % c->capacity;
+        c->count++;
+        q->count++;
+        pthread_cond_signal(&q->not_empty);
+    }
+    c->admitted++;
+    g_server.total_requests += request->items ? request->item_count : 1;
+    pthread_mutex_unlock(&q->lock);
+
+    if (superseded) {
+        drop_request(superseded, "Superseded by a newer frame of the stream");
+    }
+    return ADMISSION_ACCEPTED;
+}
+
+Admission Server_AdmitRequest(InferenceRequest* request, int* retry_after) {
+    return admit_request(request, false, retry_after);
+}
+
+bool Server_QueueRequest(InferenceRequest* request) {
+    return admit_request(request, false, NULL) == ADMISSION_ACCEPTED;
+}
+
+bool Server_QueueRequestWait(InferenceRequest* request) {
+    return admit_request(request, true, NULL) == ADMISSION_ACCEPTED;
+}
+
+void Server_WriteResult(JsonWriter* w, InferenceRequest* request, ModelResultFormat format) {
+    JSONW_BeginObject(w, NULL);
+    JSONW_Int(w, "index", request->image_index);
+    JSONW_Int(w, "status", request->status_code);
+
+    if (request->status_code == 200 || request->status_code == 204) {
+        Model_WriteDetections(Server_GetRequestModel(request), w, "detections", request->detections,
+                              request->detection_count,
+                              request->transform.original_width,
+                              request->transform.original_height,
+                              request->image_index, format);
+    } else if ((request->status_code == 400 || request->status_code == 504) &&
+               request->response_data) {
+        JSONW_String(w, "error", request->response_data);
+    } else if (request->status_code == 503) {
+        JSONW_String(w, "error", "Server shutting down");
+    } else {
+        JSONW_String(w, "error", "Inference failed");
+    }
+    JSONW_EndObject(w);
 }
 
 // Free request resources
@@ -290,39 +2008,69 @@ void Server_FreeRequest(InferenceRequest* request) {
         return;
     }
 
-    if (request->image_data) {
-        free(request->image_data);
+    for (int i = 0; i < request->item_count; i++) {
+        Server_FreeRequest(request->items[i]);
     }
-    if (request->content_type) {
-        free(request->content_type);
+
+    if (request->image_data) {
+        if (request->release_image) {
+            request->release_image(request->image_data);
+        } else {
+            free(request->image_data);
+        }
     }
-    if (request->response_data) {
-        cJSON_Delete((cJSON*)request->response_data);
+    // Error messages and a tiled request's decode are the only heap
+    // allocations left
+    free(request->response_data);
+    JPEG_FreeImage(&request->decoded);
+
+    // Batch items are part of the batch's arena
+    if (request->batch) {
+        pthread_mutex_destroy(&request->lock);
+        pthread_cond_destroy(&request->done);
+        return;
     }
+    Server_ReleaseModel(request->model);
+    request_return(request);
+}
 
-    pthread_mutex_destroy(&request->lock);
-    pthread_cond_destroy(&request->done);
+void Server_GetPoolStats(int* size, int* in_use, uint64_t* overflow) {
+    pthread_mutex_lock(&g_server.pool_lock);
+    if (size) *size = g_server.pool_size;
+    if (in_use) *in_use = g_server.pool_size - g_server.pool_free_count;
+    if (overflow) *overflow = g_server.pool_overflow;
+    pthread_mutex_unlock(&g_server.pool_lock);
+}
 
-    free(request);
+void Server_GetJpegConfig(JpegBackend* backend, bool* fast) {
+    if (backend) *backend = g_server.jpeg_backend;
+    if (fast) *fast = g_server.jpeg_fast;
 }
 
 // Get server statistics
 void Server_GetStats(uint64_t* total, uint64_t* success,
                     uint64_t* failed, uint64_t* busy) {
+    pthread_mutex_lock(&g_server.queue.lock);
     if (total) *total = g_server.total_requests;
+    if (busy) *busy = g_server.busy_responses;
+    pthread_mutex_unlock(&g_server.queue.lock);
+
+    pthread_mutex_lock(&g_server.stats_lock);
     if (success) *success = g_server.successful_inferences;
     if (failed) *failed = g_server.failed_inferences;
-    if (busy) *busy = g_server.busy_responses;
+    pthread_mutex_unlock(&g_server.stats_lock);
 }
 
 // Get timing statistics
 void Server_GetTiming(double* avg_ms, double* min_ms, double* max_ms) {
+    pthread_mutex_lock(&g_server.stats_lock);
     if (avg_ms) {
         *avg_ms = (g_server.successful_inferences > 0) ?
                   g_server.total_inference_time_ms / g_server.successful_inferences : 0.0;
     }
     if (min_ms) *min_ms = g_server.min_inference_time_ms;
     if (max_ms) *max_ms = g_server.max_inference_time_ms;
+    pthread_mutex_unlock(&g_server.stats_lock);
 }
 
 // Get current queue size
@@ -333,74 +2081,174 @@ int Server_GetQueueSize(void) {
     return size;
 }
 
-// Check if queue is full
-bool Server_IsQueueFull(void) {
+int Server_GetQueueCapacity(RequestPriority priority) {
+    if (priority < 0 || priority >= PRIORITY_COUNT) {
+        return 0;
+    }
+    return g_server.queue.classes[priority].capacity;
+}
+
+void Server_GetAdmissionStats(double* p50_ms, uint64_t* deadline_rejected) {
+    pthread_mutex_lock(&g_server.stats_lock);
+    if (p50_ms) *p50_ms = g_server.p50_ms;
+    pthread_mutex_unlock(&g_server.stats_lock);
+
     pthread_mutex_lock(&g_server.queue.lock);
-    bool full = (g_server.queue.count >= MAX_QUEUE_SIZE);
+    if (deadline_rejected) *deadline_rejected = g_server.deadline_rejections;
     pthread_mutex_unlock(&g_server.queue.lock);
-    return full;
 }
 
-// Store latest inference for monitoring (best-effort, non-blocking)
-void Server_StoreLatestInference(const uint8_t* image_data, size_t image_size,
-                                 const char* detections_json) {
-    if (!image_data || !detections_json || image_size == 0) {
-        return;
+void Server_GetQueueStats(double* wait_avg_ms, double* wait_max_ms,
+                          uint64_t* expired, uint64_t* superseded) {
+    pthread_mutex_lock(&g_server.stats_lock);
+    if (wait_avg_ms) {
+        *wait_avg_ms = (g_server.queue_wait_count > 0) ?
+                       g_server.total_queue_wait_ms / g_server.queue_wait_count : 0.0;
     }
+    if (wait_max_ms) *wait_max_ms = g_server.max_queue_wait_ms;
+    if (expired) *expired = g_server.expired_requests;
+    pthread_mutex_unlock(&g_server.stats_lock);
 
-    pthread_mutex_lock(&g_server.latest.lock);
+    pthread_mutex_lock(&g_server.queue.lock);
+    if (superseded) *superseded = g_server.superseded_requests;
+    pthread_mutex_unlock(&g_server.queue.lock);
+}
 
-    // Free old data if exists
-    if (g_server.latest.image_data) {
-        free(g_server.latest.image_data);
-        g_server.latest.image_data = NULL;
+void Server_GetPriorityStats(RequestPriority priority, PriorityStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (priority < 0 || priority >= PRIORITY_COUNT) {
+        return;
     }
-    if (g_server.latest.detections_json) {
-        free(g_server.latest.detections_json);
-        g_server.latest.detections_json = NULL;
+
+    pthread_mutex_lock(&g_server.queue.lock);
+    const PriorityClass* c = &g_server.queue.classes[priority];
+    stats->queued = c->count;
+    stats->capacity = c->capacity;
+    stats->weight = c->weight;
+    stats->admitted = c->admitted;
+    stats->rejected = c->rejected;
+    stats->claimed = c->claimed;
+    stats->wait_average_ms = c->claimed ? c->total_wait_ms / c->claimed : 0.0;
+    pthread_mutex_unlock(&g_server.queue.lock);
+}
+
+const char* Server_PriorityName(RequestPriority priority) {
+    if (priority < 0 || priority >= PRIORITY_COUNT) {
+        return "unknown";
     }
+    return priority_names[priority];
+}
 
-    // Store new data (copy)
-    g_server.latest.image_data = malloc(image_size);
-    if (g_server.latest.image_data) {
-        memcpy(g_server.latest.image_data, image_data, image_size);
-        g_server.latest.image_size = image_size;
-        g_server.latest.detections_json = strdup(detections_json);
-        g_server.latest.timestamp = time(NULL);
-        g_server.latest.has_data = true;
-    } else {
-        syslog(LOG_WARNING, "Failed to allocate memory for latest inference cache");
+bool Server_PriorityFromString(const char* name, RequestPriority* priority) {
+    for (int i = 0; name && i < PRIORITY_COUNT; i++) {
+        if (strcmp(name, priority_names[i]) == 0) {
+            *priority = (RequestPriority)i;
+            return true;
+        }
     }
+    return false;
+}
 
-    pthread_mutex_unlock(&g_server.latest.lock);
+// Check if queue is full (the default class, which the single-image endpoints use)
+bool Server_IsQueueFull(void) {
+    pthread_mutex_lock(&g_server.queue.lock);
+    const PriorityClass* c = &g_server.queue.classes[PRIORITY_NORMAL];
+    bool full = (c->count >= c->capacity);
+    pthread_mutex_unlock(&g_server.queue.lock);
+    return full;
 }
 
-// Get latest inference for monitoring
-bool Server_GetLatestInference(uint8_t** image_data, size_t* image_size,
-                               char** detections_json, time_t* timestamp) {
-    if (!image_data || !image_size || !detections_json || !timestamp) {
-        return false;
+void Server_ReleaseLatestInference(LatestInference* latest) {
+    if (latest && atomic_fetch_sub(&latest->refs, 1) == 1) {
+        latest->release_image(latest->image_data);
+        Server_ReleaseModel(latest->model);
+        free(latest);
     }
+}
 
-    pthread_mutex_lock(&g_server.latest.lock);
+// Store latest inference for monitoring (best-effort, non-blocking)
+void Server_StoreLatestInference(InferenceRequest* req) {
+    if (!req || !req->image_data || req->image_size == 0 || req->detection_count < 0) {
+        return;
+    }
 
-    if (!g_server.latest.has_data) {
-        pthread_mutex_unlock(&g_server.latest.lock);
-        return false;
+    // Nobody is watching: skip the allocation (and keep the last frame)
+    uint64_t polled = atomic_load_explicit(&g_server.latest_polled_ns, memory_order_relaxed);
+    if (polled == 0 || Latency_Now() - polled > (uint64_t)LATEST_IDLE_SECONDS * 1000000000ULL) {
+        return;
     }
 
-    // Copy data out
-    *image_data = malloc(g_server.latest.image_size);
-    if (!*image_data) {
-        pthread_mutex_unlock(&g_server.latest.lock);
-        return false;
+    LatestInference* latest = malloc(sizeof(LatestInference) +
+                                     req->detection_count * sizeof(ModelDetection));
+    if (!latest) {
+        LOG_LIMITED(LOG_LEVEL_WARNING, "Failed to allocate memory for latest inference cache");
+        return;
+    }
+
+    if (req->release_image == keep_batch_data) {
+        // Batch items point into the shared upload, which the batch releases
+        latest->image_data = malloc(req->image_size);
+        if (!latest->image_data) {
+            free(latest);
+            LOG_LIMITED(LOG_LEVEL_WARNING, "Failed to allocate memory for latest inference cache");
+            return;
+        }
+        memcpy(latest->image_data, req->image_data, req->image_size);
+        latest->release_image = free;
+    } else {
+        // The JPEG is not needed after preprocessing, so the frame takes it over
+        latest->image_data = req->image_data;
+        latest->release_image = req->release_image ? req->release_image : free;
+        req->image_data = NULL;
+    }
+    atomic_init(&latest->refs, 1);
+    latest->model = request_model(req);
+    pthread_mutex_lock(&g_server.model_lock);
+    latest->model->refs++;
+    pthread_mutex_unlock(&g_server.model_lock);
+    latest->image_size = req->image_size;
+    if (req->detection_count > 0) {
+        memcpy(latest->detections, req->detections,
+               req->detection_count * sizeof(ModelDetection));
     }
+    latest->detection_count = req->detection_count;
+    latest->image_width = req->transform.original_width;
+    latest->image_height = req->transform.original_height;
+    latest->image_index = req->image_index;
+    latest->timestamp = time(NULL);
+    latest->sequence = atomic_fetch_add(&g_server.latest_sequence, 1) + 1;
+
+    LatestInference* previous = atomic_exchange(&g_server.latest, latest);
+
+    // A reader that loaded the previous frame but has not taken its reference
+    // yet is still counted; that window is a few instructions long
+    while (atomic_load(&g_server.latest_readers) > 0) {
+        sched_yield();
+    }
+    Server_ReleaseLatestInference(previous);
+}
 
-    memcpy(*image_data, g_server.latest.image_data, g_server.latest.image_size);
-    *image_size = g_server.latest.image_size;
-    *detections_json = strdup(g_server.latest.detections_json);
-    *timestamp = g_server.latest.timestamp;
+LatestInference* Server_AcquireLatestInference(void) {
+    atomic_store_explicit(&g_server.latest_polled_ns, Latency_Now(), memory_order_relaxed);
 
-    pthread_mutex_unlock(&g_server.latest.lock);
-    return true;
+    atomic_fetch_add(&g_server.latest_readers, 1);
+    LatestInference* latest = atomic_load(&g_server.latest);
+    if (latest) {
+        atomic_fetch_add(&latest->refs, 1);
+    }
+    atomic_fetch_sub(&g_server.latest_readers, 1);
+    return latest;
+}
+
+void Server_WriteLatestDetections(JsonWriter* w, const char* key, const LatestInference* latest) {
+    Model_WriteDetections(latest->model->ctx, w, key, latest->detections,
+                          latest->detection_count,
+                          latest->image_width,
+                          latest->image_height,
+                          latest->image_index, MODEL_FORMAT_FULL);
+}
+
+void Server_LatestETag(const LatestInference* latest, char* etag, size_t size) {
+    snprintf(etag, size, "\"%llx-%llu\"", (unsigned long long)g_server.started,
+             (unsigned long long)latest->sequence);
 }
@@ -10,66 +10,314 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/time.h>
 #include "cJSON.h"
+#include "Model.h"
 
 // Configuration
-#define MAX_QUEUE_SIZE 3
+#define DEFAULT_QUEUE_SIZE 3               // server.max_queue_size
+#define MAX_QUEUE_LIMIT 64                 // Per priority class
+#define LATENCY_WINDOW 64                  // Recent inference times behind the p50 estimate
+#define STREAM_ID_SIZE 32                  // X-Stream-Id, including the terminator
 #define MAX_IMAGE_SIZE (10 * 1024 * 1024)  // 10MB max image size
+#define MAX_FRAME_SIZE (32 * 1024 * 1024)  // Raw frames (/inference-frame): 4K RGB fits
+#define MAX_FRAME_DIMENSION 8192
+#define MAX_BATCH_ITEMS 64                 // Images per /inference-batch request
+#define MAX_BATCH_SIZE (64 * 1024 * 1024)  // 64MB max batch upload
+#define MAX_TILES 16                       // Tiles per request (?tiles=CxR)
+#define DEFAULT_TILE_OVERLAP 0.2f          // Share of a tile also covered by its neighbour
+#define MAX_TILE_OVERLAP 0.5f
+#define PIPELINE_DEPTH 2                   // Requests buffered between pipeline stages
+#define DEFAULT_PREPROCESS_THREADS 2
+#define MAX_PREPROCESS_THREADS 8
+#define REQUEST_POOL_PER_QUEUE_ENTRY 4     // Pooled requests per admission queue entry
+#define REQUEST_ARENA_SIZE 4096            // Initial arena of a pooled request
+#define REQUEST_ARENA_MAX (256 * 1024)     // Largest arena a pool slot keeps
+#define MAX_MODELS 4                       // Named models: "model" plus the "models" list
+#define DEFAULT_MODEL_NAME "default"       // Of the "model" settings without a name
 
-// Request queue structures
+typedef enum {
+    REQUEST_CONTENT_JPEG = 0,       // image/jpeg
+    REQUEST_CONTENT_TENSOR,         // application/octet-stream, model input size
+    REQUEST_CONTENT_FRAME           // Raw image_width x image_height frame of frame_format
+} RequestContent;
+
+// Scheduling class; each has its own admission queue depth and weight
+typedef enum {
+    PRIORITY_HIGH = 0,              // Live analytics (TCP streams by default)
+    PRIORITY_NORMAL,                // Single-image endpoints by default
+    PRIORITY_LOW,                   // Bulk work (/inference-batch by default)
+    PRIORITY_COUNT
+} RequestPriority;
+
+// Bump allocator for a request's transient buffers. Reset when the request is
+// freed; overflow blocks are folded into one larger block at that point, so a
+// pool slot stops allocating once it has seen its typical load.
 typedef struct {
+    uint8_t* base;
+    size_t size;
+    size_t used;
+    struct RequestArenaBlock* overflow;
+    size_t overflow_bytes;
+} RequestArena;
+
+// Outcome of the admission decision for a request
+typedef enum {
+    ADMISSION_ACCEPTED = 0,
+    ADMISSION_QUEUE_FULL,
+    ADMISSION_DEADLINE,     // Estimated queue wait exceeds the request's deadline
+    ADMISSION_STOPPED       // Server shutting down
+} Admission;
+
+struct ServerModel;
+
+// Request queue structures
+typedef struct InferenceRequest {
     uint8_t* image_data;
     size_t image_size;
+    void (*release_image)(void* data);  // Frees image_data (free() if NULL)
     int image_index;        // For dataset validation (-1 if not specified)
     int image_width;        // Original received image width
     int image_height;       // Original received image height
-    char* content_type;
-    void* response_data;    // Will hold cJSON* response
+    int deadline_ms;        // Latency budget from X-Deadline-Ms (0: none)
+    char stream_id[STREAM_ID_SIZE];     // Latest-only stream (X-Stream-Id, "" for none)
+    RequestPriority priority;
+    struct ServerModel* model;      // Referenced model (NULL: the default at admission; items use their batch's)
+    RequestContent content;
+    VdoFormat frame_format;         // REQUEST_CONTENT_FRAME: NV12 (VDO_FORMAT_YUV) or RGB
+    ModelRegion region;             // Tiles: part of their request's image to run
+    ModelDetection* detections;     // Postprocess result (in the arena), formatted per response
+    int detection_count;            // -1 if postprocessing failed
+    char* response_data;    // Error message for the response, if any
     int status_code;
+
+    // Pipeline state (owned by whichever stage currently holds the request)
+    int slot;               // Model tensor slot holding input/output (-1 if none)
+    ModelTransform transform;
+    uint64_t enqueue_ns;    // Admitted (batch items: their batch); Latency_Now() clock
+    uint64_t start_ns;      // Claimed by a preprocess worker
+    uint64_t submit_ns;     // Job handed to larod (slot head only)
+
+    // Batch uploads: the batch owns the data and takes one admission queue
+    // entry; preprocess workers claim its items in order
+    struct InferenceRequest* batch;     // Owning batch (items only)
+    struct InferenceRequest** items;    // Batch only: items in request order
+    int item_count;
+    int items_claimed;      // Batch only: handed to preprocess workers
+    int items_pending;      // Batch only: not yet completed
+
+    // Tiled requests: a batch whose items are regions of its one image. The
+    // first tile to be preprocessed decodes a JPEG for all of them; once the
+    // last is done their detections are merged into the batch.
+    bool tiled;
+    DecodedImage decoded;   // Shared decode (data NULL until then)
+    bool decode_failed;     // Error message in response_data
+
+    // Requests sharing one job on models with a batch dimension: the first
+    // holds the slot, the others follow through slot_next
+    struct InferenceRequest* slot_next;
+    int slot_item;          // Position in the slot's batch
+
+    bool processed;
+
+    // Called once the request is processed, instead of someone waiting on
+    // done; the callback owns the request (batch items cannot have one)
+    void (*on_complete)(struct InferenceRequest* req, void* user_data);
+    void* user_data;
+
+    // Kept across reuse of a pool slot (everything above is cleared)
     pthread_mutex_t lock;
     pthread_cond_t done;
-    bool processed;
+    RequestArena arena;     // Batch items allocate from their batch's arena
+    bool pooled;            // Returned to the pool instead of freed
 } InferenceRequest;
 
 typedef struct {
-    InferenceRequest* requests[MAX_QUEUE_SIZE];
+    InferenceRequest** requests;
+    int capacity;
     int head;
     int tail;
     int count;
+    bool closed;            // Set on shutdown; wakes all waiters
     pthread_mutex_t lock;
     pthread_cond_t not_empty;
     pthread_cond_t not_full;
 } RequestQueue;
 
-// Latest inference cache (for monitoring)
+// One priority class of the admission queue (guarded by the admission lock)
+typedef struct {
+    InferenceRequest** requests;
+    int capacity;           // server.priorities.<class>.max_queue_size
+    int head;
+    int tail;
+    int count;
+    int weight;             // Share of claims while other classes wait too
+    int credit;             // Smooth weighted round-robin state
+    uint64_t admitted;
+    uint64_t rejected;      // Queue full or deadline
+    uint64_t claimed;       // Requests (batch items) handed to preprocessing
+    double total_wait_ms;   // Admission to claim, over claimed
+} PriorityClass;
+
+// Admission queue: one ring per priority class behind a single lock, so
+// admission and scheduling each are one decision
 typedef struct {
+    PriorityClass classes[PRIORITY_COUNT];
+    int count;              // Queued in all classes
+    bool closed;            // Set on shutdown; wakes all waiters
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;    // Broadcast, waiters may wait for different classes
+} AdmissionQueue;
+
+// Priority class counters for /health
+typedef struct {
+    int queued;
+    int capacity;
+    int weight;
+    uint64_t admitted;
+    uint64_t rejected;
+    uint64_t claimed;
+    double wait_average_ms;
+} PriorityStats;
+
+// Frames are only kept while a monitor has asked for one this recently
+#define LATEST_IDLE_SECONDS 10
+
+// Latest inference (for monitoring): an immutable, reference-counted frame.
+// The JPEG is the request's own buffer, adopted instead of copied; detections
+// are formatted on read.
+typedef struct {
+    _Atomic int refs;
     uint8_t* image_data;       // JPEG image data
     size_t image_size;
-    char* detections_json;     // JSON string of detections
+    void (*release_image)(void* data);
+    int detection_count;
+    int image_width;
+    int image_height;
+    int image_index;
     time_t timestamp;
-    pthread_mutex_t lock;
-    bool has_data;
+    uint64_t sequence;         // Per stored frame, for the ETag
+    struct ServerModel* model; // Referenced, for the labels
+    ModelDetection detections[];
 } LatestInference;
 
+// A loaded model with its own inference and postprocess threads; the
+// preprocess workers are shared. Requests hold a reference from the moment
+// they are given the model until they are freed, so a model replaced by a
+// reload finishes the requests it has and is destroyed after the last one.
+typedef struct ServerModel {
+    int refs;                       // Registry and requests (model lock)
+    ModelContext* ctx;
+    uint64_t generation;            // Loads of its name, 1 for the first
+    time_t loaded;
+    RequestQueue ready;             // Filled slots waiting to be submitted
+    RequestQueue post;              // Finished jobs, one entry per tensor slot
+    pthread_t inference_thread;
+    pthread_t postprocess_thread;
+    bool threads_started;
+} ServerModel;
+
+// One configured name. Loads run on a loader thread per entry: the new
+// model is swapped in once it is ready, then the old one is drained.
+typedef struct {
+    char name[MODEL_NAME_SIZE];
+    bool configured;                // Named in the settings (entries are reused)
+    ServerModel* current;           // NULL until a load succeeds
+    char* config;                   // Settings last loaded or scheduled, printed
+    cJSON* pending;                 // Settings to load next (NULL: none)
+    bool unload;                    // Retire current once pending loads are done
+    char* error;                    // Last failed load
+    uint64_t loads;
+    ModelDescription desc;          // From the cache or the last load
+    bool described;
+    bool loading;                   // Loader thread running
+    uint64_t loading_since;         // Latency_Now() when the running load started
+    bool loader_joinable;
+    pthread_t loader;
+} ModelEntry;
+
+// Registry snapshot of one model for /health, /models and /capabilities
+typedef struct {
+    char name[MODEL_NAME_SIZE];
+    bool is_default;
+    bool loaded;
+    bool loading;
+    uint64_t generation;
+    int in_use;                     // Requests referencing the current model
+    bool described;                 // desc is known, also before the first load is done
+    ModelDescription desc;
+    int retry_after;                // Expected seconds until loading is done (0: unknown)
+    char error[128];                // Last failed load ("" if none)
+} ServerModelInfo;
+
 // Server state
+//
+// Requests flow through three stages connected by bounded queues:
+//   queue (admission) -> preprocess workers -> ready -> inference thread
+//   -> larod (async, one job per tensor slot) -> post -> postprocess thread
+// The ready and post queues and the threads behind them belong to the
+// request's model. Preprocess workers block on a free tensor slot and a full
+// downstream queue blocks the upstream stage, which in turn fills the
+// admission queue and makes new requests get a 503.
 typedef struct {
     bool running;
-    pthread_t inference_thread;
-    RequestQueue queue;
+    pthread_t preprocess_threads[MAX_PREPROCESS_THREADS];
+    int preprocess_thread_count;
+    JpegBackend jpeg_backend;          // Decoder each preprocess worker creates
+    bool jpeg_fast;                    // TurboJPEG fast DCT/upsampling
+    AdmissionQueue queue;
+    pthread_mutex_t stats_lock;
+
+    // Model registry; entry 0 is the default model ("model" settings)
+    ModelEntry models[MAX_MODELS];
+    int model_count;                   // Entries in use, configured or not
+    pthread_mutex_t model_lock;
+    pthread_cond_t model_released;     // A model reference was released
+    bool models_closed;                // Shutting down: no more loads
+
+    // Preallocated requests (admission capacity of all classes *
+    // REQUEST_POOL_PER_QUEUE_ENTRY); requests beyond that come from the heap
+    // and count as overflow
+    int max_queue_size;
+    InferenceRequest* pool;
+    InferenceRequest** pool_free;
+    int pool_size;
+    int pool_free_count;
+    uint64_t pool_overflow;
+    pthread_mutex_t pool_lock;
 
     // Statistics
     uint64_t total_requests;
     uint64_t successful_inferences;
     uint64_t failed_inferences;
-    uint64_t busy_responses;
+    uint64_t busy_responses;            // Rejected at admission (queue lock)
+    uint64_t deadline_rejections;       // Part of busy_responses (queue lock)
+    uint64_t superseded_requests;       // Replaced by a newer frame of their stream (queue lock)
+    uint64_t expired_requests;          // Deadline passed while queued, answered 504
 
     // Timing statistics (in milliseconds)
     double total_inference_time_ms;
     double min_inference_time_ms;
     double max_inference_time_ms;
+    double recent_ms[LATENCY_WINDOW];   // Ring of the latest inference times
+    int recent_count;
+    int recent_next;
+    double p50_ms;                      // Median of recent_ms, 0 until measured
+    double total_queue_wait_ms;         // Admission to preprocess, every claimed request
+    double max_queue_wait_ms;
+    uint64_t queue_wait_count;
 
-    // Latest inference cache
-    LatestInference latest;
+    // Latest inference cache: swapped atomically; readers in the middle of
+    // taking a reference are counted so the writer knows when the old frame
+    // can no longer be picked up
+    LatestInference* _Atomic latest;
+    _Atomic int latest_readers;
+    _Atomic uint64_t latest_sequence;
+    _Atomic uint64_t latest_polled_ns;  // Last monitor read (0: never)
+    time_t started;                     // Distinguishes ETags across restarts
 } ServerState;
 
 // Server lifecycle
@@ -77,26 +325,123 @@ bool Server_Init(void);
 void Server_Cleanup(void);
 bool Server_IsRunning(void);
 
-// Request processing
+// Request processing; requests and batches start at PRIORITY_NORMAL
 InferenceRequest* Server_CreateRequest(const uint8_t* data, size_t size,
-                                      const char* content_type, int image_index,
+                                      RequestContent content, int image_index,
                                       int image_width, int image_height);
+// Like Server_CreateRequest, but takes ownership of data instead of copying it.
+// release frees data from Server_FreeRequest; it is also called if creation fails.
+InferenceRequest* Server_AdoptRequest(uint8_t* data, size_t size,
+                                     void (*release)(void* data),
+                                     RequestContent content, int image_index,
+                                     int image_width, int image_height);
+// Batch of count items over one upload buffer (adopted as in Server_AdoptRequest).
+// Add every item with Server_AddBatchItem, then queue it with Server_QueueRequest;
+// it is processed once all items are. Server_FreeRequest frees the items too.
+InferenceRequest* Server_CreateBatch(uint8_t* data, size_t size,
+                                    void (*release)(void* data), int count);
+// Item over size bytes at offset into the batch data
+bool Server_AddBatchItem(InferenceRequest* batch, size_t offset, size_t size,
+                         RequestContent content, int image_index,
+                         int image_width, int image_height);
+// Request over parts of one JPEG or frame (adopted as in Server_AdoptRequest):
+// roi (NULL: the whole image) split into a cols x rows grid of tiles that
+// overlap by overlap (0 .. MAX_TILE_OVERLAP) of a tile. cols or rows of 0
+// picks as many as it takes for tiles of about the model input size, within
+// MAX_TILES. Tiles go through the pipeline like batch items, and the request
+// is answered like a single one with the detections merged in image coordinates.
+// The grid is laid out for model (NULL: the default), which the request uses.
+// Queue it with Server_QueueRequest; set frame_format before that for frames.
+InferenceRequest* Server_CreateTiledRequest(ServerModel* model, uint8_t* data, size_t size,
+                                           void (*release)(void* data),
+                                           RequestContent content, int image_index,
+                                           int image_width, int image_height,
+                                           const ModelRegion* roi, int cols, int rows,
+                                           float overlap);
+// Admit request to the queue of its priority class in one decision under the
+// queue lock. Rejected when that class is full, or when request->deadline_ms
+// is set and the estimated wait (requests queued in this and higher classes x
+// recent p50 inference time) exceeds it.
+// retry_after (optional) gets the seconds after which a retry is likely to
+// be admitted (0 when shutting down). The caller still owns a rejected request.
+// A request with a stream_id replaces a queued, unclaimed request of the same
+// stream (in any class), which is answered 504. With the same priority it
+// takes that request's place: the class limit does not apply, and the
+// deadline estimate counts the requests ahead of that place. A request that
+// is still queued once its deadline has passed is answered 504 without being
+// run.
+Admission Server_AdmitRequest(InferenceRequest* request, int* retry_after);
+// Server_AdmitRequest(request, NULL) == ADMISSION_ACCEPTED
 bool Server_QueueRequest(InferenceRequest* request);
+// Like Server_QueueRequest, but waits for queue space; fails only once the
+// server stops
+bool Server_QueueRequestWait(InferenceRequest* request);
 void Server_FreeRequest(InferenceRequest* request);
 
+// Write the result object {index, status, detections | error} of a processed
+// request, with detections in format (full or lean)
+void Server_WriteResult(JsonWriter* w, InferenceRequest* request, ModelResultFormat format);
+
 // Statistics
 void Server_GetStats(uint64_t* total, uint64_t* success,
                     uint64_t* failed, uint64_t* busy);
 void Server_GetTiming(double* avg_ms, double* min_ms, double* max_ms);
+// Request pool occupancy; overflow counts requests that had to use the heap
+void Server_GetPoolStats(int* size, int* in_use, uint64_t* overflow);
+// JPEG decoder configuration of the preprocess workers (server.jpeg_decoder, jpeg_fast_decode)
+void Server_GetJpegConfig(JpegBackend* backend, bool* fast);
 
 // Queue status
 int Server_GetQueueSize(void);
+// Admission queue depth of one priority class
+int Server_GetQueueCapacity(RequestPriority priority);
 bool Server_IsQueueFull(void);
+// Admission estimate inputs
+void Server_GetAdmissionStats(double* p50_ms, uint64_t* deadline_rejected);
+// Time from admission to preprocessing, and requests dropped unrun (504)
+void Server_GetQueueStats(double* wait_avg_ms, double* wait_max_ms,
+                          uint64_t* expired, uint64_t* superseded);
+void Server_GetPriorityStats(RequestPriority priority, PriorityStats* stats);
+
+// "high", "normal" or "low"
+const char* Server_PriorityName(RequestPriority priority);
+// Returns false for an unknown name
+bool Server_PriorityFromString(const char* name, RequestPriority* priority);
+
+// Model registry. Names are "model.name" (default "default") for the
+// "model" settings and the "name" of each object in "models"; those
+// objects override the "model" settings for their model.
+// Reference to the current model of name (NULL: the default); NULL if the
+// name is unknown or has no loaded model. Release with Server_ReleaseModel.
+ServerModel* Server_AcquireModel(const char* name);
+void Server_ReleaseModel(ServerModel* model);
+// Run request (not yet queued) on model; the request takes its own reference
+void Server_SetRequestModel(InferenceRequest* request, ServerModel* model);
+// Context a request runs on (NULL before it has a model)
+ModelContext* Server_GetRequestModel(const InferenceRequest* request);
+// Reload name from the current settings in the background; the old model
+// serves until the new one is ready and is freed once its requests are done.
+// false if the name is unknown.
+bool Server_ReloadModel(const char* name);
+// Apply changed "model"/"models" settings: load new names, reload models
+// whose settings changed and unload removed ones, all in the background
+void Server_ConfigureModels(void);
+// Snapshot of the registry, default model first; returns the number written
+int Server_ListModels(ServerModelInfo* info, int max);
+// Snapshot of one model; false if the name is unknown
+bool Server_GetModelInfo(const char* name, ServerModelInfo* info);
 
-// Latest inference cache (for monitoring)
-void Server_StoreLatestInference(const uint8_t* image_data, size_t image_size,
-                                 const char* detections_json);
-bool Server_GetLatestInference(uint8_t** image_data, size_t* image_size,
-                               char** detections_json, time_t* timestamp);
+// Latest inference cache (for monitoring). Storing takes over the request's
+// image buffer (batch items are copied) and is skipped while no monitor has
+// read a frame for LATEST_IDLE_SECONDS.
+void Server_StoreLatestInference(InferenceRequest* request);
+// Reference to the latest frame (NULL if none yet); never blocks the writer.
+// Release with Server_ReleaseLatestInference.
+LatestInference* Server_AcquireLatestInference(void);
+void Server_ReleaseLatestInference(LatestInference* latest);
+// Detections of a frame as the full-format JSON array
+void Server_WriteLatestDetections(JsonWriter* w, const char* key, const LatestInference* latest);
+// Quoted ETag of a frame, unique across restarts
+void Server_LatestETag(const LatestInference* latest, char* etag, size_t size);
 
 #endif // SERVER_H
@@ -0,0 +1,492 @@
+/**
+ * stream.c - Persistent Inference Streams Implementation
+ *
+ * One reader thread per connection turns frames into requests; results are
+ * queued by the completion callback and sent by a writer thread, so a slow
+ * client never stalls the pipeline.
+ */
+
+#include "stream.h"
+#include "server.h"
+#include "Model.h"
+#include "jpeg_decoder.h"
+#include "jsonwriter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define FRAME_HEADER 8
+#define SEND_TIMEOUT_S 5
+
+typedef struct StreamResult {
+    struct StreamResult* next;
+    size_t size;
+    uint8_t data[];         // Frame header + JSON
+} StreamResult;
+
+typedef struct {
+    int fd;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int in_flight;          // Frames queued or running in the pipeline
+    bool reading;           // Cleared once the reader stops taking frames
+    StreamResult* head;     // Results waiting for the writer
+    StreamResult* tail;
+} StreamConnection;
+
+static struct {
+    bool running;
+    int port;
+    int listen_fd;
+    char* token;
+    pthread_t listener;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    StreamConnection* connections[STREAM_MAX_CONNECTIONS];
+    int connection_count;
+    uint64_t frames;
+    uint64_t rejected;
+} g_stream = { .listen_fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER, .idle = PTHREAD_COND_INITIALIZER };
+
+static uint32_t read_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void write_le32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static bool read_full(int fd, uint8_t* buf, size_t size) {
+    while (size > 0) {
+        ssize_t n = recv(fd, buf, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool send_full(int fd, const uint8_t* buf, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, buf, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Results
+//-----------------------------------------------------------------------------
+
+// Queue the result in w for the writer; called with conn->lock held
+static void push_result(StreamConnection* conn, int index, const JsonWriter* w) {
+    const char* json = JSONW_Data(w);
+    if (!json) {
+        syslog(LOG_WARNING, "Stream: failed to format result %d", index);
+        return;
+    }
+
+    size_t json_size = JSONW_Length(w);
+    StreamResult* entry = malloc(sizeof(StreamResult) + FRAME_HEADER + json_size);
+    if (entry) {
+        entry->next = NULL;
+        entry->size = FRAME_HEADER + json_size;
+        write_le32(entry->data, (uint32_t)index);
+        write_le32(entry->data + 4, (uint32_t)json_size);
+        memcpy(entry->data + FRAME_HEADER, json, json_size);
+
+        if (conn->tail) {
+            conn->tail->next = entry;
+        } else {
+            conn->head = entry;
+        }
+        conn->tail = entry;
+        pthread_cond_broadcast(&conn->changed);
+    }
+}
+
+// Answer a frame that never reached the pipeline
+static void push_error(StreamConnection* conn, int index, int status, const char* error) {
+    pthread_mutex_lock(&g_stream.lock);
+    g_stream.rejected++;
+    pthread_mutex_unlock(&g_stream.lock);
+
+    JsonWriter* w = JSONW_Thread();
+    JSONW_BeginObject(w, NULL);
+    JSONW_Int(w, "index", index);
+    JSONW_Int(w, "status", status);
+    JSONW_String(w, "error", error);
+    JSONW_EndObject(w);
+
+    pthread_mutex_lock(&conn->lock);
+    push_result(conn, index, w);
+    pthread_mutex_unlock(&conn->lock);
+}
+
+// Completion callback; runs on whichever pipeline thread finished the request
+static void on_frame_done(InferenceRequest* req, void* user_data) {
+    StreamConnection* conn = (StreamConnection*)user_data;
+    int index = req->image_index;
+    JsonWriter* w = JSONW_Thread();
+    Server_WriteResult(w, req, MODEL_FORMAT_FULL);
+    Server_FreeRequest(req);
+
+    pthread_mutex_lock(&conn->lock);
+    push_result(conn, index, w);
+    conn->in_flight--;
+    pthread_cond_broadcast(&conn->changed);
+    pthread_mutex_unlock(&conn->lock);
+}
+
+static void* writer_thread(void* arg) {
+    StreamConnection* conn = (StreamConnection*)arg;
+    bool broken = false;
+
+    pthread_mutex_lock(&conn->lock);
+    for (;;) {
+        while (!conn->head && (conn->reading || conn->in_flight > 0)) {
+            pthread_cond_wait(&conn->changed, &conn->lock);
+        }
+        StreamResult* entry = conn->head;
+        if (!entry) {
+            break;
+        }
+        conn->head = entry->next;
+        if (!conn->head) conn->tail = NULL;
+        pthread_mutex_unlock(&conn->lock);
+
+        // Keep draining after a failed send so completions are still released
+        if (!broken && !send_full(conn->fd, entry->data, entry->size)) {
+            broken = true;
+            shutdown(conn->fd, SHUT_RD);
+        }
+        free(entry);
+        pthread_mutex_lock(&conn->lock);
+    }
+    pthread_mutex_unlock(&conn->lock);
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Connections
+//-----------------------------------------------------------------------------
+
+// Turn one frame payload into a queued request; takes ownership of data
+// Frames run on the default model
+static void submit_frame(StreamConnection* conn, int index, uint8_t* data, size_t size) {
+    ServerModel* model = Server_AcquireModel(NULL);
+    RequestContent content;
+    int width, height;
+
+    if (!model) {
+        free(data);
+        push_error(conn, index, 503, "Model not loaded");
+        return;
+    }
+    if (size >= 2 && data[0] == 0xFF && data[1] == 0xD8) {
+        if (!JPEG_GetDimensions(data, size, &width, &height)) {
+            Server_ReleaseModel(model);
+            free(data);
+            push_error(conn, index, 400, "Invalid JPEG image");
+            return;
+        }
+        content = REQUEST_CONTENT_JPEG;
+    } else if (size == Model_GetInputSize(model->ctx)) {
+        content = REQUEST_CONTENT_TENSOR;
+        width = Model_GetWidth(model->ctx);
+        height = Model_GetHeight(model->ctx);
+    } else {
+        Server_ReleaseModel(model);
+        free(data);
+        push_error(conn, index, 400, "Not a JPEG and not a model input tensor");
+        return;
+    }
+
+    InferenceRequest* req = Server_AdoptRequest(data, size, NULL, content,
+                                                index, width, height);
+    Server_SetRequestModel(req, model);
+    Server_ReleaseModel(model);
+    if (!req) {
+        push_error(conn, index, 500, "Failed to create request");
+        return;
+    }
+    req->on_complete = on_frame_done;
+    req->user_data = conn;
+    req->priority = PRIORITY_HIGH;      // Streams are the live traffic
+
+    pthread_mutex_lock(&conn->lock);
+    conn->in_flight++;
+    pthread_mutex_unlock(&conn->lock);
+
+    // Streams wait for queue space rather than dropping frames; the
+    // in-flight limit keeps one client from holding the whole queue
+    if (!Server_QueueRequestWait(req)) {
+        pthread_mutex_lock(&conn->lock);
+        conn->in_flight--;
+        pthread_mutex_unlock(&conn->lock);
+        Server_FreeRequest(req);
+        push_error(conn, index, 503, "Server shutting down");
+        return;
+    }
+
+    pthread_mutex_lock(&g_stream.lock);
+    g_stream.frames++;
+    pthread_mutex_unlock(&g_stream.lock);
+}
+
+static void read_frames(StreamConnection* conn) {
+    bool authenticated = !g_stream.token;
+    uint8_t header[FRAME_HEADER];
+
+    for (;;) {
+        // Stop reading while the client has enough frames in flight
+        pthread_mutex_lock(&conn->lock);
+        while (conn->in_flight >= STREAM_MAX_IN_FLIGHT) {
+            pthread_cond_wait(&conn->changed, &conn->lock);
+        }
+        pthread_mutex_unlock(&conn->lock);
+
+        if (!read_full(conn->fd, header, sizeof(header))) {
+            return;
+        }
+        int index = (int32_t)read_le32(header);
+        size_t size = read_le32(header + 4);
+        if (size == 0 || size > MAX_IMAGE_SIZE) {
+            // The stream cannot be resynchronized after a bad length
+            push_error(conn, index, 413, "Invalid frame length");
+            return;
+        }
+
+        // Nothing larger than the token is buffered before authentication
+        if (!authenticated && size != strlen(g_stream.token)) {
+            push_error(conn, index, 401, "Invalid token");
+            return;
+        }
+
+        uint8_t* data = malloc(size);
+        if (!data) {
+            push_error(conn, index, 500, "Out of memory");
+            return;
+        }
+        if (!read_full(conn->fd, data, size)) {
+            free(data);
+            return;
+        }
+
+        if (!authenticated) {
+            authenticated = memcmp(data, g_stream.token, size) == 0;
+            free(data);
+            if (!authenticated) {
+                push_error(conn, index, 401, "Invalid token");
+                return;
+            }
+            continue;
+        }
+
+        submit_frame(conn, index, data, size);
+    }
+}
+
+static void unregister_connection(StreamConnection* conn) {
+    pthread_mutex_lock(&g_stream.lock);
+    for (int i = 0; i < g_stream.connection_count; i++) {
+        if (g_stream.connections[i] == conn) {
+            g_stream.connections[i] = g_stream.connections[--g_stream.connection_count];
+            break;
+        }
+    }
+    pthread_cond_broadcast(&g_stream.idle);
+    pthread_mutex_unlock(&g_stream.lock);
+}
+
+static void* connection_thread(void* arg) {
+    StreamConnection* conn = (StreamConnection*)arg;
+
+    if (pthread_create(&conn->writer, NULL, writer_thread, conn) == 0) {
+        read_frames(conn);
+
+        // Writer exits once every in-flight frame is answered
+        pthread_mutex_lock(&conn->lock);
+        conn->reading = false;
+        pthread_cond_broadcast(&conn->changed);
+        pthread_mutex_unlock(&conn->lock);
+        pthread_join(conn->writer, NULL);
+    } else {
+        syslog(LOG_ERR, "Stream: failed to create writer thread");
+    }
+
+    syslog(LOG_INFO, "Stream: connection closed");
+    unregister_connection(conn);
+    close(conn->fd);
+    pthread_cond_destroy(&conn->changed);
+    pthread_mutex_destroy(&conn->lock);
+    free(conn);
+    return NULL;
+}
+
+static void start_connection(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval timeout = { .tv_sec = SEND_TIMEOUT_S };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    StreamConnection* conn = calloc(1, sizeof(StreamConnection));
+    if (!conn) {
+        close(fd);
+        return;
+    }
+    conn->fd = fd;
+    conn->reading = true;
+    pthread_mutex_init(&conn->lock, NULL);
+    pthread_cond_init(&conn->changed, NULL);
+
+    pthread_mutex_lock(&g_stream.lock);
+    if (!g_stream.running || g_stream.connection_count >= STREAM_MAX_CONNECTIONS) {
+        pthread_mutex_unlock(&g_stream.lock);
+        syslog(LOG_WARNING, "Stream: connection refused (%d connections open)",
+               STREAM_MAX_CONNECTIONS);
+        pthread_cond_destroy(&conn->changed);
+        pthread_mutex_destroy(&conn->lock);
+        free(conn);
+        close(fd);
+        return;
+    }
+    g_stream.connections[g_stream.connection_count++] = conn;
+    pthread_mutex_unlock(&g_stream.lock);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, connection_thread, conn) != 0) {
+        syslog(LOG_ERR, "Stream: failed to create connection thread");
+        unregister_connection(conn);
+        pthread_cond_destroy(&conn->changed);
+        pthread_mutex_destroy(&conn->lock);
+        free(conn);
+        close(fd);
+        return;
+    }
+    pthread_detach(thread);
+    syslog(LOG_INFO, "Stream: connection opened");
+}
+
+// Runs until Stream_Stop shuts the listening socket down
+static void* listener_thread(void* arg) {
+    for (;;) {
+        int fd = accept(g_stream.listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            int error = errno;
+            pthread_mutex_lock(&g_stream.lock);
+            bool running = g_stream.running;
+            pthread_mutex_unlock(&g_stream.lock);
+            if (running) {
+                syslog(LOG_WARNING, "Stream: accept failed: %s", strerror(error));
+            }
+            break;
+        }
+        start_connection(fd);
+    }
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Lifecycle
+//-----------------------------------------------------------------------------
+
+bool Stream_Start(int port, const char* token) {
+    if (port <= 0) {
+        syslog(LOG_INFO, "Stream: disabled");
+        return true;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        syslog(LOG_ERR, "Stream: socket failed: %s", strerror(errno));
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(fd, STREAM_MAX_CONNECTIONS) != 0) {
+        syslog(LOG_ERR, "Stream: cannot listen on port %d: %s", port, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    g_stream.listen_fd = fd;
+    g_stream.port = port;
+    g_stream.token = (token && token[0]) ? strdup(token) : NULL;
+    g_stream.running = true;
+    if (pthread_create(&g_stream.listener, NULL, listener_thread, NULL) != 0) {
+        syslog(LOG_ERR, "Stream: failed to create listener thread");
+        g_stream.running = false;
+        close(fd);
+        g_stream.listen_fd = -1;
+        free(g_stream.token);
+        g_stream.token = NULL;
+        return false;
+    }
+
+    syslog(LOG_INFO, "Stream: listening on port %d%s", port,
+           g_stream.token ? " (token required)" : "");
+    return true;
+}
+
+void Stream_Stop(void) {
+    if (g_stream.listen_fd < 0) {
+        return;
+    }
+
+    // Wakes accept() in the listener
+    pthread_mutex_lock(&g_stream.lock);
+    g_stream.running = false;
+    pthread_mutex_unlock(&g_stream.lock);
+    shutdown(g_stream.listen_fd, SHUT_RDWR);
+    pthread_join(g_stream.listener, NULL);
+    close(g_stream.listen_fd);
+    g_stream.listen_fd = -1;
+
+    // Readers see end of stream; each connection closes once its frames are answered
+    pthread_mutex_lock(&g_stream.lock);
+    for (int i = 0; i < g_stream.connection_count; i++) {
+        shutdown(g_stream.connections[i]->fd, SHUT_RD);
+    }
+    while (g_stream.connection_count > 0) {
+        pthread_cond_wait(&g_stream.idle, &g_stream.lock);
+    }
+    g_stream.port = 0;
+    pthread_mutex_unlock(&g_stream.lock);
+
+    free(g_stream.token);
+    g_stream.token = NULL;
+    syslog(LOG_INFO, "Stream: stopped");
+}
+
+void Stream_GetStats(int* port, int* connections, uint64_t* frames, uint64_t* rejected) {
+    pthread_mutex_lock(&g_stream.lock);
+    if (port) *port = g_stream.port;
+    if (connections) *connections = g_stream.connection_count;
+    if (frames) *frames = g_stream.frames;
+    if (rejected) *rejected = g_stream.rejected;
+    pthread_mutex_unlock(&g_stream.lock);
+}
@@ -0,0 +1,56 @@
+/**
+ * stream.h - Persistent Inference Streams
+ *
+ * Raw TCP listener for continuous analytics: a client keeps one connection
+ * open, pushes frames and reads detections back asynchronously, skipping the
+ * per-request FastCGI setup.
+ *
+ * Both directions use the /inference-batch item framing, one frame at a time:
+ *
+ *   int32 index (little-endian)    Sequence number chosen by the client
+ *   uint32 length (little-endian)  Payload bytes
+ *   payload                        Client: JPEG or raw RGB tensor of the model
+ *                                  input size. Server: JSON result
+ *                                  {index, status, detections | error}
+ *
+ * Results carry the index of their frame and may arrive out of order. While
+ * the admission queue is full, frames wait instead of getting a 503. If a
+ * token is configured, the payload of the first frame must equal it; a first
+ * frame of another length is answered 401 before its payload is read.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STREAM_MAX_CONNECTIONS 4
+#define STREAM_MAX_IN_FLIGHT 4     // Frames per connection queued or running
+
+/**
+ * @brief Start listening on port (0 leaves streaming disabled)
+ *
+ * @param token  Shared secret the first frame must carry (NULL or "" for none)
+ * @return false if the listener could not be started
+ */
+bool Stream_Start(int port, const char* token);
+
+/**
+ * @brief Close the listener and every connection
+ *
+ * Frames still in the pipeline are answered before their connection closes,
+ * so call this before Server_Cleanup.
+ */
+void Stream_Stop(void);
+
+/**
+ * @brief Stream counters for /health
+ *
+ * @param port  Listening port (0 when disabled)
+ * @param frames  Frames handed to the pipeline
+ * @param rejected  Frames answered with an error without being run
+ */
+void Stream_GetStats(int* port, int* connections, uint64_t* frames, uint64_t* rejected);
+
+#endif // STREAM_H
@@ -0,0 +1,186 @@
+/**
+ * tflite.c - TFLite Model File Introspection Implementation
+ *
+ * FlatBuffer layout used here (all little-endian): the file starts with the
+ * offset of the root table. A table starts with the signed distance back to
+ * its vtable, which lists the offset of each field in the table (0: absent,
+ * the default applies). Tables, vectors and strings are referenced by
+ * unsigned offsets relative to where the reference is stored, and vectors
+ * start with their length.
+ *
+ * Schema path: Model.subgraphs[0] (field 2) -> SubGraph.tensors (0),
+ * .inputs (1), .outputs (2) -> Tensor.shape (0), .type (1),
+ * .quantization (4) -> QuantizationParameters.scale (2), .zero_point (3).
+ */
+
+#include "tflite.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MODEL_SUBGRAPHS 2
+#define SUBGRAPH_TENSORS 0
+#define SUBGRAPH_INPUTS 1
+#define SUBGRAPH_OUTPUTS 2
+#define TENSOR_SHAPE 0
+#define TENSOR_TYPE 1
+#define TENSOR_QUANTIZATION 4
+#define QUANTIZATION_SCALE 2
+#define QUANTIZATION_ZERO_POINT 3
+
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    bool bad;               // An offset pointed outside the file
+} FlatBuffer;
+
+static bool fits(FlatBuffer* fb, size_t pos, size_t length) {
+    if (pos > fb->size || length > fb->size - pos) {
+        fb->bad = true;
+        return false;
+    }
+    return true;
+}
+
+static uint32_t read_u32(FlatBuffer* fb, size_t pos) {
+    uint32_t v = 0;
+    if (fits(fb, pos, sizeof(v))) memcpy(&v, fb->data + pos, sizeof(v));
+    return v;
+}
+
+static uint16_t read_u16(FlatBuffer* fb, size_t pos) {
+    uint16_t v = 0;
+    if (fits(fb, pos, sizeof(v))) memcpy(&v, fb->data + pos, sizeof(v));
+    return v;
+}
+
+// Position of field of the table at table, 0 if absent
+static size_t field(FlatBuffer* fb, size_t table, int index) {
+    int32_t back = (int32_t)read_u32(fb, table);
+    size_t vtable = (size_t)((int64_t)table - back);
+    uint16_t vtable_size = read_u16(fb, vtable);
+    size_t entry = 4 + 2 * (size_t)index;
+    if (fb->bad || entry + 2 > vtable_size) {
+        return 0;
+    }
+    uint16_t offset = read_u16(fb, vtable + entry);
+    return offset ? table + offset : 0;
+}
+
+// Follow the reference stored at pos (0 stays 0)
+static size_t deref(FlatBuffer* fb, size_t pos) {
+    if (!pos) return 0;
+    uint32_t offset = read_u32(fb, pos);
+    return fb->bad ? 0 : pos + offset;
+}
+
+// Vector referenced by field: its length and the position of element 0
+static uint32_t vector(FlatBuffer* fb, size_t table, int index, size_t element_size,
+                       size_t* elements) {
+    size_t vec = deref(fb, field(fb, table, index));
+    if (!vec) return 0;
+    uint32_t length = read_u32(fb, vec);
+    if (fb->bad || !fits(fb, vec + 4, (size_t)length * element_size)) return 0;
+    *elements = vec + 4;
+    return length;
+}
+
+static bool read_tensor(FlatBuffer* fb, bool output, int index, TFLiteTensorInfo* info,
+                        const char** error) {
+    size_t root = read_u32(fb, 0);
+    size_t subgraphs;
+    if (vector(fb, root, MODEL_SUBGRAPHS, 4, &subgraphs) == 0) {
+        *error = "Model has no subgraph";
+        return false;
+    }
+    size_t subgraph = deref(fb, subgraphs);
+
+    size_t ids;
+    uint32_t count = vector(fb, subgraph, output ? SUBGRAPH_OUTPUTS : SUBGRAPH_INPUTS, 4, &ids);
+    if (index < 0 || (uint32_t)index >= count) {
+        *error = output ? "No such output tensor" : "No such input tensor";
+        return false;
+    }
+    uint32_t id = read_u32(fb, ids + 4 * (size_t)index);
+
+    size_t tensors;
+    uint32_t tensor_count = vector(fb, subgraph, SUBGRAPH_TENSORS, 4, &tensors);
+    if (id >= tensor_count) {
+        *error = "Tensor index out of range";
+        return false;
+    }
+    size_t tensor = deref(fb, tensors + 4 * (size_t)id);
+
+    memset(info, 0, sizeof(*info));
+    size_t type = field(fb, tensor, TENSOR_TYPE);
+    info->type = type && fits(fb, type, 1) ? fb->data[type] : TFLITE_TYPE_FLOAT32;
+
+    size_t dims;
+    uint32_t dim_count = vector(fb, tensor, TENSOR_SHAPE, 4, &dims);
+    for (uint32_t i = 0; i < dim_count && i < TFLITE_MAX_DIMS; i++) {
+        info->dims[i] = (int32_t)read_u32(fb, dims + 4 * (size_t)i);
+    }
+    info->dim_count = dim_count < TFLITE_MAX_DIMS ? (int)dim_count : TFLITE_MAX_DIMS;
+
+    size_t quantization = deref(fb, field(fb, tensor, TENSOR_QUANTIZATION));
+    size_t scales, zero_points;
+    if (quantization && vector(fb, quantization, QUANTIZATION_SCALE, 4, &scales) > 0) {
+        uint32_t bits = read_u32(fb, scales);
+        memcpy(&info->scale, &bits, sizeof(info->scale));
+        if (vector(fb, quantization, QUANTIZATION_ZERO_POINT, 8, &zero_points) > 0) {
+            uint64_t zero = (uint64_t)read_u32(fb, zero_points) |
+                            (uint64_t)read_u32(fb, zero_points + 4) << 32;
+            info->zero_point = (int64_t)zero;
+        }
+        info->quantized = info->scale > 0;
+    }
+
+    if (fb->bad) {
+        *error = "Model file is truncated or corrupt";
+        return false;
+    }
+    return true;
+}
+
+bool TFLite_GetTensorInfo(int fd, bool output, int index, TFLiteTensorInfo* info,
+                          char** error_msg) {
+    if (error_msg) *error_msg = NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 8) {
+        if (error_msg) *error_msg = strdup("Model file is empty or unreadable");
+        return false;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        if (error_msg) *error_msg = strdup("Model file could not be mapped");
+        return false;
+    }
+
+    FlatBuffer fb = { data, (size_t)st.st_size, false };
+    const char* error = NULL;
+    bool ok = memcmp(fb.data + 4, "TFL3", 4) == 0;
+    if (!ok) {
+        error = "Not a TFLite model (no TFL3 identifier)";
+    } else {
+        ok = read_tensor(&fb, output, index, info, &error);
+    }
+    munmap(data, st.st_size);
+
+    if (!ok && error_msg) *error_msg = strdup(error);
+    return ok;
+}
+
+const char* TFLite_TypeName(int type) {
+    switch (type) {
+    case TFLITE_TYPE_FLOAT32: return "float32";
+    case TFLITE_TYPE_FLOAT16: return "float16";
+    case TFLITE_TYPE_INT32: return "int32";
+    case TFLITE_TYPE_UINT8: return "uint8";
+    case TFLITE_TYPE_INT8: return "int8";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,50 @@
+/**
+ * tflite.h - TFLite Model File Introspection
+ *
+ * Reads what larod does not report from a .tflite file: the type, shape and
+ * quantization of the first subgraph's input and output tensors. The file is
+ * a FlatBuffer; only the few tables on the way to those tensors are walked,
+ * with every offset checked against the file size, so no TFLite or
+ * FlatBuffers library is needed.
+ */
+
+#ifndef TFLITE_H
+#define TFLITE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TFLITE_MAX_DIMS 8
+
+// TensorType values of the TFLite schema that models here use
+#define TFLITE_TYPE_FLOAT32 0
+#define TFLITE_TYPE_FLOAT16 1
+#define TFLITE_TYPE_INT32 2
+#define TFLITE_TYPE_UINT8 3
+#define TFLITE_TYPE_INT8 9
+
+typedef struct {
+    int type;                   // TFLITE_TYPE_*
+    int dims[TFLITE_MAX_DIMS];
+    int dim_count;
+    bool quantized;             // scale and zero_point are set
+    float scale;                // Per tensor, or the first channel's if per axis
+    int64_t zero_point;
+} TFLiteTensorInfo;
+
+/**
+ * @brief Describe an input or output tensor of the model in an open file
+ *
+ * Maps the file read-only; the file offset is left alone.
+ *
+ * @param output  Describe output index (false: input index)
+ * @param error_msg  Output: strdup'd message on failure (can be NULL)
+ * @return false if the file is no TFLite model or has no such tensor
+ */
+bool TFLite_GetTensorInfo(int fd, bool output, int index, TFLiteTensorInfo* info,
+                          char** error_msg);
+
+// "float32", "uint8", "int8", ... ("unknown" for others)
+const char* TFLite_TypeName(int type);
+
+#endif // TFLITE_H
@@ -2,14 +2,14 @@
 
 # Usage: ./build.sh [--clean]
 # --clean: Force rebuild without cache (slower but ensures fresh build)
-# default: Use cache (faster, TensorFlow only downloaded once)
+# default: Use cache (faster)
 
 CACHE_FLAG=""
 if [ "$1" = "--clean" ]; then
     CACHE_FLAG="--no-cache"
-    echo "Clean build (no cache) - TensorFlow will be downloaded"
+    echo "Clean build (no cache)"
 else
-    echo "Cached build - reusing TensorFlow layer"
+    echo "Cached build"
 fi
 
 echo ""
@@ -1,7 +1,9 @@
 /**
  * Batch Inference Example for Node.js
  *
- * Process multiple images in parallel with the inference server.
+ * Process multiple images in parallel with the inference server. Images are
+ * sent in groups through /inference-batch; --batch-size 1 sends one request
+ * per image instead.
  */
 
 const fs = require('fs').promises;
@@ -59,6 +61,72 @@ async function processSingleImage(client, imagePath, index, maxRetries = 3) {
     };
 }
 
+/**
+ * Process a group of images with one /inference-batch request, with retry logic
+ */
+async function processImageBatch(client, batch, maxRetries = 3) {
+    const failed = (error, attempts) => batch.map(({ index, imagePath }) => ({
+        index,
+        image: path.basename(imagePath),
+        success: false,
+        error,
+        attempts
+    }));
+
+    let items;
+    try {
+        items = await Promise.all(batch.map(async ({ index, imagePath }) => ({
+            index,
+            data: await fs.readFile(imagePath)
+        })));
+    } catch (error) {
+        return failed(error.message, 0);
+    }
+
+    for (let attempt = 0; attempt < maxRetries; attempt++) {
+        let results;
+        const startTime = Date.now();
+        try {
+            results = await client.inferBatch(items);
+        } catch (error) {
+            const errorMsg = error.message;
+
+            // If server is busy, wait and retry
+            if (errorMsg.includes('busy') || errorMsg.includes('503')) {
+                if (attempt < maxRetries - 1) {
+                    await new Promise(resolve => setTimeout(resolve, 500 * (attempt + 1)));
+                    continue;
+                }
+            }
+            return failed(errorMsg, attempt + 1);
+        }
+
+        // Time per image, comparable with single requests
+        const inferenceTime = (Date.now() - startTime) / 1000 / items.length;
+
+        return batch.map(({ index, imagePath }) => {
+            const result = results[index] || { status: 0, error: 'Missing from response' };
+            const success = result.status === 200 || result.status === 204;
+            return success ? {
+                index,
+                image: path.basename(imagePath),
+                success,
+                detections: result.detections || [],
+                inferenceTime,
+                attempts: attempt + 1
+            } : {
+                index,
+                image: path.basename(imagePath),
+                success,
+                error: result.error || `Status ${result.status}`,
+                attempts: attempt + 1
+            };
+        });
+    }
+
+    return failed('Max retries exceeded', maxRetries);
+}
+
 /**
  * Process all images in a directory
  */
@@ -66,6 +134,7 @@ async function batchInference(client, imageDir, options = {}) {
     const {
         outputFile = null,
         numWorkers = 3,
+        batchSize = 16,
         imageExtensions = ['.jpg', '.jpeg', '.png', '.JPG', '.JPEG', '.PNG']
     } = options;
 
@@ -83,7 +152,8 @@ async function batchInference(client, imageDir, options = {}) {
         return {};
     }
 
-    console.log(`Processing ${totalImages} images with ${numWorkers} workers...`);
+    console.log(`Processing ${totalImages} images with ${numWorkers} workers ` +
+        `(${batchSize} images per request)...`);
 
     // Create progress bar
     const progressBar = new ProgressBar('[:bar] :current/:total :percent :etas | Success: :success', {
@@ -98,12 +168,20 @@ async function batchInference(client, imageDir, options = {}) {
     const startTime = Date.now();
 
     async function worker(imageFiles, startIdx) {
-        for (let i = startIdx; i < imageFiles.length; i += numWorkers) {
-            const result = await processSingleImage(client, imageFiles[i], i);
-            results.push(result);
+        const step = numWorkers * batchSize;
+        for (let i = startIdx * batchSize; i < imageFiles.length; i += step) {
+            let batchResults;
+            if (batchSize > 1) {
+                const batch = imageFiles.slice(i, i + batchSize)
+                    .map((imagePath, k) => ({ index: i + k, imagePath }));
+                batchResults = await processImageBatch(client, batch);
+            } else {
+                batchResults = [await processSingleImage(client, imageFiles[i], i)];
+            }
+            results.push(...batchResults);
 
             const successCount = results.filter(r => r.success).length;
-            progressBar.tick({ success: `${successCount}/${results.length}` });
+            progressBar.tick(batchResults.length, { success: `${successCount}/${results.length}` });
         }
     }
 
@@ -202,6 +280,7 @@ if (require.main === module) {
         console.log('  --password <pass>  Camera password (default: pass)');
         console.log('  --output <file>    Output JSON file path');
         console.log('  --workers <n>      Number of parallel workers (default: 3)');
+        console.log('  --batch-size <n>   Images per request, max 64; 1 sends one request per image (default: 16)');
         console.log('');
         console.log('Example:');
         console.log('  node batch-inference.js ./images --output results.json --workers 3');
@@ -214,6 +293,8 @@ if (require.main === module) {
     const password = args.includes('--password') ? args[args.indexOf('--password') + 1] : 'pass';
     const outputFile = args.includes('--output') ? args[args.indexOf('--output') + 1] : null;
     const numWorkers = args.includes('--workers') ? parseInt(args[args.indexOf('--workers') + 1]) : 3;
+    const batchSize = args.includes('--batch-size') ?
+        Math.max(1, Math.min(64, parseInt(args[args.indexOf('--batch-size') + 1]))) : 16;
 
     (async () => {
         try {
@@ -221,7 +302,8 @@ if (require.main === module) {
 
             await batchInference(client, imageDir, {
                 outputFile,
-                numWorkers
+                numWorkers,
+                batchSize
             });
 
         } catch (error) {
@@ -231,4 +313,4 @@ if (require.main === module) {
     })();
 }
 
-module.exports = { batchInference, processSingleImage };
+module.exports = { batchInference, processSingleImage, processImageBatch };
@@ -104,6 +104,49 @@ class InferenceClient {
         }
     }
 
+    /**
+     * Perform inference on several images in one request
+     *
+     * Each item is sent as a little-endian int32 index and uint32 length
+     * followed by the JPEG bytes (or a raw RGB tensor of the model input size).
+     *
+     * @param {Array<{index: number, data: Buffer}>} items - At most 64 images
+     * @returns {Promise<Object>} Map of image index to {status, detections} or {status, error}
+     */
+    async inferBatch(items) {
+        const parts = [];
+        for (const item of items) {
+            const header = Buffer.alloc(8);
+            header.writeInt32LE(item.index, 0);
+            header.writeUInt32LE(item.data.length, 4);
+            parts.push(header, item.data);
+        }
+
+        const headers = {
+            'Content-Type': 'application/octet-stream'
+        };
+
+        try {
+            const response = await this.client.request({
+                method: 'POST',
+                url: `${this.baseUrl}/inference-batch`,
+                data: Buffer.concat(parts),
+                headers: headers
+            });
+
+            const results = {};
+            response.data.results.forEach(result => {
+                results[result.index] = result;
+            });
+            return results;
+        } catch (error) {
+            if (error.response && error.response.status === 503) {
+                throw new Error('Server busy - queue full');
+            }
+            throw error;
+        }
+    }
+
     /**
      * Perform inference on a preprocessed RGB tensor
      * @param {Buffer} tensorBuffer - RGB tensor data (width * height * 3 bytes)
@@ -3,6 +3,8 @@
 Batch Inference Example
 
 Demonstrates how to process multiple images efficiently with the inference server.
+Images are sent in groups through /inference-batch (one HTTP request and queue
+entry per group); --batch-size 1 sends one request per image instead.
 Includes error handling, retry logic, and progress tracking.
 """
 
@@ -10,11 +12,11 @@ import os
 import time
 import json
 from pathlib import Path
-from typing import List, Dict
+from typing import List, Dict, Tuple
 from concurrent.futures import ThreadPoolExecutor, as_completed
 from tqdm import tqdm
 
-from inference_client import InferenceClient
+from inference_client import InferenceClient, ServerBusyError
 
 
 def process_single_image(client: InferenceClient, image_path: str, index: int, max_retries: int = 3) -> Dict:
@@ -49,9 +51,9 @@ def process_single_image(client: InferenceClient, image_path: str, index: int, m
             error_msg = str(e)
 
             # If server is busy, wait and retry
-            if 'busy' in error_msg.lower() or '503' in error_msg:
+            if isinstance(e, ServerBusyError):
                 if attempt < max_retries - 1:
-                    time.sleep(0.5 * (attempt + 1))  # Exponential backoff
+                    time.sleep(retry_delay(e, attempt))
                     continue
 
             # Other errors
@@ -72,11 +74,81 @@ def process_single_image(client: InferenceClient, image_path: str, index: int, m
     }
 
 
+def retry_delay(error: ServerBusyError, attempt: int) -> float:
+    """Seconds to wait before retrying: the server's Retry-After, else backoff"""
+    if error.retry_after is not None:
+        return float(error.retry_after)
+    return 0.5 * (attempt + 1)
+
+
+def process_image_batch(client: InferenceClient, batch: List[Tuple[int, str]], max_retries: int = 3) -> List[Dict]:
+    """
+    Process a group of images with one /inference-batch request, with retry logic.
+
+    Args:
+        client: InferenceClient instance
+        batch: (index, image_path) pairs
+        max_retries: Maximum number of retry attempts
+
+    Returns:
+        One result dictionary per image (same format as process_single_image)
+    """
+    def failed(error_msg: str, attempts: int) -> List[Dict]:
+        return [{
+            'index': index,
+            'image': os.path.basename(image_path),
+            'success': False,
+            'error': error_msg,
+            'attempts': attempts
+        } for index, image_path in batch]
+
+    try:
+        items = [(index, client.load_jpeg(image_path)) for index, image_path in batch]
+    except Exception as e:
+        return failed(str(e), 0)
+
+    for attempt in range(max_retries):
+        try:
+            start_time = time.time()
+            results = client.infer_batch(items)
+            # Time per image, comparable with single requests
+            inference_time = (time.time() - start_time) / len(items)
+        except Exception as e:
+            error_msg = str(e)
+
+            # If server is busy, wait and retry
+            if isinstance(e, ServerBusyError):
+                if attempt < max_retries - 1:
+                    time.sleep(retry_delay(e, attempt))
+                    continue
+            return failed(error_msg, attempt + 1)
+
+        output = []
+        for index, image_path in batch:
+            result = results.get(index, {'status': 0, 'error': 'Missing from response'})
+            entry = {
+                'index': index,
+                'image': os.path.basename(image_path),
+                'success': result['status'] in (200, 204),
+                'attempts': attempt + 1
+            }
+            if entry['success']:
+                entry['detections'] = result.get('detections', [])
+                entry['inference_time'] = inference_time
+            else:
+                entry['error'] = result.get('error', f"Status {result['status']}")
+            output.append(entry)
+        return output
+
+    return failed('Max retries exceeded', max_retries)
+
+
 def batch_inference(
     client: InferenceClient,
     image_dir: str,
     output_file: str = None,
     num_workers: int = 3,
+    batch_size: int = 16,
     image_extensions: List[str] = ['.jpg', '.jpeg', '.png']
 ) -> Dict:
     """
@@ -87,6 +159,7 @@ def batch_inference(
         image_dir: Directory containing images
         output_file: Optional JSON output file path
         num_workers: Number of parallel workers (should match server queue size)
+        batch_size: Images per /inference-batch request (1: one request per image)
         image_extensions: List of image file extensions to process
 
     Returns:
@@ -106,7 +179,8 @@ def batch_inference(
         print(f"No images found in {image_dir}")
         return {}
 
-    print(f"Processing {total_images} images with {num_workers} workers...")
+    print(f"Processing {total_images} images with {num_workers} workers "
+          f"({batch_size} images per request)...")
 
     # Process images in parallel
     results = []
@@ -114,17 +188,24 @@ def batch_inference(
 
     with ThreadPoolExecutor(max_workers=num_workers) as executor:
         # Submit all tasks
-        futures = {
-            executor.submit(process_single_image, client, str(img_path), idx): idx
-            for idx, img_path in enumerate(image_files)
-        }
+        if batch_size > 1:
+            indexed = [(idx, str(img_path)) for idx, img_path in enumerate(image_files)]
+            futures = [
+                executor.submit(process_image_batch, client, indexed[i:i + batch_size])
+                for i in range(0, total_images, batch_size)
+            ]
+        else:
+            futures = [
+                executor.submit(lambda p, i: [process_single_image(client, p, i)], str(img_path), idx)
+                for idx, img_path in enumerate(image_files)
+            ]
 
         # Process results with progress bar
         with tqdm(total=total_images, desc="Processing") as pbar:
             for future in as_completed(futures):
-                result = future.result()
-                results.append(result)
-                pbar.update(1)
+                batch_results = future.result()
+                results.extend(batch_results)
+                pbar.update(len(batch_results))
 
                 # Update progress bar description with success rate
                 success_count = sum(1 for r in results if r['success'])
@@ -230,6 +311,10 @@ if __name__ == "__main__":
     parser.add_argument('--password', default='pass', help='Camera password')
     parser.add_argument('--output', help='Output JSON file path')
     parser.add_argument('--workers', type=int, default=3, help='Number of parallel workers')
+    parser.add_argument('--batch-size', type=int, default=16,
+                        help='Images per request, max 64 (1: one request per image)')
+    parser.add_argument('--priority', choices=['high', 'normal', 'low'],
+                        help='Scheduling class (default: low for batches, normal per image)')
 
     args = parser.parse_args()
 
@@ -237,7 +322,8 @@ if __name__ == "__main__":
     client = InferenceClient(
         host=args.host,
         username=args.username,
-        password=args.password
+        password=args.password,
+        priority=args.priority
     )
 
     # Run batch inference
@@ -245,5 +331,6 @@ if __name__ == "__main__":
         client=client,
         image_dir=args.image_dir,
         output_file=args.output,
-        num_workers=args.workers
+        num_workers=args.workers,
+        batch_size=max(1, min(args.batch_size, 64))
     )
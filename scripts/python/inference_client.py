@@ -35,6 +35,10 @@ Arguments:
     -m, --mode            Inference mode: jpeg, tensor, or both (default: both)
     -i, --index           Image index metadata sent to server (default: 0)
     -c, --confidence      Minimum confidence threshold 0.0-1.0 (default: 0.0)
+    -f, --format          Response format: full, lean, or bin (default: full)
+    -d, --deadline        Latency budget in ms; the server rejects early with
+                          Retry-After when the queue cannot meet it, and drops
+                          the request with 504 if it expires queued (optional)
 
 This script talks to an Axis camera inference server at /local/detectx
 and runs JPEG and/or tensor inference on the provided image using the model
@@ -44,6 +48,7 @@ configured on the camera.
 import argparse
 import io
 import json
+import struct
 import sys
 import time
 from typing import Dict, List, Optional, Tuple
@@ -55,10 +60,32 @@ from requests.auth import HTTPDigestAuth
 from PIL import Image
 
 
+class ServerBusyError(Exception):
+    """The server rejected a request with 503 (queue full or deadline not reachable)"""
+
+    def __init__(self, message: str, retry_after: Optional[int] = None):
+        super().__init__(message)
+        self.retry_after = retry_after  # Seconds suggested by Retry-After, if sent
+
+    @classmethod
+    def from_response(cls, response: requests.Response) -> 'ServerBusyError':
+        retry_after = response.headers.get('Retry-After')
+        return cls(
+            "Server busy - queue full",
+            int(retry_after) if retry_after and retry_after.isdigit() else None
+        )
+
+
+class RequestDroppedError(Exception):
+    """The server dropped a queued request unrun (504): deadline passed or superseded"""
+
+
 class InferenceClient:
     """Client for Axis Camera Inference Server"""
 
-    def __init__(self, host: str, username: str = None, password: str = None):
+    def __init__(self, host: str, username: str = None, password: str = None,
+                 deadline_ms: Optional[int] = None, stream_id: Optional[str] = None,
+                 priority: Optional[str] = None):
         """
         Initialize the inference client.
 
@@ -66,10 +93,23 @@ class InferenceClient:
             host: Camera IP or hostname (e.g., "192.168.1.100")
             username: Optional digest auth username
             password: Optional digest auth password
+            deadline_ms: Optional latency budget sent as X-Deadline-Ms; requests
+                the server cannot start in time fail fast with ServerBusyError
+            stream_id: Optional X-Stream-Id (max 31 chars); a queued frame of the
+                same stream is replaced by the next one (RequestDroppedError)
+            priority: Optional scheduling class sent as X-Priority: "high",
+                "normal" or "low" (default: the endpoint's class)
         """
         self.base_url = f"http://{host}/local/detectx"
         self.auth = HTTPDigestAuth(username, password) if username and password else None
         self.session = requests.Session()
+        if deadline_ms:
+            self.session.headers['X-Deadline-Ms'] = str(deadline_ms)
+        if stream_id:
+            self.session.headers['X-Stream-Id'] = stream_id
+        if priority:
+            self.session.headers['X-Priority'] = priority
+        self._labels = None
 
     def get_capabilities(self) -> Dict:
         """
@@ -95,7 +135,9 @@ class InferenceClient:
         response.raise_for_status()
         return response.json()
 
-    def infer_jpeg(self, image_path: str, image_index: int = -1) -> List[Dict]:
+    def infer_jpeg(
+        self, image_path: str, image_index: int = -1, result_format: str = "full"
+    ) -> List[Dict]:
         """
         Perform inference on a JPEG image.
         Automatically converts non-JPEG formats (PNG, BMP, etc.) to JPEG.
@@ -103,6 +145,7 @@ class InferenceClient:
         Args:
             image_path: Path to image file (JPEG, PNG, BMP, etc.)
             image_index: Optional image index for dataset validation
+            result_format: "full", "lean" or "bin" (packed binary, decoded here)
 
         Returns:
             List of detections, each containing:
@@ -112,14 +155,101 @@ class InferenceClient:
                 - confidence: Detection confidence (0.0-1.0)
                 - bbox_pixels: Bounding box in pixels {x, y, w, h}
                 - bbox_yolo: Normalized bounding box (center format)
+            For "lean" and "bin" only label, class_id, confidence and
+            bbox ([x, y, w, h] in pixels) are present.
 
         Raises:
             requests.HTTPError: If inference fails
         """
-        url = f"{self.base_url}/inference-jpeg"
+        image_data = self.load_jpeg(image_path)
+
+        headers = {'Content-Type': 'image/jpeg'}
+
+        return self._post_inference(
+            "inference-jpeg", image_data, headers, image_index, result_format
+        )
+
+    def _post_inference(
+        self, endpoint: str, data: bytes, headers: Dict,
+        image_index: int, result_format: str
+    ) -> List[Dict]:
+        params = {}
         if image_index >= 0:
-            url += f"?index={image_index}"
+            params['index'] = image_index
+        if result_format != "full":
+            params['format'] = result_format
+
+        response = self.session.post(
+            f"{self.base_url}/{endpoint}", params=params, data=data,
+            headers=headers, auth=self.auth
+        )
+
+        # Handle different status codes
+        if response.status_code == 200:
+            if result_format == "bin":
+                return self.decode_packed(response.content, self._get_labels())
+            return response.json()['detections']
+        elif response.status_code == 204:
+            return []  # No detections
+        elif response.status_code == 503:
+            raise ServerBusyError.from_response(response)
+        elif response.status_code == 504:
+            raise RequestDroppedError(response.text)
+        else:
+            response.raise_for_status()
+
+    def _get_labels(self) -> List[str]:
+        if self._labels is None:
+            self._labels = self.get_capabilities()['model']['classes']
+        return self._labels
+
+    @staticmethod
+    def decode_packed(data: bytes, labels: List[str]) -> List[Dict]:
+        """
+        Decode a packed binary response (format=bin).
 
+        Layout (little-endian): 16-byte header "DX", u8 version, u8 record
+        size, u16 count, u16 reserved, i32 index, u16 image width, u16 image
+        height; then per detection u16 class_id, f16 confidence and u16 x, y,
+        w, h in original image pixels.
+
+        Args:
+            data: Response body
+            labels: Class names from /capabilities, indexed by class_id
+
+        Returns:
+            List of detections in the lean format
+        """
+        magic, version, record_size, count, _, index, width, height = \
+            struct.unpack_from('<2sBBHHiHH', data, 0)
+        if magic != b'DX' or version != 1:
+            raise ValueError("Not a packed detection response")
+
+        detections = []
+        for i in range(count):
+            class_id, confidence, x, y, w, h = struct.unpack_from(
+                '<HeHHHH', data, 16 + i * record_size
+            )
+            known = class_id < len(labels)
+            detections.append({
+                'label': labels[class_id] if known else f"class_{class_id}",
+                'class_id': class_id if known else -1,
+                'confidence': confidence,
+                'bbox': [x, y, w, h],
+            })
+        return detections
+
+    @staticmethod
+    def load_jpeg(image_path: str) -> bytes:
+        """
+        Read an image as JPEG bytes, converting other formats in memory.
+
+        Args:
+            image_path: Path to image file (JPEG, PNG, BMP, etc.)
+
+        Returns:
+            JPEG encoded image data
+        """
         # Check if image needs conversion to JPEG
         img = Image.open(image_path)
         if img.format != 'JPEG':
@@ -129,30 +259,50 @@ class InferenceClient:
             if img.mode in ('RGBA', 'LA', 'P'):
                 img = img.convert('RGB')
             img.save(buffer, format='JPEG', quality=95)
-            image_data = buffer.getvalue()
-        else:
-            # Already JPEG, read directly
-            with open(image_path, 'rb') as f:
-                image_data = f.read()
+            return buffer.getvalue()
 
-        headers = {'Content-Type': 'image/jpeg'}
+        # Already JPEG, read directly
+        with open(image_path, 'rb') as f:
+            return f.read()
+
+    def infer_batch(self, items: List[Tuple[int, bytes]]) -> Dict[int, Dict]:
+        """
+        Perform inference on several images in one request.
+
+        Each item is sent as a little-endian int32 index and uint32 length
+        followed by the JPEG bytes (or a raw RGB tensor of the model input size).
+
+        Args:
+            items: (image_index, data) pairs, at most 64 per request
+
+        Returns:
+            Dictionary mapping image index to its result:
+                - status: Per-image HTTP status (200, 204, 400, ...)
+                - detections: List of detections (status 200/204)
+                - error: Error message (other statuses)
+
+        Raises:
+            ServerBusyError: If the server is busy (503)
+            requests.HTTPError: If the batch is rejected
+        """
+        url = f"{self.base_url}/inference-batch"
+
+        body = b''.join(struct.pack('<iI', index, len(data)) + data for index, data in items)
+        headers = {'Content-Type': 'application/octet-stream'}
 
         response = self.session.post(
-            url, data=image_data, headers=headers, auth=self.auth
+            url, data=body, headers=headers, auth=self.auth
         )
 
-        # Handle different status codes
-        if response.status_code == 200:
-            return response.json()['detections']
-        elif response.status_code == 204:
-            return []  # No detections
-        elif response.status_code == 503:
-            raise Exception("Server busy - queue full")
-        else:
-            response.raise_for_status()
+        if response.status_code == 503:
+            raise ServerBusyError.from_response(response)
+        response.raise_for_status()
+
+        return {result['index']: result for result in response.json()['results']}
 
     def infer_tensor(
-        self, rgb_array: np.ndarray, image_index: int = -1
+        self, rgb_array: np.ndarray, image_index: int = -1,
+        result_format: str = "full"
     ) -> List[Dict]:
         """
         Perform inference on a preprocessed RGB tensor.
@@ -161,6 +311,7 @@ class InferenceClient:
             rgb_array: NumPy array with shape (height, width, 3) and dtype uint8
                       Must match model input dimensions (typically 640x640x3)
             image_index: Optional image index for dataset validation
+            result_format: "full", "lean" or "bin" (see infer_jpeg)
 
         Returns:
             List of detections (same format as infer_jpeg)
@@ -169,10 +320,6 @@ class InferenceClient:
             ValueError: If array dimensions don't match model requirements
             requests.HTTPError: If inference fails
         """
-        url = f"{self.base_url}/inference-tensor"
-        if image_index >= 0:
-            url += f"?index={image_index}"
-
         # Validate array shape
         if rgb_array.ndim != 3 or rgb_array.shape[2] != 3:
             raise ValueError(f"Expected shape (H, W, 3), got {rgb_array.shape}")
@@ -185,19 +332,10 @@ class InferenceClient:
 
         headers = {'Content-Type': 'application/octet-stream'}
 
-        response = self.session.post(
-            url, data=tensor_bytes, headers=headers, auth=self.auth
+        return self._post_inference(
+            "inference-tensor", tensor_bytes, headers, image_index, result_format
         )
 
-        if response.status_code == 200:
-            return response.json()['detections']
-        elif response.status_code == 204:
-            return []
-        elif response.status_code == 503:
-            raise Exception("Server busy - queue full")
-        else:
-            response.raise_for_status()
-
     def preprocess_image_to_tensor(
         self, image_path: str, target_size: Tuple[int, int] = (640, 640)
     ) -> np.ndarray:
@@ -285,9 +423,33 @@ def parse_args() -> argparse.Namespace:
         help="Minimum confidence threshold (0.0-1.0, default: 0.0 shows all)"
     )
 
+    parser.add_argument(
+        "--format", "-f",
+        choices=["full", "lean", "bin"],
+        default="full",
+        help="Response format: full JSON, lean JSON or packed binary (default: full)"
+    )
+
+    parser.add_argument(
+        "--deadline", "-d",
+        type=int,
+        default=None,
+        help="Latency budget in ms sent as X-Deadline-Ms (default: none)"
+    )
+
     return parser.parse_args()
 
 
+def print_detections(detections: List[Dict]) -> None:
+    for det in detections:
+        if 'bbox_pixels' in det:
+            box = det['bbox_pixels']
+            x, y, w, h = box['x'], box['y'], box['w'], box['h']
+        else:
+            x, y, w, h = det['bbox']
+        print(f"  - {det['label']}: {det['confidence']:.2%} at ({x}, {y}) {w}x{h}")
+
+
 def main() -> None:
     args = parse_args()
 
@@ -296,6 +458,7 @@ def main() -> None:
         host=args.host,
         username=args.username,
         password=args.password,
+        deadline_ms=args.deadline,
     )
 
     # Get server capabilities
@@ -319,7 +482,9 @@ def main() -> None:
     if args.mode in ("jpeg", "both"):
         print("=== JPEG Inference ===")
         start_time = time.time()
-        detections = client.infer_jpeg(image_path, image_index=args.index)
+        detections = client.infer_jpeg(
+            image_path, image_index=args.index, result_format=args.format
+        )
         inference_time_ms = (time.time() - start_time) * 1000
 
         # Filter by confidence threshold
@@ -329,13 +494,7 @@ def main() -> None:
         print(f"Inference time: {inference_time_ms:.1f} ms")
         print(f"Found {len(detections)} objects (confidence >= {args.confidence:.0%}):")
 
-        # Show individual detections
-        for det in detections:
-            print(
-                f"  - {det['label']}: {det['confidence']:.2%} at "
-                f"({det['bbox_pixels']['x']}, {det['bbox_pixels']['y']}) "
-                f"{det['bbox_pixels']['w']}x{det['bbox_pixels']['h']}"
-            )
+        print_detections(detections)
 
         # Show label summary
         if detections:
@@ -355,7 +514,9 @@ def main() -> None:
         print(f"Preprocessing time: {preprocess_time_ms:.1f} ms")
 
         inference_start = time.time()
-        detections = client.infer_tensor(tensor, image_index=args.index)
+        detections = client.infer_tensor(
+            tensor, image_index=args.index, result_format=args.format
+        )
         inference_time_ms = (time.time() - inference_start) * 1000
 
         # Filter by confidence threshold
@@ -366,13 +527,7 @@ def main() -> None:
         print(f"Total time: {preprocess_time_ms + inference_time_ms:.1f} ms")
         print(f"Found {len(detections)} objects (confidence >= {args.confidence:.0%}):")
 
-        # Show individual detections
-        for det in detections:
-            print(
-                f"  - {det['label']}: {det['confidence']:.2%} at "
-                f"({det['bbox_pixels']['x']}, {det['bbox_pixels']['y']}) "
-                f"{det['bbox_pixels']['w']}x{det['bbox_pixels']['h']}"
-            )
+        print_detections(detections)
 
         # Show label summary
         if detections:
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""
+Streaming Inference Example
+
+Pushes images over one persistent TCP connection to the server's stream
+port (server.stream_port in settings.json) and prints detections as they
+come back. Frames are pipelined: up to --window frames are sent before the
+first result arrives, so there is no per-image request setup.
+
+Usage:
+  python3 stream_inference.py /path/to/images --host 192.168.1.100 --port 8555
+
+Frames and results both use the /inference-batch item framing: int32 index
+and uint32 length (little-endian), then the payload. Results are JSON
+objects {index, status, detections | error} and may arrive out of order.
+"""
+
+import argparse
+import json
+import socket
+import struct
+import threading
+import time
+from pathlib import Path
+from typing import Callable, Dict, Optional
+
+from inference_client import InferenceClient
+
+
+class StreamClient:
+    """Persistent inference stream to the server's TCP listener"""
+
+    def __init__(self, host: str, port: int, token: Optional[str] = None,
+                 window: int = 4):
+        """
+        Connect to the stream listener.
+
+        Args:
+            host: Camera IP address or hostname
+            port: Stream port configured on the camera
+            token: Stream token, if one is configured on the camera
+            window: Frames sent ahead of their results (server allows 4 in flight)
+        """
+        self.sock = socket.create_connection((host, port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.window = threading.Semaphore(window)
+        if token:
+            self._send(-1, token.encode())
+
+    def _send(self, index: int, payload: bytes):
+        self.sock.sendall(struct.pack('<iI', index, len(payload)) + payload)
+
+    def _recv_exact(self, size: int) -> Optional[bytes]:
+        data = b''
+        while len(data) < size:
+            chunk = self.sock.recv(size - len(data))
+            if not chunk:
+                return None
+            data += chunk
+        return data
+
+    def send_frame(self, index: int, data: bytes):
+        """Send a JPEG or model-size RGB tensor; blocks while the window is full"""
+        self.window.acquire()
+        self._send(index, data)
+
+    def receive(self, on_result: Callable[[Dict], None]):
+        """Read results until the server closes the connection"""
+        while True:
+            header = self._recv_exact(8)
+            if header is None:
+                return
+            _, length = struct.unpack('<iI', header)
+            payload = self._recv_exact(length)
+            if payload is None:
+                return
+            self.window.release()
+            on_result(json.loads(payload))
+
+    def close_send(self):
+        """Stop sending; results of frames in flight still arrive"""
+        self.sock.shutdown(socket.SHUT_WR)
+
+    def close(self):
+        self.sock.close()
+
+
+def stream_directory(client: StreamClient, image_dir: str) -> Dict[int, Dict]:
+    """
+    Stream every image in a directory and collect the results.
+
+    Returns:
+        Map of frame index to result
+    """
+    extensions = {'.jpg', '.jpeg', '.png', '.bmp'}
+    images = sorted(p for p in Path(image_dir).iterdir() if p.suffix.lower() in extensions)
+    results = {}
+
+    def on_result(result: Dict):
+        results[result['index']] = result
+        name = images[result['index']].name if 0 <= result['index'] < len(images) else '?'
+        if result['status'] in (200, 204):
+            print(f"{name}: {len(result.get('detections', []))} detections")
+        else:
+            print(f"{name}: {result['status']} {result.get('error', '')}")
+
+    reader = threading.Thread(target=client.receive, args=(on_result,))
+    reader.start()
+
+    start = time.time()
+    for index, path in enumerate(images):
+        client.send_frame(index, InferenceClient.load_jpeg(str(path)))
+    client.close_send()
+    reader.join()
+    elapsed = time.time() - start
+
+    print(f"\n{len(results)}/{len(images)} results in {elapsed:.2f} s "
+          f"({len(results) / elapsed if elapsed > 0 else 0:.1f} frames/s)")
+    return results
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Streaming image inference")
+    parser.add_argument('image_dir', help='Directory containing images')
+    parser.add_argument('--host', default='192.168.1.100', help='Camera IP address')
+    parser.add_argument('--port', type=int, required=True, help='Stream port (server.stream_port)')
+    parser.add_argument('--token', help='Stream token (server.stream_token)')
+    parser.add_argument('--window', type=int, default=4, help='Frames in flight (default: 4)')
+
+    args = parser.parse_args()
+
+    client = StreamClient(args.host, args.port, args.token, max(1, args.window))
+    try:
+        stream_directory(client, args.image_dir)
+    finally:
+        client.close()